@@ -0,0 +1,305 @@
+/*
+ * wakeup-latency.c
+ *
+ * Measure how late a periodic "UI" thread wakes up while CPU hogs run
+ * in a background cpu cgroup, optionally held to a CFS bandwidth quota
+ * and with the foreground preferring its wakeups.
+ *
+ * The measuring thread stays in the cgroup it was started in (the root
+ * group on Android), sleeps to an absolute deadline every frame, and
+ * does a little work once woken, as a UI thread would.  The hogs are
+ * moved to a background group created for the run and removed after.
+ *
+ * Compile with:
+ *	gcc -O2 -Wall -o wakeup-latency wakeup-latency.c -lrt
+ *
+ * For example, compare:
+ *	wakeup-latency -n 4
+ *	wakeup-latency -n 4 -q 20000 -b
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define NSEC_PER_SEC	1000000000LL
+#define NSEC_PER_USEC	1000LL
+
+#define MAX_HOGS	64
+#define MAX_SAMPLES	100000
+
+static const char *cgroup = "/dev/cpuctl";
+static char bg_group[256];
+static int nr_hogs = 2;
+static long quota_us = -1;
+static long period_us = 100000;
+static int boost;
+static int seconds = 10;
+static long frame_us = 16667;
+static long work_us = 2000;
+
+static pid_t hogs[MAX_HOGS];
+static long long samples[MAX_SAMPLES];
+static int old_boost = -1;
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static int write_file(const char *dir, const char *name, const char *val)
+{
+	char path[512];
+	FILE *f;
+	int ret = 0;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "w");
+	if (!f) {
+		fprintf(stderr, "open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (fputs(val, f) < 0)
+		ret = -1;
+	if (fclose(f))
+		ret = -1;
+	if (ret)
+		fprintf(stderr, "write %s to %s: %s\n", val, path,
+			strerror(errno));
+	return ret;
+}
+
+static int read_file(const char *dir, const char *name, char *buf, int len)
+{
+	char path[512];
+	FILE *f;
+	size_t n;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	n = fread(buf, 1, len - 1, f);
+	buf[n] = '\0';
+	fclose(f);
+	return 0;
+}
+
+static void hog(void)
+{
+	volatile unsigned long i = 0;
+
+	for (;;)
+		i++;
+}
+
+static int setup(void)
+{
+	char buf[32];
+	int i;
+
+	snprintf(bg_group, sizeof(bg_group), "%s/wakeup-latency-bg", cgroup);
+	if (mkdir(bg_group, 0755) && errno != EEXIST) {
+		fprintf(stderr, "mkdir %s: %s\n", bg_group, strerror(errno));
+		return -1;
+	}
+
+	if (quota_us >= 0) {
+		snprintf(buf, sizeof(buf), "%ld", period_us);
+		if (write_file(bg_group, "cpu.cfs_period_us", buf))
+			return -1;
+		snprintf(buf, sizeof(buf), "%ld", quota_us);
+		if (write_file(bg_group, "cpu.cfs_quota_us", buf))
+			return -1;
+	}
+
+	if (boost) {
+		if (!read_file(cgroup, "cpu.wakeup_boost", buf, sizeof(buf)))
+			old_boost = atoi(buf);
+		if (write_file(cgroup, "cpu.wakeup_boost", "1"))
+			return -1;
+	}
+
+	for (i = 0; i < nr_hogs; i++) {
+		hogs[i] = fork();
+		if (hogs[i] < 0) {
+			perror("fork");
+			return -1;
+		}
+		if (!hogs[i])
+			hog();
+		snprintf(buf, sizeof(buf), "%d", hogs[i]);
+		if (write_file(bg_group, "tasks", buf))
+			return -1;
+	}
+
+	return 0;
+}
+
+static void cleanup(void)
+{
+	char buf[256];
+	int i;
+
+	for (i = 0; i < nr_hogs; i++) {
+		if (hogs[i] > 0) {
+			kill(hogs[i], SIGKILL);
+			waitpid(hogs[i], NULL, 0);
+		}
+	}
+
+	if (!read_file(bg_group, "cpu.stat", buf, sizeof(buf)))
+		printf("background cpu.stat:\n%s", buf);
+
+	if (old_boost >= 0) {
+		snprintf(buf, sizeof(buf), "%d", old_boost);
+		write_file(cgroup, "cpu.wakeup_boost", buf);
+	}
+
+	rmdir(bg_group);
+}
+
+static void on_signal(int sig)
+{
+	cleanup();
+	_exit(1);
+}
+
+static int cmp_ll(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int measure(void)
+{
+	long long next, start, end, sum = 0;
+	struct timespec ts;
+	int n = 0;
+
+	start = now_ns();
+	end = start + seconds * NSEC_PER_SEC;
+	next = start;
+
+	while (n < MAX_SAMPLES) {
+		long long woke, busy_until;
+
+		next += frame_us * NSEC_PER_USEC;
+		if (next > end)
+			break;
+
+		ts.tv_sec = next / NSEC_PER_SEC;
+		ts.tv_nsec = next % NSEC_PER_SEC;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				       &ts, NULL) == EINTR)
+			;
+
+		woke = now_ns();
+		samples[n++] = woke - next;
+		sum += woke - next;
+
+		/* a frame's worth of work */
+		busy_until = woke + work_us * NSEC_PER_USEC;
+		while (now_ns() < busy_until)
+			;
+
+		/* don't try to catch up on missed frames */
+		if (now_ns() > next + frame_us * NSEC_PER_USEC)
+			next = now_ns();
+	}
+
+	if (!n) {
+		fprintf(stderr, "no samples\n");
+		return -1;
+	}
+
+	qsort(samples, n, sizeof(samples[0]), cmp_ll);
+	printf("%d hogs, quota %ld us / %ld us, wakeup boost %s\n",
+	       nr_hogs, quota_us, period_us, boost ? "on" : "off");
+	printf("%d wakeups: min %lld avg %lld p50 %lld p99 %lld max %lld us\n",
+	       n, samples[0] / NSEC_PER_USEC, sum / n / NSEC_PER_USEC,
+	       samples[n / 2] / NSEC_PER_USEC,
+	       samples[n * 99 / 100] / NSEC_PER_USEC,
+	       samples[n - 1] / NSEC_PER_USEC);
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -c path  cpu cgroup mount point (default %s)\n"
+		"  -n hogs  background CPU hogs (default %d)\n"
+		"  -q us    background cpu.cfs_quota_us (default unlimited)\n"
+		"  -p us    background cpu.cfs_period_us (default %ld)\n"
+		"  -b       set cpu.wakeup_boost on the foreground group\n"
+		"  -t secs  duration (default %d)\n"
+		"  -f us    frame interval (default %ld)\n"
+		"  -w us    work done each frame (default %ld)\n",
+		name, cgroup, nr_hogs, period_us, seconds, frame_us, work_us);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int opt, ret;
+
+	while ((opt = getopt(argc, argv, "c:n:q:p:bt:f:w:")) != -1) {
+		switch (opt) {
+		case 'c':
+			cgroup = optarg;
+			break;
+		case 'n':
+			nr_hogs = atoi(optarg);
+			break;
+		case 'q':
+			quota_us = atol(optarg);
+			break;
+		case 'p':
+			period_us = atol(optarg);
+			break;
+		case 'b':
+			boost = 1;
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'f':
+			frame_us = atol(optarg);
+			break;
+		case 'w':
+			work_us = atol(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (nr_hogs < 0 || nr_hogs > MAX_HOGS || seconds <= 0 ||
+	    frame_us <= 0 || work_us < 0)
+		usage(argv[0]);
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	ret = setup();
+	if (!ret)
+		ret = measure();
+	cleanup();
+
+	return ret ? 1 : 0;
+}
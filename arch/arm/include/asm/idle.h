@@ -0,0 +1,15 @@
+#ifndef __ASM_ARM_IDLE_H
+#define __ASM_ARM_IDLE_H
+
+/*
+ * Called with interrupts enabled around each call of pm_idle from the
+ * idle loop, whoever owns pm_idle.
+ */
+#define IDLE_START 1
+#define IDLE_END 2
+
+struct notifier_block;
+void idle_notifier_register(struct notifier_block *n);
+void idle_notifier_unregister(struct notifier_block *n);
+
+#endif /* __ASM_ARM_IDLE_H */
@@ -0,0 +1,210 @@
+/* arch/arm/mach-msm/cache_maint.c
+ *
+ * Cache maintenance for buffers shared with other bus masters.
+ *
+ * Cleaning a buffer line by line costs time in proportion to its size,
+ * while cleaning the whole cache by set/way costs about the same however
+ * much of it is dirty.  Callers describe the ranges they need maintained;
+ * once their total reaches the threshold the whole cache is cleaned and
+ * invalidated instead.  Invalidating alone is always done by range, as
+ * invalidating the whole cache would throw away dirty lines that belong
+ * to someone else.
+ *
+ * The time spent is accounted per client, operation and method, and
+ * shown in /sys/kernel/debug/cache_maint/stats (write to it to reset).
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/debugfs.h>
+#include <linux/math64.h>
+#include <asm/cacheflush.h>
+#include <asm/sizes.h>
+
+#include <mach/cache_maint.h>
+
+#define CACHE_MAINT_NR_OPS	3
+
+/* Roughly the size of the L2 on QSD8x50: past this, walking the cache by
+ * set/way touches fewer lines than walking the buffer by address.
+ */
+static u32 cache_maint_threshold = SZ_256K;
+
+struct cache_maint_stat {
+	unsigned long count;
+	u64 bytes;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+/* [client][op - 1][whole] */
+static struct cache_maint_stat
+	cache_maint_stats[CACHE_MAINT_NR_CLIENTS][CACHE_MAINT_NR_OPS][2];
+static DEFINE_SPINLOCK(cache_maint_lock);
+
+void cache_maint_begin(struct cache_maint *cm, int client, unsigned op,
+		       unsigned long bytes)
+{
+	BUG_ON(op < CACHE_MAINT_CLEAN || op > CACHE_MAINT_FLUSH);
+
+	cm->client = client;
+	cm->op = op;
+	cm->bytes = bytes;
+	cm->whole = 0;
+	cm->start = ktime_get();
+
+#ifndef CONFIG_OUTER_CACHE
+	/* an outer cache can only be maintained by range */
+	if ((op & CACHE_MAINT_CLEAN) && bytes >= cache_maint_threshold) {
+		flush_cache_all();
+		cm->whole = 1;
+	}
+#endif
+}
+
+void cache_maint_range(struct cache_maint *cm, void *vaddr,
+		       unsigned long paddr, unsigned long len)
+{
+	if (cm->whole || !len)
+		return;
+
+	switch (cm->op) {
+	case CACHE_MAINT_CLEAN:
+		dmac_clean_range(vaddr, vaddr + len);
+		outer_clean_range(paddr, paddr + len);
+		break;
+	case CACHE_MAINT_INV:
+		dmac_inv_range(vaddr, vaddr + len);
+		outer_inv_range(paddr, paddr + len);
+		break;
+	default:
+		dmac_flush_range(vaddr, vaddr + len);
+		outer_flush_range(paddr, paddr + len);
+		break;
+	}
+}
+
+void cache_maint_end(struct cache_maint *cm)
+{
+	struct cache_maint_stat *stat;
+	unsigned long flags;
+	u64 ns;
+
+	flush_axi_bus_buffer();
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), cm->start));
+	stat = &cache_maint_stats[cm->client][cm->op - 1][cm->whole];
+
+	spin_lock_irqsave(&cache_maint_lock, flags);
+	stat->count++;
+	stat->bytes += cm->bytes;
+	stat->total_ns += ns;
+	if (ns > stat->max_ns)
+		stat->max_ns = ns;
+	spin_unlock_irqrestore(&cache_maint_lock, flags);
+}
+
+#if defined(CONFIG_DEBUG_FS)
+
+#define DEBUG_BUFMAX 2048
+
+static const char *cache_maint_clients[CACHE_MAINT_NR_CLIENTS] = {
+	[CACHE_MAINT_PMEM] = "pmem",
+	[CACHE_MAINT_KGSL] = "kgsl",
+	[CACHE_MAINT_MDP] = "mdp",
+};
+
+static const char *cache_maint_ops[CACHE_MAINT_NR_OPS] = {
+	"clean", "inv", "flush",
+};
+
+static ssize_t debug_read_stats(struct file *file, char __user *ubuf,
+				size_t count, loff_t *ppos)
+{
+	struct cache_maint_stat stat;
+	unsigned long flags;
+	char *buf;
+	int client, op, whole;
+	int n = 0;
+	ssize_t ret;
+
+	buf = kmalloc(DEBUG_BUFMAX, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	n += scnprintf(buf + n, DEBUG_BUFMAX - n, "threshold %u bytes\n",
+		       cache_maint_threshold);
+	n += scnprintf(buf + n, DEBUG_BUFMAX - n,
+		       "%-6s %-5s %-5s %8s %10s %9s %9s\n", "client", "op",
+		       "how", "count", "KB", "avg ns", "max ns");
+	for (client = 0; client < CACHE_MAINT_NR_CLIENTS; client++)
+		for (op = 0; op < CACHE_MAINT_NR_OPS; op++)
+			for (whole = 0; whole < 2; whole++) {
+				spin_lock_irqsave(&cache_maint_lock, flags);
+				stat = cache_maint_stats[client][op][whole];
+				spin_unlock_irqrestore(&cache_maint_lock,
+						       flags);
+				if (!stat.count)
+					continue;
+				n += scnprintf(buf + n, DEBUG_BUFMAX - n,
+					       "%-6s %-5s %-5s %8lu %10llu "
+					       "%9llu %9llu\n",
+					       cache_maint_clients[client],
+					       cache_maint_ops[op],
+					       whole ? "whole" : "range",
+					       stat.count, stat.bytes >> 10,
+					       div64_u64(stat.total_ns,
+							 stat.count),
+					       stat.max_ns);
+			}
+
+	ret = simple_read_from_buffer(ubuf, count, ppos, buf, n);
+	kfree(buf);
+	return ret;
+}
+
+static ssize_t debug_reset_stats(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&cache_maint_lock, flags);
+	memset(cache_maint_stats, 0, sizeof(cache_maint_stats));
+	spin_unlock_irqrestore(&cache_maint_lock, flags);
+	return count;
+}
+
+static const struct file_operations debug_stats_fops = {
+	.read = debug_read_stats,
+	.write = debug_reset_stats,
+};
+
+static int __init cache_maint_debug_init(void)
+{
+	struct dentry *dent;
+
+	dent = debugfs_create_dir("cache_maint", 0);
+	if (IS_ERR(dent))
+		return PTR_ERR(dent);
+
+	debugfs_create_file("stats", 0644, dent, NULL, &debug_stats_fops);
+	debugfs_create_u32("threshold", 0644, dent, &cache_maint_threshold);
+	return 0;
+}
+
+late_initcall(cache_maint_debug_init);
+#endif
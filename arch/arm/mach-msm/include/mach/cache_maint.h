@@ -0,0 +1,60 @@
+/* arch/arm/mach-msm/include/mach/cache_maint.h
+ *
+ * Cache maintenance for buffers shared with other bus masters.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef __ASM_ARCH_MSM_CACHE_MAINT_H
+#define __ASM_ARCH_MSM_CACHE_MAINT_H
+
+#include <linux/types.h>
+#include <linux/ktime.h>
+
+/* operations; the pmem and kgsl ioctls use the same encoding */
+#define CACHE_MAINT_CLEAN	1
+#define CACHE_MAINT_INV		2
+#define CACHE_MAINT_FLUSH	(CACHE_MAINT_CLEAN | CACHE_MAINT_INV)
+
+/* who asked, for the statistics */
+enum {
+	CACHE_MAINT_PMEM,
+	CACHE_MAINT_KGSL,
+	CACHE_MAINT_MDP,
+	CACHE_MAINT_NR_CLIENTS,
+};
+
+struct cache_maint {
+	int client;
+	unsigned op;
+	unsigned long bytes;
+	int whole;		/* the whole cache was flushed in begin */
+	ktime_t start;
+};
+
+/* Usage:
+ *
+ *	cache_maint_begin(&cm, CACHE_MAINT_PMEM, op, total_bytes);
+ *	for each range
+ *		cache_maint_range(&cm, vaddr, paddr, len);
+ *	cache_maint_end(&cm);
+ *
+ * If total_bytes is large enough, begin flushes the whole cache and the
+ * per-range calls do nothing; callers that have to work to find their
+ * ranges can check cm.whole and skip that.
+ */
+void cache_maint_begin(struct cache_maint *cm, int client, unsigned op,
+		       unsigned long bytes);
+void cache_maint_range(struct cache_maint *cm, void *vaddr,
+		       unsigned long paddr, unsigned long len);
+void cache_maint_end(struct cache_maint *cm);
+
+#endif
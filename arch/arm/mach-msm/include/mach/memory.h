@@ -48,6 +48,7 @@ void *alloc_bootmem_aligned(unsigned long size, unsigned long alignment);
 void clean_and_invalidate_caches(unsigned long, unsigned long, unsigned long);
 void clean_caches(unsigned long, unsigned long, unsigned long);
 void invalidate_caches(unsigned long, unsigned long, unsigned long);
+void flush_axi_bus_buffer(void);
 
 #ifdef CONFIG_ARCH_MSM_ARM11
 void write_to_strongly_ordered_memory(void);
@@ -193,6 +193,11 @@ struct mdp_device {
 	void (*dma_wait)(struct mdp_device *mdp, int interface);
 	int (*blit)(struct mdp_device *mdp, struct fb_info *fb,
 		    struct mdp_blit_req *req);
+	int (*blit_queue)(struct mdp_device *mdp, struct fb_info *fb,
+			  struct mdp_blit_req *req, int count,
+			  uint32_t *fence);
+	int (*blit_wait)(struct mdp_device *mdp, uint32_t fence,
+			 unsigned long timeout);
 	void (*set_grp_disp)(struct mdp_device *mdp, uint32_t disp_id);
 	void (*configure_dma)(struct mdp_device *mdp);
 	int (*check_output_format)(struct mdp_device *mdp, int bpp);
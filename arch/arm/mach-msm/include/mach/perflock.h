@@ -19,7 +19,8 @@
 #ifndef __ARCH_ARM_MACH_PERF_LOCK_H
 #define __ARCH_ARM_MACH_PERF_LOCK_H
 
-#include <linux/list.h>
+#include <linux/workqueue.h>
+#include <linux/pm_qos_params.h>
 
 /*
  * Performance level determine differnt EBI1 rate
@@ -33,7 +34,8 @@ enum {
 };
 
 struct perf_lock {
-	struct list_head link;
+	struct pm_qos_request qos;	/* PM_QOS_CPU_FREQ_MIN, while held */
+	struct delayed_work release;
 	unsigned int flags;
 	unsigned int level;
 	const char *name;
@@ -3,6 +3,14 @@
  * Copyright (C) 2008 HTC Corporation
  * Author: Eiven Peng <eiven_peng@htc.com>
  *
+ * A perf_lock holds the cpu at the speed of its level while it is active,
+ * and for PERF_UNLOCK_DELAY after it is released.  Each held lock keeps a
+ * PM_QOS_CPU_FREQ_MIN request named after it, so /sys/kernel/debug/pm_qos
+ * shows which of them set the speed, and all of them share one
+ * PM_QOS_CPU_FREQ_MAX request at the speed of the highest level held.
+ * cpufreq applies both, and the highest level is found from a count of
+ * the locks held at each level rather than by walking them.
+ *
  * This software is licensed under the terms of the GNU General Public
  * License version 2, as published by the Free Software Foundation, and
  * may be copied, distributed, and modified under those terms.
@@ -21,101 +29,130 @@
 #include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
 #include <linux/cpufreq.h>
-#include <linux/timer.h>
+#include <linux/mutex.h>
+#include <linux/pm_qos_params.h>
 #include <mach/perflock.h>
 #include "proc_comm.h"
 #include "acpuclock.h"
 
 #define PERF_LOCK_INITIALIZED	(1U << 0)
 #define PERF_LOCK_ACTIVE	(1U << 1)
+#define PERF_LOCK_HELD		(1U << 2)	/* qos request in place */
 
 enum {
 	PERF_LOCK_DEBUG = 1U << 0,
 	PERF_EXPIRE_DEBUG = 1U << 1,
-	PERF_CPUFREQ_NOTIFY_DEBUG = 1U << 2,
 	PERF_CPUFREQ_LOCK_DEBUG = 1U << 3,
 	PERF_SCREEN_ON_POLICY_DEBUG = 1U << 4,
 };
 
-static LIST_HEAD(active_perf_locks);
-static LIST_HEAD(inactive_perf_locks);
-static DEFINE_SPINLOCK(list_lock);
-static DEFINE_SPINLOCK(policy_update_lock);
+static DEFINE_MUTEX(perflock_mutex);
 static int initialized;
 static unsigned int *perf_acpu_table;
 static unsigned int table_size;
 static unsigned int curr_lock_speed;
-static struct cpufreq_policy *cpufreq_policy;
+static unsigned int nr_active;
+static unsigned int nr_held[PERF_LOCK_INVALID];
+static struct pm_qos_request perflock_ceiling;
 
 #ifdef CONFIG_PERF_LOCK_DEBUG
 static int debug_mask = PERF_LOCK_DEBUG | PERF_EXPIRE_DEBUG |
-	PERF_CPUFREQ_NOTIFY_DEBUG | PERF_CPUFREQ_LOCK_DEBUG;
+	PERF_CPUFREQ_LOCK_DEBUG;
 #else
 static int debug_mask = PERF_CPUFREQ_LOCK_DEBUG | PERF_SCREEN_ON_POLICY_DEBUG;
 #endif
 module_param_call(debug_mask, param_set_int, param_get_int,
 		&debug_mask, S_IWUSR | S_IRUGO);
 
-static unsigned int get_perflock_speed(void);
-static void print_active_locks(void);
+static unsigned int policy_min;
+static unsigned int policy_max;
 
 #ifdef CONFIG_PERFLOCK_SCREEN_POLICY
 /* Increase cpufreq minumum frequency when screen on.
     Pull down to lowest speed when screen off. */
-static unsigned int screen_off_policy_req;
-static unsigned int screen_on_policy_req;
-static void perflock_early_suspend(struct early_suspend *handler)
+static struct pm_qos_request screen_floor;
+static struct pm_qos_request screen_ceiling;
+static unsigned int screen_max = CONFIG_PERFLOCK_SCREEN_ON_MAX;
+#endif
+
+/* the speed of the highest level held in kHz, 0 if none is held */
+static unsigned int get_perflock_speed(void)
+{
+	int level;
+
+	for (level = PERF_LOCK_INVALID - 1; level >= 0; level--)
+		if (nr_held[level])
+			return perf_acpu_table[level] / 1000;
+	return 0;
+}
+
+/* called with perflock_mutex held, after a lock is taken or dropped */
+static void perflock_update_ceiling(void)
 {
-	unsigned long irqflags;
+	unsigned int lock_speed = get_perflock_speed();
 
-	spin_lock_irqsave(&policy_update_lock, irqflags);
-	if (screen_on_policy_req) {
-		screen_on_policy_req--;
-		spin_unlock_irqrestore(&policy_update_lock, irqflags);
+	if (lock_speed == curr_lock_speed)
 		return;
+	curr_lock_speed = lock_speed;
+
+	if (debug_mask & PERF_CPUFREQ_LOCK_DEBUG) {
+		if (lock_speed)
+			pr_info("%s: cpufreq lock speed %d\n",
+				__func__, lock_speed);
+		else
+			pr_info("%s: cpufreq recover policy\n", __func__);
 	}
-	screen_off_policy_req++;
-	spin_unlock_irqrestore(&policy_update_lock, irqflags);
 
-	if (cpufreq_policy)
-		cpufreq_update_policy(cpufreq_policy->cpu);
+#ifdef CONFIG_PERFLOCK_SCREEN_POLICY
+	/* a held lock sets the speed whatever the screen does */
+	pm_qos_update_request(&screen_ceiling,
+			      lock_speed ? PM_QOS_DEFAULT_VALUE : screen_max);
+#endif
+	pm_qos_update_request(&perflock_ceiling,
+			      lock_speed ? lock_speed : PM_QOS_DEFAULT_VALUE);
 }
 
-static void perflock_late_resume(struct early_suspend *handler)
+#ifdef CONFIG_PERFLOCK_SCREEN_POLICY
+static void perflock_screen_policy(unsigned int min, unsigned int max)
 {
-	unsigned long irqflags;
+	if (debug_mask & PERF_SCREEN_ON_POLICY_DEBUG)
+		pr_info("%s: policy_min %d policy_max %d\n",
+			__func__, min, max);
+
+	mutex_lock(&perflock_mutex);
+	screen_max = max;
+	pm_qos_update_request(&screen_floor, min);
+	if (!curr_lock_speed)
+		pm_qos_update_request(&screen_ceiling, max);
+	mutex_unlock(&perflock_mutex);
+}
+
+static void perflock_early_suspend(struct early_suspend *handler)
+{
+	perflock_screen_policy(CONFIG_PERFLOCK_SCREEN_OFF_MIN,
+			       CONFIG_PERFLOCK_SCREEN_OFF_MAX);
+}
 
+static void perflock_late_resume(struct early_suspend *handler)
+{
 /*
  * This workaround is for hero project
  * May cause potential bug:
  * Accidentally set cpu in high freq in screen off mode.
- * senario: in screen off early suspended state, runs the following sequence:
- * 1.perflock_late_resume():acpuclk_set_rate(high freq);screen_on_pilicy_req=1;
- * 2.perflock_early_suspend():if(screen_on_policy_req) return;
- * 3.perflock_notifier_call(): only set policy's min and max
  */
 #ifdef CONFIG_MACH_HERO
 	/* Work around for display driver,
 	 * need to increase cpu speed immediately.
 	 */
-	unsigned int lock_speed = get_perflock_speed() / 1000;
+	unsigned int lock_speed = curr_lock_speed;
 	if (lock_speed > CONFIG_PERFLOCK_SCREEN_ON_MIN)
 		acpuclk_set_rate(lock_speed * 1000, 0);
 	else
 		acpuclk_set_rate(CONFIG_PERFLOCK_SCREEN_ON_MIN * 1000, 0);
 #endif
 
-	spin_lock_irqsave(&policy_update_lock, irqflags);
-	if (screen_off_policy_req) {
-		screen_off_policy_req--;
-		spin_unlock_irqrestore(&policy_update_lock, irqflags);
-		return;
-	}
-	screen_on_policy_req++;
-	spin_unlock_irqrestore(&policy_update_lock, irqflags);
-
-	if (cpufreq_policy)
-		cpufreq_update_policy(cpufreq_policy->cpu);
+	perflock_screen_policy(CONFIG_PERFLOCK_SCREEN_ON_MIN,
+			       CONFIG_PERFLOCK_SCREEN_ON_MAX);
 }
 
 static struct early_suspend perflock_power_suspend = {
@@ -128,118 +165,35 @@ static int __init perflock_screen_policy_init(void)
 {
 	register_early_suspend(&perflock_power_suspend);
 
-	screen_on_policy_req++;
-	if (cpufreq_policy)
-		cpufreq_update_policy(cpufreq_policy->cpu);
-
 	return 0;
 }
 
 late_initcall(perflock_screen_policy_init);
 #endif
 
-#if 0
-static unsigned int policy_min = CONFIG_MSM_CPU_FREQ_ONDEMAND_MIN;
-static unsigned int policy_max = CONFIG_MSM_CPU_FREQ_ONDEMAND_MAX;
-#else
-static unsigned int policy_min;
-static unsigned int policy_max;
-#endif
-static int perflock_notifier_call(struct notifier_block *self,
-			       unsigned long event, void *data)
-{
-	struct cpufreq_policy *policy = data;
-	unsigned int lock_speed;
-	unsigned long irqflags;
-
-	spin_lock_irqsave(&policy_update_lock, irqflags);
-	if (debug_mask & PERF_CPUFREQ_NOTIFY_DEBUG)
-		pr_info("%s: event=%ld, policy->min=%d, policy->max=%d",
-			__func__, event, policy->min, policy->max);
-
-	if (event == CPUFREQ_START)
-		cpufreq_policy = policy;
-	else if (event == CPUFREQ_NOTIFY) {
-		/* Each time cpufreq_update_policy,
-		 * min/max will reset, need to set it again. */
-#ifdef CONFIG_PERFLOCK_SCREEN_POLICY
-		if (screen_on_policy_req) {
-			if (debug_mask & PERF_SCREEN_ON_POLICY_DEBUG)
-				pr_info("%s: screen_on_policy_req %d,"
-					"policy_min %d\n", __func__,
-					screen_on_policy_req,
-					CONFIG_PERFLOCK_SCREEN_ON_MIN);
-			policy_min = CONFIG_PERFLOCK_SCREEN_ON_MIN;
-			policy_max = CONFIG_PERFLOCK_SCREEN_ON_MAX;
-			screen_on_policy_req--;
-		} else if (screen_off_policy_req) {
-			if (debug_mask & PERF_SCREEN_ON_POLICY_DEBUG)
-				pr_info("%s: screen_off_policy_req %d,"
-					"policy_min %d\n", __func__,
-					screen_off_policy_req,
-					CONFIG_MSM_CPU_FREQ_ONDEMAND_MIN);
-			policy_min = CONFIG_PERFLOCK_SCREEN_OFF_MIN;
-			policy_max = CONFIG_PERFLOCK_SCREEN_OFF_MAX;
-			screen_off_policy_req--;
-		}
-#endif
-		lock_speed = get_perflock_speed() / 1000;
-		if (lock_speed) {
-			policy->min = lock_speed;
-			policy->max = lock_speed;
-			if (debug_mask & PERF_CPUFREQ_LOCK_DEBUG) {
-				pr_info("%s: cpufreq lock speed %d\n",
-					__func__, lock_speed);
-				print_active_locks();
-			}
-		} else {
-			policy->min = policy_min;
-			policy->max = policy_max;
-			if (debug_mask & PERF_CPUFREQ_LOCK_DEBUG)
-				pr_info("%s: cpufreq recover policy %d %d\n",
-					__func__, policy->min, policy->max);
-		}
-		curr_lock_speed = lock_speed;
-	}
-	spin_unlock_irqrestore(&policy_update_lock, irqflags);
-
-	return 0;
-}
-
-static struct notifier_block perflock_notifier = {
-	.notifier_call = perflock_notifier_call,
-};
-
-static unsigned int get_perflock_speed(void)
+#define PERF_UNLOCK_DELAY		(HZ)
+static void do_expire_perf_lock(struct work_struct *work)
 {
-	unsigned long irqflags;
-	struct perf_lock *lock;
-	unsigned int perf_level = 0;
-
-	/* Get the maxmimum perf level. */
-	if (list_empty(&active_perf_locks))
-		return 0;
-
-	spin_lock_irqsave(&list_lock, irqflags);
-	list_for_each_entry(lock, &active_perf_locks, link) {
-		if (lock->level > perf_level)
-			perf_level = lock->level;
+	struct perf_lock *lock =
+		container_of(work, struct perf_lock, release.work);
+
+	mutex_lock(&perflock_mutex);
+	/* locked again before the delay ran out */
+	if ((lock->flags & PERF_LOCK_ACTIVE) ||
+	    !(lock->flags & PERF_LOCK_HELD)) {
+		mutex_unlock(&perflock_mutex);
+		return;
 	}
-	spin_unlock_irqrestore(&list_lock, irqflags);
-
-	return perf_acpu_table[perf_level];
-}
-
-static void print_active_locks(void)
-{
-	unsigned long irqflags;
-	struct perf_lock *lock;
 
-	spin_lock_irqsave(&list_lock, irqflags);
-	list_for_each_entry(lock, &active_perf_locks, link) {
-		pr_info("active perf lock '%s'\n", lock->name);
-	}
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	if (debug_mask & PERF_EXPIRE_DEBUG)
+		pr_info("%s: '%s' timed out to unlock\n",
+			__func__, lock->name);
+
+	lock->flags &= ~PERF_LOCK_HELD;
+	nr_held[lock->level]--;
+	pm_qos_update_request(&lock->qos, PM_QOS_DEFAULT_VALUE);
+	perflock_update_ceiling();
+	mutex_unlock(&perflock_mutex);
 }
 
 /**
@@ -253,8 +207,6 @@ static void print_active_locks(void)
 void perf_lock_init(struct perf_lock *lock,
 			unsigned int level, const char *name)
 {
-	unsigned long irqflags = 0;
-
 	WARN_ON(!name);
 	WARN_ON(level >= PERF_LOCK_INVALID);
 	WARN_ON(lock->flags & PERF_LOCK_INITIALIZED);
@@ -269,10 +221,9 @@ void perf_lock_init(struct perf_lock *lock,
 	lock->flags = PERF_LOCK_INITIALIZED;
 	lock->level = level;
 
-	INIT_LIST_HEAD(&lock->link);
-	spin_lock_irqsave(&list_lock, irqflags);
-	list_add(&lock->link, &inactive_perf_locks);
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	INIT_DELAYED_WORK(&lock->release, do_expire_perf_lock);
+	pm_qos_add_request(&lock->qos, PM_QOS_CPU_FREQ_MIN, name,
+			   PM_QOS_DEFAULT_VALUE);
 }
 EXPORT_SYMBOL(perf_lock_init);
 
@@ -284,46 +235,34 @@ EXPORT_SYMBOL(perf_lock_init);
  */
 void perf_lock(struct perf_lock *lock)
 {
-	unsigned long irqflags;
-
 	WARN_ON(!initialized);
 	WARN_ON((lock->flags & PERF_LOCK_INITIALIZED) == 0);
 	WARN_ON(lock->flags & PERF_LOCK_ACTIVE);
 
-	spin_lock_irqsave(&list_lock, irqflags);
+	mutex_lock(&perflock_mutex);
 	if (debug_mask & PERF_LOCK_DEBUG)
 		pr_info("%s: '%s', flags %d level %d\n",
 			__func__, lock->name, lock->flags, lock->level);
 	if (lock->flags & PERF_LOCK_ACTIVE) {
 		pr_err("%s: over-locked\n", __func__);
+		mutex_unlock(&perflock_mutex);
 		return;
 	}
 	lock->flags |= PERF_LOCK_ACTIVE;
-	list_del(&lock->link);
-	list_add(&lock->link, &active_perf_locks);
-	spin_unlock_irqrestore(&list_lock, irqflags);
-
-	/* Update cpufreq policy - scaling_min/scaling_max */
-	if (cpufreq_policy &&
-			(curr_lock_speed != (get_perflock_speed() / 1000)))
-		cpufreq_update_policy(cpufreq_policy->cpu);
-}
-EXPORT_SYMBOL(perf_lock);
-
-#define PERF_UNLOCK_DELAY		(HZ)
-static void do_expire_perf_locks(struct work_struct *work)
-{
-	if (debug_mask & PERF_EXPIRE_DEBUG)
-		pr_info("%s: timed out to unlock\n", __func__);
-
-	if (cpufreq_policy &&
-			(curr_lock_speed != (get_perflock_speed() / 1000))) {
-		if (debug_mask & PERF_EXPIRE_DEBUG)
-			pr_info("%s: update cpufreq policy\n", __func__);
-		cpufreq_update_policy(cpufreq_policy->cpu);
+	nr_active++;
+
+	/* still held if it was released less than PERF_UNLOCK_DELAY ago */
+	cancel_delayed_work(&lock->release);
+	if (!(lock->flags & PERF_LOCK_HELD) && initialized) {
+		lock->flags |= PERF_LOCK_HELD;
+		nr_held[lock->level]++;
+		pm_qos_update_request(&lock->qos,
+				      perf_acpu_table[lock->level] / 1000);
+		perflock_update_ceiling();
 	}
+	mutex_unlock(&perflock_mutex);
 }
-static DECLARE_DELAYED_WORK(work_expire_perf_locks, do_expire_perf_locks);
+EXPORT_SYMBOL(perf_lock);
 
 /**
  * perf_unlock - de-activate a perf lock
@@ -333,29 +272,25 @@ static DECLARE_DELAYED_WORK(work_expire_perf_locks, do_expire_perf_locks);
  */
 void perf_unlock(struct perf_lock *lock)
 {
-	unsigned long irqflags;
-
 	WARN_ON(!initialized);
 	WARN_ON((lock->flags & PERF_LOCK_ACTIVE) == 0);
 
-	spin_lock_irqsave(&list_lock, irqflags);
+	mutex_lock(&perflock_mutex);
 	if (debug_mask & PERF_LOCK_DEBUG)
 		pr_info("%s: '%s', flags %d level %d\n",
 			__func__, lock->name, lock->flags, lock->level);
 	if (!(lock->flags & PERF_LOCK_ACTIVE)) {
 		pr_err("%s: under-locked\n", __func__);
+		mutex_unlock(&perflock_mutex);
 		return;
 	}
 	lock->flags &= ~PERF_LOCK_ACTIVE;
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_perf_locks);
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	nr_active--;
 
 	/* Prevent lock/unlock quickly, add a timeout to release perf_lock */
-	if (cpufreq_policy &&
-			(curr_lock_speed != (get_perflock_speed() / 1000)))
-		schedule_delayed_work(&work_expire_perf_locks,
-			PERF_UNLOCK_DELAY);
+	if (lock->flags & PERF_LOCK_HELD)
+		schedule_delayed_work(&lock->release, PERF_UNLOCK_DELAY);
+	mutex_unlock(&perflock_mutex);
 }
 EXPORT_SYMBOL(perf_unlock);
 
@@ -378,7 +313,7 @@ EXPORT_SYMBOL(is_perf_lock_active);
  */
 int is_perf_locked(void)
 {
-	return (!list_empty(&active_perf_locks));
+	return nr_active != 0;
 }
 EXPORT_SYMBOL(is_perf_locked);
 
@@ -428,7 +363,14 @@ void __init perflock_init(struct perflock_platform_data *pdata)
 		goto invalid_config;
 
 	perf_acpu_table_fixup();
-	cpufreq_register_notifier(&perflock_notifier, CPUFREQ_POLICY_NOTIFIER);
+	pm_qos_add_request(&perflock_ceiling, PM_QOS_CPU_FREQ_MAX, "perflock",
+			   PM_QOS_DEFAULT_VALUE);
+#ifdef CONFIG_PERFLOCK_SCREEN_POLICY
+	pm_qos_add_request(&screen_floor, PM_QOS_CPU_FREQ_MIN, "screen",
+			   CONFIG_PERFLOCK_SCREEN_ON_MIN);
+	pm_qos_add_request(&screen_ceiling, PM_QOS_CPU_FREQ_MAX, "screen",
+			   screen_max);
+#endif
 
 	initialized = 1;
 
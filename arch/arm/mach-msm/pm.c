@@ -26,6 +26,8 @@
 #include <linux/suspend.h>
 #include <linux/reboot.h>
 #include <linux/earlysuspend.h>
+#include <linux/cpuidle.h>
+#include <linux/pm_qos_params.h>
 #include <mach/msm_iomap.h>
 #include <mach/system.h>
 #include <asm/io.h>
@@ -71,7 +73,20 @@ module_param_named(sleep_mode, msm_pm_sleep_mode, int, S_IRUGO | S_IWUSR | S_IWG
 static int msm_pm_idle_sleep_mode = CONFIG_MSM7X00A_IDLE_SLEEP_MODE;
 module_param_named(idle_sleep_mode, msm_pm_idle_sleep_mode, int, S_IRUGO | S_IWUSR | S_IWGRP);
 static int msm_pm_idle_sleep_min_time = CONFIG_MSM7X00A_IDLE_SLEEP_MIN_TIME;
-module_param_named(idle_sleep_min_time, msm_pm_idle_sleep_min_time, int, S_IRUGO | S_IWUSR | S_IWGRP);
+static int msm_pm_idle_sleep_latency = CONFIG_MSM7X00A_IDLE_SLEEP_LATENCY;
+static void msm_cpuidle_set_params(void);
+static int msm_pm_set_idle_param(const char *val, struct kernel_param *kp)
+{
+	int ret = param_set_int(val, kp);
+
+	if (!ret)
+		msm_cpuidle_set_params();
+	return ret;
+}
+module_param_call(idle_sleep_min_time, msm_pm_set_idle_param, param_get_int,
+		  &msm_pm_idle_sleep_min_time, S_IRUGO | S_IWUSR | S_IWGRP);
+module_param_call(idle_sleep_latency, msm_pm_set_idle_param, param_get_int,
+		  &msm_pm_idle_sleep_latency, S_IRUGO | S_IWUSR | S_IWGRP);
 static int msm_pm_idle_spin_time = CONFIG_MSM7X00A_IDLE_SPIN_TIME;
 module_param_named(idle_spin_time, msm_pm_idle_spin_time, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
@@ -215,9 +230,13 @@ msm_pm_wait_state(uint32_t wait_all_set, uint32_t wait_all_clear,
  * Enable it after booting up BOOT_LOCK_TIMEOUT sec.
  */
 #define BOOT_LOCK_TIMEOUT      (60 * HZ)
+/* cpuidle does not look at the halt lock, it is kept in wfi instead */
+static struct pm_qos_request boot_latency;
+
 static void do_expire_boot_lock(struct work_struct *work)
 {
 	enable_hlt();
+	pm_qos_remove_request(&boot_latency);
 	pr_info("Release 'boot-time' halt_lock\n");
 }
 static DECLARE_DELAYED_WORK(work_expire_boot_lock, do_expire_boot_lock);
@@ -507,10 +526,15 @@ static int msm_pm_idle_spin(void)
 	return 0;
 }
 
-void arch_idle(void)
+/*
+ * Wait for interrupt, or if @sleep is set and sleep is allowed, sleep in
+ * msm_pm_idle_sleep_mode for at most @sleep_time ns.  Called with
+ * interrupts disabled between msm_timer_enter_idle() and
+ * msm_timer_exit_idle(); returns what to pass the latter.
+ */
+static int msm_pm_idle(int sleep, int64_t sleep_time)
 {
 	int ret;
-	int64_t sleep_time;
 	int low_power = 0;
 #ifdef CONFIG_MSM_IDLE_STATS
 	int64_t t1;
@@ -523,10 +547,7 @@ void arch_idle(void)
 		!has_wake_lock(WAKE_LOCK_IDLE) &&
 #endif
 		msm_irq_idle_sleep_allowed();
-	if (msm_pm_reset_vector == NULL)
-		return;
 
-	sleep_time = msm_timer_enter_idle();
 #ifdef CONFIG_MSM_IDLE_STATS
 	t1 = ktime_to_ns(ktime_get());
 	msm_pm_add_stat(MSM_PM_STAT_NOT_IDLE, t1 - t2);
@@ -535,7 +556,7 @@ void arch_idle(void)
 	if (msm_pm_debug_mask & MSM_PM_DEBUG_IDLE)
 		printk(KERN_INFO "arch_idle: sleep time %llu, allow_sleep %d\n",
 		       sleep_time, allow_sleep);
-	if (sleep_time < msm_pm_idle_sleep_min_time || !allow_sleep) {
+	if (!sleep || !allow_sleep) {
 		unsigned long saved_rate;
 		/* only spin while trying wfi ramp down */
 		if (acpuclk_get_wfi_rate() && msm_pm_idle_spin() < 0) {
@@ -598,13 +619,122 @@ void arch_idle(void)
 #endif
 	}
 abort_idle:
-	msm_timer_exit_idle(low_power);
 #ifdef CONFIG_MSM_IDLE_STATS
 	t2 = ktime_to_ns(ktime_get());
 	msm_pm_add_stat(exit_stat, t2 - t1);
 #endif
+	return low_power;
+}
+
+void arch_idle(void)
+{
+	int64_t sleep_time;
+	int low_power;
+
+	if (msm_pm_reset_vector == NULL)
+		return;
+
+	sleep_time = msm_timer_enter_idle();
+	low_power = msm_pm_idle(sleep_time >= msm_pm_idle_sleep_min_time,
+				sleep_time);
+	msm_timer_exit_idle(low_power);
 }
 
+#ifdef CONFIG_CPU_IDLE
+/*
+ * With cpuidle, whether to sleep is up to its governor, which learns how
+ * long idle periods really last rather than trusting the next timer, and
+ * keeps within pm_qos cpu_dma_latency.  idle_sleep_min_time becomes the
+ * target residency of the sleep state.
+ */
+enum {
+	MSM_CPUIDLE_STATE_WFI,
+	MSM_CPUIDLE_STATE_SLEEP,
+	MSM_CPUIDLE_NR_STATES,
+};
+
+static struct cpuidle_driver msm_cpuidle_driver = {
+	.name = "msm_idle",
+	.owner = THIS_MODULE,
+};
+
+static struct cpuidle_device msm_cpuidle_device;
+
+static void msm_cpuidle_set_params(void)
+{
+	struct cpuidle_state *state =
+		&msm_cpuidle_device.states[MSM_CPUIDLE_STATE_SLEEP];
+
+	state->exit_latency = msm_pm_idle_sleep_latency;
+	state->target_residency = msm_pm_idle_sleep_min_time / NSEC_PER_USEC;
+}
+
+static int msm_cpuidle_enter(struct cpuidle_device *dev,
+			     struct cpuidle_state *state)
+{
+	int sleep = state == &dev->states[MSM_CPUIDLE_STATE_SLEEP];
+	int low_power = 0;
+	int64_t sleep_time;
+	ktime_t start;
+
+	local_irq_disable();
+	start = ktime_get();
+	if (!need_resched() && msm_pm_reset_vector) {
+		sleep_time = msm_timer_enter_idle();
+		low_power = msm_pm_idle(sleep, sleep_time);
+		msm_timer_exit_idle(low_power);
+	}
+	/* sleep was not allowed, or an interrupt came first */
+	if (sleep && !low_power)
+		dev->last_state = &dev->states[MSM_CPUIDLE_STATE_WFI];
+	local_irq_enable();
+
+	return ktime_to_us(ktime_sub(ktime_get(), start));
+}
+
+static int __init msm_cpuidle_init(void)
+{
+	struct cpuidle_device *dev = &msm_cpuidle_device;
+	struct cpuidle_state *state;
+	int ret;
+
+	ret = cpuidle_register_driver(&msm_cpuidle_driver);
+	if (ret)
+		return ret;
+
+	state = &dev->states[MSM_CPUIDLE_STATE_WFI];
+	snprintf(state->name, CPUIDLE_NAME_LEN, "wfi");
+	snprintf(state->desc, CPUIDLE_DESC_LEN, "Wait for interrupt");
+	state->exit_latency = 1;
+	state->target_residency = 1;
+	state->power_usage = -1;
+	state->flags = CPUIDLE_FLAG_TIME_VALID | CPUIDLE_FLAG_SHALLOW;
+	state->enter = msm_cpuidle_enter;
+
+	state = &dev->states[MSM_CPUIDLE_STATE_SLEEP];
+	snprintf(state->name, CPUIDLE_NAME_LEN, "sleep");
+	snprintf(state->desc, CPUIDLE_DESC_LEN, "Sleep in idle_sleep_mode");
+	state->power_usage = -1;
+	state->flags = CPUIDLE_FLAG_TIME_VALID | CPUIDLE_FLAG_DEEP;
+	state->enter = msm_cpuidle_enter;
+
+	dev->cpu = 0;
+	dev->state_count = MSM_CPUIDLE_NR_STATES;
+	msm_cpuidle_set_params();
+
+	ret = cpuidle_register_device(dev);
+	if (ret) {
+		pr_err("msm_cpuidle_init: cpuidle_register_device failed %d\n",
+		       ret);
+		cpuidle_unregister_driver(&msm_cpuidle_driver);
+	}
+	return ret;
+}
+#else
+static inline void msm_cpuidle_set_params(void) { }
+static inline int msm_cpuidle_init(void) { return 0; }
+#endif
+
 static int msm_pm_enter(suspend_state_t state)
 {
 	msm_sleep(msm_pm_sleep_mode, msm_pm_max_sleep_time, 0);
@@ -849,9 +979,13 @@ static int __init msm_pm_init(void)
 	if (board_mfg_mode() == 0)
 	{
 		disable_hlt();
+		pm_qos_add_request(&boot_latency, PM_QOS_CPU_DMA_LATENCY,
+				   "boot-time", 0);
 		schedule_delayed_work(&work_expire_boot_lock, BOOT_LOCK_TIMEOUT);
 		pr_info("Acquire 'boot-time' halt_lock\n");
 	}
+
+	msm_cpuidle_init();
 	return 0;
 }
 
@@ -27,12 +27,14 @@
 #include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/io.h>
+#include <linux/kthread.h>
 
 #include <mach/msm_smd.h>
 #include <mach/msm_iomap.h>
 #include <mach/system.h>
 
 #include "smd_private.h"
+#include "smd_debug.h"
 #include "proc_comm.h"
 
 #if defined(CONFIG_ARCH_QSD8X50)
@@ -69,6 +71,22 @@ module_param_named(ciq_info, msm_smd_ciq_info,
 module_param_named(debug_mask, msm_smd_debug_mask,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* see smd_notify_other_cpu() */
+static int smd_coalesce_us = 100;
+module_param_named(coalesce_us, smd_coalesce_us,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+static int smd_coalesce_max = 8;
+module_param_named(coalesce_max, smd_coalesce_max,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* see smd_poll_check() */
+static int smd_poll_threshold = 16;
+module_param_named(poll_threshold, smd_poll_threshold,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+static int smd_poll_interval_us = 1000;
+module_param_named(poll_interval_us, smd_poll_interval_us,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+
 void *smem_item(unsigned id, unsigned *size);
 static void smd_diag(void);
 
@@ -154,72 +172,10 @@ static DEFINE_MUTEX(smd_creation_mutex);
 
 static int smd_initialized;
 
-struct smd_alloc_elm {
-	char name[20];
-	uint32_t cid;
-	uint32_t ctype;
-	uint32_t ref_count;
-};
-
-struct smd_half_channel {
-	unsigned state;
-	unsigned char fDSR;
-	unsigned char fCTS;
-	unsigned char fCD;
-	unsigned char fRI;
-	unsigned char fHEAD;
-	unsigned char fTAIL;
-	unsigned char fSTATE;
-	unsigned char fUNUSED;
-	unsigned tail;
-	unsigned head;
-};
-
-struct smd_shared_v1 {
-	struct smd_half_channel ch0;
-	unsigned char data0[SMD_BUF_SIZE];
-	struct smd_half_channel ch1;
-	unsigned char data1[SMD_BUF_SIZE];
-};
-
-struct smd_shared_v2 {
-	struct smd_half_channel ch0;
-	struct smd_half_channel ch1;
-};
-
-struct smd_channel {
-	volatile struct smd_half_channel *send;
-	volatile struct smd_half_channel *recv;
-	unsigned char *send_data;
-	unsigned char *recv_data;
-
-	unsigned fifo_mask;
-	unsigned fifo_size;
-	unsigned current_packet;
-	unsigned n;
-
-	struct list_head ch_list;
-
-	void *priv;
-	void (*notify)(void *priv, unsigned flags);
-
-	int (*read)(struct smd_channel *ch, void *data, int len);
-	int (*write)(struct smd_channel *ch, const void *data, int len);
-	int (*read_avail)(struct smd_channel *ch);
-	int (*write_avail)(struct smd_channel *ch);
-
-	void (*update_state)(struct smd_channel *ch);
-	unsigned last_state;
-	void (*notify_other_cpu)(void);
-	unsigned type;
-
-	char name[32];
-	struct platform_device pdev;
-};
-
 LIST_HEAD(smd_ch_closed_list);
 LIST_HEAD(smd_ch_list_modem);
 LIST_HEAD(smd_ch_list_dsp);
+LIST_HEAD(smd_ch_list_virtual);
 
 static unsigned char smd_ch_allocated[64];
 static struct work_struct probe_work;
@@ -404,6 +360,67 @@ static void ch_write_done(struct smd_channel *ch, unsigned count)
 	ch->send->fHEAD = 1;
 }
 
+/* Notifications to the other cpu after data moved through a fifo are
+ * coalesced: one that comes within smd_coalesce_us of the previous
+ * interrupt is held back, and the held back ones go out as a single
+ * interrupt when the window ends or smd_coalesce_max have piled up.
+ * An isolated write still interrupts right away.
+ */
+static void __smd_kick_other_cpu(struct smd_channel *ch, ktime_t now)
+{
+	ch->kicks_pending = 0;
+	ch->last_kick = now;
+	ch->kick_count++;
+	ch->notify_other_cpu();
+}
+
+/* interrupt the other cpu now, flushing any held back notification */
+static void smd_kick_other_cpu(struct smd_channel *ch)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ch->kick_lock, flags);
+	__smd_kick_other_cpu(ch, ktime_get());
+	spin_unlock_irqrestore(&ch->kick_lock, flags);
+}
+
+static void smd_notify_other_cpu(struct smd_channel *ch)
+{
+	unsigned long flags;
+	ktime_t now;
+
+	spin_lock_irqsave(&ch->kick_lock, flags);
+	now = ktime_get();
+	if (smd_coalesce_us <= 0 || (!ch->kicks_pending &&
+	    ktime_us_delta(now, ch->last_kick) >= smd_coalesce_us)) {
+		__smd_kick_other_cpu(ch, now);
+	} else if (++ch->kicks_pending >= smd_coalesce_max) {
+		hrtimer_try_to_cancel(&ch->kick_timer);
+		__smd_kick_other_cpu(ch, now);
+	} else {
+		ch->kick_deferred++;
+		if (ch->kicks_pending == 1)
+			hrtimer_start(&ch->kick_timer,
+				      ktime_set(0, smd_coalesce_us * 1000),
+				      HRTIMER_MODE_REL);
+	}
+	spin_unlock_irqrestore(&ch->kick_lock, flags);
+}
+
+static enum hrtimer_restart smd_kick_timer_func(struct hrtimer *timer)
+{
+	struct smd_channel *ch = container_of(timer, struct smd_channel,
+					      kick_timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&ch->kick_lock, flags);
+	if (ch->kicks_pending)
+		__smd_kick_other_cpu(ch, ktime_get());
+	spin_unlock_irqrestore(&ch->kick_lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
 static void ch_set_state(struct smd_channel *ch, unsigned n)
 {
 	if (n == SMD_SS_OPENED) {
@@ -417,7 +434,7 @@ static void ch_set_state(struct smd_channel *ch, unsigned n)
 	}
 	ch->send->state = n;
 	ch->send->fSTATE = 1;
-	ch->notify_other_cpu();
+	smd_kick_other_cpu(ch);
 }
 
 static void do_smd_probe(void)
@@ -463,6 +480,121 @@ static void smd_state_change(struct smd_channel *ch,
 		break;
 	}
 }
+/* Polled receive: a channel that takes smd_poll_threshold interrupts
+ * within one jiffy stops calling notify() from the interrupt and is
+ * polled every smd_poll_interval_us instead, with one notify() per poll
+ * however much arrived.  The other side is not told and keeps
+ * interrupting; those interrupts only record what they saw for the
+ * next poll.  After SMD_POLL_IDLE_EXIT polls without new data the
+ * channel goes back to notifying from the interrupt.  All of this runs
+ * under smd_lock.
+ */
+#define SMD_POLL_IDLE_EXIT	2
+
+static struct hrtimer smd_poll_timer;
+static int smd_poll_running;
+
+static ktime_t smd_poll_interval(void)
+{
+	return ktime_set(0, max(smd_poll_interval_us, 100) * 1000);
+}
+
+static void smd_poll_check(struct smd_channel *ch)
+{
+	if (smd_poll_threshold <= 0)
+		return;
+
+	if (ch->irq_window != jiffies) {
+		ch->irq_window = jiffies;
+		ch->irq_window_count = 0;
+	}
+	if (++ch->irq_window_count < smd_poll_threshold)
+		return;
+
+	ch->polling = 1;
+	ch->poll_idle = 0;
+	ch->poll_pending = 0;
+	ch->poll_entered++;
+
+	if (!smd_poll_running) {
+		smd_poll_running = 1;
+		hrtimer_start(&smd_poll_timer, smd_poll_interval(),
+			      HRTIMER_MODE_REL);
+	}
+}
+
+static void smd_poll_stop(struct smd_channel *ch)
+{
+	ch->polling = 0;
+	ch->irq_window_count = 0;
+}
+
+/* returns 1 if the channel stays in polled mode */
+static int smd_poll_channel(struct smd_channel *ch)
+{
+	unsigned ch_flags = ch->poll_pending;
+
+	ch->poll_pending = 0;
+	ch->poll_count++;
+
+	if (ch->recv->fHEAD) {
+		ch->recv->fHEAD = 0;
+		ch_flags |= 1;
+	}
+	if (ch->recv->fTAIL) {
+		ch->recv->fTAIL = 0;
+		ch_flags |= 2;
+	}
+
+	if (ch_flags) {
+		ch->poll_idle = 0;
+	} else if (++ch->poll_idle >= SMD_POLL_IDLE_EXIT) {
+		smd_poll_stop(ch);
+	}
+
+	if (ch_flags) {
+		ch->update_state(ch);
+		ch->notify(ch->priv, SMD_EVENT_DATA);
+		ch->notify_count++;
+	}
+	return ch->polling;
+}
+
+static int smd_poll_list(struct list_head *list)
+{
+	struct smd_channel *ch;
+	int active = 0;
+
+	list_for_each_entry(ch, list, ch_list) {
+		if (!ch->polling)
+			continue;
+		if (ch_is_open(ch))
+			active |= smd_poll_channel(ch);
+		else
+			smd_poll_stop(ch);
+	}
+	return active;
+}
+
+static enum hrtimer_restart smd_poll_timer_func(struct hrtimer *timer)
+{
+	unsigned long flags;
+	int active;
+
+	spin_lock_irqsave(&smd_lock, flags);
+	active = smd_poll_list(&smd_ch_list_modem);
+	active |= smd_poll_list(&smd_ch_list_dsp);
+	active |= smd_poll_list(&smd_ch_list_virtual);
+	smd_poll_running = active;
+	spin_unlock_irqrestore(&smd_lock, flags);
+
+	if (!active)
+		return HRTIMER_NORESTART;
+
+	hrtimer_forward_now(timer, smd_poll_interval());
+	return HRTIMER_RESTART;
+}
+
 static void handle_smd_irq(struct list_head *list, void (*notify)(void))
 {
 	unsigned long flags;
@@ -482,12 +614,10 @@ static void handle_smd_irq(struct list_head *list, void (*notify)(void))
 			if (ch->recv->fHEAD) {
 				ch->recv->fHEAD = 0;
 				ch_flags |= 1;
-				do_notify |= 1;
 			}
 			if (ch->recv->fTAIL) {
 				ch->recv->fTAIL = 0;
 				ch_flags |= 2;
-				do_notify |= 1;
 			}
 			if (ch->recv->fSTATE) {
 				ch->recv->fSTATE = 0;
@@ -498,9 +628,21 @@ static void handle_smd_irq(struct list_head *list, void (*notify)(void))
 		tmp = ch->recv->state;
 		if (tmp != ch->last_state)
 			smd_state_change(ch, ch->last_state, tmp);
+		/* a state change is answered at once, new data like any
+		 * other notification to the other cpu, so coalesced
+		 */
+		if (ch_flags && !(ch_flags & 4))
+			smd_notify_other_cpu(ch);
 		if (ch_flags) {
+			ch->irq_count++;
+			if (ch->polling) {
+				ch->poll_pending |= ch_flags;
+				continue;
+			}
+			smd_poll_check(ch);
 			ch->update_state(ch);
 			ch->notify(ch->priv, SMD_EVENT_DATA);
+			ch->notify_count++;
 		}
 	}
 	if (do_notify)
@@ -586,7 +728,8 @@ void smd_kick(smd_channel_t *ch)
 			ch->notify(ch->priv, SMD_EVENT_CLOSE);
 	}
 	ch->notify(ch->priv, SMD_EVENT_DATA);
-	ch->notify_other_cpu();
+	ch->notify_count++;
+	smd_notify_other_cpu(ch);
 	spin_unlock_irqrestore(&smd_lock, flags);
 }
 
@@ -613,16 +756,16 @@ static int smd_is_packet(int chn, unsigned type)
 		return 0;
 }
 
-static int smd_stream_write(smd_channel_t *ch, const void *_data, int len)
+/* basic write interface to ch_write_{buffer,done}; the caller
+ * notifies the other cpu
+ */
+static int ch_write(struct smd_channel *ch, const void *_data, int len)
 {
 	void *ptr;
 	const unsigned char *buf = _data;
 	unsigned xfer;
 	int orig_len = len;
 
-	if (len < 0)
-		return -EINVAL;
-
 	while ((xfer = ch_write_buffer(ch, &ptr)) != 0) {
 		if (!ch_is_open(ch))
 			break;
@@ -636,11 +779,27 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len)
 			break;
 	}
 
-	ch->notify_other_cpu();
-
 	return orig_len - len;
 }
 
+static int smd_stream_write(smd_channel_t *ch, const void *_data, int len)
+{
+	int r;
+
+	if (len < 0)
+		return -EINVAL;
+
+	r = ch_write(ch, _data, len);
+
+	/* a short write means the fifo is full, so don't hold that back */
+	if (r < len)
+		smd_kick_other_cpu(ch);
+	else
+		smd_notify_other_cpu(ch);
+
+	return r;
+}
+
 static int smd_packet_write(smd_channel_t *ch, const void *_data, int len)
 {
 	unsigned hdr[5];
@@ -654,8 +813,9 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len)
 	hdr[0] = len;
 	hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
 
-	smd_stream_write(ch, hdr, sizeof(hdr));
-	smd_stream_write(ch, _data, len);
+	ch_write(ch, hdr, sizeof(hdr));
+	ch_write(ch, _data, len);
+	smd_notify_other_cpu(ch);
 
 	return len;
 }
@@ -669,7 +829,7 @@ static int smd_stream_read(smd_channel_t *ch, void *data, int len)
 
 	r = ch_read(ch, data, len);
 	if (r > 0)
-		ch->notify_other_cpu();
+		smd_notify_other_cpu(ch);
 
 	return r;
 }
@@ -687,7 +847,7 @@ static int smd_packet_read(smd_channel_t *ch, void *data, int len)
 
 	r = ch_read(ch, data, len);
 	if (r > 0)
-		ch->notify_other_cpu();
+		smd_notify_other_cpu(ch);
 
 	spin_lock_irqsave(&smd_lock, flags);
 	ch->current_packet -= r;
@@ -745,6 +905,30 @@ static int smd_alloc_v1(struct smd_channel *ch)
 }
 
 
+static void smd_set_channel_ops(struct smd_channel *ch, int packet)
+{
+	if (packet) {
+		ch->read = smd_packet_read;
+		ch->write = smd_packet_write;
+		ch->read_avail = smd_packet_read_avail;
+		ch->write_avail = smd_packet_write_avail;
+		ch->update_state = update_packet_state;
+	} else {
+		ch->read = smd_stream_read;
+		ch->write = smd_stream_write;
+		ch->read_avail = smd_stream_read_avail;
+		ch->write_avail = smd_stream_write_avail;
+		ch->update_state = update_stream_state;
+	}
+}
+
+static void smd_init_kick_timer(struct smd_channel *ch)
+{
+	spin_lock_init(&ch->kick_lock);
+	hrtimer_init(&ch->kick_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ch->kick_timer.function = smd_kick_timer_func;
+}
+
 static unsigned smd_alloc_channel(const char *name, uint32_t cid, uint32_t type)
 {
 	struct smd_channel *ch;
@@ -769,19 +953,8 @@ static unsigned smd_alloc_channel(const char *name, uint32_t cid, uint32_t type)
 	else
 		ch->notify_other_cpu = notify_dsp_smd;
 
-	if (smd_is_packet(cid, type)) {
-		ch->read = smd_packet_read;
-		ch->write = smd_packet_write;
-		ch->read_avail = smd_packet_read_avail;
-		ch->write_avail = smd_packet_write_avail;
-		ch->update_state = update_packet_state;
-	} else {
-		ch->read = smd_stream_read;
-		ch->write = smd_stream_write;
-		ch->read_avail = smd_stream_read_avail;
-		ch->write_avail = smd_stream_write_avail;
-		ch->update_state = update_stream_state;
-	}
+	smd_set_channel_ops(ch, smd_is_packet(cid, type));
+	smd_init_kick_timer(ch);
 
 	if (ch->type == SMD_TYPE_APPS_MODEM)
 		memcpy(ch->name, "SMD_", 4);
@@ -853,8 +1026,12 @@ int smd_open(const char *name, smd_channel_t **_ch,
 
 	spin_lock_irqsave(&smd_lock, flags);
 
+	smd_poll_stop(ch);
+
 	if (ch->type == SMD_APPS_MODEM)
 		list_add(&ch->ch_list, &smd_ch_list_modem);
+	else if (ch->type == SMD_TYPE_VIRTUAL)
+		list_add(&ch->ch_list, &smd_ch_list_virtual);
 	else
 		list_add(&ch->ch_list, &smd_ch_list_dsp);
 
@@ -880,9 +1057,12 @@ int smd_close(smd_channel_t *ch)
 	spin_lock_irqsave(&smd_lock, flags);
 	ch->notify = do_nothing_notify;
 	list_del(&ch->ch_list);
+	smd_poll_stop(ch);
 	ch_set_state(ch, SMD_SS_CLOSED);
 	spin_unlock_irqrestore(&smd_lock, flags);
 
+	hrtimer_cancel(&ch->kick_timer);
+
 	mutex_lock(&smd_creation_mutex);
 	list_add(&ch->ch_list, &smd_ch_closed_list);
 	mutex_unlock(&smd_creation_mutex);
@@ -956,6 +1136,247 @@ int smd_cur_packet_size(smd_channel_t *ch)
 }
 
 
+#ifdef CONFIG_MSM_SMD_VIRTUAL
+/* ------------------------------------------------------------------------- */
+
+/* Virtual channels: the "shared memory" of the channel is an ordinary
+ * kernel allocation and the remote processor is a kernel thread that
+ * services the far end of every virtual channel.  It answers open and
+ * close, and either echoes back whatever the apps side writes or simply
+ * consumes it.  The apps side goes through the regular smd_open(),
+ * smd_read() and smd_write() paths, so those can be tested and
+ * benchmarked without a modem.
+ */
+
+struct smd_virtual {
+	struct smd_channel ch;
+	struct smd_shared_v2 shared;
+	struct list_head list;
+	int mode;
+	unsigned last_state;	/* apps state last seen by the remote */
+	unsigned char fifo[0];	/* send fifo, then recv fifo */
+};
+
+static LIST_HEAD(smd_virtual_list);
+static DEFINE_MUTEX(smd_virtual_lock);
+static DECLARE_WAIT_QUEUE_HEAD(smd_virtual_wait);
+static atomic_t smd_virtual_pending = ATOMIC_INIT(0);
+static struct task_struct *smd_virtual_task;
+static unsigned smd_virtual_cid = SMD_CHANNELS;
+
+/* the apps -> remote "interrupt" */
+static void notify_virtual_smd(void)
+{
+	atomic_set(&smd_virtual_pending, 1);
+	wake_up(&smd_virtual_wait);
+}
+
+/* the remote -> apps "interrupt" */
+static void smd_virtual_irq_handler(unsigned long arg)
+{
+	handle_smd_irq(&smd_ch_list_virtual, notify_virtual_smd);
+}
+
+static DECLARE_TASKLET(smd_virtual_irq_tasklet, smd_virtual_irq_handler, 0);
+
+static void smd_virtual_set_state(struct smd_channel *ch, unsigned n)
+{
+	unsigned char on = (n == SMD_SS_OPENED);
+
+	ch->recv->fDSR = on;
+	ch->recv->fCTS = on;
+	ch->recv->fCD = on;
+	ch->recv->state = n;
+	ch->recv->fSTATE = 1;
+}
+
+/* Act as the remote end of one channel: ch->send is what the remote
+ * reads and ch->recv is what it writes.  Returns 1 if the apps side
+ * needs an interrupt.
+ */
+static int smd_virtual_service(struct smd_virtual *v)
+{
+	struct smd_channel *ch = &v->ch;
+	unsigned state = ch->send->state;
+	unsigned head, tail, rhead, rtail, n, space;
+	int irq = 0;
+
+	if (state != v->last_state) {
+		v->last_state = state;
+		if (state == SMD_SS_OPENING) {
+			ch->send->tail = 0;
+			ch->recv->head = 0;
+			smd_virtual_set_state(ch, SMD_SS_OPENED);
+			irq = 1;
+		} else if (state == SMD_SS_CLOSED) {
+			smd_virtual_set_state(ch, SMD_SS_CLOSED);
+		}
+	}
+
+	if (state != SMD_SS_OPENED)
+		return irq;
+
+	for (;;) {
+		head = ch->send->head;
+		tail = ch->send->tail;
+		if (head == tail)
+			break;
+		rmb();
+		n = (tail < head ? head : ch->fifo_size) - tail;
+
+		if (v->mode == SMD_VIRTUAL_ECHO) {
+			/* same free space rules as ch_write_buffer() */
+			rhead = ch->recv->head;
+			rtail = ch->recv->tail;
+			if (rhead < rtail)
+				space = rtail - rhead - 1;
+			else if (rtail == 0)
+				space = ch->fifo_size - rhead - 1;
+			else
+				space = ch->fifo_size - rhead;
+			if (n > space)
+				n = space;
+			if (n == 0)
+				break;
+
+			memcpy(ch->recv_data + rhead, ch->send_data + tail, n);
+			wmb();
+			ch->recv->head = (rhead + n) & ch->fifo_mask;
+			ch->recv->fHEAD = 1;
+		}
+
+		ch->send->tail = (tail + n) & ch->fifo_mask;
+		ch->recv->fTAIL = 1;
+		irq = 1;
+	}
+
+	return irq;
+}
+
+static int smd_virtual_thread(void *arg)
+{
+	struct smd_virtual *v;
+	int irq;
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(smd_virtual_wait,
+			atomic_xchg(&smd_virtual_pending, 0) ||
+			kthread_should_stop());
+
+		irq = 0;
+		mutex_lock(&smd_virtual_lock);
+		list_for_each_entry(v, &smd_virtual_list, list)
+			irq |= smd_virtual_service(v);
+		mutex_unlock(&smd_virtual_lock);
+
+		if (irq)
+			tasklet_schedule(&smd_virtual_irq_tasklet);
+	}
+	return 0;
+}
+
+/* Create a closed virtual channel called @name, to be opened with
+ * smd_open().  @ctype selects SMD_KIND_PACKET or SMD_KIND_STREAM, and
+ * @fifo_size (a power of two) is the size of each direction's fifo.
+ */
+int smd_virtual_create(const char *name, unsigned ctype,
+		       unsigned fifo_size, int mode)
+{
+	struct smd_virtual *v, *tmp;
+	struct smd_channel *ch;
+
+	if (!smd_virtual_task)
+		return -ENODEV;
+
+	/* fifo must be a power-of-two size that fits a packet header */
+	if (fifo_size <= 2 * SMD_HEADER_SIZE || (fifo_size & (fifo_size - 1)))
+		return -EINVAL;
+
+	if (strlen(name) >= sizeof(ch->name))
+		return -EINVAL;
+
+	v = kzalloc(sizeof(*v) + 2 * fifo_size, GFP_KERNEL);
+	if (!v)
+		return -ENOMEM;
+
+	v->mode = mode;
+	v->last_state = SMD_SS_CLOSED;
+
+	ch = &v->ch;
+	ch->send = &v->shared.ch0;
+	ch->recv = &v->shared.ch1;
+	ch->send_data = v->fifo;
+	ch->recv_data = v->fifo + fifo_size;
+	ch->fifo_size = fifo_size;
+	ch->fifo_mask = fifo_size - 1;
+	ch->type = SMD_TYPE_VIRTUAL;
+	ch->notify_other_cpu = notify_virtual_smd;
+	smd_set_channel_ops(ch, (ctype & SMD_KIND_MASK) == SMD_KIND_PACKET);
+	smd_init_kick_timer(ch);
+	strcpy(ch->name, name);
+
+	mutex_lock(&smd_virtual_lock);
+	list_for_each_entry(tmp, &smd_virtual_list, list) {
+		if (!strcmp(tmp->ch.name, name)) {
+			mutex_unlock(&smd_virtual_lock);
+			kfree(v);
+			return -EEXIST;
+		}
+	}
+	ch->n = smd_virtual_cid++;
+	list_add(&v->list, &smd_virtual_list);
+	mutex_unlock(&smd_virtual_lock);
+
+	pr_info("smd_virtual_create() cid=%02d size=%05d '%s'\n",
+		ch->n, ch->fifo_size, ch->name);
+
+	mutex_lock(&smd_creation_mutex);
+	list_add(&ch->ch_list, &smd_ch_closed_list);
+	mutex_unlock(&smd_creation_mutex);
+
+	return 0;
+}
+
+/* Free a virtual channel, which must have been closed again */
+int smd_virtual_destroy(const char *name)
+{
+	struct smd_channel *ch;
+	struct smd_virtual *v;
+
+	ch = smd_get_channel(name);
+	if (!ch)
+		return -EBUSY;
+
+	if (ch->type != SMD_TYPE_VIRTUAL) {
+		mutex_lock(&smd_creation_mutex);
+		list_add(&ch->ch_list, &smd_ch_closed_list);
+		mutex_unlock(&smd_creation_mutex);
+		return -EINVAL;
+	}
+
+	v = container_of(ch, struct smd_virtual, ch);
+	mutex_lock(&smd_virtual_lock);
+	list_del(&v->list);
+	mutex_unlock(&smd_virtual_lock);
+
+	kfree(v);
+	return 0;
+}
+
+static int __init smd_virtual_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(smd_virtual_thread, NULL, "smd_virtual");
+	if (IS_ERR(task)) {
+		pr_err("smd_virtual_init: cannot start remote thread\n");
+		return PTR_ERR(task);
+	}
+	smd_virtual_task = task;
+	return 0;
+}
+#endif
+
 /* ------------------------------------------------------------------------- */
 
 void *smem_alloc(unsigned id, unsigned size)
@@ -1220,6 +1641,12 @@ static struct platform_driver msm_smd_driver = {
 
 static int __init msm_smd_init(void)
 {
+	hrtimer_init(&smd_poll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	smd_poll_timer.function = smd_poll_timer_func;
+
+#ifdef CONFIG_MSM_SMD_VIRTUAL
+	smd_virtual_init();
+#endif
 	return platform_driver_register(&msm_smd_driver);
 }
 
@@ -0,0 +1,319 @@
+/* arch/arm/mach-msm/smd_bench.c
+ *
+ * Throughput and latency benchmark for the SMD packet and stream paths,
+ * run over virtual channels so no modem is involved.
+ *
+ * For each channel kind and fifo size two channels are created in turn:
+ * one whose remote end discards everything (to measure how fast the
+ * apps side can push data through smd_write()), and one whose remote
+ * end echoes everything back (to measure the round trip time of a
+ * single message through smd_write(), the remote, the interrupt path
+ * and smd_read()).  The interrupts raised in each direction during the
+ * throughput run show how well they are being coalesced.
+ *
+ * Write a message count to /sys/kernel/debug/smd_bench to run it;
+ * reading the file returns the last result.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/errno.h>
+#include <linux/slab.h>
+#include <linux/fs.h>
+#include <linux/sched.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/uaccess.h>
+
+#include <mach/msm_smd.h>
+
+#include "smd_private.h"
+#include "smd_debug.h"
+
+#define BENCH_NAME		"smd_bench"
+#define BENCH_MAX		100000
+#define BENCH_TIMEOUT		(2 * HZ)
+#define BENCH_RESULT_SIZE	2048
+
+static int bench_size = 256;
+module_param(bench_size, int, 0644);
+MODULE_PARM_DESC(bench_size, "Bytes per message in the throughput test");
+
+static int bench_rtt_size = 64;
+module_param(bench_rtt_size, int, 0644);
+MODULE_PARM_DESC(bench_rtt_size, "Bytes per message in the latency test");
+
+static const unsigned bench_fifo_sizes[] = { 1024, 2048, 4096, 8192, 16384 };
+
+static const struct {
+	const char *name;
+	unsigned ctype;
+} bench_kinds[] = {
+	{ "stream", SMD_KIND_STREAM },
+	{ "packet", SMD_KIND_PACKET },
+};
+
+static DEFINE_MUTEX(bench_lock);
+static DECLARE_WAIT_QUEUE_HEAD(bench_wait);
+static smd_channel_t *bench_ch;
+static int bench_open;
+static void bench_notify(void *priv, unsigned event)
+{
+	if (event == SMD_EVENT_OPEN)
+		bench_open = 1;
+	else if (event == SMD_EVENT_CLOSE)
+		bench_open = 0;
+	wake_up(&bench_wait);
+}
+
+static int bench_start(unsigned ctype, unsigned fifo_size, int mode)
+{
+	int rc;
+
+	rc = smd_virtual_create(BENCH_NAME, ctype, fifo_size, mode);
+	if (rc)
+		return rc;
+
+	bench_open = 0;
+	rc = smd_open(BENCH_NAME, &bench_ch, NULL, bench_notify);
+	if (rc) {
+		smd_virtual_destroy(BENCH_NAME);
+		return rc;
+	}
+
+	if (!wait_event_timeout(bench_wait, bench_open, BENCH_TIMEOUT)) {
+		smd_close(bench_ch);
+		smd_virtual_destroy(BENCH_NAME);
+		return -ETIMEDOUT;
+	}
+	return 0;
+}
+
+static void bench_stop(void)
+{
+	smd_close(bench_ch);
+	smd_virtual_destroy(BENCH_NAME);
+	bench_ch = NULL;
+}
+
+/* Write one message; stream writes may be partial, packet writes fail
+ * with -ENOMEM until the whole packet fits.
+ */
+static int bench_write(const void *data, int len)
+{
+	int done = 0;
+	int n;
+
+	while (done < len) {
+		n = smd_write(bench_ch, data + done, len - done);
+		if (n > 0) {
+			done += n;
+			continue;
+		}
+		if (n < 0 && n != -ENOMEM)
+			return n;
+		if (!wait_event_timeout(bench_wait,
+					smd_write_avail(bench_ch) >= len - done,
+					BENCH_TIMEOUT))
+			return -ETIMEDOUT;
+	}
+	return 0;
+}
+
+/* Push count messages into a sink and report KB/s and interrupts */
+static int bench_throughput(int count, int size, unsigned long *kbps,
+			    unsigned *kicks, unsigned *irqs)
+{
+	void *buf;
+	int empty;
+	u64 ns;
+	ktime_t start;
+	int i, rc = 0;
+
+	buf = kzalloc(size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	empty = smd_write_avail(bench_ch);
+	start = ktime_get();
+	for (i = 0; i < count && !rc; i++)
+		rc = bench_write(buf, size);
+
+	/* wait for the remote to drain the fifo */
+	if (!rc && !wait_event_timeout(bench_wait,
+				       smd_write_avail(bench_ch) == empty,
+				       BENCH_TIMEOUT))
+		rc = -ETIMEDOUT;
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (!rc && ns)
+		*kbps = div64_u64((u64)count * size * NSEC_PER_SEC, ns) >> 10;
+	*kicks = bench_ch->kick_count;
+	*irqs = bench_ch->irq_count;
+
+	kfree(buf);
+	return rc;
+}
+
+/* Round trips of count messages through an echoing remote */
+static int bench_latency(int count, int size, unsigned long *avg_ns,
+			 unsigned long *max_ns)
+{
+	void *tx, *rx;
+	u64 total = 0, ns, max = 0;
+	ktime_t start;
+	int i, got, n, rc = 0;
+
+	tx = kzalloc(size, GFP_KERNEL);
+	rx = kmalloc(size, GFP_KERNEL);
+	if (!tx || !rx) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < count && !rc; i++) {
+		start = ktime_get();
+		rc = bench_write(tx, size);
+		for (got = 0; !rc && got < size; got += n) {
+			if (!wait_event_timeout(bench_wait,
+						smd_read_avail(bench_ch) > 0,
+						BENCH_TIMEOUT)) {
+				rc = -ETIMEDOUT;
+				break;
+			}
+			n = smd_read(bench_ch, rx + got, size - got);
+			if (n < 0)
+				rc = n;
+		}
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+		total += ns;
+		if (ns > max)
+			max = ns;
+	}
+
+	if (!rc) {
+		*avg_ns = div64_u64(total, count);
+		*max_ns = max;
+	}
+out:
+	kfree(rx);
+	kfree(tx);
+	return rc;
+}
+
+static int bench_run(unsigned long count, char *result,
+		     size_t result_size)
+{
+	unsigned long kbps = 0, avg = 0, max = 0;
+	unsigned kicks = 0, irqs = 0;
+	unsigned fifo_size;
+	int i, j, size, rtt_size;
+	int len = 0;
+	int rc;
+
+	len += scnprintf(result + len, result_size - len,
+			 "%lu messages\n", count);
+	len += scnprintf(result + len, result_size - len,
+			 "%-6s %5s %4s %7s %7s %7s %4s %7s %9s\n", "kind",
+			 "fifo", "msg", "KB/s", "kicks", "irqs", "rtt",
+			 "avg ns", "max ns");
+
+	for (i = 0; i < ARRAY_SIZE(bench_kinds); i++) {
+		for (j = 0; j < ARRAY_SIZE(bench_fifo_sizes); j++) {
+			fifo_size = bench_fifo_sizes[j];
+			/* leave room for at least a few messages in flight */
+			size = clamp(bench_size, 1, (int)fifo_size / 4);
+			rtt_size = clamp(bench_rtt_size, 1, (int)fifo_size / 4);
+
+			rc = bench_start(bench_kinds[i].ctype, fifo_size,
+					 SMD_VIRTUAL_SINK);
+			if (rc)
+				return rc;
+			rc = bench_throughput(count, size, &kbps,
+					      &kicks, &irqs);
+			bench_stop();
+			if (rc)
+				return rc;
+
+			rc = bench_start(bench_kinds[i].ctype, fifo_size,
+					 SMD_VIRTUAL_ECHO);
+			if (rc)
+				return rc;
+			rc = bench_latency(count, rtt_size, &avg, &max);
+			bench_stop();
+			if (rc)
+				return rc;
+
+			len += scnprintf(result + len, result_size - len,
+					 "%-6s %5u %4d %7lu %7u %7u %4d %7lu "
+					 "%9lu\n", bench_kinds[i].name,
+					 fifo_size, size, kbps, kicks, irqs,
+					 rtt_size, avg, max);
+		}
+	}
+	return 0;
+}
+
+static char bench_result[BENCH_RESULT_SIZE];
+
+static ssize_t bench_read(struct file *file, char __user *buf,
+			  size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&bench_lock);
+	ret = simple_read_from_buffer(buf, count, ppos, bench_result,
+				      strlen(bench_result));
+	mutex_unlock(&bench_lock);
+	return ret;
+}
+
+static ssize_t bench_write_file(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	char tmp[16];
+	unsigned long n;
+	int rc;
+
+	if (count >= sizeof(tmp))
+		return -EINVAL;
+	if (copy_from_user(tmp, buf, count))
+		return -EFAULT;
+	tmp[count] = 0;
+	if (strict_strtoul(strstrip(tmp), 0, &n) || !n || n > BENCH_MAX)
+		return -EINVAL;
+
+	mutex_lock(&bench_lock);
+	bench_result[0] = 0;
+	rc = bench_run(n, bench_result, sizeof(bench_result));
+	mutex_unlock(&bench_lock);
+
+	return rc < 0 ? rc : count;
+}
+
+static const struct file_operations bench_fops = {
+	.read	= bench_read,
+	.write	= bench_write_file,
+};
+
+static int __init smd_bench_init(void)
+{
+	debugfs_create_file(BENCH_NAME, 0600, NULL, NULL, &bench_fops);
+	return 0;
+}
+
+late_initcall(smd_bench_init);
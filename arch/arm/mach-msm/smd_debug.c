@@ -165,6 +165,37 @@ static int dump_ch(char *buf, int max, struct smd_channel *ch)
 		);
 }
 
+static int dump_ch_stats(char *buf, int max, struct smd_channel *ch)
+{
+	return scnprintf(buf, max,
+			 "ch%02d: irq %u notify %u kick %u deferred %u "
+			 "poll %u/%u%s '%s'\n", ch->n,
+			 ch->irq_count, ch->notify_count,
+			 ch->kick_count, ch->kick_deferred,
+			 ch->poll_entered, ch->poll_count,
+			 ch->polling ? " polling" : "", ch->name);
+}
+
+static int debug_read_ch_stats(char *buf, int max)
+{
+	struct smd_channel *ch;
+	unsigned long flags;
+	int i = 0;
+
+	spin_lock_irqsave(&smd_lock, flags);
+	list_for_each_entry(ch, &smd_ch_list_dsp, ch_list)
+		i += dump_ch_stats(buf + i, max - i, ch);
+	list_for_each_entry(ch, &smd_ch_list_modem, ch_list)
+		i += dump_ch_stats(buf + i, max - i, ch);
+	list_for_each_entry(ch, &smd_ch_list_virtual, ch_list)
+		i += dump_ch_stats(buf + i, max - i, ch);
+	list_for_each_entry(ch, &smd_ch_closed_list, ch_list)
+		i += dump_ch_stats(buf + i, max - i, ch);
+	spin_unlock_irqrestore(&smd_lock, flags);
+
+	return i;
+}
+
 static int debug_read_stat(char *buf, int max)
 {
 	char *msg;
@@ -211,6 +242,7 @@ static int debug_read_stat(char *buf, int max)
 	}
 #endif
 
+	i += debug_read_ch_stats(buf + i, max - i);
 	return i;
 }
 
@@ -248,6 +280,8 @@ static int debug_read_ch(char *buf, int max)
 		i += dump_ch(buf + i, max - i, ch);
 	list_for_each_entry(ch, &smd_ch_list_modem, ch_list)
 		i += dump_ch(buf + i, max - i, ch);
+	list_for_each_entry(ch, &smd_ch_list_virtual, ch_list)
+		i += dump_ch(buf + i, max - i, ch);
 	list_for_each_entry(ch, &smd_ch_closed_list, ch_list)
 		i += dump_ch(buf + i, max - i, ch);
 	spin_unlock_irqrestore(&smd_lock, flags);
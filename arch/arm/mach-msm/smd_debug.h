@@ -17,6 +17,7 @@
 #include <linux/platform_device.h>
 #include <linux/spinlock.h>
 #include <linux/list.h>
+#include <linux/hrtimer.h>
 
 struct smd_alloc_elm {
 	char name[20];
@@ -37,7 +38,7 @@ struct smd_half_channel {
 	unsigned char fUNUSED;
 	unsigned tail;
 	unsigned head;
-} __attribute__((packed));
+};
 
 struct smd_shared_v1 {
 	struct smd_half_channel ch0;
@@ -77,6 +78,27 @@ struct smd_channel {
 	void (*notify_other_cpu)(void);
 	unsigned type;
 
+	/* coalescing of notifications to the other cpu */
+	spinlock_t kick_lock;
+	struct hrtimer kick_timer;
+	ktime_t last_kick;
+	unsigned kicks_pending;
+
+	/* polled receive, under smd_lock */
+	int polling;
+	unsigned poll_pending;
+	unsigned poll_idle;
+	unsigned long irq_window;
+	unsigned irq_window_count;
+
+	/* statistics, shown in debugfs smd/stat */
+	unsigned irq_count;
+	unsigned notify_count;
+	unsigned kick_count;
+	unsigned kick_deferred;
+	unsigned poll_count;
+	unsigned poll_entered;
+
 	char name[32];
 	struct platform_device pdev;
 };
@@ -84,6 +106,7 @@ struct smd_channel {
 extern struct list_head smd_ch_closed_list;
 extern struct list_head smd_ch_list_modem;
 extern struct list_head smd_ch_list_dsp;
+extern struct list_head smd_ch_list_virtual;
 
 extern spinlock_t smd_lock;
 extern spinlock_t smem_lock;
@@ -260,6 +260,7 @@ typedef enum {
 #define SMD_TYPE_APPS_MODEM	0x000
 #define SMD_TYPE_APPS_DSP	0x001
 #define SMD_TYPE_MODEM_DSP	0x002
+#define SMD_TYPE_VIRTUAL	0x0FF
 
 #define SMD_KIND_MASK		0xF00
 #define SMD_KIND_UNKNOWN	0x000
@@ -270,4 +271,14 @@ void *smem_find(unsigned id, unsigned size);
 void *smem_item(unsigned id, unsigned *size);
 uint32_t raw_smsm_get_state(enum smsm_state_item item);
 
+#ifdef CONFIG_MSM_SMD_VIRTUAL
+/* what the remote end of a virtual channel does with received data */
+#define SMD_VIRTUAL_ECHO	0
+#define SMD_VIRTUAL_SINK	1
+
+int smd_virtual_create(const char *name, unsigned ctype,
+		       unsigned fifo_size, int mode);
+int smd_virtual_destroy(const char *name);
+#endif
+
 #endif
@@ -18,7 +18,6 @@
 /* TODO: handle cases where smd_write() will tempfail due to full fifo */
 /* TODO: thread priority? schedule a work to bump it? */
 /* TODO: maybe make server_list_lock a mutex */
-/* TODO: pool fragments to avoid kmalloc/kfree churn */
 
 #include <linux/module.h>
 #include <linux/kernel.h>
@@ -34,6 +33,8 @@
 #include <linux/sched.h>
 #include <linux/poll.h>
 #include <linux/wakelock.h>
+#include <linux/jhash.h>
+#include <linux/rculist.h>
 #include <asm/uaccess.h>
 #include <asm/byteorder.h>
 #include <linux/platform_device.h>
@@ -80,12 +81,23 @@
 #define NTFY(x...) do {} while (0)
 #endif
 
-static LIST_HEAD(local_endpoints);
-static LIST_HEAD(remote_endpoints);
+/*
+ * Endpoints are hashed by cid (the pid is implied: local endpoints are
+ * RPCROUTER_PID_LOCAL, remote ones RPCROUTER_PID_REMOTE) and servers by
+ * prog, so that all versions of a program share a bucket for the
+ * compatible version search.  Lookups run under RCU; the locks below
+ * only serialize updates.
+ */
+#define RPCROUTER_EPT_HASH_BITS		8
+#define RPCROUTER_SERVER_HASH_BITS	8
+
+static struct hlist_head local_endpoints[1 << RPCROUTER_EPT_HASH_BITS];
+static struct hlist_head remote_endpoints[1 << RPCROUTER_EPT_HASH_BITS];
+static struct hlist_head server_hash[1 << RPCROUTER_SERVER_HASH_BITS];
 
 static LIST_HEAD(server_list);
 
-static smd_channel_t *smd_channel;
+static struct rpcrouter_xprt *rr_xprt;
 static int initialized;
 static wait_queue_head_t newserver_wait;
 static wait_queue_head_t smd_wait;
@@ -130,6 +142,19 @@ static struct platform_device rpcrouter_pdev = {
 	.id		= -1,
 };
 
+static inline struct hlist_head *rr_ept_bucket(struct hlist_head *table,
+					       uint32_t cid)
+{
+	return &table[jhash_1word(cid, 0) &
+		      ((1 << RPCROUTER_EPT_HASH_BITS) - 1)];
+}
+
+static inline struct hlist_head *rr_server_bucket(uint32_t prog)
+{
+	return &server_hash[jhash_1word(prog, 0) &
+			    ((1 << RPCROUTER_SERVER_HASH_BITS) - 1)];
+}
+
 
 static int rpcrouter_send_control_msg(union rr_control_msg *msg)
 {
@@ -156,17 +181,22 @@ static int rpcrouter_send_control_msg(union rr_control_msg *msg)
 
 	need = sizeof(hdr) + hdr.size;
 	spin_lock_irqsave(&smd_lock, flags);
-	while (smd_write_avail(smd_channel) < need) {
+	while (rr_xprt->write_avail() < need) {
 		spin_unlock_irqrestore(&smd_lock, flags);
 		msleep(250);
 		spin_lock_irqsave(&smd_lock, flags);
 	}
-	smd_write(smd_channel, &hdr, sizeof(hdr));
-	smd_write(smd_channel, msg, hdr.size);
+	rr_xprt->write(&hdr, sizeof(hdr));
+	rr_xprt->write(msg, hdr.size);
 	spin_unlock_irqrestore(&smd_lock, flags);
 	return 0;
 }
 
+static void rr_free_server(struct rcu_head *head)
+{
+	kfree(container_of(head, struct rr_server, rcu));
+}
+
 static struct rr_server *rpcrouter_create_server(uint32_t pid,
 							uint32_t cid,
 							uint32_t prog,
@@ -188,6 +218,7 @@ static struct rr_server *rpcrouter_create_server(uint32_t pid,
 
 	spin_lock_irqsave(&server_list_lock, flags);
 	list_add_tail(&server->list, &server_list);
+	hlist_add_head_rcu(&server->hash, rr_server_bucket(prog));
 	spin_unlock_irqrestore(&server_list_lock, flags);
 
 	if (pid == RPCROUTER_PID_REMOTE) {
@@ -199,37 +230,47 @@ static struct rr_server *rpcrouter_create_server(uint32_t pid,
 out_fail:
 	spin_lock_irqsave(&server_list_lock, flags);
 	list_del(&server->list);
+	hlist_del_rcu(&server->hash);
 	spin_unlock_irqrestore(&server_list_lock, flags);
-	kfree(server);
+	call_rcu(&server->rcu, rr_free_server);
 	return ERR_PTR(rc);
 }
 
-static void rpcrouter_destroy_server(struct rr_server *server)
+/*
+ * Caller holds rcu_read_lock() or server_list_lock; the server is only
+ * good until it drops it.
+ */
+struct rr_server *msm_rpcrouter_lookup_server(uint32_t prog, uint32_t ver)
 {
-	unsigned long flags;
+	struct rr_server *server;
+	struct hlist_node *n;
 
-	spin_lock_irqsave(&server_list_lock, flags);
-	list_del(&server->list);
-	spin_unlock_irqrestore(&server_list_lock, flags);
-	device_destroy(msm_rpcrouter_class, server->device_number);
-	kfree(server);
+	hlist_for_each_entry_rcu(server, n, rr_server_bucket(prog), hash) {
+		if (server->prog == prog
+		 && server->vers == ver)
+			return server;
+	}
+	return NULL;
 }
 
-static struct rr_server *rpcrouter_lookup_server(uint32_t prog, uint32_t ver)
+/* Look up and unhash in one go, so that only one caller frees it */
+static int rpcrouter_destroy_server(uint32_t prog, uint32_t ver)
 {
 	struct rr_server *server;
 	unsigned long flags;
 
 	spin_lock_irqsave(&server_list_lock, flags);
-	list_for_each_entry(server, &server_list, list) {
-		if (server->prog == prog
-		 && server->vers == ver) {
-			spin_unlock_irqrestore(&server_list_lock, flags);
-			return server;
-		}
+	server = msm_rpcrouter_lookup_server(prog, ver);
+	if (!server) {
+		spin_unlock_irqrestore(&server_list_lock, flags);
+		return -ENOENT;
 	}
+	list_del(&server->list);
+	hlist_del_rcu(&server->hash);
 	spin_unlock_irqrestore(&server_list_lock, flags);
-	return NULL;
+	device_destroy(msm_rpcrouter_class, server->device_number);
+	call_rcu(&server->rcu, rr_free_server);
+	return 0;
 }
 
 static struct rr_server *rpcrouter_lookup_server_by_dev(dev_t dev)
@@ -248,10 +289,63 @@ static struct rr_server *rpcrouter_lookup_server_by_dev(dev_t dev)
 	return NULL;
 }
 
+void msm_rpcrouter_put_packet(struct msm_rpc_endpoint *ept,
+			      struct rr_packet *pkt)
+{
+	unsigned long flags;
+
+	if (pkt->data != pkt->buf)
+		kfree(pkt->data);
+
+	spin_lock_irqsave(&ept->read_q_lock, flags);
+	if (ept->pkt_pool_count < RPCROUTER_PKT_POOL_MAX) {
+		list_add(&pkt->list, &ept->pkt_pool);
+		ept->pkt_pool_count++;
+		pkt = NULL;
+	}
+	spin_unlock_irqrestore(&ept->read_q_lock, flags);
+
+	kfree(pkt);
+}
+
+static void rr_free_packets(struct list_head *list)
+{
+	struct rr_packet *pkt, *tmp;
+
+	list_for_each_entry_safe(pkt, tmp, list, list) {
+		list_del(&pkt->list);
+		if (pkt->data != pkt->buf)
+			kfree(pkt->data);
+		kfree(pkt);
+	}
+}
+
+static void rr_free_local_endpoint(struct rcu_head *head)
+{
+	struct msm_rpc_endpoint *ept =
+		container_of(head, struct msm_rpc_endpoint, rcu);
+
+	rr_free_packets(&ept->incomplete);
+	rr_free_packets(&ept->read_q);
+	rr_free_packets(&ept->pkt_pool);
+	kfree(ept);
+}
+
+void msm_rpcrouter_put_local_endpoint(struct msm_rpc_endpoint *ept)
+{
+	if (!atomic_dec_and_test(&ept->ref))
+		return;
+
+	wake_lock_destroy(&ept->read_q_wake_lock);
+	call_rcu(&ept->rcu, rr_free_local_endpoint);
+}
+
 struct msm_rpc_endpoint *msm_rpcrouter_create_local_endpoint(dev_t dev)
 {
 	struct msm_rpc_endpoint *ept;
+	struct rr_packet *pkt;
 	unsigned long flags;
+	int i;
 
 	ept = kmalloc(sizeof(struct msm_rpc_endpoint), GFP_KERNEL);
 	if (!ept)
@@ -295,8 +389,20 @@ struct msm_rpc_endpoint *msm_rpcrouter_create_local_endpoint(dev_t dev)
 	wake_lock_init(&ept->read_q_wake_lock, WAKE_LOCK_SUSPEND, "rpc_read");
 	INIT_LIST_HEAD(&ept->incomplete);
 
+	/* Fill the packet pool; the receive path allocates if it runs dry */
+	INIT_LIST_HEAD(&ept->pkt_pool);
+	for (i = 0; i < RPCROUTER_PKT_POOL_MIN; i++) {
+		pkt = kmalloc(sizeof(struct rr_packet), GFP_KERNEL);
+		if (!pkt)
+			break;
+		list_add(&pkt->list, &ept->pkt_pool);
+		ept->pkt_pool_count++;
+	}
+
+	atomic_set(&ept->ref, 1);
 	spin_lock_irqsave(&local_endpoints_lock, flags);
-	list_add_tail(&ept->list, &local_endpoints);
+	hlist_add_head_rcu(&ept->hash,
+			   rr_ept_bucket(local_endpoints, ept->cid));
 	spin_unlock_irqrestore(&local_endpoints_lock, flags);
 	return ept;
 }
@@ -305,6 +411,7 @@ int msm_rpcrouter_destroy_local_endpoint(struct msm_rpc_endpoint *ept)
 {
 	int rc;
 	union rr_control_msg msg;
+	unsigned long flags;
 
 	msg.cmd = RPCROUTER_CTRL_CMD_REMOVE_CLIENT;
 	msg.cli.pid = ept->pid;
@@ -315,9 +422,12 @@ int msm_rpcrouter_destroy_local_endpoint(struct msm_rpc_endpoint *ept)
 	if (rc < 0)
 		return rc;
 
-	wake_lock_destroy(&ept->read_q_wake_lock);
-	list_del(&ept->list);
-	kfree(ept);
+	spin_lock_irqsave(&local_endpoints_lock, flags);
+	hlist_del_rcu(&ept->hash);
+	spin_unlock_irqrestore(&local_endpoints_lock, flags);
+
+	/* do_read_data() may still hold a reference */
+	msm_rpcrouter_put_local_endpoint(ept);
 	return 0;
 }
 
@@ -333,44 +443,58 @@ static int rpcrouter_create_remote_endpoint(uint32_t cid)
 
 	new_c->cid = cid;
 	new_c->pid = RPCROUTER_PID_REMOTE;
+	atomic_set(&new_c->ref, 1);
 	init_waitqueue_head(&new_c->quota_wait);
 	spin_lock_init(&new_c->quota_lock);
 
 	spin_lock_irqsave(&remote_endpoints_lock, flags);
-	list_add_tail(&new_c->list, &remote_endpoints);
+	hlist_add_head_rcu(&new_c->hash, rr_ept_bucket(remote_endpoints, cid));
 	spin_unlock_irqrestore(&remote_endpoints_lock, flags);
 	return 0;
 }
 
-static struct msm_rpc_endpoint *rpcrouter_lookup_local_endpoint(uint32_t cid)
+static void rr_free_remote_endpoint(struct rcu_head *head)
+{
+	kfree(container_of(head, struct rr_remote_endpoint, rcu));
+}
+
+void msm_rpcrouter_put_remote_endpoint(struct rr_remote_endpoint *r_ept)
+{
+	if (atomic_dec_and_test(&r_ept->ref))
+		call_rcu(&r_ept->rcu, rr_free_remote_endpoint);
+}
+
+struct msm_rpc_endpoint *msm_rpcrouter_lookup_local_endpoint(uint32_t cid)
 {
 	struct msm_rpc_endpoint *ept;
-	unsigned long flags;
+	struct hlist_node *n;
 
-	spin_lock_irqsave(&local_endpoints_lock, flags);
-	list_for_each_entry(ept, &local_endpoints, list) {
-		if (ept->cid == cid) {
-			spin_unlock_irqrestore(&local_endpoints_lock, flags);
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(ept, n, rr_ept_bucket(local_endpoints, cid),
+				 hash) {
+		if (ept->cid == cid && atomic_inc_not_zero(&ept->ref)) {
+			rcu_read_unlock();
 			return ept;
 		}
 	}
-	spin_unlock_irqrestore(&local_endpoints_lock, flags);
+	rcu_read_unlock();
 	return NULL;
 }
 
-static struct rr_remote_endpoint *rpcrouter_lookup_remote_endpoint(uint32_t cid)
+struct rr_remote_endpoint *msm_rpcrouter_lookup_remote_endpoint(uint32_t cid)
 {
 	struct rr_remote_endpoint *ept;
-	unsigned long flags;
+	struct hlist_node *n;
 
-	spin_lock_irqsave(&remote_endpoints_lock, flags);
-	list_for_each_entry(ept, &remote_endpoints, list) {
-		if (ept->cid == cid) {
-			spin_unlock_irqrestore(&remote_endpoints_lock, flags);
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(ept, n, rr_ept_bucket(remote_endpoints, cid),
+				 hash) {
+		if (ept->cid == cid && atomic_inc_not_zero(&ept->ref)) {
+			rcu_read_unlock();
 			return ept;
 		}
 	}
-	spin_unlock_irqrestore(&remote_endpoints_lock, flags);
+	rcu_read_unlock();
 	return NULL;
 }
 
@@ -424,7 +548,7 @@ static int process_control_msg(union rr_control_msg *msg, int len)
 	case RPCROUTER_CTRL_CMD_RESUME_TX:
 		RR("o RESUME_TX id=%d:%08x\n", msg->cli.pid, msg->cli.cid);
 
-		r_ept = rpcrouter_lookup_remote_endpoint(msg->cli.cid);
+		r_ept = msm_rpcrouter_lookup_remote_endpoint(msg->cli.cid);
 		if (!r_ept) {
 			printk(KERN_ERR
 			       "rpcrouter: Unable to resume client\n");
@@ -434,13 +558,26 @@ static int process_control_msg(union rr_control_msg *msg, int len)
 		r_ept->tx_quota_cntr = 0;
 		spin_unlock_irqrestore(&r_ept->quota_lock, flags);
 		wake_up(&r_ept->quota_wait);
+		msm_rpcrouter_put_remote_endpoint(r_ept);
 		break;
 
 	case RPCROUTER_CTRL_CMD_NEW_SERVER:
 		RR("o NEW_SERVER id=%d:%08x prog=%08x:%08x\n",
 		   msg->srv.pid, msg->srv.cid, msg->srv.prog, msg->srv.vers);
 
-		server = rpcrouter_lookup_server(msg->srv.prog, msg->srv.vers);
+		spin_lock_irqsave(&server_list_lock, flags);
+		server = msm_rpcrouter_lookup_server(msg->srv.prog,
+						     msg->srv.vers);
+		if (server) {
+			if ((server->pid == msg->srv.pid) &&
+			    (server->cid == msg->srv.cid)) {
+				printk(KERN_ERR "rpcrouter: Duplicate svr\n");
+			} else {
+				server->pid = msg->srv.pid;
+				server->cid = msg->srv.cid;
+			}
+		}
+		spin_unlock_irqrestore(&server_list_lock, flags);
 
 		if (!server) {
 			server = rpcrouter_create_server(
@@ -453,33 +590,26 @@ static int process_control_msg(union rr_control_msg *msg, int len)
 			 * client to our remote client list
 			 * if we get a NEW_SERVER notification
 			 */
-			if (!rpcrouter_lookup_remote_endpoint(msg->srv.cid)) {
+			r_ept = msm_rpcrouter_lookup_remote_endpoint(
+				msg->srv.cid);
+			if (!r_ept) {
 				rc = rpcrouter_create_remote_endpoint(
 					msg->srv.cid);
 				if (rc < 0)
 					printk(KERN_ERR
 						"rpcrouter:Client create"
 						"error (%d)\n", rc);
-			}
+			} else
+				msm_rpcrouter_put_remote_endpoint(r_ept);
 			schedule_work(&work_create_pdevs);
 			wake_up(&newserver_wait);
-		} else {
-			if ((server->pid == msg->srv.pid) &&
-			    (server->cid == msg->srv.cid)) {
-				printk(KERN_ERR "rpcrouter: Duplicate svr\n");
-			} else {
-				server->pid = msg->srv.pid;
-				server->cid = msg->srv.cid;
-			}
 		}
 		break;
 
 	case RPCROUTER_CTRL_CMD_REMOVE_SERVER:
 		RR("o REMOVE_SERVER prog=%08x:%d\n",
 		   msg->srv.prog, msg->srv.vers);
-		server = rpcrouter_lookup_server(msg->srv.prog, msg->srv.vers);
-		if (server)
-			rpcrouter_destroy_server(server);
+		rpcrouter_destroy_server(msg->srv.prog, msg->srv.vers);
 		break;
 
 	case RPCROUTER_CTRL_CMD_REMOVE_CLIENT:
@@ -490,12 +620,21 @@ static int process_control_msg(union rr_control_msg *msg, int len)
 			       "local client\n");
 			break;
 		}
-		r_ept = rpcrouter_lookup_remote_endpoint(msg->cli.cid);
+		r_ept = msm_rpcrouter_lookup_remote_endpoint(msg->cli.cid);
 		if (r_ept) {
 			spin_lock_irqsave(&remote_endpoints_lock, flags);
-			list_del(&r_ept->list);
+			hlist_del_rcu(&r_ept->hash);
 			spin_unlock_irqrestore(&remote_endpoints_lock, flags);
-			kfree(r_ept);
+
+			/* don't leave writers waiting for a RESUME_TX */
+			spin_lock_irqsave(&r_ept->quota_lock, flags);
+			r_ept->tx_quota_cntr = 0;
+			spin_unlock_irqrestore(&r_ept->quota_lock, flags);
+			wake_up(&r_ept->quota_wait);
+
+			/* the hash's reference, then our own */
+			msm_rpcrouter_put_remote_endpoint(r_ept);
+			msm_rpcrouter_put_remote_endpoint(r_ept);
 		}
 
 		/* Notify local clients of this event */
@@ -537,16 +676,60 @@ static void do_create_pdevs(struct work_struct *work)
 	spin_unlock_irqrestore(&server_list_lock, flags);
 }
 
+void msm_rpcrouter_xprt_notify(void)
+{
+	if (rr_xprt->read_avail() >= rpcrouter_need_len)
+		wake_lock(&rpcrouter_wake_lock);
+	wake_up(&smd_wait);
+}
+
+#ifndef CONFIG_MSM_RPCROUTER_LOOPBACK
+static smd_channel_t *smd_channel;
+
 static void rpcrouter_smdnotify(void *_dev, unsigned event)
 {
 	if (event != SMD_EVENT_DATA)
 		return;
 
-	if (smd_read_avail(smd_channel) >= rpcrouter_need_len)
-		wake_lock(&rpcrouter_wake_lock);
-	wake_up(&smd_wait);
+	msm_rpcrouter_xprt_notify();
+}
+
+static int rpcrouter_smd_open(void)
+{
+	return smd_open("SMD_RPCCALL", &smd_channel, NULL,
+			rpcrouter_smdnotify);
+}
+
+static int rpcrouter_smd_read_avail(void)
+{
+	return smd_read_avail(smd_channel);
 }
 
+static int rpcrouter_smd_read(void *data, int len)
+{
+	return smd_read(smd_channel, data, len);
+}
+
+static int rpcrouter_smd_write_avail(void)
+{
+	return smd_write_avail(smd_channel);
+}
+
+static int rpcrouter_smd_write(const void *data, int len)
+{
+	return smd_write(smd_channel, data, len);
+}
+
+static struct rpcrouter_xprt rpcrouter_smd_xprt = {
+	.name		= "SMD_RPCCALL",
+	.open		= rpcrouter_smd_open,
+	.read_avail	= rpcrouter_smd_read_avail,
+	.read		= rpcrouter_smd_read,
+	.write_avail	= rpcrouter_smd_write_avail,
+	.write		= rpcrouter_smd_write,
+};
+#endif
+
 static void *rr_malloc(unsigned sz)
 {
 	void *ptr = kmalloc(sz, GFP_KERNEL);
@@ -561,6 +744,46 @@ static void *rr_malloc(unsigned sz)
 	return ptr;
 }
 
+static struct rr_packet *rr_get_packet(struct msm_rpc_endpoint *ept)
+{
+	struct rr_packet *pkt = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ept->read_q_lock, flags);
+	if (!list_empty(&ept->pkt_pool)) {
+		pkt = list_first_entry(&ept->pkt_pool, struct rr_packet, list);
+		list_del(&pkt->list);
+		ept->pkt_pool_count--;
+	}
+	spin_unlock_irqrestore(&ept->read_q_lock, flags);
+
+	if (!pkt)
+		pkt = rr_malloc(sizeof(struct rr_packet));
+
+	pkt->data = pkt->buf;
+	pkt->size = sizeof(pkt->buf);
+	pkt->length = 0;
+	return pkt;
+}
+
+/* Make room for len more bytes; only multi-fragment messages get here */
+static void rr_packet_reserve(struct rr_packet *pkt, uint32_t len)
+{
+	unsigned char *data;
+	uint32_t size;
+
+	if (pkt->length + len <= pkt->size)
+		return;
+
+	size = max(pkt->size * 2, pkt->length + len);
+	data = rr_malloc(size);
+	memcpy(data, pkt->data, pkt->length);
+	if (pkt->data != pkt->buf)
+		kfree(pkt->data);
+	pkt->data = data;
+	pkt->size = size;
+}
+
 /* TODO: deal with channel teardown / restore */
 static int rr_read(void *data, int len)
 {
@@ -569,8 +792,8 @@ static int rr_read(void *data, int len)
 //	printk("rr_read() %d\n", len);
 	for(;;) {
 		spin_lock_irqsave(&smd_lock, flags);
-		if (smd_read_avail(smd_channel) >= len) {
-			rc = smd_read(smd_channel, data, len);
+		if (rr_xprt->read_avail() >= len) {
+			rc = rr_xprt->read(data, len);
 			spin_unlock_irqrestore(&smd_lock, flags);
 			if (rc == len)
 				return 0;
@@ -584,7 +807,7 @@ static int rr_read(void *data, int len)
 //		printk("rr_read: waiting (%d)\n", len);
 		smd_wait_count++;
 		wake_up(&smd_wait);
-		wait_event(smd_wait, smd_read_avail(smd_channel) >= len);
+		wait_event(smd_wait, rr_xprt->read_avail() >= len);
 		smd_wait_count++;
 	}
 	return 0;
@@ -596,10 +819,10 @@ static void do_read_data(struct work_struct *work)
 {
 	struct rr_header hdr;
 	struct rr_packet *pkt;
-	struct rr_fragment *frag;
 	struct msm_rpc_endpoint *ept;
 	uint32_t pm, mid;
 	unsigned long flags;
+	int found = 0;
 
 	if (rr_read(&hdr, sizeof(hdr)))
 		goto fail_io;
@@ -635,62 +858,61 @@ static void do_read_data(struct work_struct *work)
 
 	hdr.size -= sizeof(pm);
 
-	frag = rr_malloc(hdr.size + sizeof(*frag));
-	frag->next = NULL;
-	frag->length = hdr.size;
-	if (rr_read(frag->data, hdr.size))
-		goto fail_io;
-
-	ept = rpcrouter_lookup_local_endpoint(hdr.dst_cid);
+	ept = msm_rpcrouter_lookup_local_endpoint(hdr.dst_cid);
 	if (!ept) {
 		DIAG("no local ept for cid %08x\n", hdr.dst_cid);
-		kfree(frag);
+		if (rr_read(r2r_buf, hdr.size))
+			goto fail_io;
 		goto done;
 	}
 
 	/* See if there is already a partial packet that matches our mid
-	 * and if so, append this fragment to that packet.
+	 * and if so, append this fragment to that packet.  Otherwise the
+	 * mid is new -- take a packet for it from the endpoint's pool, and
+	 * put it on the incomplete list unless this is the last fragment.
 	 */
 	mid = PACMARK_MID(pm);
 	list_for_each_entry(pkt, &ept->incomplete, list) {
 		if (pkt->mid == mid) {
-			pkt->last->next = frag;
-			pkt->last = frag;
-			pkt->length += frag->length;
-			if (PACMARK_LAST(pm)) {
-				list_del(&pkt->list);
-				goto packet_complete;
-			}
-			goto done;
+			found = 1;
+			break;
 		}
 	}
-	/* This mid is new -- create a packet for it, and put it on
-	 * the incomplete list if this fragment is not a last fragment,
-	 * otherwise put it on the read queue.
-	 */
-	pkt = rr_malloc(sizeof(struct rr_packet));
-	pkt->first = frag;
-	pkt->last = frag;
-	memcpy(&pkt->hdr, &hdr, sizeof(hdr));
-	pkt->mid = mid;
-	pkt->length = frag->length;
-	if (!PACMARK_LAST(pm)) {
-		list_add_tail(&pkt->list, &ept->incomplete);
-		goto done;
+	if (found) {
+		if (PACMARK_LAST(pm))
+			list_del(&pkt->list);
+	} else {
+		pkt = rr_get_packet(ept);
+		memcpy(&pkt->hdr, &hdr, sizeof(hdr));
+		pkt->mid = mid;
+		if (!PACMARK_LAST(pm))
+			list_add_tail(&pkt->list, &ept->incomplete);
 	}
 
-packet_complete:
+	/* Read the fragment straight into its place in the message */
+	rr_packet_reserve(pkt, hdr.size);
+	if (rr_read(pkt->data + pkt->length, hdr.size))
+		goto fail_io;
+	pkt->length += hdr.size;
+
+	if (!PACMARK_LAST(pm))
+		goto done;
+
 	spin_lock_irqsave(&ept->read_q_lock, flags);
 	if (ept->flags & MSM_RPC_ENABLE_RECEIVE) {
 		wake_lock(&ept->read_q_wake_lock);
 		list_add_tail(&pkt->list, &ept->read_q);
 		wake_up(&ept->wait_q);
+		pkt = NULL;
 	} else {
 		pr_warning("smd_rpcrouter: Unexpected incoming data on %08x:%08x\n",
 				be32_to_cpu(ept->dst_prog),
 				be32_to_cpu(ept->dst_vers));
 	}
 	spin_unlock_irqrestore(&ept->read_q_lock, flags);
+	if (pkt)
+		msm_rpcrouter_put_packet(ept, pkt);
+	msm_rpcrouter_put_local_endpoint(ept);
 done:
 
 	if (hdr.confirm_rx) {
@@ -823,7 +1045,7 @@ int msm_rpc_write(struct msm_rpc_endpoint *ept, void *buffer, int count)
 		   be32_to_cpu(rq->xid), hdr.dst_pid, hdr.dst_cid, count);
 	}
 
-	r_ept = rpcrouter_lookup_remote_endpoint(hdr.dst_cid);
+	r_ept = msm_rpcrouter_lookup_remote_endpoint(hdr.dst_cid);
 
 	if (!r_ept) {
 		printk(KERN_ERR
@@ -857,6 +1079,7 @@ int msm_rpc_write(struct msm_rpc_endpoint *ept, void *buffer, int count)
 	if (signal_pending(current) &&
 	    (!(ept->flags & MSM_RPC_UNINTERRUPTIBLE))) {
 		spin_unlock_irqrestore(&r_ept->quota_lock, flags);
+		msm_rpcrouter_put_remote_endpoint(r_ept);
 		return -ERESTARTSYS;
 	}
 	r_ept->tx_quota_cntr++;
@@ -869,20 +1092,21 @@ int msm_rpc_write(struct msm_rpc_endpoint *ept, void *buffer, int count)
 	pacmark = PACMARK(count, ++next_pacmarkid, 0, 1);
 
 	spin_unlock_irqrestore(&r_ept->quota_lock, flags);
+	msm_rpcrouter_put_remote_endpoint(r_ept);
 
 	spin_lock_irqsave(&smd_lock, flags);
 
 	needed = sizeof(hdr) + hdr.size;
-	while (smd_write_avail(smd_channel) < needed) {
+	while (rr_xprt->write_avail() < needed) {
 		spin_unlock_irqrestore(&smd_lock, flags);
 		msleep(250);
 		spin_lock_irqsave(&smd_lock, flags);
 	}
 
 	/* TODO: deal with full fifo */
-	smd_write(smd_channel, &hdr, sizeof(hdr));
-	smd_write(smd_channel, &pacmark, sizeof(pacmark));
-	smd_write(smd_channel, buffer, count);
+	rr_xprt->write(&hdr, sizeof(hdr));
+	rr_xprt->write(&pacmark, sizeof(pacmark));
+	rr_xprt->write(buffer, count);
 
 	spin_unlock_irqrestore(&smd_lock, flags);
 
@@ -896,34 +1120,23 @@ EXPORT_SYMBOL(msm_rpc_write);
 int msm_rpc_read(struct msm_rpc_endpoint *ept, void **buffer,
 		 unsigned user_len, long timeout)
 {
-	struct rr_fragment *frag, *next;
-	char *buf;
+	struct rr_packet *pkt;
 	int rc;
 
-	rc = __msm_rpc_read(ept, &frag, user_len, timeout);
-	if (rc <= 0)
-		return rc;
-
-	/* single-fragment messages conveniently can be
-	 * returned as-is (the buffer is at the front)
-	 */
-	if (frag->next == 0) {
-		*buffer = (void*) frag;
+	rc = __msm_rpc_read(ept, &pkt, user_len, timeout);
+	if (rc < 0)
 		return rc;
-	}
 
-	/* multi-fragment messages, we have to do it the
-	 * hard way, which is rather disgusting right now
+	/* Messages that fit the packet's own buffer are returned as-is
+	 * (the buffer is at the front); larger ones were assembled in a
+	 * separate allocation that the caller can take over.
 	 */
-	buf = rr_malloc(rc);
-	*buffer = buf;
-
-	while (frag != NULL) {
-		memcpy(buf, frag->data, frag->length);
-		next = frag->next;
-		buf += frag->length;
-		kfree(frag);
-		frag = next;
+	if (pkt->data == pkt->buf) {
+		*buffer = pkt;
+	} else {
+		*buffer = pkt->data;
+		pkt->data = pkt->buf;
+		msm_rpcrouter_put_packet(ept, pkt);
 	}
 
 	return rc;
@@ -946,6 +1159,7 @@ int msm_rpc_call_reply(struct msm_rpc_endpoint *ept, uint32_t proc,
 {
 	struct rpc_request_hdr *req = _request;
 	struct rpc_reply_hdr *reply;
+	struct rr_packet *pkt;
 	int rc;
 
 	if (request_size < sizeof(*req))
@@ -972,16 +1186,17 @@ int msm_rpc_call_reply(struct msm_rpc_endpoint *ept, uint32_t proc,
 		goto error;
 
 	for (;;) {
-		rc = msm_rpc_read(ept, (void*) &reply, -1, timeout);
+		rc = __msm_rpc_read(ept, &pkt, -1, timeout);
 		if (rc < 0)
 			goto error;
+		reply = (void *) pkt->data;
 		if (rc < (3 * sizeof(uint32_t))) {
 			rc = -EIO;
 			break;
 		}
 		/* we should not get CALL packets -- ignore them */
 		if (reply->type == 0) {
-			kfree(reply);
+			msm_rpcrouter_put_packet(ept, pkt);
 			continue;
 		}
 		/* If an earlier call timed out, we could get the (no
@@ -989,7 +1204,7 @@ int msm_rpc_call_reply(struct msm_rpc_endpoint *ept, uint32_t proc,
 		 * we don't expect.
 		 */
 		if (reply->xid != req->xid) {
-			kfree(reply);
+			msm_rpcrouter_put_packet(ept, pkt);
 			continue;
 		}
 		if (reply->reply_stat != 0) {
@@ -1011,7 +1226,7 @@ int msm_rpc_call_reply(struct msm_rpc_endpoint *ept, uint32_t proc,
 		}
 		break;
 	}
-	kfree(reply);
+	msm_rpcrouter_put_packet(ept, pkt);
 error:
 	ept->flags &= ~MSM_RPC_ENABLE_RECEIVE;
 	wake_unlock(&ept->read_q_wake_lock);
@@ -1032,7 +1247,7 @@ static inline int ept_packet_available(struct msm_rpc_endpoint *ept)
 }
 
 int __msm_rpc_read(struct msm_rpc_endpoint *ept,
-		   struct rr_fragment **frag_ret,
+		   struct rr_packet **pkt_ret,
 		   unsigned len, long timeout)
 {
 	struct rr_packet *pkt;
@@ -1043,7 +1258,10 @@ int __msm_rpc_read(struct msm_rpc_endpoint *ept,
 
 	IO("READ on ept %p\n", ept);
 
-	if (ept->flags & MSM_RPC_UNINTERRUPTIBLE) {
+	if (timeout == 0) {
+		if (!ept_packet_available(ept))
+			return -EAGAIN;
+	} else if (ept->flags & MSM_RPC_UNINTERRUPTIBLE) {
 		if (timeout < 0) {
 			wait_event(ept->wait_q, ept_packet_available(ept));
 		} else {
@@ -1085,8 +1303,8 @@ int __msm_rpc_read(struct msm_rpc_endpoint *ept,
 
 	rc = pkt->length;
 
-	*frag_ret = pkt->first;
-	rq = (void*) pkt->first->data;
+	*pkt_ret = pkt;
+	rq = (void*) pkt->data;
 	if ((rc >= (sizeof(uint32_t) * 3)) && (rq->type == 0)) {
 		IO("READ on ept %p is a CALL on %08x:%08x proc %d xid %d\n",
 			ept, be32_to_cpu(rq->prog), be32_to_cpu(rq->vers),
@@ -1108,7 +1326,6 @@ int __msm_rpc_read(struct msm_rpc_endpoint *ept,
 	else IO("READ on ept %p (%d bytes)\n", ept, rc);
 #endif
 
-	kfree(pkt);
 	return rc;
 }
 
@@ -1135,20 +1352,20 @@ static int msm_rpc_get_compatible_server(uint32_t prog,
 					uint32_t *found_vers)
 {
 	struct rr_server *server;
-	unsigned long     flags;
+	struct hlist_node *n;
 	if (found_vers == NULL)
 		return 0;
 
-	spin_lock_irqsave(&server_list_lock, flags);
-	list_for_each_entry(server, &server_list, list) {
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(server, n, rr_server_bucket(prog), hash) {
 		if ((server->prog == prog) &&
 		    msm_rpc_is_compatible_version(server->vers, ver)) {
 			*found_vers = server->vers;
-			spin_unlock_irqrestore(&server_list_lock, flags);
+			rcu_read_unlock();
 			return 0;
 		}
 	}
-	spin_unlock_irqrestore(&server_list_lock, flags);
+	rcu_read_unlock();
 	return -1;
 }
 #endif
@@ -1157,6 +1374,7 @@ struct msm_rpc_endpoint *msm_rpc_connect(uint32_t prog, uint32_t vers, unsigned
 {
 	struct msm_rpc_endpoint *ept;
 	struct rr_server *server;
+	uint32_t dst_pid = 0, dst_cid = 0;
 
 #if defined(CONFIG_ARCH_QSD8X50)
 	if (!(vers & RPC_VERSION_MODE_MASK)) {
@@ -1171,7 +1389,13 @@ struct msm_rpc_endpoint *msm_rpc_connect(uint32_t prog, uint32_t vers, unsigned
 	}
 #endif
 
-	server = rpcrouter_lookup_server(prog, vers);
+	rcu_read_lock();
+	server = msm_rpcrouter_lookup_server(prog, vers);
+	if (server) {
+		dst_pid = server->pid;
+		dst_cid = server->cid;
+	}
+	rcu_read_unlock();
 	if (!server)
 		return ERR_PTR(-EHOSTUNREACH);
 
@@ -1180,8 +1404,8 @@ struct msm_rpc_endpoint *msm_rpc_connect(uint32_t prog, uint32_t vers, unsigned
 		return ept;
 
 	ept->flags = flags;
-	ept->dst_pid = server->pid;
-	ept->dst_cid = server->cid;
+	ept->dst_pid = dst_pid;
+	ept->dst_cid = dst_cid;
 	ept->dst_prog = cpu_to_be32(prog);
 	ept->dst_vers = cpu_to_be32(vers);
 
@@ -1229,26 +1453,22 @@ int msm_rpc_register_server(struct msm_rpc_endpoint *ept,
 int msm_rpc_unregister_server(struct msm_rpc_endpoint *ept,
 			      uint32_t prog, uint32_t vers)
 {
-	struct rr_server *server;
-	server = rpcrouter_lookup_server(prog, vers);
+	int rc;
 
-	if (!server)
-		return -ENOENT;
+	rc = rpcrouter_destroy_server(prog, vers);
+	if (rc < 0)
+		return rc;
 
 	ept->flags &= ~MSM_RPC_ENABLE_RECEIVE;
 	wake_unlock(&ept->read_q_wake_lock);
-	rpcrouter_destroy_server(server);
 	return 0;
 }
 
-static int msm_rpcrouter_probe(struct platform_device *pdev)
+int msm_rpcrouter_start(struct rpcrouter_xprt *xprt)
 {
 	int rc;
 
 	/* Initialize what we need to start processing */
-	INIT_LIST_HEAD(&local_endpoints);
-	INIT_LIST_HEAD(&remote_endpoints);
-
 	init_waitqueue_head(&newserver_wait);
 	init_waitqueue_head(&smd_wait);
 	wake_lock_init(&rpcrouter_wake_lock, WAKE_LOCK_SUSPEND, "SMD_RPCCALL");
@@ -1261,9 +1481,10 @@ static int msm_rpcrouter_probe(struct platform_device *pdev)
 	if (rc < 0)
 		goto fail_destroy_workqueue;
 
-	/* Open up SMD channel 2 */
+	/* Open up the transport, SMD channel 2 unless testing */
 	initialized = 0;
-	rc = smd_open("SMD_RPCCALL", &smd_channel, NULL, rpcrouter_smdnotify);
+	rr_xprt = xprt;
+	rc = xprt->open();
 	if (rc < 0)
 		goto fail_remove_devices;
 
@@ -1277,6 +1498,18 @@ static int msm_rpcrouter_probe(struct platform_device *pdev)
 	return rc;
 }
 
+#ifdef CONFIG_MSM_RPCROUTER_LOOPBACK
+/* no modem: run against the in-kernel loopback peer instead */
+static int __init rpcrouter_init(void)
+{
+	return msm_rpcrouter_start(&msm_rpcrouter_loopback_xprt);
+}
+#else
+static int msm_rpcrouter_probe(struct platform_device *pdev)
+{
+	return msm_rpcrouter_start(&rpcrouter_smd_xprt);
+}
+
 static int msm_rpcrouter_suspend(struct platform_device *pdev,
 					pm_message_t state)
 {
@@ -1302,6 +1535,7 @@ static int __init rpcrouter_init(void)
 {
 	return platform_driver_register(&msm_smd_channel2_driver);
 }
+#endif
 
 module_init(rpcrouter_init);
 MODULE_DESCRIPTION("MSM RPC Router");
@@ -20,6 +20,7 @@
 
 #include <linux/types.h>
 #include <linux/list.h>
+#include <linux/rcupdate.h>
 #include <linux/cdev.h>
 #include <linux/platform_device.h>
 #include <linux/wakelock.h>
@@ -81,19 +82,24 @@ struct rr_header {
 
 #define RPCROUTER_MAX_REMOTE_SERVERS		100
 
-struct rr_fragment {
-	unsigned char data[RPCROUTER_MSGSIZE_MAX];
-	uint32_t length;
-	struct rr_fragment *next;
-};
+/* packets kept in each endpoint's pool */
+#define RPCROUTER_PKT_POOL_MIN			4
+#define RPCROUTER_PKT_POOL_MAX			16
 
+/*
+ * A received message.  Fragments are read from the transport straight
+ * into data, which points at buf until the message outgrows it.  buf must
+ * stay first: msm_rpc_read() hands the whole packet to its caller, who
+ * frees the message with kfree().
+ */
 struct rr_packet {
-	struct list_head list;
-	struct rr_fragment *first;
-	struct rr_fragment *last;
-	struct rr_header hdr;
+	unsigned char buf[RPCROUTER_MSGSIZE_MAX];
+	unsigned char *data;
+	uint32_t size;		/* capacity of data */
+	uint32_t length;	/* bytes assembled so far */
 	uint32_t mid;
-	uint32_t length;
+	struct rr_header hdr;
+	struct list_head list;
 };
 
 #define PACMARK_LAST(n) ((n) & 0x80000000)
@@ -111,6 +117,8 @@ static inline uint32_t PACMARK(uint32_t len, uint32_t mid, uint32_t first,
 
 struct rr_server {
 	struct list_head list;
+	struct hlist_node hash;		/* in server_hash, keyed by prog */
+	struct rcu_head rcu;
 
 	uint32_t pid;
 	uint32_t cid;
@@ -127,16 +135,20 @@ struct rr_server {
 struct rr_remote_endpoint {
 	uint32_t pid;
 	uint32_t cid;
+	atomic_t ref;
 
 	int tx_quota_cntr;
 	spinlock_t quota_lock;
 	wait_queue_head_t quota_wait;
 
-	struct list_head list;
+	struct hlist_node hash;		/* in remote_endpoints, keyed by cid */
+	struct rcu_head rcu;
 };
 
 struct msm_rpc_endpoint {
-	struct list_head list;
+	struct hlist_node hash;		/* in local_endpoints, keyed by cid */
+	atomic_t ref;
+	struct rcu_head rcu;
 
 	/* incomplete packets waiting for assembly */
 	struct list_head incomplete;
@@ -144,6 +156,10 @@ struct msm_rpc_endpoint {
 	/* complete packets waiting to be read */
 	struct list_head read_q;
 	spinlock_t read_q_lock;
+
+	/* free packets for the receive path, protected by read_q_lock */
+	struct list_head pkt_pool;
+	int pkt_pool_count;
 	struct wake_lock read_q_wake_lock;
 	wait_queue_head_t wait_q;
 	unsigned flags;
@@ -175,15 +191,45 @@ struct msm_rpc_endpoint {
 	dev_t dev;
 };
 
+/* transport to the remote router: the SMD_RPCCALL channel or a loopback */
+
+struct rpcrouter_xprt {
+	const char *name;
+	int (*open)(void);
+	int (*read_avail)(void);
+	int (*read)(void *data, int len);
+	int (*write_avail)(void);
+	int (*write)(const void *data, int len);
+};
+
 /* shared between smd_rpcrouter*.c */
 
+int msm_rpcrouter_start(struct rpcrouter_xprt *xprt);
+void msm_rpcrouter_xprt_notify(void);
+
+#ifdef CONFIG_MSM_RPCROUTER_LOOPBACK
+extern struct rpcrouter_xprt msm_rpcrouter_loopback_xprt;
+#endif
+
+/* a timeout of 0 polls; -1 waits forever */
 int __msm_rpc_read(struct msm_rpc_endpoint *ept,
-		   struct rr_fragment **frag,
+		   struct rr_packet **pkt,
 		   unsigned len, long timeout);
+void msm_rpcrouter_put_packet(struct msm_rpc_endpoint *ept,
+			      struct rr_packet *pkt);
 
 struct msm_rpc_endpoint *msm_rpcrouter_create_local_endpoint(dev_t dev);
 int msm_rpcrouter_destroy_local_endpoint(struct msm_rpc_endpoint *ept);
 
+/* lookup of a local endpoint takes a reference, drop it with _put */
+struct msm_rpc_endpoint *msm_rpcrouter_lookup_local_endpoint(uint32_t cid);
+void msm_rpcrouter_put_local_endpoint(struct msm_rpc_endpoint *ept);
+/* so does that of a remote endpoint */
+struct rr_remote_endpoint *msm_rpcrouter_lookup_remote_endpoint(uint32_t cid);
+void msm_rpcrouter_put_remote_endpoint(struct rr_remote_endpoint *r_ept);
+/* servers take no reference: call under rcu_read_lock(), and don't sleep */
+struct rr_server *msm_rpcrouter_lookup_server(uint32_t prog, uint32_t vers);
+
 int msm_rpcrouter_create_server_cdev(struct rr_server *server);
 int msm_rpcrouter_create_server_pdev(struct rr_server *server);
 
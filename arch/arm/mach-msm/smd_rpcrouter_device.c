@@ -75,30 +75,79 @@ static ssize_t rpcrouter_read(struct file *filp, char __user *buf,
 			      size_t count, loff_t *ppos)
 {
 	struct msm_rpc_endpoint *ept;
-	struct rr_fragment *frag, *next;
+	struct rr_packet *pkt;
 	int rc;
 
 	ept = (struct msm_rpc_endpoint *) filp->private_data;
 
-	rc = __msm_rpc_read(ept, &frag, count, -1);
+	rc = __msm_rpc_read(ept, &pkt, count, -1);
 	if (rc < 0)
 		return rc;
 
-	count = rc;
+	if (copy_to_user(buf, pkt->data, pkt->length)) {
+		printk(KERN_ERR
+		       "rpcrouter: could not copy all read data to user!\n");
+		rc = -EFAULT;
+	}
+	msm_rpcrouter_put_packet(ept, pkt);
+
+	return rc;
+}
 
-	while (frag != NULL) {		
-		if (copy_to_user(buf, frag->data, frag->length)) {
-			printk(KERN_ERR
-			       "rpcrouter: could not copy all read data to user!\n");
+/*
+ * Read as many queued messages as fit into the user buffer, each one
+ * preceded by its length as a uint32_t.  Blocks for the first message
+ * only.  Stops after an RPC call, since only one reply can be pending.
+ */
+static int rpcrouter_read_batch(struct msm_rpc_endpoint *ept,
+				struct rpcrouter_ioctl_read_batch __user *arg)
+{
+	struct rpcrouter_ioctl_read_batch batch;
+	struct rpc_request_hdr *rq;
+	struct rr_packet *pkt;
+	char __user *buf;
+	uint32_t used = 0;
+	uint32_t len;
+	long timeout = -1;
+	int count = 0;
+	int is_call;
+	int rc = 0;
+
+	if (copy_from_user(&batch, arg, sizeof(batch)))
+		return -EFAULT;
+	buf = batch.buf;
+
+	while (used + sizeof(len) <= batch.size) {
+		rc = __msm_rpc_read(ept, &pkt, batch.size - used - sizeof(len),
+				    timeout);
+		if (rc < 0)
+			break;
+
+		len = rc;
+		rq = (void *) pkt->data;
+		is_call = len >= (sizeof(uint32_t) * 3) && rq->type == 0;
+
+		if (put_user(len, (uint32_t __user *) (buf + used)) ||
+		    copy_to_user(buf + used + sizeof(len), pkt->data, len))
 			rc = -EFAULT;
-		}
-		buf += frag->length;
-		next = frag->next;
-		kfree(frag);
-		frag = next;
+		msm_rpcrouter_put_packet(ept, pkt);
+		if (rc < 0)
+			break;
+
+		used += sizeof(len) + len;
+		count++;
+		if (is_call)
+			break;
+		timeout = 0;
 	}
+	if (!count)
+		return rc;
 
-	return rc;
+	batch.size = used;
+	batch.count = count;
+	if (copy_to_user(arg, &batch, sizeof(batch)))
+		return -EFAULT;
+	return count;
 }
 
 static ssize_t rpcrouter_write(struct file *filp, const char __user *buf,
@@ -206,6 +255,10 @@ static long rpcrouter_ioctl(struct file *filp, unsigned int cmd,
 		rc = put_user(n, (unsigned int *)arg);
 		break;
 
+	case RPC_ROUTER_IOCTL_READ_BATCH:
+		rc = rpcrouter_read_batch(ept, (void __user *) arg);
+		break;
+
 	default:
 		rc = -EINVAL;
 		break;
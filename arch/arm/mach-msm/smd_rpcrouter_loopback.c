@@ -0,0 +1,603 @@
+/* arch/arm/mach-msm/smd_rpcrouter_loopback.c
+ *
+ * In-kernel stand-in for the modem side of the RPC router, so that the
+ * router's receive and dispatch paths can be tested and benchmarked on
+ * a device (or emulator) without a running modem.
+ *
+ * The loopback peer says HELLO, announces a single echo server and
+ * answers every RPC call to it with an accepted reply carrying the call
+ * arguments back.  Replies can be split into fragments to exercise
+ * reassembly.
+ *
+ * Tests are run by writing a count to their file in debugfs; reading the
+ * file returns the last result:
+ *
+ *  rpcrouter_loopback	round trips through msm_rpc_call_reply()
+ *  rpcrouter_lookup	endpoint/server lookup and receive dispatch cost
+ *			with that many synthetic endpoints and servers (at
+ *			most 512, as each one has its own packet pool)
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/errno.h>
+#include <linux/err.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/fs.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/rcupdate.h>
+#include <linux/uaccess.h>
+#include <asm/byteorder.h>
+#include <asm/div64.h>
+
+#include <mach/msm_rpcrouter.h>
+#include "smd_rpcrouter.h"
+
+#define LB_FIFO_SIZE		8192	/* per direction, power of two */
+
+#define LB_SERVER_CID		0x00001000
+#define LB_PROG			0x3000fffe
+#define LB_VERS			0x00010001
+
+#define LB_TEST_PROG		0x31000000	/* synthetic local servers */
+#define LB_TEST_ROUNDS		16
+#define LB_TEST_MAX		10000
+/* each endpoint pre-fills a pool of RPCROUTER_PKT_POOL_MIN packets */
+#define LB_LOOKUP_MAX		512
+
+static int frag_size;
+module_param(frag_size, int, 0644);
+MODULE_PARM_DESC(frag_size, "Split replies into fragments of this size");
+
+static int bench_size = 64;
+module_param(bench_size, int, 0644);
+MODULE_PARM_DESC(bench_size, "Argument bytes per benchmark call");
+
+struct lb_fifo {
+	unsigned char buf[LB_FIFO_SIZE];
+	unsigned head;		/* free running */
+	unsigned tail;
+};
+
+static struct lb_fifo lb_to_peer;
+static struct lb_fifo lb_to_router;
+static DEFINE_SPINLOCK(lb_lock);
+static DECLARE_WAIT_QUEUE_HEAD(lb_space_wait);
+
+static struct workqueue_struct *lb_workqueue;
+static void lb_peer_work(struct work_struct *work);
+static DECLARE_WORK(lb_work, lb_peer_work);
+
+static unsigned char lb_msg[RPCROUTER_MSGSIZE_MAX];
+static unsigned char lb_reply[RPCROUTER_MSGSIZE_MAX];
+static DEFINE_MUTEX(lb_send_lock);	/* fragments of one message in order */
+static uint8_t lb_next_mid;
+
+static int lb_fifo_avail(struct lb_fifo *f)
+{
+	return f->head - f->tail;
+}
+
+static int lb_fifo_space(struct lb_fifo *f)
+{
+	return LB_FIFO_SIZE - lb_fifo_avail(f);
+}
+
+static void lb_fifo_put(struct lb_fifo *f, const void *data, int len)
+{
+	unsigned off = f->head & (LB_FIFO_SIZE - 1);
+	int n = min(len, (int) (LB_FIFO_SIZE - off));
+
+	memcpy(f->buf + off, data, n);
+	memcpy(f->buf, data + n, len - n);
+	f->head += len;
+}
+
+static void lb_fifo_peek(struct lb_fifo *f, void *data, int len)
+{
+	unsigned off = f->tail & (LB_FIFO_SIZE - 1);
+	int n = min(len, (int) (LB_FIFO_SIZE - off));
+
+	memcpy(data, f->buf + off, n);
+	memcpy(data + n, f->buf, len - n);
+}
+
+static void lb_fifo_get(struct lb_fifo *f, void *data, int len)
+{
+	lb_fifo_peek(f, data, len);
+	f->tail += len;
+}
+
+/* router side of the transport */
+
+static int lb_read_avail(void)
+{
+	unsigned long flags;
+	int n;
+
+	spin_lock_irqsave(&lb_lock, flags);
+	n = lb_fifo_avail(&lb_to_router);
+	spin_unlock_irqrestore(&lb_lock, flags);
+	return n;
+}
+
+static int lb_read(void *data, int len)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lb_lock, flags);
+	len = min(len, lb_fifo_avail(&lb_to_router));
+	lb_fifo_get(&lb_to_router, data, len);
+	spin_unlock_irqrestore(&lb_lock, flags);
+
+	wake_up(&lb_space_wait);
+	return len;
+}
+
+static int lb_write_avail(void)
+{
+	unsigned long flags;
+	int n;
+
+	spin_lock_irqsave(&lb_lock, flags);
+	n = lb_fifo_space(&lb_to_peer);
+	spin_unlock_irqrestore(&lb_lock, flags);
+	return n;
+}
+
+static int lb_write(const void *data, int len)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lb_lock, flags);
+	len = min(len, lb_fifo_space(&lb_to_peer));
+	lb_fifo_put(&lb_to_peer, data, len);
+	spin_unlock_irqrestore(&lb_lock, flags);
+
+	queue_work(lb_workqueue, &lb_work);
+	return len;
+}
+
+/* peer side */
+
+static void lb_peer_send(struct rr_header *hdr, const void *body)
+{
+	unsigned long flags;
+	int need = sizeof(*hdr) + hdr->size;
+
+	for (;;) {
+		spin_lock_irqsave(&lb_lock, flags);
+		if (lb_fifo_space(&lb_to_router) >= need)
+			break;
+		spin_unlock_irqrestore(&lb_lock, flags);
+		wait_event(lb_space_wait,
+			   lb_fifo_space(&lb_to_router) >= need);
+	}
+	lb_fifo_put(&lb_to_router, hdr, sizeof(*hdr));
+	lb_fifo_put(&lb_to_router, body, hdr->size);
+	spin_unlock_irqrestore(&lb_lock, flags);
+
+	msm_rpcrouter_xprt_notify();
+}
+
+static void lb_peer_send_control(union rr_control_msg *msg)
+{
+	struct rr_header hdr;
+
+	hdr.version = RPCROUTER_VERSION;
+	hdr.type = msg->cmd;
+	hdr.src_pid = RPCROUTER_PID_REMOTE;
+	hdr.src_cid = RPCROUTER_ROUTER_ADDRESS;
+	hdr.confirm_rx = 0;
+	hdr.size = sizeof(*msg);
+	hdr.dst_pid = RPCROUTER_PID_LOCAL;
+	hdr.dst_cid = RPCROUTER_ROUTER_ADDRESS;
+
+	lb_peer_send(&hdr, msg);
+}
+
+static void lb_peer_send_data(struct rr_header *in, void *data, int len)
+{
+	struct rr_header hdr;
+	unsigned char frag[RPCROUTER_MSGSIZE_MAX];
+	uint32_t *pm = (uint32_t *) frag;
+	int max = RPCROUTER_MSGSIZE_MAX - sizeof(*pm);
+	int first = 1;
+	int n;
+
+	if (frag_size > 0 && frag_size < max)
+		max = frag_size;
+
+	hdr.version = RPCROUTER_VERSION;
+	hdr.type = RPCROUTER_CTRL_CMD_DATA;
+	hdr.src_pid = RPCROUTER_PID_REMOTE;
+	hdr.src_cid = LB_SERVER_CID;
+	hdr.confirm_rx = 0;
+	hdr.dst_pid = in->src_pid;
+	hdr.dst_cid = in->src_cid;
+
+	mutex_lock(&lb_send_lock);
+	lb_next_mid++;
+	do {
+		n = min(len, max);
+		*pm = PACMARK(n, lb_next_mid, first, n == len);
+		memcpy(frag + sizeof(*pm), data, n);
+		hdr.size = sizeof(*pm) + n;
+		lb_peer_send(&hdr, frag);
+
+		data += n;
+		len -= n;
+		first = 0;
+	} while (len > 0);
+	mutex_unlock(&lb_send_lock);
+}
+
+/* Answer a call to the echo server with its own arguments */
+static void lb_peer_echo(struct rr_header *hdr, void *msg, int len)
+{
+	struct rpc_request_hdr *req = msg;
+	struct rpc_reply_hdr *reply = (void *) lb_reply;
+	int args;
+
+	if (len < sizeof(*req) || req->type != 0)
+		return;
+
+	args = len - sizeof(*req);
+	memset(reply, 0, sizeof(*reply));
+	reply->xid = req->xid;
+	reply->type = cpu_to_be32(1);
+	reply->reply_stat = cpu_to_be32(RPCMSG_REPLYSTAT_ACCEPTED);
+	reply->data.acc_hdr.accept_stat = cpu_to_be32(RPC_ACCEPTSTAT_SUCCESS);
+	memcpy(lb_reply + sizeof(*reply), msg + sizeof(*req), args);
+
+	lb_peer_send_data(hdr, lb_reply, sizeof(*reply) + args);
+}
+
+static void lb_peer_handle(struct rr_header *hdr, void *body)
+{
+	union rr_control_msg ctl;
+	union rr_control_msg *msg = body;
+
+	if (hdr->dst_cid == RPCROUTER_ROUTER_ADDRESS) {
+		/* The router answered our HELLO: announce the echo server */
+		if (hdr->size == sizeof(*msg) &&
+		    msg->cmd == RPCROUTER_CTRL_CMD_HELLO) {
+			memset(&ctl, 0, sizeof(ctl));
+			ctl.srv.cmd = RPCROUTER_CTRL_CMD_NEW_SERVER;
+			ctl.srv.pid = RPCROUTER_PID_REMOTE;
+			ctl.srv.cid = LB_SERVER_CID;
+			ctl.srv.prog = LB_PROG;
+			ctl.srv.vers = LB_VERS;
+			lb_peer_send_control(&ctl);
+		}
+		return;
+	}
+
+	if (hdr->dst_cid != LB_SERVER_CID || hdr->size < sizeof(uint32_t))
+		return;
+
+	/* The router only sends single-fragment messages */
+	lb_peer_echo(hdr, body + sizeof(uint32_t),
+		     hdr->size - sizeof(uint32_t));
+
+	if (hdr->confirm_rx) {
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.cli.cmd = RPCROUTER_CTRL_CMD_RESUME_TX;
+		ctl.cli.pid = RPCROUTER_PID_REMOTE;
+		ctl.cli.cid = LB_SERVER_CID;
+		lb_peer_send_control(&ctl);
+	}
+}
+
+static void lb_peer_work(struct work_struct *work)
+{
+	struct rr_header hdr;
+	unsigned long flags;
+
+	for (;;) {
+		spin_lock_irqsave(&lb_lock, flags);
+		if (lb_fifo_avail(&lb_to_peer) < sizeof(hdr)) {
+			spin_unlock_irqrestore(&lb_lock, flags);
+			break;
+		}
+		lb_fifo_peek(&lb_to_peer, &hdr, sizeof(hdr));
+		if (hdr.size > RPCROUTER_MSGSIZE_MAX) {
+			spin_unlock_irqrestore(&lb_lock, flags);
+			printk(KERN_ERR "rpcrouter_loopback: bad message "
+			       "size %d\n", hdr.size);
+			break;
+		}
+		if (lb_fifo_avail(&lb_to_peer) < sizeof(hdr) + hdr.size) {
+			spin_unlock_irqrestore(&lb_lock, flags);
+			break;
+		}
+		lb_fifo_get(&lb_to_peer, &hdr, sizeof(hdr));
+		lb_fifo_get(&lb_to_peer, lb_msg, hdr.size);
+		spin_unlock_irqrestore(&lb_lock, flags);
+
+		lb_peer_handle(&hdr, lb_msg);
+	}
+}
+
+static int lb_open(void)
+{
+	union rr_control_msg ctl;
+
+	lb_workqueue = create_singlethread_workqueue("rpcrouter_lb");
+	if (!lb_workqueue)
+		return -ENOMEM;
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.cmd = RPCROUTER_CTRL_CMD_HELLO;
+	lb_peer_send_control(&ctl);
+	return 0;
+}
+
+struct rpcrouter_xprt msm_rpcrouter_loopback_xprt = {
+	.name		= "loopback",
+	.open		= lb_open,
+	.read_avail	= lb_read_avail,
+	.read		= lb_read,
+	.write_avail	= lb_write_avail,
+	.write		= lb_write,
+};
+
+/* tests, run by writing a count to their debugfs file */
+
+struct lb_test {
+	const char *name;
+	int (*run)(unsigned long count, char *result, size_t len);
+	unsigned long max_count;
+	char result[192];
+};
+
+static DEFINE_MUTEX(lb_test_lock);
+
+/* Round trips through msm_rpc_call_reply() to the echo server */
+static int lb_bench(unsigned long count, char *result, size_t len)
+{
+	struct msm_rpc_endpoint *ept;
+	struct rpc_request_hdr *req;
+	void *reply;
+	int size = clamp(bench_size, 0, 256);
+	unsigned long long total = 0, max = 0, ns;
+	ktime_t start;
+	int i, rc = 0;
+
+	req = kzalloc(sizeof(*req) + size, GFP_KERNEL);
+	reply = kmalloc(sizeof(struct rpc_reply_hdr) + size, GFP_KERNEL);
+	if (!req || !reply) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	ept = msm_rpc_connect(LB_PROG, LB_VERS, 0);
+	if (IS_ERR(ept)) {
+		rc = PTR_ERR(ept);
+		goto out;
+	}
+
+	for (i = 0; i < count; i++) {
+		start = ktime_get();
+		rc = msm_rpc_call_reply(ept, 0, req, sizeof(*req) + size,
+					reply, sizeof(struct rpc_reply_hdr) +
+					size, 5 * HZ);
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+		if (rc < 0)
+			break;
+		total += ns;
+		if (ns > max)
+			max = ns;
+	}
+	msm_rpc_close(ept);
+
+	if (i) {
+		do_div(total, i);
+		snprintf(result, len,
+			 "%d calls, %d bytes: avg %llu ns max %llu ns\n",
+			 i, size, total, max);
+	}
+out:
+	kfree(reply);
+	kfree(req);
+	return rc < 0 ? rc : 0;
+}
+
+static unsigned long long lb_ns_per(ktime_t start, int ops)
+{
+	unsigned long long ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	do_div(ns, ops);
+	return ns;
+}
+
+/*
+ * Register count endpoints, each with a server, then time hashed lookups
+ * of all of them and the dispatch of one message per endpoint from the
+ * loopback peer through do_read_data() to the endpoint's read queue.
+ */
+static int lb_lookup_test(unsigned long count, char *result,
+			  size_t len)
+{
+	struct msm_rpc_endpoint **epts;
+	struct msm_rpc_endpoint *ept;
+	struct rr_server *srv;
+	struct rr_packet *pkt;
+	struct rr_header hdr;
+	struct rpc_reply_hdr msg;
+	unsigned long long local_ns, server_ns, dispatch_ns;
+	ktime_t start;
+	int created = 0;
+	int i, round;
+	int rc = 0;
+
+	epts = vmalloc(count * sizeof(*epts));
+	if (!epts)
+		return -ENOMEM;
+
+	for (i = 0; i < count; i++) {
+		epts[i] = msm_rpcrouter_create_local_endpoint(MKDEV(0, 0));
+		if (!epts[i]) {
+			rc = -ENOMEM;
+			goto out;
+		}
+		created++;
+		rc = msm_rpc_register_server(epts[i], LB_TEST_PROG + i,
+					     LB_VERS);
+		if (rc < 0)
+			goto out;
+	}
+
+	start = ktime_get();
+	for (round = 0; round < LB_TEST_ROUNDS; round++) {
+		for (i = 0; i < count; i++) {
+			ept = msm_rpcrouter_lookup_local_endpoint(epts[i]->cid);
+			if (ept != epts[i]) {
+				rc = -ENOENT;
+				goto out;
+			}
+			msm_rpcrouter_put_local_endpoint(ept);
+		}
+	}
+	local_ns = lb_ns_per(start, LB_TEST_ROUNDS * count);
+
+	start = ktime_get();
+	for (round = 0; round < LB_TEST_ROUNDS; round++) {
+		for (i = 0; i < count; i++) {
+			rcu_read_lock();
+			srv = msm_rpcrouter_lookup_server(LB_TEST_PROG + i,
+							  LB_VERS);
+			rcu_read_unlock();
+			if (!srv) {
+				rc = -ENOENT;
+				goto out;
+			}
+		}
+	}
+	server_ns = lb_ns_per(start, LB_TEST_ROUNDS * count);
+
+	/* a reply, so that reading it does not expect an answer */
+	memset(&msg, 0, sizeof(msg));
+	msg.type = cpu_to_be32(1);
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.src_pid = RPCROUTER_PID_LOCAL;
+
+	start = ktime_get();
+	for (i = 0; i < count; i++) {
+		hdr.src_cid = epts[i]->cid;
+		lb_peer_send_data(&hdr, &msg, sizeof(msg));
+	}
+	for (i = 0; i < count; i++) {
+		rc = __msm_rpc_read(epts[i], &pkt, -1, HZ);
+		if (rc < 0)
+			goto out;
+		msm_rpcrouter_put_packet(epts[i], pkt);
+	}
+	dispatch_ns = lb_ns_per(start, count);
+	rc = 0;
+
+	snprintf(result, len,
+		 "%lu endpoints and servers: endpoint lookup %llu ns, "
+		 "server lookup %llu ns, dispatch %llu ns per message\n",
+		 count, local_ns, server_ns, dispatch_ns);
+out:
+	for (i = 0; i < created; i++) {
+		msm_rpc_unregister_server(epts[i], LB_TEST_PROG + i, LB_VERS);
+		msm_rpc_close(epts[i]);
+	}
+	vfree(epts);
+	return rc;
+}
+
+static struct lb_test lb_tests[] = {
+	{
+		.name = "rpcrouter_loopback",
+		.run = lb_bench,
+		.max_count = LB_TEST_MAX,
+	},
+	{
+		.name = "rpcrouter_lookup",
+		.run = lb_lookup_test,
+		.max_count = LB_LOOKUP_MAX,
+	},
+};
+
+static int lb_test_open(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return 0;
+}
+
+static ssize_t lb_test_read(struct file *file, char __user *buf,
+			    size_t count, loff_t *ppos)
+{
+	struct lb_test *test = file->private_data;
+	ssize_t ret;
+
+	mutex_lock(&lb_test_lock);
+	ret = simple_read_from_buffer(buf, count, ppos, test->result,
+				      strlen(test->result));
+	mutex_unlock(&lb_test_lock);
+	return ret;
+}
+
+static ssize_t lb_test_write(struct file *file, const char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	struct lb_test *test = file->private_data;
+	char tmp[16];
+	unsigned long n;
+	int rc;
+
+	if (count >= sizeof(tmp))
+		return -EINVAL;
+	if (copy_from_user(tmp, buf, count))
+		return -EFAULT;
+	tmp[count] = 0;
+	if (strict_strtoul(strstrip(tmp), 0, &n) || !n ||
+	    n > test->max_count)
+		return -EINVAL;
+
+	mutex_lock(&lb_test_lock);
+	test->result[0] = 0;
+	rc = test->run(n, test->result, sizeof(test->result));
+	mutex_unlock(&lb_test_lock);
+
+	return rc < 0 ? rc : count;
+}
+
+static const struct file_operations lb_test_fops = {
+	.open	= lb_test_open,
+	.read	= lb_test_read,
+	.write	= lb_test_write,
+};
+
+static int __init rpcrouter_loopback_debugfs_init(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(lb_tests); i++)
+		debugfs_create_file(lb_tests[i].name, 0600, NULL,
+				    &lb_tests[i], &lb_test_fops);
+	return 0;
+}
+
+late_initcall(rpcrouter_loopback_debugfs_init);
@@ -0,0 +1,163 @@
+/*
+ * drivers/base/power/async_test.c
+ *
+ * Dummy platform devices that are slow to suspend and resume, to see what
+ * asynchronous device suspend and resume save.
+ *
+ * Each device sleeps for delay_ms in its suspend and resume callbacks and
+ * has asked to be handled asynchronously unless async is 0.  After every
+ * suspend the time from the first resume starting to the last one ending
+ * is logged.  The PM core has four pm_async threads, so with
+ * /sys/power/pm_async set it should be about delay_ms times nr_devices / 4,
+ * rounded up; with it cleared, nr_devices times delay_ms.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/platform_device.h>
+#include <linux/suspend.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+
+#define PM_ASYNC_TEST_MAX_DEVICES	16
+
+static int nr_devices = 4;
+module_param(nr_devices, int, S_IRUGO);
+
+static int delay_ms = 100;
+module_param(delay_ms, int, S_IRUGO | S_IWUSR);
+
+static int async = 1;
+module_param(async, int, S_IRUGO);
+
+static struct platform_device *test_devices[PM_ASYNC_TEST_MAX_DEVICES];
+
+static DEFINE_SPINLOCK(test_lock);
+static ktime_t first_start;
+static ktime_t last_end;
+static int nr_resumed;
+
+static int pm_async_test_suspend(struct platform_device *pdev,
+				 pm_message_t state)
+{
+	msleep(delay_ms);
+	return 0;
+}
+
+static int pm_async_test_resume(struct platform_device *pdev)
+{
+	ktime_t start = ktime_get();
+	unsigned long flags;
+
+	msleep(delay_ms);
+
+	spin_lock_irqsave(&test_lock, flags);
+	if (!nr_resumed++ || start.tv64 < first_start.tv64)
+		first_start = start;
+	last_end = ktime_get();
+	spin_unlock_irqrestore(&test_lock, flags);
+	return 0;
+}
+
+static struct platform_driver pm_async_test_driver = {
+	.suspend	= pm_async_test_suspend,
+	.resume		= pm_async_test_resume,
+	.driver		= {
+		.name	= "pm_async_test",
+		.owner	= THIS_MODULE,
+	},
+};
+
+static int pm_async_test_notify(struct notifier_block *nb,
+				unsigned long event, void *unused)
+{
+	unsigned long flags;
+
+	if (event != PM_POST_SUSPEND)
+		return NOTIFY_DONE;
+
+	spin_lock_irqsave(&test_lock, flags);
+	if (nr_resumed)
+		pr_info("pm_async_test: %d devices resumed in %lld us "
+			"(%d ms each)\n", nr_resumed,
+			ktime_to_us(ktime_sub(last_end, first_start)),
+			delay_ms);
+	nr_resumed = 0;
+	spin_unlock_irqrestore(&test_lock, flags);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block pm_async_test_nb = {
+	.notifier_call = pm_async_test_notify,
+};
+
+static void pm_async_test_remove_devices(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(test_devices); i++) {
+		if (test_devices[i])
+			platform_device_unregister(test_devices[i]);
+		test_devices[i] = NULL;
+	}
+}
+
+static int __init pm_async_test_init(void)
+{
+	struct platform_device *pdev;
+	int ret;
+	int i;
+
+	nr_devices = clamp(nr_devices, 1, PM_ASYNC_TEST_MAX_DEVICES);
+
+	ret = platform_driver_register(&pm_async_test_driver);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < nr_devices; i++) {
+		pdev = platform_device_register_simple("pm_async_test", i,
+						       NULL, 0);
+		if (IS_ERR(pdev)) {
+			ret = PTR_ERR(pdev);
+			goto err_devices;
+		}
+		if (async)
+			device_enable_async_suspend(&pdev->dev);
+		test_devices[i] = pdev;
+	}
+
+	ret = register_pm_notifier(&pm_async_test_nb);
+	if (ret)
+		goto err_devices;
+
+	return 0;
+
+err_devices:
+	pm_async_test_remove_devices();
+	platform_driver_unregister(&pm_async_test_driver);
+	return ret;
+}
+
+static void __exit pm_async_test_exit(void)
+{
+	unregister_pm_notifier(&pm_async_test_nb);
+	pm_async_test_remove_devices();
+	platform_driver_unregister(&pm_async_test_driver);
+}
+
+module_init(pm_async_test_init);
+module_exit(pm_async_test_exit);
+
+MODULE_DESCRIPTION("Dummy devices to test asynchronous suspend and resume");
+MODULE_LICENSE("GPL");
@@ -23,7 +23,10 @@
 #include <linux/pm.h>
 #include <linux/resume-trace.h>
 #include <linux/rwsem.h>
+#include <linux/sched.h>
+#include <linux/suspend.h>
 #include <linux/timer.h>
+#include <linux/workqueue.h>
 
 #include "../base.h"
 #include "power.h"
@@ -51,6 +54,27 @@ static DEFINE_TIMER(dpm_drv_wd, dpm_drv_timeout, 0, 0);
  */
 static bool transition_started;
 
+/*
+ * The transition being carried out, for the devices handled asynchronously,
+ * and the first error one of them returned while suspending.
+ */
+static pm_message_t pm_transition;
+static int async_error;
+
+/*
+ * Asynchronous devices are handed round-robin to a few single-thread
+ * workqueues of their own, so that callbacks which sleep overlap even on
+ * a uniprocessor.  A device only ever waits for devices queued before it,
+ * so the queues cannot deadlock on each other.
+ */
+#define DPM_ASYNC_THREADS 4
+static const char *dpm_async_wq_names[DPM_ASYNC_THREADS] = {
+	"pm_async/0", "pm_async/1", "pm_async/2", "pm_async/3",
+};
+static struct workqueue_struct *dpm_async_wq[DPM_ASYNC_THREADS];
+static int nr_dpm_async_wq;
+static int dpm_async_next;
+
 /**
  *	device_pm_lock - lock the list of active devices used by the PM core
  */
@@ -271,6 +295,107 @@ static void pm_dev_err(struct device *dev, pm_message_t state, char *info,
 		kobject_name(&dev->kobj), pm_verb(state.event), info, error);
 }
 
+static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
+{
+	u64 usecs64 = ktime_to_us(ktime_sub(ktime_get(), starttime));
+	unsigned long usecs;
+
+	usecs = do_div(usecs64, USEC_PER_MSEC);
+	printk(KERN_INFO "PM: %s%s of devices complete after %lu.%03lu "
+		"msecs\n", info ? info : "", pm_verb(state.event),
+		(unsigned long)usecs64, usecs);
+}
+
+/*
+ * With initcall_debug, report how long each device took, like the
+ * initcalls at boot, to find the devices that make resume slow.  The
+ * suspend profiler is told either way.
+ */
+static ktime_t initcall_debug_start(struct device *dev)
+{
+	if (initcall_debug)
+		printk(KERN_INFO "calling  %s @ %i\n",
+			dev_name(dev), task_pid_nr(current));
+	return ktime_get();
+}
+
+static void initcall_debug_report(struct device *dev, ktime_t calltime,
+				  int error)
+{
+	s64 usecs = ktime_to_us(ktime_sub(ktime_get(), calltime));
+
+	suspend_profile_callback(dev_name(dev), usecs);
+	if (initcall_debug)
+		printk(KERN_INFO "call %s returned %d after %lld usecs\n",
+			dev_name(dev), error, usecs);
+}
+
+/*
+ * A device flagged with device_enable_async_suspend() is suspended and
+ * resumed by a pm_async thread, in parallel with other devices.  Its parent
+ * is resumed before it and suspended after it all the same: each device
+ * completes power.completion when its callbacks are done, and waits for
+ * its parent's before resuming and its children's before suspending.
+ * Devices handled synchronously only wait for asynchronous ones, since
+ * dpm_list order already has the others done.
+ */
+static bool is_async(struct device *dev)
+{
+	return dev->power.async_suspend && pm_async_enabled &&
+		nr_dpm_async_wq && !pm_trace_is_enabled();
+}
+
+static void dpm_async_schedule(struct device *dev, work_func_t func)
+{
+	get_device(dev);
+	INIT_WORK(&dev->power.work, func);
+	queue_work(dpm_async_wq[dpm_async_next++ % nr_dpm_async_wq],
+		   &dev->power.work);
+}
+
+static void dpm_async_synchronize(void)
+{
+	int i;
+
+	for (i = 0; i < nr_dpm_async_wq; i++)
+		flush_workqueue(dpm_async_wq[i]);
+}
+
+static int __init dpm_async_init(void)
+{
+	int i;
+
+	for (i = 0; i < DPM_ASYNC_THREADS; i++) {
+		dpm_async_wq[i] =
+			create_singlethread_workqueue(dpm_async_wq_names[i]);
+		if (!dpm_async_wq[i])
+			break;
+	}
+	nr_dpm_async_wq = i;
+	return 0;
+}
+core_initcall(dpm_async_init);
+
+static void dpm_wait(struct device *dev, bool async)
+{
+	if (!dev)
+		return;
+
+	if (async || is_async(dev))
+		wait_for_completion(&dev->power.completion);
+}
+
+static int dpm_wait_fn(struct device *dev, void *async_ptr)
+{
+	dpm_wait(dev, *((bool *)async_ptr));
+	return 0;
+}
+
+static void dpm_wait_for_children(struct device *dev, bool async)
+{
+	device_for_each_child(dev, &async, dpm_wait_fn);
+}
+
 /*------------------------- Resume routines -------------------------*/
 
 /**
@@ -282,6 +407,7 @@ static void pm_dev_err(struct device *dev, pm_message_t state, char *info,
  */
 static int resume_device_noirq(struct device *dev, pm_message_t state)
 {
+	ktime_t calltime;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
@@ -290,6 +416,7 @@ static int resume_device_noirq(struct device *dev, pm_message_t state)
 	if (!dev->bus)
 		goto End;
 
+	calltime = initcall_debug_start(dev);
 	if (dev->bus->pm) {
 		pm_dev_dbg(dev, state, "EARLY ");
 		error = pm_noirq_op(dev, dev->bus->pm, state);
@@ -297,6 +424,7 @@ static int resume_device_noirq(struct device *dev, pm_message_t state)
 		pm_dev_dbg(dev, state, "legacy EARLY ");
 		error = dev->bus->resume_early(dev);
 	}
+	initcall_debug_report(dev, calltime, error);
  End:
 	TRACE_RESUME(error);
 	return error;
@@ -345,14 +473,18 @@ EXPORT_SYMBOL_GPL(device_power_up);
  *	resume_device - Restore state for one device.
  *	@dev:	Device.
  *	@state: PM transition of the system being carried out.
+ *	@async: If true, the device is being resumed asynchronously.
  */
-static int resume_device(struct device *dev, pm_message_t state)
+static int resume_device(struct device *dev, pm_message_t state, bool async)
 {
 	int error = 0;
+	ktime_t calltime;
 
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
 
+	dpm_wait(dev->parent, async);
+	calltime = initcall_debug_start(dev);
 	down(&dev->sem);
 
 	if (dev->bus) {
@@ -390,11 +522,24 @@ static int resume_device(struct device *dev, pm_message_t state)
 	}
  End:
 	up(&dev->sem);
+	initcall_debug_report(dev, calltime, error);
+	complete_all(&dev->power.completion);
 
 	TRACE_RESUME(error);
 	return error;
 }
 
+static void async_resume(struct work_struct *work)
+{
+	struct device *dev = container_of(work, struct device, power.work);
+	int error;
+
+	error = resume_device(dev, pm_transition, true);
+	if (error)
+		pm_dev_err(dev, pm_transition, " async", error);
+	put_device(dev);
+}
+
 /**
  *	dpm_drv_timeout - Driver suspend / resume watchdog handler
  *	@data: struct device which timed out
@@ -444,21 +589,33 @@ static void dpm_drv_wdclr(struct device *dev)
 static void dpm_resume(pm_message_t state)
 {
 	struct list_head list;
+	struct device *dev;
+	ktime_t starttime = ktime_get();
 
 	INIT_LIST_HEAD(&list);
 	mutex_lock(&dpm_list_mtx);
 	transition_started = false;
+	pm_transition = state;
+	dpm_async_next = 0;
+	list_for_each_entry(dev, &dpm_list, power.entry)
+		if (dev->power.status >= DPM_OFF)
+			INIT_COMPLETION(dev->power.completion);
+
 	while (!list_empty(&dpm_list)) {
-		struct device *dev = to_device(dpm_list.next);
+		dev = to_device(dpm_list.next);
 
 		get_device(dev);
 		if (dev->power.status >= DPM_OFF) {
-			int error;
+			int error = 0;
 
 			dev->power.status = DPM_RESUMING;
 			mutex_unlock(&dpm_list_mtx);
 
-			error = resume_device(dev, state);
+			if (is_async(dev)) {
+				dpm_async_schedule(dev, async_resume);
+			} else {
+				error = resume_device(dev, state, false);
+			}
 
 			mutex_lock(&dpm_list_mtx);
 			if (error)
@@ -473,6 +630,8 @@ static void dpm_resume(pm_message_t state)
 	}
 	list_splice(&list, &dpm_list);
 	mutex_unlock(&dpm_list_mtx);
+	dpm_async_synchronize();
+	dpm_show_time(starttime, state, NULL);
 }
 
 /**
@@ -581,11 +740,13 @@ static pm_message_t resume_event(pm_message_t sleep_state)
  */
 static int suspend_device_noirq(struct device *dev, pm_message_t state)
 {
+	ktime_t calltime;
 	int error = 0;
 
 	if (!dev->bus)
 		return 0;
 
+	calltime = initcall_debug_start(dev);
 	if (dev->bus->pm) {
 		pm_dev_dbg(dev, state, "LATE ");
 		error = pm_noirq_op(dev, dev->bus->pm, state);
@@ -594,6 +755,7 @@ static int suspend_device_noirq(struct device *dev, pm_message_t state)
 		error = dev->bus->suspend_late(dev, state);
 		suspend_report_result(dev->bus->suspend_late, error);
 	}
+	initcall_debug_report(dev, calltime, error);
 	return error;
 }
 
@@ -629,11 +791,21 @@ EXPORT_SYMBOL_GPL(device_power_down);
  *	suspend_device - Save state of one device.
  *	@dev:	Device.
  *	@state: PM transition of the system being carried out.
+ *	@async: If true, the device is being suspended asynchronously.
  */
-static int suspend_device(struct device *dev, pm_message_t state)
+static int suspend_device(struct device *dev, pm_message_t state, bool async)
 {
 	int error = 0;
+	ktime_t calltime;
 
+	dpm_wait_for_children(dev, async);
+	if (async_error)
+		goto Complete;
+
+	/* The watchdog guards one device at a time, so only sync ones */
+	if (!async)
+		dpm_drv_wdset(dev);
+	calltime = initcall_debug_start(dev);
 	down(&dev->sem);
 
 	if (dev->class) {
@@ -674,10 +846,34 @@ static int suspend_device(struct device *dev, pm_message_t state)
 	}
  End:
 	up(&dev->sem);
+	initcall_debug_report(dev, calltime, error);
+	if (!async)
+		dpm_drv_wdclr(dev);
+	if (error) {
+		async_error = error;
+	} else {
+		/* Called with dpm_list_mtx released, which guards the status */
+		mutex_lock(&dpm_list_mtx);
+		dev->power.status = DPM_OFF;
+		mutex_unlock(&dpm_list_mtx);
+	}
+ Complete:
+	complete_all(&dev->power.completion);
 
 	return error;
 }
 
+static void async_suspend(struct work_struct *work)
+{
+	struct device *dev = container_of(work, struct device, power.work);
+	int error;
+
+	error = suspend_device(dev, pm_transition, true);
+	if (error)
+		pm_dev_err(dev, pm_transition, " async", error);
+	put_device(dev);
+}
+
 /**
  *	dpm_suspend - Suspend every device.
  *	@state: PM transition of the system being carried out.
@@ -687,19 +883,25 @@ static int suspend_device(struct device *dev, pm_message_t state)
 static int dpm_suspend(pm_message_t state)
 {
 	struct list_head list;
+	ktime_t starttime = ktime_get();
 	int error = 0;
 
 	INIT_LIST_HEAD(&list);
 	mutex_lock(&dpm_list_mtx);
+	pm_transition = state;
+	async_error = 0;
+	dpm_async_next = 0;
 	while (!list_empty(&dpm_list)) {
 		struct device *dev = to_device(dpm_list.prev);
 
 		get_device(dev);
+		INIT_COMPLETION(dev->power.completion);
 		mutex_unlock(&dpm_list_mtx);
 
-		dpm_drv_wdset(dev);
-		error = suspend_device(dev, state);
-		dpm_drv_wdclr(dev);
+		if (is_async(dev))
+			dpm_async_schedule(dev, async_suspend);
+		else
+			error = suspend_device(dev, state, false);
 
 		mutex_lock(&dpm_list_mtx);
 		if (error) {
@@ -707,13 +909,19 @@ static int dpm_suspend(pm_message_t state)
 			put_device(dev);
 			break;
 		}
-		dev->power.status = DPM_OFF;
 		if (!list_empty(&dev->power.entry))
 			list_move(&dev->power.entry, &list);
 		put_device(dev);
+		if (async_error)
+			break;
 	}
 	list_splice(&list, dpm_list.prev);
 	mutex_unlock(&dpm_list_mtx);
+	dpm_async_synchronize();
+	if (!error)
+		error = async_error;
+	if (!error)
+		dpm_show_time(starttime, state, NULL);
 	return error;
 }
 
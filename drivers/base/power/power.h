@@ -1,6 +1,10 @@
 static inline void device_pm_init(struct device *dev)
 {
 	dev->power.status = DPM_ON;
+#ifdef CONFIG_PM_SLEEP
+	init_completion(&dev->power.completion);
+	complete_all(&dev->power.completion);
+#endif
 }
 
 #ifdef CONFIG_PM_SLEEP
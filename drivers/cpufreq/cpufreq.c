@@ -28,6 +28,7 @@
 #include <linux/cpu.h>
 #include <linux/completion.h>
 #include <linux/mutex.h>
+#include <linux/pm_qos_params.h>
 
 #define dprintk(msg...) cpufreq_debug_printk(CPUFREQ_DEBUG_CORE, \
 						"cpufreq-core", msg)
@@ -1632,6 +1633,29 @@ int cpufreq_get_policy(struct cpufreq_policy *policy, unsigned int cpu)
 EXPORT_SYMBOL(cpufreq_get_policy);
 
 
+/*
+ * Apply the PM_QOS_CPU_FREQ_MIN floor and PM_QOS_CPU_FREQ_MAX ceiling to
+ * a policy.  A floor raises both limits, so it holds even over a lower
+ * max set by the user; the ceiling is applied last and wins over it.
+ */
+static void cpufreq_apply_qos(struct cpufreq_policy *policy)
+{
+	unsigned int floor = pm_qos_requirement(PM_QOS_CPU_FREQ_MIN);
+	unsigned int ceiling = pm_qos_requirement(PM_QOS_CPU_FREQ_MAX);
+
+	if (floor > policy->cpuinfo.max_freq)
+		floor = policy->cpuinfo.max_freq;
+	if (policy->min < floor)
+		policy->min = floor;
+	if (policy->max < floor)
+		policy->max = floor;
+
+	if (policy->max > ceiling)
+		policy->max = ceiling;
+	if (policy->min > policy->max)
+		policy->min = policy->max;
+}
+
 /*
  * data   : current policy.
  * policy : policy to be set.
@@ -1666,6 +1690,9 @@ static int __cpufreq_set_policy(struct cpufreq_policy *data,
 	blocking_notifier_call_chain(&cpufreq_policy_notifier_list,
 			CPUFREQ_INCOMPATIBLE, policy);
 
+	/* adjust to the pm_qos frequency constraints */
+	cpufreq_apply_qos(policy);
+
 	/* verify the cpu speed can be set within this limit,
 	   which might be different to the first one */
 	ret = cpufreq_driver->verify(policy);
@@ -1917,6 +1944,37 @@ int cpufreq_unregister_driver(struct cpufreq_driver *driver)
 }
 EXPORT_SYMBOL_GPL(cpufreq_unregister_driver);
 
+static void cpufreq_qos_work_fn(struct work_struct *work)
+{
+	unsigned int cpu;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		cpufreq_update_policy(cpu);
+	put_online_cpus();
+}
+
+static DECLARE_WORK(cpufreq_qos_work, cpufreq_qos_work_fn);
+
+/*
+ * The notifiers may be called with the lock of a pm_qos requester held,
+ * so the policies are updated from a work.
+ */
+static int cpufreq_qos_notify(struct notifier_block *nb, unsigned long value,
+			      void *data)
+{
+	schedule_work(&cpufreq_qos_work);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cpufreq_qos_min_nb = {
+	.notifier_call = cpufreq_qos_notify,
+};
+
+static struct notifier_block cpufreq_qos_max_nb = {
+	.notifier_call = cpufreq_qos_notify,
+};
+
 static int __init cpufreq_core_init(void)
 {
 	int cpu;
@@ -1925,6 +1983,9 @@ static int __init cpufreq_core_init(void)
 		per_cpu(policy_cpu, cpu) = -1;
 		init_rwsem(&per_cpu(cpu_policy_rwsem, cpu));
 	}
+
+	pm_qos_add_notifier(PM_QOS_CPU_FREQ_MIN, &cpufreq_qos_min_nb);
+	pm_qos_add_notifier(PM_QOS_CPU_FREQ_MAX, &cpufreq_qos_max_nb);
 	return 0;
 }
 
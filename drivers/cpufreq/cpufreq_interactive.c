@@ -0,0 +1,648 @@
+/*
+ * drivers/cpufreq/cpufreq_interactive.c
+ *
+ * A cpufreq governor for latency sensitive, interactive workloads.
+ *
+ * Load is sampled by a timer that is armed when the CPU leaves idle, so a
+ * CPU that wakes up to work is looked at timer_rate later rather than at
+ * the end of a fixed sampling period.  Load at or above go_hispeed_load
+ * takes the CPU from its lowest speed straight to hispeed_freq; above that
+ * the speed follows the load.  Speed is only lowered once the current one
+ * has been held for min_sample_time, and input events from touch screens
+ * and keys raise it to hispeed_freq ahead of the work they cause.
+ *
+ * Raising the speed is done from a realtime thread, lowering it from a
+ * workqueue.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpufreq.h>
+#include <linux/cpumask.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/timer.h>
+#include <linux/tick.h>
+#include <linux/input.h>
+#include <linux/workqueue.h>
+#include <linux/slab.h>
+#include <linux/notifier.h>
+#include <asm/idle.h>
+
+#define DEFAULT_GO_HISPEED_LOAD		85
+#define DEFAULT_MIN_SAMPLE_TIME		(80 * USEC_PER_MSEC)
+#define DEFAULT_TIMER_RATE		(20 * USEC_PER_MSEC)
+
+struct cpufreq_interactive_cpuinfo {
+	struct timer_list cpu_timer;
+	int timer_idlecancel;
+	u64 time_in_idle;
+	u64 idle_exit_time;
+	u64 target_set_time;
+	u64 target_set_time_in_idle;
+	struct cpufreq_policy *policy;
+	struct cpufreq_frequency_table *freq_table;
+	unsigned int target_freq;
+	int governor_enabled;
+	int idling;
+};
+
+static DEFINE_PER_CPU(struct cpufreq_interactive_cpuinfo, cpuinfo);
+
+static struct task_struct *up_task;
+static struct workqueue_struct *down_wq;
+static struct work_struct freq_scale_down_work;
+static cpumask_t up_cpumask;
+static DEFINE_SPINLOCK(up_cpumask_lock);
+static cpumask_t down_cpumask;
+static DEFINE_SPINLOCK(down_cpumask_lock);
+
+
+/* number of policies using the governor */
+static unsigned int gov_enabled;
+static DEFINE_MUTEX(gov_mutex);
+
+/* Tunables, shown under cpufreq/interactive of each policy */
+
+/* speed to go to from the lowest one when the load is high, in kHz */
+static unsigned int hispeed_freq;
+
+/* load, in percent, at which to go to hispeed_freq */
+static unsigned int go_hispeed_load = DEFAULT_GO_HISPEED_LOAD;
+
+/* time to hold a speed before lowering it, in us */
+static unsigned int min_sample_time = DEFAULT_MIN_SAMPLE_TIME;
+
+/* time from leaving idle to looking at the load, in us */
+static unsigned int timer_rate = DEFAULT_TIMER_RATE;
+
+/* go to hispeed_freq on input events */
+static unsigned int input_boost = 1;
+
+static unsigned int cpufreq_interactive_load(u64 idle, u64 idle_start,
+					     u64 now, u64 start)
+{
+	unsigned int delta_idle = (unsigned int)(idle - idle_start);
+	unsigned int delta_time = (unsigned int)(now - start);
+
+	if (!delta_time || delta_idle > delta_time)
+		return 0;
+	return 100 * (delta_time - delta_idle) / delta_time;
+}
+
+static void cpufreq_interactive_arm_timer(unsigned int cpu,
+					  struct cpufreq_interactive_cpuinfo
+					  *pcpu)
+{
+	pcpu->time_in_idle = get_cpu_idle_time_us(cpu, &pcpu->idle_exit_time);
+	mod_timer(&pcpu->cpu_timer, jiffies + usecs_to_jiffies(timer_rate));
+}
+
+static void cpufreq_interactive_timer(unsigned long data)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, data);
+	struct cpufreq_policy *policy;
+	unsigned int load, load_since_change;
+	unsigned int new_freq;
+	int index;
+	u64 now, now_idle;
+	unsigned long flags;
+
+	smp_rmb();
+	if (!pcpu->governor_enabled)
+		return;
+	policy = pcpu->policy;
+
+	now_idle = get_cpu_idle_time_us(data, &now);
+
+	/* too soon after the sample started to say anything */
+	if (now - pcpu->idle_exit_time < USEC_PER_MSEC)
+		goto rearm;
+
+	/* the greater of the load since leaving idle and the load since
+	 * the speed was last set */
+	load = cpufreq_interactive_load(now_idle, pcpu->time_in_idle,
+					now, pcpu->idle_exit_time);
+	load_since_change = cpufreq_interactive_load(now_idle,
+					pcpu->target_set_time_in_idle,
+					now, pcpu->target_set_time);
+	if (load_since_change > load)
+		load = load_since_change;
+
+	new_freq = policy->max * load / 100;
+	if (load >= go_hispeed_load) {
+		if (policy->cur == policy->min || new_freq < hispeed_freq)
+			new_freq = hispeed_freq;
+	}
+
+	if (cpufreq_frequency_table_target(policy, pcpu->freq_table,
+					   new_freq, CPUFREQ_RELATION_H,
+					   &index)) {
+		pr_warning("cpufreq_interactive: no speed for %u kHz\n",
+			   new_freq);
+		goto rearm;
+	}
+	new_freq = pcpu->freq_table[index].frequency;
+
+	if (new_freq == pcpu->target_freq)
+		goto rearm_if_notmax;
+
+	if (new_freq < pcpu->target_freq &&
+	    now - pcpu->target_set_time < min_sample_time)
+		goto rearm;
+
+	pcpu->target_set_time_in_idle = now_idle;
+	pcpu->target_set_time = now;
+
+	if (new_freq < pcpu->target_freq) {
+		pcpu->target_freq = new_freq;
+		spin_lock_irqsave(&down_cpumask_lock, flags);
+		cpumask_set_cpu(data, &down_cpumask);
+		spin_unlock_irqrestore(&down_cpumask_lock, flags);
+		queue_work(down_wq, &freq_scale_down_work);
+	} else {
+		pcpu->target_freq = new_freq;
+		spin_lock_irqsave(&up_cpumask_lock, flags);
+		cpumask_set_cpu(data, &up_cpumask);
+		spin_unlock_irqrestore(&up_cpumask_lock, flags);
+		wake_up_process(up_task);
+	}
+
+rearm_if_notmax:
+	/* at full speed there is nothing to look for until the next idle
+	 * exit */
+	if (pcpu->target_freq == policy->max)
+		return;
+
+rearm:
+	if (timer_pending(&pcpu->cpu_timer))
+		return;
+
+	/* At the lowest speed only a busy CPU needs looking at again, and
+	 * the timer is cancelled if it goes idle before it runs.
+	 */
+	if (pcpu->target_freq == policy->min) {
+		smp_rmb();
+		if (pcpu->idling)
+			return;
+		pcpu->timer_idlecancel = 1;
+	}
+	cpufreq_interactive_arm_timer(data, pcpu);
+}
+
+static void cpufreq_interactive_idle_start(void)
+{
+	unsigned int cpu = smp_processor_id();
+	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
+	int pending;
+
+	if (!pcpu->governor_enabled)
+		return;
+
+	pcpu->idling = 1;
+	smp_wmb();
+	pending = timer_pending(&pcpu->cpu_timer);
+
+	if (pcpu->target_freq != pcpu->policy->min) {
+		/* An idle CPU above the lowest speed holds the others in its
+		 * policy there too; look again even if it stays idle.
+		 */
+		if (!pending) {
+			pcpu->timer_idlecancel = 0;
+			cpufreq_interactive_arm_timer(cpu, pcpu);
+		}
+	} else if (pending && pcpu->timer_idlecancel) {
+		/* the timer was only there in case the CPU stayed busy */
+		del_timer(&pcpu->cpu_timer);
+		pcpu->timer_idlecancel = 0;
+	}
+
+	/* the tick was stopped before the timer was armed, work out the
+	 * next event again so that it is not slept through */
+	if (timer_pending(&pcpu->cpu_timer))
+		tick_nohz_stop_sched_tick(1);
+}
+
+static void cpufreq_interactive_idle_end(void)
+{
+	unsigned int cpu = smp_processor_id();
+	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
+
+	if (!pcpu->governor_enabled)
+		return;
+
+	pcpu->idling = 0;
+	smp_wmb();
+
+	if (!timer_pending(&pcpu->cpu_timer)) {
+		pcpu->timer_idlecancel = 0;
+		cpufreq_interactive_arm_timer(cpu, pcpu);
+	}
+}
+
+static int cpufreq_interactive_idle_notifier(struct notifier_block *nb,
+					     unsigned long val, void *data)
+{
+	switch (val) {
+	case IDLE_START:
+		cpufreq_interactive_idle_start();
+		break;
+	case IDLE_END:
+		cpufreq_interactive_idle_end();
+		break;
+	}
+
+	return 0;
+}
+
+static struct notifier_block cpufreq_interactive_idle_nb = {
+	.notifier_call = cpufreq_interactive_idle_notifier,
+};
+
+/* Set the speed of the policy to the highest target of its CPUs. */
+static void cpufreq_interactive_set_speed(unsigned int cpu)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
+	unsigned int max_freq = 0;
+	unsigned int j;
+
+	if (lock_policy_rwsem_write(cpu) < 0)
+		return;
+
+	smp_rmb();
+	if (pcpu->governor_enabled) {
+		for_each_cpu(j, pcpu->policy->cpus) {
+			struct cpufreq_interactive_cpuinfo *pjcpu =
+				&per_cpu(cpuinfo, j);
+
+			if (pjcpu->target_freq > max_freq)
+				max_freq = pjcpu->target_freq;
+		}
+
+		if (max_freq != pcpu->policy->cur)
+			__cpufreq_driver_target(pcpu->policy, max_freq,
+						CPUFREQ_RELATION_H);
+	}
+
+	unlock_policy_rwsem_write(cpu);
+}
+
+static int cpufreq_interactive_up_task(void *data)
+{
+	cpumask_t tmp_mask;
+	unsigned long flags;
+	unsigned int cpu;
+
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		spin_lock_irqsave(&up_cpumask_lock, flags);
+
+		if (cpumask_empty(&up_cpumask)) {
+			spin_unlock_irqrestore(&up_cpumask_lock, flags);
+			schedule();
+
+			if (kthread_should_stop())
+				break;
+
+			spin_lock_irqsave(&up_cpumask_lock, flags);
+		}
+
+		set_current_state(TASK_RUNNING);
+		tmp_mask = up_cpumask;
+		cpumask_clear(&up_cpumask);
+		spin_unlock_irqrestore(&up_cpumask_lock, flags);
+
+		for_each_cpu(cpu, &tmp_mask)
+			cpufreq_interactive_set_speed(cpu);
+	}
+
+	return 0;
+}
+
+static void cpufreq_interactive_freq_down(struct work_struct *work)
+{
+	cpumask_t tmp_mask;
+	unsigned long flags;
+	unsigned int cpu;
+
+	spin_lock_irqsave(&down_cpumask_lock, flags);
+	tmp_mask = down_cpumask;
+	cpumask_clear(&down_cpumask);
+	spin_unlock_irqrestore(&down_cpumask_lock, flags);
+
+	for_each_cpu(cpu, &tmp_mask)
+		cpufreq_interactive_set_speed(cpu);
+}
+
+/* Go to hispeed_freq now and hold it for min_sample_time, as if the load
+ * had asked for it.  Called from the input event handler, which runs with
+ * interrupts off.
+ */
+static void cpufreq_interactive_boost(void)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu;
+	unsigned long flags;
+	unsigned int cpu;
+	int boost = 0;
+
+	for_each_online_cpu(cpu) {
+		pcpu = &per_cpu(cpuinfo, cpu);
+		smp_rmb();
+		if (!pcpu->governor_enabled)
+			continue;
+
+		if (pcpu->target_freq < hispeed_freq) {
+			pcpu->target_freq = hispeed_freq;
+			spin_lock_irqsave(&up_cpumask_lock, flags);
+			cpumask_set_cpu(cpu, &up_cpumask);
+			spin_unlock_irqrestore(&up_cpumask_lock, flags);
+			boost = 1;
+		}
+		pcpu->target_set_time_in_idle =
+			get_cpu_idle_time_us(cpu, &pcpu->target_set_time);
+	}
+
+	if (boost)
+		wake_up_process(up_task);
+}
+
+static void cpufreq_interactive_input_event(struct input_handle *handle,
+					    unsigned int type,
+					    unsigned int code, int value)
+{
+	/* once per report, whatever it holds */
+	if (input_boost && type == EV_SYN && code == SYN_REPORT)
+		cpufreq_interactive_boost();
+}
+
+static int input_dev_filter(const char *input_dev_name)
+{
+	if (strstr(input_dev_name, "touchscreen") ||
+	    strstr(input_dev_name, "-keypad") ||
+	    strstr(input_dev_name, "-nav") ||
+	    strstr(input_dev_name, "-oj"))
+		return 0;
+	return 1;
+}
+
+static int cpufreq_interactive_input_connect(struct input_handler *handler,
+					     struct input_dev *dev,
+					     const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	if (input_dev_filter(dev->name))
+		return 0;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "cpufreq_interactive";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err2;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err1;
+
+	return 0;
+err1:
+	input_unregister_handle(handle);
+err2:
+	kfree(handle);
+	return error;
+}
+
+static void cpufreq_interactive_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id cpufreq_interactive_ids[] = {
+	{ .driver_info = 1 },
+	{ },
+};
+
+static struct input_handler cpufreq_interactive_input_handler = {
+	.event		= cpufreq_interactive_input_event,
+	.connect	= cpufreq_interactive_input_connect,
+	.disconnect	= cpufreq_interactive_input_disconnect,
+	.name		= "cpufreq_interactive",
+	.id_table	= cpufreq_interactive_ids,
+};
+
+#define show_one(file_name)						\
+static ssize_t show_##file_name						\
+(struct cpufreq_policy *unused, char *buf)				\
+{									\
+	return sprintf(buf, "%u\n", file_name);				\
+}
+
+#define store_one(file_name, min, max)					\
+static ssize_t store_##file_name					\
+(struct cpufreq_policy *unused, const char *buf, size_t count)		\
+{									\
+	unsigned int input;						\
+									\
+	if (sscanf(buf, "%u", &input) != 1 ||				\
+	    input < (min) || input > (max))				\
+		return -EINVAL;						\
+	file_name = input;						\
+	return count;							\
+}
+
+#define define_one_rw(_name)						\
+show_one(_name)								\
+static struct freq_attr _name##_attr =					\
+__ATTR(_name, 0644, show_##_name, store_##_name)
+
+store_one(hispeed_freq, 0, UINT_MAX)
+define_one_rw(hispeed_freq);
+store_one(go_hispeed_load, 1, 100)
+define_one_rw(go_hispeed_load);
+store_one(min_sample_time, 0, 10 * USEC_PER_SEC)
+define_one_rw(min_sample_time);
+store_one(timer_rate, USEC_PER_MSEC, USEC_PER_SEC)
+define_one_rw(timer_rate);
+store_one(input_boost, 0, 1)
+define_one_rw(input_boost);
+
+static struct attribute *interactive_attributes[] = {
+	&hispeed_freq_attr.attr,
+	&go_hispeed_load_attr.attr,
+	&min_sample_time_attr.attr,
+	&timer_rate_attr.attr,
+	&input_boost_attr.attr,
+	NULL
+};
+
+static struct attribute_group interactive_attr_group = {
+	.attrs = interactive_attributes,
+	.name = "interactive",
+};
+
+static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
+					unsigned int event)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu;
+	struct cpufreq_frequency_table *freq_table;
+	unsigned int j;
+	u64 wall;
+	int rc;
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		if (!cpu_online(policy->cpu))
+			return -EINVAL;
+
+		/* the load is worked out from the nohz idle accounting */
+		if (get_cpu_idle_time_us(policy->cpu, &wall) == -1ULL) {
+			pr_err("cpufreq_interactive: no idle time "
+			       "accounting, boot without nohz=off\n");
+			return -EINVAL;
+		}
+
+		freq_table = cpufreq_frequency_get_table(policy->cpu);
+		if (!freq_table)
+			return -EINVAL;
+
+		mutex_lock(&gov_mutex);
+		rc = sysfs_create_group(&policy->kobj, &interactive_attr_group);
+		if (rc) {
+			mutex_unlock(&gov_mutex);
+			return rc;
+		}
+
+		if (!hispeed_freq)
+			hispeed_freq = policy->max;
+
+		for_each_cpu(j, policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+			pcpu->policy = policy;
+			pcpu->target_freq = policy->cur;
+			pcpu->freq_table = freq_table;
+			pcpu->target_set_time_in_idle =
+				get_cpu_idle_time_us(j,
+					&pcpu->target_set_time);
+			pcpu->timer_idlecancel = 0;
+			pcpu->governor_enabled = 1;
+			smp_wmb();
+		}
+
+		/* the input handler is shared by all policies */
+		if (gov_enabled++ == 0 &&
+		    input_register_handler(&cpufreq_interactive_input_handler))
+			pr_warning("cpufreq_interactive: no input boost\n");
+		mutex_unlock(&gov_mutex);
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		mutex_lock(&gov_mutex);
+		for_each_cpu(j, policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+			pcpu->governor_enabled = 0;
+			smp_wmb();
+			del_timer_sync(&pcpu->cpu_timer);
+		}
+
+		if (--gov_enabled == 0)
+			input_unregister_handler(
+				&cpufreq_interactive_input_handler);
+
+		sysfs_remove_group(&policy->kobj, &interactive_attr_group);
+		mutex_unlock(&gov_mutex);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		if (policy->max < policy->cur)
+			__cpufreq_driver_target(policy, policy->max,
+						CPUFREQ_RELATION_H);
+		else if (policy->min > policy->cur)
+			__cpufreq_driver_target(policy, policy->min,
+						CPUFREQ_RELATION_L);
+		for_each_cpu(j, policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+			pcpu->target_freq = policy->cur;
+		}
+		break;
+	}
+	return 0;
+}
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_INTERACTIVE
+static
+#endif
+struct cpufreq_governor cpufreq_gov_interactive = {
+	.name			= "interactive",
+	.governor		= cpufreq_governor_interactive,
+	.max_transition_latency	= 10000000,
+	.owner			= THIS_MODULE,
+};
+
+static int __init cpufreq_interactive_init(void)
+{
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO - 1 };
+	struct cpufreq_interactive_cpuinfo *pcpu;
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		pcpu = &per_cpu(cpuinfo, cpu);
+		init_timer(&pcpu->cpu_timer);
+		pcpu->cpu_timer.function = cpufreq_interactive_timer;
+		pcpu->cpu_timer.data = cpu;
+	}
+
+	up_task = kthread_create(cpufreq_interactive_up_task, NULL,
+				 "kinteractiveup");
+	if (IS_ERR(up_task))
+		return PTR_ERR(up_task);
+
+	sched_setscheduler_nocheck(up_task, SCHED_FIFO, &param);
+	get_task_struct(up_task);
+
+	down_wq = create_workqueue("kinteractive_down");
+	if (!down_wq)
+		goto err_freeuptask;
+
+	INIT_WORK(&freq_scale_down_work, cpufreq_interactive_freq_down);
+
+	idle_notifier_register(&cpufreq_interactive_idle_nb);
+
+	return cpufreq_register_governor(&cpufreq_gov_interactive);
+
+err_freeuptask:
+	kthread_stop(up_task);
+	put_task_struct(up_task);
+	return -ENOMEM;
+}
+
+/* registered before the drivers when it is the default governor */
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_INTERACTIVE
+fs_initcall(cpufreq_interactive_init);
+#else
+device_initcall(cpufreq_interactive_init);
+#endif
+
+MODULE_DESCRIPTION("'cpufreq_interactive' - A cpufreq governor for "
+	"latency sensitive workloads");
+MODULE_LICENSE("GPL");
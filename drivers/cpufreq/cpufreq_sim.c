@@ -0,0 +1,253 @@
+/*
+ * drivers/cpufreq/cpufreq_sim.c
+ *
+ * A cpufreq driver that drives no hardware, for trying governors out.
+ *
+ * It offers a few of the QSD8x50 Scorpion speeds, takes latency_us to
+ * "switch" between them and remembers the last switches it was asked
+ * for.  Read /sys/kernel/debug/cpufreq_sim/trace for them, one line per
+ * switch with the time in us and the old and new speeds in kHz; write to
+ * it to clear them.
+ *
+ * It registers late, so that a real driver, if there is one, wins.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpufreq.h>
+#include <linux/delay.h>
+#include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/debugfs.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#define CPUFREQ_SIM_TRACE_LEN	256
+
+static unsigned int latency_us = 50;
+module_param(latency_us, uint, S_IRUGO);
+
+static struct cpufreq_frequency_table cpufreq_sim_table[] = {
+	{ 0, 245000 },
+	{ 1, 384000 },
+	{ 2, 576000 },
+	{ 3, 768000 },
+	{ 4, 998400 },
+	{ 0, CPUFREQ_TABLE_END },
+};
+
+static DEFINE_PER_CPU(unsigned int, cpufreq_sim_cur);
+
+struct cpufreq_sim_switch {
+	ktime_t time;
+	unsigned int cpu;
+	unsigned int old;
+	unsigned int new;
+};
+
+static struct cpufreq_sim_switch cpufreq_sim_trace[CPUFREQ_SIM_TRACE_LEN];
+static unsigned int cpufreq_sim_head;
+static unsigned int cpufreq_sim_count;
+static DEFINE_SPINLOCK(cpufreq_sim_lock);
+
+static void cpufreq_sim_record(struct cpufreq_freqs *freqs)
+{
+	struct cpufreq_sim_switch *sw;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cpufreq_sim_lock, flags);
+	sw = &cpufreq_sim_trace[cpufreq_sim_head];
+	sw->time = ktime_get();
+	sw->cpu = freqs->cpu;
+	sw->old = freqs->old;
+	sw->new = freqs->new;
+	cpufreq_sim_head = (cpufreq_sim_head + 1) % CPUFREQ_SIM_TRACE_LEN;
+	if (cpufreq_sim_count < CPUFREQ_SIM_TRACE_LEN)
+		cpufreq_sim_count++;
+	spin_unlock_irqrestore(&cpufreq_sim_lock, flags);
+}
+
+static int cpufreq_sim_target(struct cpufreq_policy *policy,
+			      unsigned int target_freq,
+			      unsigned int relation)
+{
+	struct cpufreq_freqs freqs;
+	unsigned int index;
+
+	if (cpufreq_frequency_table_target(policy, cpufreq_sim_table,
+					   target_freq, relation, &index))
+		return -EINVAL;
+
+	freqs.old = per_cpu(cpufreq_sim_cur, policy->cpu);
+	freqs.new = cpufreq_sim_table[index].frequency;
+	freqs.cpu = policy->cpu;
+	if (freqs.old == freqs.new)
+		return 0;
+
+	cpufreq_notify_transition(&freqs, CPUFREQ_PRECHANGE);
+	udelay(latency_us);
+	per_cpu(cpufreq_sim_cur, policy->cpu) = freqs.new;
+	cpufreq_sim_record(&freqs);
+	cpufreq_notify_transition(&freqs, CPUFREQ_POSTCHANGE);
+	return 0;
+}
+
+static int cpufreq_sim_verify(struct cpufreq_policy *policy)
+{
+	return cpufreq_frequency_table_verify(policy, cpufreq_sim_table);
+}
+
+static unsigned int cpufreq_sim_get(unsigned int cpu)
+{
+	return per_cpu(cpufreq_sim_cur, cpu);
+}
+
+static int cpufreq_sim_cpu_init(struct cpufreq_policy *policy)
+{
+	int ret;
+
+	ret = cpufreq_frequency_table_cpuinfo(policy, cpufreq_sim_table);
+	if (ret)
+		return ret;
+
+	cpufreq_frequency_table_get_attr(cpufreq_sim_table, policy->cpu);
+	per_cpu(cpufreq_sim_cur, policy->cpu) = policy->cpuinfo.min_freq;
+	policy->cur = policy->cpuinfo.min_freq;
+	policy->cpuinfo.transition_latency = latency_us * NSEC_PER_USEC;
+	return 0;
+}
+
+static int cpufreq_sim_cpu_exit(struct cpufreq_policy *policy)
+{
+	cpufreq_frequency_table_put_attr(policy->cpu);
+	return 0;
+}
+
+static struct freq_attr *cpufreq_sim_attr[] = {
+	&cpufreq_freq_attr_scaling_available_freqs,
+	NULL,
+};
+
+static struct cpufreq_driver cpufreq_sim_driver = {
+	.flags		= CPUFREQ_STICKY,
+	.init		= cpufreq_sim_cpu_init,
+	.exit		= cpufreq_sim_cpu_exit,
+	.verify		= cpufreq_sim_verify,
+	.target		= cpufreq_sim_target,
+	.get		= cpufreq_sim_get,
+	.name		= "sim",
+	.owner		= THIS_MODULE,
+	.attr		= cpufreq_sim_attr,
+};
+
+#if defined(CONFIG_DEBUG_FS)
+
+#define DEBUG_BUFMAX (CPUFREQ_SIM_TRACE_LEN * 40)
+
+static ssize_t debug_read_trace(struct file *file, char __user *ubuf,
+				size_t count, loff_t *ppos)
+{
+	struct cpufreq_sim_switch sw;
+	unsigned long flags;
+	unsigned int i, first, nr;
+	char *buf;
+	int n = 0;
+	ssize_t ret;
+
+	buf = kmalloc(DEBUG_BUFMAX, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&cpufreq_sim_lock, flags);
+	nr = cpufreq_sim_count;
+	first = (cpufreq_sim_head + CPUFREQ_SIM_TRACE_LEN - nr) %
+		CPUFREQ_SIM_TRACE_LEN;
+	spin_unlock_irqrestore(&cpufreq_sim_lock, flags);
+
+	for (i = 0; i < nr; i++) {
+		spin_lock_irqsave(&cpufreq_sim_lock, flags);
+		sw = cpufreq_sim_trace[(first + i) % CPUFREQ_SIM_TRACE_LEN];
+		spin_unlock_irqrestore(&cpufreq_sim_lock, flags);
+		n += scnprintf(buf + n, DEBUG_BUFMAX - n, "%llu %u %u %u\n",
+			       (unsigned long long)ktime_to_us(sw.time),
+			       sw.cpu, sw.old, sw.new);
+	}
+
+	ret = simple_read_from_buffer(ubuf, count, ppos, buf, n);
+	kfree(buf);
+	return ret;
+}
+
+static ssize_t debug_clear_trace(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&cpufreq_sim_lock, flags);
+	cpufreq_sim_head = 0;
+	cpufreq_sim_count = 0;
+	spin_unlock_irqrestore(&cpufreq_sim_lock, flags);
+	return count;
+}
+
+static const struct file_operations debug_trace_fops = {
+	.read = debug_read_trace,
+	.write = debug_clear_trace,
+};
+
+static struct dentry *cpufreq_sim_dent;
+
+static void cpufreq_sim_debug_init(void)
+{
+	cpufreq_sim_dent = debugfs_create_dir("cpufreq_sim", 0);
+	if (IS_ERR(cpufreq_sim_dent))
+		return;
+
+	debugfs_create_file("trace", 0644, cpufreq_sim_dent, NULL,
+			    &debug_trace_fops);
+}
+
+static void cpufreq_sim_debug_exit(void)
+{
+	debugfs_remove_recursive(cpufreq_sim_dent);
+}
+#else
+static void cpufreq_sim_debug_init(void) { }
+static void cpufreq_sim_debug_exit(void) { }
+#endif
+
+static int __init cpufreq_sim_init(void)
+{
+	int ret;
+
+	ret = cpufreq_register_driver(&cpufreq_sim_driver);
+	if (ret) {
+		pr_info("cpufreq_sim: not registered, %d\n", ret);
+		return ret;
+	}
+
+	cpufreq_sim_debug_init();
+	return 0;
+}
+
+static void __exit cpufreq_sim_exit(void)
+{
+	cpufreq_sim_debug_exit();
+	cpufreq_unregister_driver(&cpufreq_sim_driver);
+}
+
+late_initcall(cpufreq_sim_init);
+module_exit(cpufreq_sim_exit);
+
+MODULE_DESCRIPTION("Simulated cpufreq driver for testing governors");
+MODULE_LICENSE("GPL");
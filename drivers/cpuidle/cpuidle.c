@@ -41,6 +41,23 @@ static void cpuidle_kick_cpus(void) {}
 
 static int __cpuidle_register_device(struct cpuidle_device *dev);
 
+/*
+ * A state left before its target residency cost more to enter than it
+ * saved; one stayed in for longer than the target residency of the next
+ * state down could have saved more there.
+ */
+static void cpuidle_count_misprediction(struct cpuidle_device *dev,
+					struct cpuidle_state *state)
+{
+	struct cpuidle_state *deeper = state + 1;
+
+	if (dev->last_residency < state->target_residency)
+		state->below++;
+	else if (deeper < &dev->states[dev->state_count] &&
+		 dev->last_residency >= deeper->target_residency)
+		state->above++;
+}
+
 /**
  * cpuidle_idle_call - the main idle loop
  *
@@ -87,6 +104,8 @@ static void cpuidle_idle_call(void)
 
 	target_state->time += (unsigned long long)dev->last_residency;
 	target_state->usage++;
+	if (target_state->flags & CPUIDLE_FLAG_TIME_VALID)
+		cpuidle_count_misprediction(dev, target_state);
 
 	/* give the governor an opportunity to reflect on the outcome */
 	if (cpuidle_curr_governor->reflect)
@@ -172,6 +191,8 @@ int cpuidle_enable_device(struct cpuidle_device *dev)
 	for (i = 0; i < dev->state_count; i++) {
 		dev->states[i].usage = 0;
 		dev->states[i].time = 0;
+		dev->states[i].above = 0;
+		dev->states[i].below = 0;
 	}
 	dev->last_residency = 0;
 	dev->last_state = NULL;
@@ -4,6 +4,20 @@
  * Copyright (C) 2006-2007 Adam Belay <abelay@novell.com>
  *
  * This code is licenced under the GPL.
+ *
+ * The time to the next timer event is only an upper bound on how long the
+ * CPU stays idle, as interrupts wake it up earlier.  How much earlier is
+ * learnt: for each order of magnitude of the time to the next timer a
+ * correction factor is kept, a decaying average of the ratio of the idle
+ * time measured to the one expected, and the expected time scaled by it
+ * is the prediction.  The deepest state whose target residency fits the
+ * prediction and whose exit latency fits PM_QOS_CPU_DMA_LATENCY is taken.
+ *
+ * With CONFIG_CPU_IDLE_GOV_MENU_TRACE the expected and measured times of
+ * the last idle periods are kept in /sys/kernel/debug/cpuidle_menu/trace.
+ * A trace in that format written to .../replay is run through the same
+ * prediction against the states of cpu 0, and reading replay then shows
+ * what it picked and how often it was wrong.
  */
 
 #include <linux/kernel.h>
@@ -13,22 +27,114 @@
 #include <linux/ktime.h>
 #include <linux/hrtimer.h>
 #include <linux/tick.h>
+#include <linux/math64.h>
 
-#define BREAK_FUZZ	4	/* 4 us */
-#define PRED_HISTORY_PCT	50
+#define BUCKETS		6
+#define RESOLUTION	1024
+#define DECAY		8
+#define UNITY		(RESOLUTION * DECAY)	/* a correction factor of 1 */
+#define MAX_INTERESTING	50000			/* us */
 
 struct menu_device {
 	int		last_state_idx;
 
 	unsigned int	expected_us;
 	unsigned int	predicted_us;
-	unsigned int    current_predicted_us;
-	unsigned int	last_measured_us;
-	unsigned int	elapsed_us;
+	unsigned int	bucket;
+	unsigned int	correction_factor[BUCKETS];
 };
 
 static DEFINE_PER_CPU(struct menu_device, menu_devices);
 
+static void menu_init_device(struct menu_device *data)
+{
+	int i;
+
+	memset(data, 0, sizeof(struct menu_device));
+	for (i = 0; i < BUCKETS; i++)
+		data->correction_factor[i] = UNITY;
+}
+
+/* idle periods of each order of magnitude are corrected separately */
+static unsigned int which_bucket(unsigned int duration)
+{
+	unsigned int bucket = 0;
+
+	while (duration >= 10 && bucket < BUCKETS - 1) {
+		duration /= 10;
+		bucket++;
+	}
+	return bucket;
+}
+
+/*
+ * Pick the deepest of @states that pays off for an idle period expected
+ * to end by @expected_us and that can be left within @latency_req.
+ */
+static int menu_predict(struct menu_device *data,
+			struct cpuidle_state *states, int state_count,
+			unsigned int expected_us, int latency_req)
+{
+	int i;
+
+	data->expected_us = expected_us;
+	data->bucket = which_bucket(expected_us);
+	data->predicted_us = div_u64((u64)expected_us *
+				     data->correction_factor[data->bucket],
+				     UNITY);
+
+	for (i = CPUIDLE_DRIVER_STATE_START + 1; i < state_count; i++) {
+		struct cpuidle_state *s = &states[i];
+
+		if (s->target_residency > data->predicted_us)
+			break;
+		if (s->exit_latency > latency_req)
+			break;
+	}
+
+	data->last_state_idx = i - 1;
+	return i - 1;
+}
+
+/*
+ * Fold an idle period that lasted @measured_us, @exit_latency of it
+ * spent leaving the state, into the correction factor it was predicted
+ * with.
+ */
+static void menu_learn(struct menu_device *data, unsigned int exit_latency,
+		       unsigned int measured_us)
+{
+	unsigned int new_factor = data->correction_factor[data->bucket];
+
+	if (measured_us > exit_latency)
+		measured_us -= exit_latency;
+
+	/* only the timer that was expected ends it this late */
+	if (measured_us > data->expected_us)
+		measured_us = data->expected_us;
+
+	new_factor -= new_factor / DECAY;
+	if (data->expected_us > 0 && measured_us < MAX_INTERESTING)
+		new_factor += RESOLUTION * measured_us / data->expected_us;
+	else
+		/* long periods are ended by timers, take them as on time */
+		new_factor += RESOLUTION;
+
+	/* a factor of 0 would predict 0 forever */
+	if (new_factor == 0)
+		new_factor = 1;
+
+	data->correction_factor[data->bucket] = new_factor;
+}
+
+#ifdef CONFIG_CPU_IDLE_GOV_MENU_TRACE
+static void menu_trace_record(unsigned int expected_us,
+			      unsigned int measured_us);
+#else
+static inline void menu_trace_record(unsigned int expected_us,
+				     unsigned int measured_us) { }
+#endif
+
 /**
  * menu_select - selects the next idle state to enter
  * @dev: the CPU
@@ -37,7 +143,7 @@ static int menu_select(struct cpuidle_device *dev)
 {
 	struct menu_device *data = &__get_cpu_var(menu_devices);
 	int latency_req = pm_qos_requirement(PM_QOS_CPU_DMA_LATENCY);
-	int i;
+	s64 expected_us;
 
 	/* Special case when user has set very strict latency requirement */
 	if (unlikely(latency_req == 0)) {
@@ -46,33 +152,16 @@ static int menu_select(struct cpuidle_device *dev)
 	}
 
 	/* determine the expected residency time */
-	data->expected_us =
-		(u32) ktime_to_ns(tick_nohz_get_sleep_length()) / 1000;
-
-	/* Recalculate predicted_us based on prediction_history_pct */
-	data->predicted_us *= PRED_HISTORY_PCT;
-	data->predicted_us += (100 - PRED_HISTORY_PCT) *
-				data->current_predicted_us;
-	data->predicted_us /= 100;
-
-	/* find the deepest idle state that satisfies our constraints */
-	for (i = CPUIDLE_DRIVER_STATE_START + 1; i < dev->state_count; i++) {
-		struct cpuidle_state *s = &dev->states[i];
+	expected_us = ktime_to_us(tick_nohz_get_sleep_length());
+	if (expected_us > UINT_MAX)
+		expected_us = UINT_MAX;
 
-		if (s->target_residency > data->expected_us)
-			break;
-		if (s->target_residency > data->predicted_us)
-			break;
-		if (s->exit_latency > latency_req)
-			break;
-	}
-
-	data->last_state_idx = i - 1;
-	return i - 1;
+	return menu_predict(data, dev->states, dev->state_count,
+			    expected_us, latency_req);
 }
 
 /**
- * menu_reflect - attempts to guess what happened after entry
+ * menu_reflect - learns from how long the CPU actually stayed idle
  * @dev: the CPU
  *
  * NOTE: it's important to be fast here because this operation will add to
@@ -81,39 +170,23 @@ static int menu_select(struct cpuidle_device *dev)
 static void menu_reflect(struct cpuidle_device *dev)
 {
 	struct menu_device *data = &__get_cpu_var(menu_devices);
-	int last_idx = data->last_state_idx;
-	unsigned int last_idle_us = cpuidle_get_last_residency(dev);
-	struct cpuidle_state *target = &dev->states[last_idx];
-	unsigned int measured_us;
+	struct cpuidle_state *target = dev->last_state;
+	unsigned int measured_us = cpuidle_get_last_residency(dev);
+
+	/* the driver may have entered a shallower state than was picked */
+	if (!target)
+		target = &dev->states[data->last_state_idx];
 
 	/*
 	 * Ugh, this idle state doesn't support residency measurements, so we
 	 * are basically lost in the dark.  As a compromise, assume we slept
-	 * for one full standard timer tick.  However, be aware that this
-	 * could potentially result in a suboptimal state transition.
+	 * for the whole expected time.
 	 */
 	if (unlikely(!(target->flags & CPUIDLE_FLAG_TIME_VALID)))
-		last_idle_us = USEC_PER_SEC / HZ;
+		measured_us = data->expected_us;
 
-	/*
-	 * measured_us and elapsed_us are the cumulative idle time, since the
-	 * last time we were woken out of idle by an interrupt.
-	 */
-	if (data->elapsed_us <= data->elapsed_us + last_idle_us)
-		measured_us = data->elapsed_us + last_idle_us;
-	else
-		measured_us = -1;
-
-	/* Predict time until next break event */
-	data->current_predicted_us = max(measured_us, data->last_measured_us);
-
-	if (last_idle_us + BREAK_FUZZ <
-	    data->expected_us - target->exit_latency) {
-		data->last_measured_us = measured_us;
-		data->elapsed_us = 0;
-	} else {
-		data->elapsed_us = measured_us;
-	}
+	menu_trace_record(data->expected_us, measured_us);
+	menu_learn(data, target->exit_latency, measured_us);
 }
 
 /**
@@ -122,13 +195,279 @@ static void menu_reflect(struct cpuidle_device *dev)
  */
 static int menu_enable_device(struct cpuidle_device *dev)
 {
-	struct menu_device *data = &per_cpu(menu_devices, dev->cpu);
+	menu_init_device(&per_cpu(menu_devices, dev->cpu));
 
-	memset(data, 0, sizeof(struct menu_device));
+	return 0;
+}
+
+#ifdef CONFIG_CPU_IDLE_GOV_MENU_TRACE
+
+#include <linux/debugfs.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+
+#define MENU_TRACE_LEN	1024
+
+struct menu_trace_entry {
+	unsigned int expected_us;
+	unsigned int measured_us;
+};
 
+static struct menu_trace_entry menu_trace[MENU_TRACE_LEN];
+static unsigned int menu_trace_head;
+static unsigned int menu_trace_count;
+static DEFINE_SPINLOCK(menu_trace_lock);
+
+static void menu_trace_record(unsigned int expected_us,
+			      unsigned int measured_us)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&menu_trace_lock, flags);
+	menu_trace[menu_trace_head].expected_us = expected_us;
+	menu_trace[menu_trace_head].measured_us = measured_us;
+	menu_trace_head = (menu_trace_head + 1) % MENU_TRACE_LEN;
+	if (menu_trace_count < MENU_TRACE_LEN)
+		menu_trace_count++;
+	spin_unlock_irqrestore(&menu_trace_lock, flags);
+}
+
+#define DEBUG_BUFMAX (MENU_TRACE_LEN * 24)
+
+static ssize_t debug_read_trace(struct file *file, char __user *ubuf,
+				size_t count, loff_t *ppos)
+{
+	struct menu_trace_entry entry;
+	unsigned long flags;
+	unsigned int i, first, nr;
+	char *buf;
+	int n = 0;
+	ssize_t ret;
+
+	buf = kmalloc(DEBUG_BUFMAX, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&menu_trace_lock, flags);
+	nr = menu_trace_count;
+	first = (menu_trace_head + MENU_TRACE_LEN - nr) % MENU_TRACE_LEN;
+	spin_unlock_irqrestore(&menu_trace_lock, flags);
+
+	for (i = 0; i < nr; i++) {
+		spin_lock_irqsave(&menu_trace_lock, flags);
+		entry = menu_trace[(first + i) % MENU_TRACE_LEN];
+		spin_unlock_irqrestore(&menu_trace_lock, flags);
+		n += scnprintf(buf + n, DEBUG_BUFMAX - n, "%u %u\n",
+			       entry.expected_us, entry.measured_us);
+	}
+
+	ret = simple_read_from_buffer(ubuf, count, ppos, buf, n);
+	kfree(buf);
+	return ret;
+}
+
+static ssize_t debug_clear_trace(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&menu_trace_lock, flags);
+	menu_trace_head = 0;
+	menu_trace_count = 0;
+	spin_unlock_irqrestore(&menu_trace_lock, flags);
+	return count;
+}
+
+static const struct file_operations debug_trace_fops = {
+	.read = debug_read_trace,
+	.write = debug_clear_trace,
+};
+
+struct menu_replay_result {
+	int state_count;
+	char name[CPUIDLE_STATE_MAX][CPUIDLE_NAME_LEN];
+	unsigned long long usage[CPUIDLE_STATE_MAX];
+	unsigned long long above[CPUIDLE_STATE_MAX];
+	unsigned long long below[CPUIDLE_STATE_MAX];
+	unsigned long long entries;
+	unsigned long long error_us;	/* sum of |predicted - measured| */
+};
+
+/* what one writer of the replay file has run through so far */
+struct menu_replay {
+	struct menu_device data;
+	struct cpuidle_state states[CPUIDLE_STATE_MAX];
+	int latency_req;
+	struct menu_replay_result result;
+	char line[32];
+	int len;
+};
+
+static DEFINE_MUTEX(menu_replay_mutex);
+static struct menu_replay_result menu_replay_last;
+
+static void menu_replay_one(struct menu_replay *r, unsigned int expected_us,
+			    unsigned int measured_us)
+{
+	struct menu_replay_result *res = &r->result;
+	struct cpuidle_state *s;
+	int idx;
+
+	idx = menu_predict(&r->data, r->states, res->state_count,
+			   expected_us, r->latency_req);
+	s = &r->states[idx];
+
+	/* counted as cpuidle counts them */
+	res->usage[idx]++;
+	if (measured_us < s->target_residency)
+		res->below[idx]++;
+	else if (idx + 1 < res->state_count &&
+		 measured_us >= r->states[idx + 1].target_residency)
+		res->above[idx]++;
+
+	res->entries++;
+	if (r->data.predicted_us > measured_us)
+		res->error_us += r->data.predicted_us - measured_us;
+	else
+		res->error_us += measured_us - r->data.predicted_us;
+
+	menu_learn(&r->data, s->exit_latency, measured_us);
+}
+
+static int debug_replay_open(struct inode *inode, struct file *file)
+{
+	struct cpuidle_device *dev = per_cpu(cpuidle_devices, 0);
+	struct menu_replay *r;
+	int i;
+
+	if (!(file->f_mode & FMODE_WRITE))
+		return 0;
+	if (!dev || !dev->state_count)
+		return -ENODEV;
+
+	r = kzalloc(sizeof(*r), GFP_KERNEL);
+	if (!r)
+		return -ENOMEM;
+
+	menu_init_device(&r->data);
+	r->latency_req = pm_qos_requirement(PM_QOS_CPU_DMA_LATENCY);
+	r->result.state_count = dev->state_count;
+	for (i = 0; i < dev->state_count; i++) {
+		r->states[i] = dev->states[i];
+		strlcpy(r->result.name[i], dev->states[i].name,
+			CPUIDLE_NAME_LEN);
+	}
+	file->private_data = r;
 	return 0;
 }
 
+static ssize_t debug_replay_write(struct file *file, const char __user *ubuf,
+				  size_t count, loff_t *ppos)
+{
+	struct menu_replay *r = file->private_data;
+	unsigned int expected_us, measured_us;
+	char *buf;
+	size_t i;
+
+	if (!r)
+		return -EINVAL;
+
+	count = min_t(size_t, count, PAGE_SIZE);
+	buf = kmalloc(count, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	if (copy_from_user(buf, ubuf, count)) {
+		kfree(buf);
+		return -EFAULT;
+	}
+
+	/* lines may be split between writes */
+	for (i = 0; i < count; i++) {
+		if (buf[i] != '\n') {
+			if (r->len < sizeof(r->line) - 1)
+				r->line[r->len++] = buf[i];
+			continue;
+		}
+		r->line[r->len] = '\0';
+		r->len = 0;
+		if (sscanf(r->line, "%u %u", &expected_us, &measured_us) == 2)
+			menu_replay_one(r, expected_us, measured_us);
+	}
+
+	kfree(buf);
+	return count;
+}
+
+static int debug_replay_release(struct inode *inode, struct file *file)
+{
+	struct menu_replay *r = file->private_data;
+
+	if (!r)
+		return 0;
+
+	mutex_lock(&menu_replay_mutex);
+	menu_replay_last = r->result;
+	mutex_unlock(&menu_replay_mutex);
+	kfree(r);
+	return 0;
+}
+
+#define REPLAY_BUFMAX 1024
+
+static ssize_t debug_replay_read(struct file *file, char __user *ubuf,
+				 size_t count, loff_t *ppos)
+{
+	struct menu_replay_result *res = &menu_replay_last;
+	char *buf;
+	int i, n = 0;
+	ssize_t ret;
+
+	buf = kmalloc(REPLAY_BUFMAX, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	mutex_lock(&menu_replay_mutex);
+	n += scnprintf(buf + n, REPLAY_BUFMAX - n,
+		       "entries %llu, mean error %llu us\n", res->entries,
+		       res->entries ? div64_u64(res->error_us, res->entries)
+		       : 0);
+	n += scnprintf(buf + n, REPLAY_BUFMAX - n, "%-16s %10s %10s %10s\n",
+		       "state", "usage", "above", "below");
+	for (i = 0; i < res->state_count; i++)
+		n += scnprintf(buf + n, REPLAY_BUFMAX - n,
+			       "%-16s %10llu %10llu %10llu\n", res->name[i],
+			       res->usage[i], res->above[i], res->below[i]);
+	mutex_unlock(&menu_replay_mutex);
+
+	ret = simple_read_from_buffer(ubuf, count, ppos, buf, n);
+	kfree(buf);
+	return ret;
+}
+
+static const struct file_operations debug_replay_fops = {
+	.open = debug_replay_open,
+	.read = debug_replay_read,
+	.write = debug_replay_write,
+	.release = debug_replay_release,
+};
+
+static void __init menu_debug_init(void)
+{
+	struct dentry *dent;
+
+	dent = debugfs_create_dir("cpuidle_menu", 0);
+	if (IS_ERR(dent))
+		return;
+
+	debugfs_create_file("trace", 0644, dent, NULL, &debug_trace_fops);
+	debugfs_create_file("replay", 0644, dent, NULL, &debug_replay_fops);
+}
+#else
+static inline void menu_debug_init(void) { }
+#endif
+
 static struct cpuidle_governor menu_governor = {
 	.name =		"menu",
 	.rating =	20,
@@ -143,6 +482,7 @@ static struct cpuidle_governor menu_governor = {
  */
 static int __init init_menu(void)
 {
+	menu_debug_init();
 	return cpuidle_register_governor(&menu_governor);
 }
 
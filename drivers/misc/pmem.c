@@ -24,12 +24,18 @@
 #include <linux/android_pmem.h>
 #include <linux/mempolicy.h>
 #include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <linux/random.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
 #include <asm/io.h>
+#include <asm/div64.h>
 #include <asm/uaccess.h>
 #include <asm/cacheflush.h>
+#include <mach/cache_maint.h>
 
 #define PMEM_MAX_DEVICES 10
-#define PMEM_MAX_ORDER 128
+#define PMEM_MAX_ORDER 32
 #define PMEM_MIN_ALLOC PAGE_SIZE
 
 #define PMEM_DEBUG 1
@@ -84,6 +90,9 @@ struct pmem_data {
 struct pmem_bits {
 	unsigned allocated:1;		/* 1 if allocated, 0 if free */
 	unsigned order:7;		/* size of the region in pmem space */
+	/* on the free list of its order, if this is the first entry of
+	 * a free region */
+	struct list_head free;
 };
 
 struct pmem_region_node {
@@ -118,6 +127,16 @@ struct pmem_info {
 	/* the bitmap for the region indicating which entries are allocated
 	 * and which are free */
 	struct pmem_bits *bitmap;
+	/* free regions of each order, linked through pmem_bits.free, and
+	 * how many there are */
+	struct list_head free_area[PMEM_MAX_ORDER];
+	unsigned long nr_free[PMEM_MAX_ORDER];
+	/* allocator statistics, shown in debugfs */
+	unsigned long nr_allocs;
+	unsigned long nr_frees;
+	unsigned long nr_failed;
+	unsigned long nr_splits;
+	unsigned long nr_merges;
 	/* indicates the region should not be managed with an allocator */
 	unsigned no_allocator;
 	/* indicates maps of this region should be cached, if a mix of
@@ -234,6 +253,20 @@ static int is_master_owner(struct file *file)
 	return ret;
 }
 
+static void pmem_free_add(int id, int index)
+{
+	int order = PMEM_ORDER(id, index);
+
+	list_add(&pmem[id].bitmap[index].free, &pmem[id].free_area[order]);
+	pmem[id].nr_free[order]++;
+}
+
+static void pmem_free_del(int id, int index)
+{
+	list_del(&pmem[id].bitmap[index].free);
+	pmem[id].nr_free[PMEM_ORDER(id, index)]--;
+}
+
 static int pmem_free(int id, int index)
 {
 	/* caller should hold the write lock on pmem_sem! */
@@ -246,6 +279,7 @@ static int pmem_free(int id, int index)
 	}
 	/* clean up the bitmap, merging any buddies */
 	pmem[id].bitmap[curr].allocated = 0;
+	pmem[id].nr_frees++;
 	/* find a slots buddy Buddy# = Slot# ^ (1 << order)
 	 * if the buddy is also free merge them
 	 * repeat until the buddy is not free or end of the bitmap is reached
@@ -255,13 +289,16 @@ static int pmem_free(int id, int index)
 		if (buddy < pmem[id].num_entries &&
 			PMEM_IS_FREE(id, buddy) &&
 				PMEM_ORDER(id, buddy) == PMEM_ORDER(id, curr)) {
+			pmem_free_del(id, buddy);
 			PMEM_ORDER(id, buddy)++;
 			PMEM_ORDER(id, curr)++;
 			curr = min(buddy, curr);
+			pmem[id].nr_merges++;
 		} else {
 			break;
 		}
 	} while (curr < pmem[id].num_entries);
+	pmem_free_add(id, curr);
 
 #ifdef PMEM_LOG
 	int i;
@@ -392,9 +429,8 @@ static int pmem_allocate(int id, unsigned long len)
 {
 	/* caller should hold the write lock on pmem_sem! */
 	/* return the corresponding pdata[] entry */
-	int curr = 0;
-	int end = pmem[id].num_entries;
-	int best_fit = -1;
+	int curr;
+	int best_fit;
 	unsigned long order = pmem_order(len);
 
 	if (pmem[id].no_allocator) {
@@ -405,39 +441,30 @@ static int pmem_allocate(int id, unsigned long len)
 		return len;
 	}
 
-	if (order > PMEM_MAX_ORDER)
-		return -1;
 	DLOG("order %lx\n", order);
 
-	/* look through the bitmap:
-	 * 	if you find a free slot of the correct order use it
-	 * 	otherwise, use the best fit (smallest with size > order) slot
-	 */
-	while (curr < end) {
-		if (PMEM_IS_FREE(id, curr)) {
-			if (PMEM_ORDER(id, curr) == (unsigned char)order) {
-				/* set the not free bit and clear others */
-				best_fit = curr;
-				break;
-			}
-			if (PMEM_ORDER(id, curr) > (unsigned char)order &&
-			    (best_fit < 0 ||
-			     PMEM_ORDER(id, curr) < PMEM_ORDER(id, best_fit)))
-				best_fit = curr;
-		}
-		curr = PMEM_NEXT_INDEX(id, curr);
-	}
+	/* take a region from the smallest non-empty free list of at least
+	 * the requested order */
+	for (curr = order; curr < PMEM_MAX_ORDER; curr++)
+		if (!list_empty(&pmem[id].free_area[curr]))
+			break;
 
-	/* if best_fit < 0, there are no suitable slots,
+	/* if there is none, there are no suitable slots,
 	 * return an error
 	 */
-	if (best_fit < 0) {
-		printk("pmem: no space left to allocate!\n");
+	if (curr >= PMEM_MAX_ORDER) {
+		pmem[id].nr_failed++;
+		if (printk_ratelimit())
+			printk("pmem: no space left to allocate!\n");
 		return -1;
 	}
+	best_fit = list_entry(pmem[id].free_area[curr].next,
+			      struct pmem_bits, free) - pmem[id].bitmap;
+	pmem_free_del(id, best_fit);
 
 	/* now partition the best fit:
-	 * 	split the slot into 2 buddies of order - 1
+	 * 	split the slot into 2 buddies of order - 1, putting the
+	 * 	upper one on the free list
 	 * 	repeat until the slot is of the correct order
 	 */
 	while (PMEM_ORDER(id, best_fit) > (unsigned char)order) {
@@ -445,7 +472,10 @@ static int pmem_allocate(int id, unsigned long len)
 		PMEM_ORDER(id, best_fit) -= 1;
 		buddy = PMEM_BUDDY_INDEX(id, best_fit);
 		PMEM_ORDER(id, buddy) = PMEM_ORDER(id, best_fit);
+		pmem_free_add(id, buddy);
+		pmem[id].nr_splits++;
 	}
+	pmem[id].nr_allocs++;
 	pmem[id].bitmap[best_fit].allocated = 1;
 	return best_fit;
 }
@@ -816,12 +846,10 @@ void flush_pmem_file(struct file *file, unsigned long offset, unsigned long len)
 	struct pmem_data *data;
 	int id;
 	void *vaddr;
+	unsigned long paddr;
 	struct pmem_region_node *region_node;
 	struct list_head *elt;
-	void *flush_start, *flush_end;
-#ifdef CONFIG_OUTER_CACHE
-	unsigned long phy_start, phy_end;
-#endif
+	struct cache_maint cm;
 
 	if (!is_pmem_file(file) || !has_allocation(file)) {
 		return;
@@ -834,17 +862,13 @@ void flush_pmem_file(struct file *file, unsigned long offset, unsigned long len)
 
 	down_read(&data->sem);
 	vaddr = pmem_start_vaddr(id, data);
+	paddr = pmem_start_addr(id, data);
 	/* if this isn't a submmapped file, flush the whole thing */
 	if (unlikely(!(data->flags & PMEM_FLAGS_CONNECTED))) {
-		dmac_flush_range(vaddr, vaddr + pmem_len(id, data));
-#ifdef CONFIG_OUTER_CACHE
-		phy_start = (unsigned long)vaddr -
-				(unsigned long)pmem[id].vbase + pmem[id].base;
-
-		phy_end  =  phy_start + pmem_len(id, data);
-
-		outer_flush_range(phy_start, phy_end);
-#endif
+		len = pmem_len(id, data);
+		cache_maint_begin(&cm, CACHE_MAINT_PMEM, CACHE_MAINT_FLUSH, len);
+		cache_maint_range(&cm, vaddr, paddr, len);
+		cache_maint_end(&cm);
 		goto end;
 	}
 	/* otherwise, flush the region of the file we are drawing */
@@ -853,23 +877,93 @@ void flush_pmem_file(struct file *file, unsigned long offset, unsigned long len)
 		if ((offset >= region_node->region.offset) &&
 		    ((offset + len) <= (region_node->region.offset +
 			region_node->region.len))) {
-			flush_start = vaddr + region_node->region.offset;
-			flush_end = flush_start + region_node->region.len;
-			dmac_flush_range(flush_start, flush_end);
-#ifdef CONFIG_OUTER_CACHE
+			offset = region_node->region.offset;
+			len = region_node->region.len;
+			cache_maint_begin(&cm, CACHE_MAINT_PMEM,
+					  CACHE_MAINT_FLUSH, len);
+			cache_maint_range(&cm, vaddr + offset, paddr + offset,
+					  len);
+			cache_maint_end(&cm);
+			break;
+		}
+	}
+end:
+	up_read(&data->sem);
+}
 
-			phy_start = (unsigned long)flush_start -
-				(unsigned long)pmem[id].vbase + pmem[id].base;
+/* Clean and/or invalidate a list of ranges of a cached allocation.  The
+ * ranges are walked through the kernel mapping of the region; the caches
+ * are physically tagged, so that covers the user mappings as well.
+ */
+static int pmem_maint_ranges(struct file *file, struct pmem_cache_op *op,
+			     struct pmem_region *ranges)
+{
+	struct pmem_data *data = (struct pmem_data *)file->private_data;
+	int id = get_id(file);
+	struct cache_maint cm;
+	unsigned long size, bytes = 0, paddr;
+	void *vaddr;
+	int i, ret = 0;
 
-			phy_end  =  phy_start + region_node->region.len;
+	down_read(&data->sem);
+	if (!has_allocation(file)) {
+		ret = -EINVAL;
+		goto out;
+	}
 
-			outer_flush_range(phy_start, phy_end);
-#endif
-			break;
+	size = pmem_len(id, data);
+	for (i = 0; i < op->nr_ranges; i++) {
+		if (ranges[i].offset > size ||
+		    ranges[i].len > size - ranges[i].offset) {
+			ret = -EINVAL;
+			goto out;
 		}
+		bytes += ranges[i].len;
 	}
-end:
+
+	vaddr = pmem_start_vaddr(id, data);
+	paddr = pmem_start_addr(id, data);
+	cache_maint_begin(&cm, CACHE_MAINT_PMEM, op->flags, bytes);
+	for (i = 0; i < op->nr_ranges; i++)
+		cache_maint_range(&cm, vaddr + ranges[i].offset,
+				  paddr + ranges[i].offset, ranges[i].len);
+	cache_maint_end(&cm);
+out:
 	up_read(&data->sem);
+	return ret;
+}
+
+/* The PMEM_*_CACHES ioctls: part of the allocation, through the
+ * caller's own mapping of it at addr->vaddr.
+ */
+static int pmem_maint_user(struct file *file, unsigned op,
+			   struct pmem_addr *addr)
+{
+	struct pmem_data *data = (struct pmem_data *)file->private_data;
+	int id = get_id(file);
+	struct cache_maint cm;
+	unsigned long size;
+	int ret = 0;
+
+	down_read(&data->sem);
+	if (!has_allocation(file)) {
+		ret = -EINVAL;
+		goto out;
+	}
+	size = pmem_len(id, data);
+	if (addr->offset > size || addr->length > size - addr->offset) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	cache_maint_begin(&cm, CACHE_MAINT_PMEM, op, addr->length);
+	cache_maint_range(&cm, (void *)addr->vaddr,
+			  pmem_start_addr(id, data) + addr->offset,
+			  addr->length);
+	cache_maint_end(&cm);
+out:
+	up_read(&data->sem);
+	return ret;
 }
 
 static int pmem_connect(unsigned long connect, struct file *file)
@@ -1188,10 +1282,16 @@ static long pmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		}
 	case PMEM_ALLOCATE:
 		{
-			if (has_allocation(file))
-				return -EINVAL;
 			data = (struct pmem_data *)file->private_data;
+			down_write(&data->sem);
+			if (has_allocation(file)) {
+				up_write(&data->sem);
+				return -EINVAL;
+			}
+			down_write(&pmem[id].bitmap_sem);
 			data->index = pmem_allocate(id, arg);
+			up_write(&pmem[id].bitmap_sem);
+			up_write(&data->sem);
 			break;
 		}
 	case PMEM_CONNECT:
@@ -1204,37 +1304,52 @@ static long pmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	case PMEM_INV_CACHES:
 		{
 			struct pmem_addr pmem_addr;
-			unsigned long vaddr;
-			unsigned long paddr;
-			unsigned long length;
-			unsigned long offset;
+			unsigned op;
 
 			id = get_id(file);
 			if (!pmem[id].cached)
 				return 0;
-			if (!has_allocation(file))
-				return -EINVAL;
 			if (copy_from_user(&pmem_addr, (void __user *)arg,
 						sizeof(struct pmem_addr)))
 				return -EFAULT;
 
-			data = (struct pmem_data *)file->private_data;
-			offset = pmem_addr.offset;
-			length = pmem_addr.length;
-			if (offset + length > pmem_len(id, data))
-				return -EINVAL;
-			vaddr = pmem_addr.vaddr;
-			paddr = pmem_start_addr(id, data) + offset;
-
 			if (cmd == PMEM_CLEAN_INV_CACHES)
-				clean_and_invalidate_caches(vaddr,
-				length, paddr);
+				op = CACHE_MAINT_FLUSH;
 			else if (cmd == PMEM_CLEAN_CACHES)
-				clean_caches(vaddr, length, paddr);
-			else if (cmd == PMEM_INV_CACHES)
-				invalidate_caches(vaddr, length, paddr);
+				op = CACHE_MAINT_CLEAN;
+			else
+				op = CACHE_MAINT_INV;
+			return pmem_maint_user(file, op, &pmem_addr);
+		}
 
-			break;
+	case PMEM_CACHE_OP:
+		{
+			struct pmem_cache_op op;
+			struct pmem_region *ranges;
+			int ret;
+
+			if (copy_from_user(&op, (void __user *)arg,
+						sizeof(struct pmem_cache_op)))
+				return -EFAULT;
+			if (!op.flags || (op.flags & ~PMEM_CACHE_FLUSH) ||
+			    op.nr_ranges > PMEM_CACHE_MAX_RANGES)
+				return -EINVAL;
+			id = get_id(file);
+			if (!pmem[id].cached || file->f_flags & O_SYNC ||
+			    !op.nr_ranges)
+				return 0;
+
+			ranges = kmalloc(op.nr_ranges * sizeof(*ranges),
+					 GFP_KERNEL);
+			if (!ranges)
+				return -ENOMEM;
+			if (copy_from_user(ranges, (void __user *)op.ranges,
+					op.nr_ranges * sizeof(*ranges)))
+				ret = -EFAULT;
+			else
+				ret = pmem_maint_ranges(file, &op, ranges);
+			kfree(ranges);
+			return ret;
 		}
 
 	default:
@@ -1245,7 +1360,52 @@ static long pmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	return 0;
 }
 
+/* free space and the largest free region, in pages; caller should hold
+ * the bitmap_sem */
+static unsigned long pmem_free_pages(int id, int *largest)
+{
+	unsigned long free = 0;
+	int order;
+
+	*largest = -1;
+	for (order = 0; order < PMEM_MAX_ORDER; order++) {
+		if (!pmem[id].nr_free[order])
+			continue;
+		free += pmem[id].nr_free[order] << order;
+		*largest = order;
+	}
+	return free;
+}
+
 #if PMEM_DEBUG
+static int debug_read_free(int id, char *buf, int max)
+{
+	unsigned long free;
+	int order, largest;
+	int n = 0;
+
+	down_read(&pmem[id].bitmap_sem);
+	free = pmem_free_pages(id, &largest);
+	n += scnprintf(buf + n, max - n,
+		       "free: %lu of %lu bytes, largest free region %lu bytes\n",
+		       free * PMEM_MIN_ALLOC, pmem[id].size,
+		       largest < 0 ? 0 : PMEM_MIN_ALLOC << largest);
+	for (order = 0; order <= largest; order++)
+		n += scnprintf(buf + n, max - n,
+			       "order %2d: %lu free (%lu bytes)\n", order,
+			       pmem[id].nr_free[order],
+			       (pmem[id].nr_free[order] << order) *
+			       PMEM_MIN_ALLOC);
+	n += scnprintf(buf + n, max - n,
+		       "allocs %lu frees %lu failed %lu splits %lu merges %lu\n",
+		       pmem[id].nr_allocs, pmem[id].nr_frees,
+		       pmem[id].nr_failed, pmem[id].nr_splits,
+		       pmem[id].nr_merges);
+	up_read(&pmem[id].bitmap_sem);
+
+	return n;
+}
+
 static ssize_t debug_open(struct inode *inode, struct file *file)
 {
 	file->private_data = inode->i_private;
@@ -1286,6 +1446,9 @@ static ssize_t debug_read(struct file *file, char __user *buf, size_t count,
 	}
 	up(&pmem[id].data_list_sem);
 
+	if (!pmem[id].no_allocator)
+		n += debug_read_free(id, buffer + n, debug_bufmax - n);
+
 	n++;
 	buffer[n] = 0;
 	return simple_read_from_buffer(buf, count, ppos, buffer, n);
@@ -1335,17 +1498,21 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 	}
 	pmem[id].num_entries = pmem[id].size / PMEM_MIN_ALLOC;
 
-	pmem[id].bitmap = kmalloc(pmem[id].num_entries *
-				  sizeof(struct pmem_bits), GFP_KERNEL);
+	pmem[id].bitmap = vmalloc(pmem[id].num_entries *
+				  sizeof(struct pmem_bits));
 	if (!pmem[id].bitmap)
 		goto err_no_mem_for_metadata;
 
 	memset(pmem[id].bitmap, 0, sizeof(struct pmem_bits) *
 					  pmem[id].num_entries);
 
+	for (i = 0; i < PMEM_MAX_ORDER; i++)
+		INIT_LIST_HEAD(&pmem[id].free_area[i]);
+
 	for (i = sizeof(pmem[id].num_entries) * 8 - 1; i >= 0; i--) {
 		if ((pmem[id].num_entries) &  1<<i) {
 			PMEM_ORDER(id, index) = i;
+			pmem_free_add(id, index);
 			index = PMEM_NEXT_INDEX(id, index);
 		}
 	}
@@ -1374,13 +1541,171 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 #endif
 	return 0;
 error_cant_remap:
-	kfree(pmem[id].bitmap);
+	vfree(pmem[id].bitmap);
 err_no_mem_for_metadata:
 	misc_deregister(&pmem[id].dev);
 err_cant_register_device:
 	return -1;
 }
 
+#ifdef CONFIG_ANDROID_PMEM_TEST
+/* A pmem region carved out of normal RAM, so the allocator can be
+ * exercised on any device: /dev/pmem_test takes the regular pmem ioctls
+ * and mmaps, and writing an operation count to debugfs pmem_test_stress
+ * runs that many random allocations and frees against it; reading it
+ * back gives the timings and how fragmented the region was left.
+ */
+#define PMEM_TEST_SLOTS 256
+
+static struct android_pmem_platform_data pmem_test_pdata = {
+	.name = "pmem_test",
+	.no_allocator = 0,
+	.cached = 1,
+};
+
+static int pmem_test_id = -1;
+
+static int pmem_test_stress(unsigned long count, char *result, size_t size)
+{
+	int id = pmem_test_id;
+	unsigned long nr_alloc = 0, nr_free = 0, nr_failed = 0;
+	unsigned long long alloc_ns = 0, free_ns = 0;
+	unsigned long i, free;
+	int max_order = ilog2(pmem[id].num_entries);
+	int *slots;
+	int largest, order, slot;
+	u32 r;
+	ktime_t start;
+
+	slots = vmalloc(PMEM_TEST_SLOTS * sizeof(int));
+	if (!slots)
+		return -ENOMEM;
+	for (slot = 0; slot < PMEM_TEST_SLOTS; slot++)
+		slots[slot] = -1;
+
+	for (i = 0; i < count; i++) {
+		r = random32();
+		slot = r % PMEM_TEST_SLOTS;
+		r /= PMEM_TEST_SLOTS;
+		/* mostly small buffers, now and then a large one */
+		order = (r & 7) ? (r >> 3) % 4 : (r >> 3) % (max_order + 1);
+
+		down_write(&pmem[id].bitmap_sem);
+		start = ktime_get();
+		if (slots[slot] < 0) {
+			slots[slot] = pmem_allocate(id, PMEM_MIN_ALLOC << order);
+			alloc_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+			if (slots[slot] < 0)
+				nr_failed++;
+			nr_alloc++;
+		} else {
+			pmem_free(id, slots[slot]);
+			free_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+			slots[slot] = -1;
+			nr_free++;
+		}
+		up_write(&pmem[id].bitmap_sem);
+
+		if ((i & 1023) == 1023)
+			cond_resched();
+	}
+
+	down_write(&pmem[id].bitmap_sem);
+	free = pmem_free_pages(id, &largest);
+	for (slot = 0; slot < PMEM_TEST_SLOTS; slot++)
+		if (slots[slot] >= 0)
+			pmem_free(id, slots[slot]);
+	up_write(&pmem[id].bitmap_sem);
+	vfree(slots);
+
+	if (nr_alloc)
+		do_div(alloc_ns, nr_alloc);
+	if (nr_free)
+		do_div(free_ns, nr_free);
+	snprintf(result, size,
+		 "%lu allocs (%lu failed) avg %llu ns, %lu frees avg %llu ns, "
+		 "%lu KB free at end, largest %lu KB\n",
+		 nr_alloc, nr_failed, alloc_ns, nr_free, free_ns,
+		 free * PMEM_MIN_ALLOC / 1024,
+		 largest < 0 ? 0 : (PMEM_MIN_ALLOC << largest) / 1024);
+	return 0;
+}
+
+static DEFINE_MUTEX(pmem_test_lock);
+static char pmem_test_result[256];
+
+static ssize_t pmem_test_read(struct file *file, char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&pmem_test_lock);
+	ret = simple_read_from_buffer(buf, count, ppos, pmem_test_result,
+				      strlen(pmem_test_result));
+	mutex_unlock(&pmem_test_lock);
+	return ret;
+}
+
+static ssize_t pmem_test_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	char tmp[16];
+	unsigned long n;
+	int ret;
+
+	if (count >= sizeof(tmp))
+		return -EINVAL;
+	if (copy_from_user(tmp, buf, count))
+		return -EFAULT;
+	tmp[count] = 0;
+	if (strict_strtoul(strstrip(tmp), 0, &n) || !n)
+		return -EINVAL;
+
+	mutex_lock(&pmem_test_lock);
+	pmem_test_result[0] = 0;
+	ret = pmem_test_stress(n, pmem_test_result, sizeof(pmem_test_result));
+	mutex_unlock(&pmem_test_lock);
+
+	return ret < 0 ? ret : count;
+}
+
+static struct file_operations pmem_test_fops = {
+	.read = pmem_test_read,
+	.write = pmem_test_write,
+};
+
+static int __init pmem_test_init(void)
+{
+	unsigned long size = CONFIG_ANDROID_PMEM_TEST_SIZE * 1024;
+	struct page *page;
+
+	if (id_count >= PMEM_MAX_DEVICES)
+		return -ENOSPC;
+
+	size = PAGE_ALIGN(size);
+	page = alloc_pages(GFP_KERNEL | __GFP_NOWARN, get_order(size));
+	if (!page) {
+		printk(KERN_ERR "pmem_test: unable to allocate %lu bytes\n",
+		       size);
+		return -ENOMEM;
+	}
+	pmem_test_pdata.start = page_to_phys(page);
+	pmem_test_pdata.size = size;
+
+	pmem_test_id = id_count;
+	if (pmem_setup(&pmem_test_pdata, NULL, NULL)) {
+		__free_pages(page, get_order(size));
+		pmem_test_id = -1;
+		return -ENODEV;
+	}
+
+	debugfs_create_file("pmem_test_stress", 0600, NULL, NULL,
+			    &pmem_test_fops);
+	return 0;
+}
+late_initcall(pmem_test_init);
+#endif
+
 static int pmem_probe(struct platform_device *pdev)
 {
 	struct android_pmem_platform_data *pdata;
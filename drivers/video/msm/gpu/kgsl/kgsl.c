@@ -31,6 +31,7 @@
 #include <linux/highmem.h>
 #include <linux/vmalloc.h>
 #include <asm/cacheflush.h>
+#include <mach/cache_maint.h>
 
 #include <asm/atomic.h>
 
@@ -40,25 +41,26 @@
 #include "kgsl_cmdstream.h"
 #include "kgsl_log.h"
 
-struct kgsl_file_private {
-	struct list_head	list;
-	struct list_head	mem_list;
-	uint32_t		ctxt_id_mask;
-	struct kgsl_pagetable	*pagetable;
-	unsigned long		vmalloc_size;
-};
-
 static void kgsl_put_phys_file(struct file *file);
 
 #ifdef CONFIG_MSM_KGSL_MMU
-static long flush_l1_cache_range(unsigned long addr, int size)
+/* Maintain [addr, addr + size) of a user mapping of vmalloc memory, a
+ * page at a time through the kernel alias of each page.
+ */
+static long kgsl_cache_range(struct cache_maint *cm, unsigned long addr,
+			     int size)
 {
 	struct page *page;
 	pte_t *pte_ptr;
-	unsigned long end;
+	unsigned long end = addr + size;
+	unsigned long next, offset;
+
+	if (cm->whole)
+		return 0;
 
-	for (end = addr; end < (addr + size); end += KGSL_PAGESIZE) {
-		pte_ptr = kgsl_get_pte_from_vaddr(end);
+	for (; addr < end; addr = next) {
+		next = min((addr & KGSL_PAGEMASK) + KGSL_PAGESIZE, end);
+		pte_ptr = kgsl_get_pte_from_vaddr(addr);
 		if (!pte_ptr)
 			return -EINVAL;
 
@@ -70,33 +72,87 @@ static long flush_l1_cache_range(unsigned long addr, int size)
 		}
 
 		pte_unmap(pte_ptr);
-		flush_dcache_page(page);
+		offset = addr & ~KGSL_PAGEMASK;
+		cache_maint_range(cm, page_address(page) + offset,
+				  page_to_phys(page) + offset, next - addr);
+	}
+
+	return 0;
+}
+
+/* Maintain [offset, offset + size) of a vmalloc or page allocation.
+ * Pages are reached directly, so they need not be mapped into the caller.
+ */
+static long kgsl_cache_entry(struct cache_maint *cm,
+			     struct kgsl_mem_entry *entry,
+			     unsigned long offset, int size)
+{
+	struct page *page;
+	unsigned long end = offset + size;
+	unsigned long next;
+
+	if (!(entry->memdesc.priv & KGSL_MEMFLAGS_PAGE_MEM))
+		return kgsl_cache_range(cm, (unsigned long)
+					entry->memdesc.hostptr + offset, size);
+	if (cm->whole)
+		return 0;
+
+	for (; offset < end; offset = next) {
+		next = min((offset & PAGE_MASK) + PAGE_SIZE, end);
+		page = entry->pages[offset >> PAGE_SHIFT];
+		cache_maint_range(cm, page_address(page) +
+				  (offset & ~PAGE_MASK),
+				  page_to_phys(page) + (offset & ~PAGE_MASK),
+				  next - offset);
 	}
 
 	return 0;
 }
 
+static long flush_l1_cache_entry(struct kgsl_mem_entry *entry)
+{
+	struct cache_maint cm;
+	long result;
+
+	cache_maint_begin(&cm, CACHE_MAINT_KGSL, CACHE_MAINT_FLUSH,
+			  entry->memdesc.size);
+	result = kgsl_cache_entry(&cm, entry, 0, entry->memdesc.size);
+	cache_maint_end(&cm);
+
+	return result;
+}
+
 static long flush_l1_cache_all(struct kgsl_file_private *private)
 {
 	int result = 0;
 	struct kgsl_mem_entry *entry = NULL;
+	struct cache_maint cm;
+	unsigned long bytes = 0;
 
 	kgsl_yamato_runpending(&kgsl_driver.yamato_device);
+	list_for_each_entry(entry, &private->mem_list, list)
+		if (KGSL_MEMFLAGS_MEM_REQUIRES_FLUSH & entry->memdesc.priv)
+			bytes += entry->memdesc.size;
+	if (!bytes)
+		return 0;
+
+	/* one decision for all of them, so that many small allocations
+	 * can add up to a whole cache flush */
+	cache_maint_begin(&cm, CACHE_MAINT_KGSL, CACHE_MAINT_FLUSH, bytes);
 	list_for_each_entry(entry, &private->mem_list, list) {
 		if (KGSL_MEMFLAGS_MEM_REQUIRES_FLUSH & entry->memdesc.priv) {
-			result =
-			    flush_l1_cache_range((unsigned long)entry->
-						 memdesc.hostptr,
-						 entry->memdesc.size);
+			result = kgsl_cache_entry(&cm, entry, 0,
+						  entry->memdesc.size);
 			if (result)
-				goto done;
+				break;
 		}
 	}
-done:
+	cache_maint_end(&cm);
+
 	return result;
 }
 #else
-static inline long flush_l1_cache_range(unsigned long addr, int size)
+static inline long flush_l1_cache_entry(struct kgsl_mem_entry *entry)
 { return 0; }
 
 static inline long flush_l1_cache_all(struct kgsl_file_private *private)
@@ -138,12 +194,21 @@ static void kgsl_hw_disable(void)
 	kgsl_driver.active = false;
 	disable_irq(kgsl_driver.interrupt_num);
 	kgsl_clk_disable();
+	kgsl_driver.standby_start = ktime_get();
+	GSL_RB_STATS(
+		kgsl_driver.yamato_device.ringbuffer.stats.standby_count++);
 	pr_debug("kgsl: hw disabled\n");
 	wake_unlock(&kgsl_driver.wake_lock);
 }
 
 static void kgsl_hw_enable(void)
 {
+#ifdef GSL_STATS_RINGBUFFER
+	if (kgsl_driver.standby_start.tv64)
+		kgsl_driver.yamato_device.ringbuffer.stats.standby_ns +=
+			ktime_to_ns(ktime_sub(ktime_get(),
+					      kgsl_driver.standby_start));
+#endif
 	wake_lock(&kgsl_driver.wake_lock);
 	kgsl_clk_enable();
 	enable_irq(kgsl_driver.interrupt_num);
@@ -254,6 +319,7 @@ static int kgsl_release(struct inode *inodep, struct file *filep)
 
 	list_for_each_entry_safe(entry, entry_tmp, &private->mem_list, list)
 		kgsl_remove_mem_entry(entry);
+	kgsl_page_pool_drain(&private->page_pool);
 
 	if (private->pagetable != NULL) {
 #ifdef PER_PROCESS_PAGE_TABLE
@@ -300,6 +366,8 @@ static int kgsl_open(struct inode *inodep, struct file *filep)
 
 	private->ctxt_id_mask = 0;
 	INIT_LIST_HEAD(&private->mem_list);
+	kgsl_page_pool_init(&private->page_pool);
+	private->pid = task_tgid_nr(current);
 
 	filep->private_data = private;
 
@@ -433,14 +501,13 @@ static long kgsl_ioctl_device_waittimestamp(struct kgsl_file_private *private,
 		goto done;
 	}
 
-	mutex_unlock(&kgsl_driver.mutex);
 	/* Don't wait forever, set a max value for now */
 	if (param.timeout == -1)
 		param.timeout = 10 * MSEC_PER_SEC;
+	/* drops the mutex while it sleeps */
 	result = kgsl_yamato_waittimestamp(&kgsl_driver.yamato_device,
 				     param.timestamp,
 				     param.timeout);
-	mutex_lock(&kgsl_driver.mutex);
 
 	kgsl_yamato_runpending(&kgsl_driver.yamato_device);
 done:
@@ -452,6 +519,7 @@ static long kgsl_ioctl_rb_issueibcmds(struct kgsl_file_private *private,
 {
 	int result = 0;
 	struct kgsl_ringbuffer_issueibcmds param;
+	struct kgsl_ibdesc ib;
 
 	if (copy_from_user(&param, arg, sizeof(param))) {
 		result = -EFAULT;
@@ -476,10 +544,77 @@ static long kgsl_ioctl_rb_issueibcmds(struct kgsl_file_private *private,
 
 	}
 
+	ib.gpuaddr = param.ibaddr;
+	ib.sizedwords = param.sizedwords;
+	result = kgsl_ringbuffer_issueibcmds(&kgsl_driver.yamato_device,
+					     param.drawctxt_id,
+					     &ib, 1,
+					     &param.timestamp,
+					     param.flags);
+	if (result != 0)
+		goto done;
+
+	if (copy_to_user(arg, &param, sizeof(param))) {
+		result = -EFAULT;
+		goto done;
+	}
+done:
+	return result;
+}
+
+static long kgsl_ioctl_rb_issueibs(struct kgsl_file_private *private,
+				   void __user *arg)
+{
+	int result = 0;
+	struct kgsl_ringbuffer_issueibs param;
+	struct kgsl_ibdesc *ibs = NULL;
+	unsigned int i;
+
+	if (copy_from_user(&param, arg, sizeof(param))) {
+		result = -EFAULT;
+		goto done;
+	}
+
+	if (param.drawctxt_id >= KGSL_CONTEXT_MAX
+		|| (private->ctxt_id_mask & 1 << param.drawctxt_id) == 0) {
+		KGSL_DRV_ERR("invalid drawctxt drawctxt_id %d\n",
+			      param.drawctxt_id);
+		result = -EINVAL;
+		goto done;
+	}
+
+	if (param.numibs == 0 || param.numibs > KGSL_MAX_IBS) {
+		KGSL_DRV_ERR("invalid numibs %u\n", param.numibs);
+		result = -EINVAL;
+		goto done;
+	}
+
+	ibs = kmalloc(param.numibs * sizeof(*ibs), GFP_KERNEL);
+	if (ibs == NULL) {
+		result = -ENOMEM;
+		goto done;
+	}
+
+	if (copy_from_user(ibs, param.ibs, param.numibs * sizeof(*ibs))) {
+		result = -EFAULT;
+		goto done;
+	}
+
+	for (i = 0; i < param.numibs; i++) {
+		if (ibs[i].sizedwords == 0 ||
+		    kgsl_sharedmem_find_region(private, ibs[i].gpuaddr,
+				ibs[i].sizedwords*sizeof(uint32_t)) == NULL) {
+			KGSL_DRV_ERR("invalid cmd buffer ibaddr %08x "
+				     "sizedwords %d\n", ibs[i].gpuaddr,
+				     ibs[i].sizedwords);
+			result = -EINVAL;
+			goto done;
+		}
+	}
+
 	result = kgsl_ringbuffer_issueibcmds(&kgsl_driver.yamato_device,
 					     param.drawctxt_id,
-					     param.ibaddr,
-					     param.sizedwords,
+					     ibs, param.numibs,
 					     &param.timestamp,
 					     param.flags);
 	if (result != 0)
@@ -490,6 +625,7 @@ static long kgsl_ioctl_rb_issueibcmds(struct kgsl_file_private *private,
 		goto done;
 	}
 done:
+	kfree(ibs);
 	return result;
 }
 
@@ -537,7 +673,8 @@ static long kgsl_ioctl_cmdstream_freememontimestamp(struct kgsl_file_private
 		goto done;
 	}
 
-	if (entry->memdesc.priv & KGSL_MEMFLAGS_VMALLOC_MEM)
+	if (entry->memdesc.priv &
+	    (KGSL_MEMFLAGS_VMALLOC_MEM | KGSL_MEMFLAGS_PAGE_MEM))
 		entry->memdesc.priv &= ~KGSL_MEMFLAGS_MEM_REQUIRES_FLUSH;
 
 	result = kgsl_cmdstream_freememontimestamp(&kgsl_driver.yamato_device,
@@ -614,12 +751,15 @@ void kgsl_remove_mem_entry(struct kgsl_mem_entry *entry)
 	if (KGSL_MEMFLAGS_VMALLOC_MEM & entry->memdesc.priv) {
 		vfree((void *)entry->memdesc.physaddr);
 		entry->priv->vmalloc_size -= entry->memdesc.size;
+	} else if (KGSL_MEMFLAGS_PAGE_MEM & entry->memdesc.priv) {
+		kgsl_page_free(&entry->priv->page_pool, entry->pages,
+			       entry->memdesc.size >> PAGE_SHIFT);
+		entry->priv->page_size -= entry->memdesc.size;
 	} else
 		kgsl_put_phys_file(entry->pmem_file);
 	list_del(&entry->list);
 
-	if (entry->free_list.prev)
-		list_del(&entry->free_list);
+	list_del(&entry->free_event.list);
 
 	kfree(entry);
 
@@ -694,7 +834,8 @@ static int kgsl_ioctl_sharedmem_from_vmalloc(struct kgsl_file_private *private,
 		goto error;
 	}
 
-	if ((private->vmalloc_size + len) > KGSL_GRAPHICS_MEMORY_LOW_WATERMARK
+	if ((private->vmalloc_size + private->page_size + len) >
+	    KGSL_GRAPHICS_MEMORY_LOW_WATERMARK
 	    && !param.force_no_low_watermark) {
 		result = -ENOMEM;
 		goto error;
@@ -705,6 +846,7 @@ static int kgsl_ioctl_sharedmem_from_vmalloc(struct kgsl_file_private *private,
 		result = -ENOMEM;
 		goto error;
 	}
+	INIT_LIST_HEAD(&entry->free_event.list);
 
 	/* allocate memory and map it to user space */
 	vmalloc_area = vmalloc_user(len);
@@ -767,6 +909,93 @@ error_free_vmalloc:
 error_free_entry:
 	kfree(entry);
 
+error:
+	return result;
+}
+
+static int kgsl_ioctl_sharedmem_alloc(struct kgsl_file_private *private,
+				      void __user *arg)
+{
+	int result = 0, len, numpages;
+	struct kgsl_sharedmem_alloc param;
+	struct kgsl_mem_entry *entry = NULL;
+	struct cache_maint cm;
+
+	if (copy_from_user(&param, arg, sizeof(param))) {
+		result = -EFAULT;
+		goto error;
+	}
+
+	if (param.size == 0 ||
+	    param.size > KGSL_GRAPHICS_MEMORY_LOW_WATERMARK * 2) {
+		KGSL_MEM_ERR("invalid size %u\n", param.size);
+		result = -EINVAL;
+		goto error;
+	}
+	len = PAGE_ALIGN(param.size);
+	numpages = len >> PAGE_SHIFT;
+
+	if ((private->vmalloc_size + private->page_size + len) >
+	    KGSL_GRAPHICS_MEMORY_LOW_WATERMARK
+	    && !param.force_no_low_watermark) {
+		result = -ENOMEM;
+		goto error;
+	}
+
+	entry = kzalloc(sizeof(struct kgsl_mem_entry), GFP_KERNEL);
+	if (entry == NULL) {
+		result = -ENOMEM;
+		goto error;
+	}
+	INIT_LIST_HEAD(&entry->free_event.list);
+
+	entry->pages = kgsl_page_alloc(&private->page_pool, numpages);
+	if (!entry->pages) {
+		result = -ENOMEM;
+		goto error_free_entry;
+	}
+
+	/* write back the zeroing before the GPU or an uncached mapping
+	 * looks at the pages */
+	entry->memdesc.size = len;
+	entry->memdesc.priv = KGSL_MEMFLAGS_PAGE_MEM;
+	cache_maint_begin(&cm, CACHE_MAINT_KGSL, CACHE_MAINT_FLUSH, len);
+	kgsl_cache_entry(&cm, entry, 0, len);
+	cache_maint_end(&cm);
+
+	result = kgsl_mmu_map_pages(private->pagetable, entry->pages,
+				    numpages, GSL_PT_PAGE_RV | GSL_PT_PAGE_WV,
+				    &entry->memdesc.gpuaddr,
+				    KGSL_MEMFLAGS_ALIGN4K);
+	if (result != 0)
+		goto error_free_pages;
+
+	entry->memdesc.pagetable = private->pagetable;
+	if (kgsl_cache_enable)
+		entry->memdesc.priv |= KGSL_MEMFLAGS_MEM_REQUIRES_FLUSH;
+	entry->priv = private;
+
+	param.gpuaddr = entry->memdesc.gpuaddr;
+
+	if (copy_to_user(arg, &param, sizeof(param))) {
+		result = -EFAULT;
+		goto error_unmap_entry;
+	}
+	private->page_size += len;
+	list_add(&entry->list, &private->mem_list);
+
+	return 0;
+
+error_unmap_entry:
+	kgsl_mmu_unmap(private->pagetable, entry->memdesc.gpuaddr,
+		       entry->memdesc.size);
+
+error_free_pages:
+	kgsl_page_free(&private->page_pool, entry->pages, numpages);
+
+error_free_entry:
+	kfree(entry);
+
 error:
 	return result;
 }
@@ -776,6 +1005,12 @@ static inline int kgsl_ioctl_sharedmem_from_vmalloc(
 {
 	return -ENOSYS;
 }
+
+static inline int kgsl_ioctl_sharedmem_alloc(
+			struct kgsl_file_private *private, void __user *arg)
+{
+	return -ENOSYS;
+}
 #endif
 
 static int kgsl_get_phys_file(int fd, unsigned long *start, unsigned long *len,
@@ -849,6 +1084,7 @@ static int kgsl_ioctl_sharedmem_from_pmem(struct kgsl_file_private *private,
 		result = -ENOMEM;
 		goto error_put_pmem;
 	}
+	INIT_LIST_HEAD(&entry->free_event.list);
 
 	entry->pmem_file = pmem_file;
 
@@ -916,19 +1152,89 @@ static int kgsl_ioctl_sharedmem_flush_cache(struct kgsl_file_private *private,
 		result = -EINVAL;
 		goto done;
 	}
-	result = flush_l1_cache_range((unsigned long)entry->memdesc.hostptr,
-				      entry->memdesc.size);
+	result = flush_l1_cache_entry(entry);
 	/* Mark memory as being flushed so we don't flush it again */
 	entry->memdesc.priv &= ~KGSL_MEMFLAGS_MEM_REQUIRES_FLUSH;
 done:
 	return result;
 }
+
+/* Clean and/or invalidate a list of ranges of one vmalloc or page
+ * allocation */
+static int kgsl_ioctl_sharedmem_cache_op(struct kgsl_file_private *private,
+					 void __user *arg)
+{
+	int result = 0;
+	struct kgsl_mem_entry *entry;
+	struct kgsl_sharedmem_cache_op param;
+	struct kgsl_cache_range *ranges = NULL;
+	struct cache_maint cm;
+	unsigned long bytes = 0;
+	unsigned int i, size;
+
+	if (copy_from_user(&param, arg, sizeof(param))) {
+		result = -EFAULT;
+		goto done;
+	}
+
+	if (!param.flags || (param.flags & ~KGSL_CACHE_FLUSH) ||
+	    param.nr_ranges > KGSL_CACHE_MAX_RANGES) {
+		result = -EINVAL;
+		goto done;
+	}
+
+	entry = kgsl_sharedmem_find(private, param.gpuaddr);
+	if (!entry || !(entry->memdesc.priv &
+			(KGSL_MEMFLAGS_VMALLOC_MEM | KGSL_MEMFLAGS_PAGE_MEM))) {
+		KGSL_DRV_ERR("invalid gpuaddr %08x\n", param.gpuaddr);
+		result = -EINVAL;
+		goto done;
+	}
+	if (!param.nr_ranges)
+		goto done;
+
+	ranges = kmalloc(param.nr_ranges * sizeof(*ranges), GFP_KERNEL);
+	if (!ranges) {
+		result = -ENOMEM;
+		goto done;
+	}
+	if (copy_from_user(ranges, (void __user *)param.ranges,
+			   param.nr_ranges * sizeof(*ranges))) {
+		result = -EFAULT;
+		goto done;
+	}
+
+	size = entry->memdesc.size;
+	for (i = 0; i < param.nr_ranges; i++) {
+		if (ranges[i].offset > size ||
+		    ranges[i].len > size - ranges[i].offset) {
+			result = -EINVAL;
+			goto done;
+		}
+		bytes += ranges[i].len;
+	}
+
+	cache_maint_begin(&cm, CACHE_MAINT_KGSL, param.flags, bytes);
+	for (i = 0; i < param.nr_ranges && !result; i++)
+		result = kgsl_cache_entry(&cm, entry, ranges[i].offset,
+					  ranges[i].len);
+	cache_maint_end(&cm);
+done:
+	kfree(ranges);
+	return result;
+}
 #else
 static int kgsl_ioctl_sharedmem_flush_cache(struct kgsl_file_private *private,
 					    void __user *arg)
 {
 	return -ENOSYS;
 }
+
+static int kgsl_ioctl_sharedmem_cache_op(struct kgsl_file_private *private,
+					 void __user *arg)
+{
+	return -ENOSYS;
+}
 #endif
 
 
@@ -968,6 +1274,12 @@ static long kgsl_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
 		result = kgsl_ioctl_rb_issueibcmds(private, (void __user *)arg);
 		break;
 
+	case IOCTL_KGSL_RINGBUFFER_ISSUEIBS:
+		if (kgsl_cache_enable)
+			flush_l1_cache_all(private);
+		result = kgsl_ioctl_rb_issueibs(private, (void __user *)arg);
+		break;
+
 	case IOCTL_KGSL_CMDSTREAM_READTIMESTAMP:
 		result =
 		    kgsl_ioctl_cmdstream_readtimestamp(private,
@@ -1000,11 +1312,22 @@ static long kgsl_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
 							   (void __user *)arg);
 		break;
 
+	case IOCTL_KGSL_SHAREDMEM_ALLOC:
+		kgsl_yamato_runpending(&kgsl_driver.yamato_device);
+		result = kgsl_ioctl_sharedmem_alloc(private,
+						    (void __user *)arg);
+		break;
+
 	case IOCTL_KGSL_SHAREDMEM_FLUSH_CACHE:
 		if (kgsl_cache_enable)
 			result = kgsl_ioctl_sharedmem_flush_cache(private,
 						       (void __user *)arg);
 		break;
+	case IOCTL_KGSL_SHAREDMEM_CACHE_OP:
+		if (kgsl_cache_enable)
+			result = kgsl_ioctl_sharedmem_cache_op(private,
+						       (void __user *)arg);
+		break;
 	case IOCTL_KGSL_SHAREDMEM_FROM_PMEM:
 		kgsl_yamato_runpending(&kgsl_driver.yamato_device);
 		result = kgsl_ioctl_sharedmem_from_pmem(private,
@@ -1042,6 +1365,57 @@ static long kgsl_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
 	return result;
 }
 
+/* The mapping of a page allocation is going away; the entry may still
+ * be around, or its gpuaddr may have been reused, so find it again.
+ */
+static void kgsl_vm_close(struct vm_area_struct *vma)
+{
+	struct kgsl_file_private *private = vma->vm_file->private_data;
+	struct kgsl_mem_entry *entry;
+
+	mutex_lock(&kgsl_driver.mutex);
+	entry = kgsl_sharedmem_find(private, vma->vm_pgoff << PAGE_SHIFT);
+	if (entry && entry->memdesc.hostptr == (void *)vma->vm_start)
+		entry->memdesc.hostptr = NULL;
+	mutex_unlock(&kgsl_driver.mutex);
+}
+
+static struct vm_operations_struct kgsl_vm_ops = {
+	.close = kgsl_vm_close,
+};
+
+/* Map a page allocation into the caller */
+static int kgsl_mmap_pages(struct kgsl_mem_entry *entry,
+			   struct vm_area_struct *vma)
+{
+	unsigned long vma_size = vma->vm_end - vma->vm_start;
+	unsigned long addr = vma->vm_start;
+	int i, result;
+
+	if (entry->memdesc.size != vma_size) {
+		KGSL_MEM_ERR("bad size %ld, should be %d\n",
+			vma_size, entry->memdesc.size);
+		return -EINVAL;
+	}
+
+	if (!kgsl_cache_enable)
+		vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+
+	for (i = 0; i < vma_size >> PAGE_SHIFT; i++, addr += PAGE_SIZE) {
+		result = vm_insert_page(vma, addr, entry->pages[i]);
+		if (result) {
+			KGSL_MEM_ERR("vm_insert_page returned %d\n", result);
+			return result;
+		}
+	}
+
+	/* informational, cleared when the mapping goes; cache
+	 * maintenance goes through entry->pages */
+	vma->vm_ops = &kgsl_vm_ops;
+	entry->memdesc.hostptr = (void *)vma->vm_start;
+	return 0;
+}
+
 static int kgsl_mmap(struct file *file, struct vm_area_struct *vma)
 {
 	int result;
@@ -1049,6 +1423,7 @@ static int kgsl_mmap(struct file *file, struct vm_area_struct *vma)
 	unsigned long vma_size = vma->vm_end - vma->vm_start;
 	unsigned long vma_offset = vma->vm_pgoff << PAGE_SHIFT;
 	struct kgsl_device *device = NULL;
+	struct kgsl_mem_entry *entry;
 
 	mutex_lock(&kgsl_driver.mutex);
 
@@ -1061,6 +1436,14 @@ static int kgsl_mmap(struct file *file, struct vm_area_struct *vma)
 			goto done;
 		}
 		memdesc = &device->memstore;
+	} else {
+		/* page allocations are mapped by their gpuaddr */
+		entry = kgsl_sharedmem_find(file->private_data, vma_offset);
+		if (entry && (entry->memdesc.priv & KGSL_MEMFLAGS_PAGE_MEM))
+			result = kgsl_mmap_pages(entry, vma);
+		else
+			result = -EINVAL;
+		goto done;
 	}
 
 	if (memdesc->size != vma_size) {
@@ -1156,6 +1539,7 @@ static int __devinit kgsl_platform_probe(struct platform_device *pdev)
 	kgsl_driver.pdev = pdev;
 
 	setup_timer(&kgsl_driver.standby_timer, kgsl_do_standby_timer, 0);
+	INIT_WORK(&kgsl_driver.event_work, kgsl_cmdstream_event_work);
 	wake_lock_init(&kgsl_driver.wake_lock, WAKE_LOCK_SUSPEND, "kgsl");
 
 	clk = clk_get(&pdev->dev, "grp_clk");
@@ -27,11 +27,15 @@
 #include <linux/wait.h>
 #include <linux/timer.h>
 #include <linux/wakelock.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
 
 #include <asm/atomic.h>
 
 #include "kgsl_device.h"
 #include "kgsl_sharedmem.h"
+#include "kgsl_cmdstream.h"
+#include "kgsl_pagealloc.h"
 
 #define DRIVER_NAME "kgsl"
 
@@ -62,18 +66,34 @@ struct kgsl_driver {
 	bool active;
 	int active_cnt;
 	struct timer_list standby_timer;
+	ktime_t standby_start;
 
 	struct wake_lock wake_lock;
+
+	/* runs the device's events when the GPU signals a timestamp */
+	struct work_struct event_work;
 };
 
 extern struct kgsl_driver kgsl_driver;
 
+struct kgsl_file_private {
+	struct list_head	list;
+	struct list_head	mem_list;
+	uint32_t		ctxt_id_mask;
+	struct kgsl_pagetable	*pagetable;
+	unsigned long		vmalloc_size;
+	unsigned long		page_size;
+	struct kgsl_page_pool	page_pool;
+	pid_t			pid;
+};
+
 struct kgsl_mem_entry {
 	struct kgsl_memdesc memdesc;
 	struct file *pmem_file;
 	struct list_head list;
-	struct list_head free_list;
-	uint32_t free_timestamp;
+	struct kgsl_event free_event;
+	/* KGSL_MEMFLAGS_PAGE_MEM: memdesc.size >> PAGE_SHIFT of them */
+	struct page **pages;
 
 	/* back pointer to private structure under whose context this
 	 * allocation is made */
@@ -20,6 +20,7 @@
 #include "kgsl_device.h"
 #include "kgsl_cmdstream.h"
 #include "kgsl_sharedmem.h"
+#include "kgsl_pm4types.h"
 
 int kgsl_cmdstream_init(struct kgsl_device *device)
 {
@@ -67,28 +68,113 @@ int kgsl_cmdstream_check_timestamp(struct kgsl_device *device,
 	return timestamp_cmp(ts_processed, timestamp);
 }
 
-void kgsl_cmdstream_memqueue_drain(struct kgsl_device *device)
+/* Make sure the CP interrupts once the oldest pending event's timestamp
+ * retires, running whatever has retired already.  The CP checks the
+ * memstore after writing each timestamp (see kgsl_ringbuffer_addcmds()),
+ * but may have passed that point for the last submission before we get
+ * here; if so, submit a NOP so there is another check to come.
+ */
+static void kgsl_cmdstream_arm(struct kgsl_device *device)
 {
-	struct kgsl_mem_entry *entry, *entry_tmp;
-	uint32_t ts_processed;
+	struct kgsl_memstore *memstore = device->memstore.hostptr;
 	struct kgsl_ringbuffer *rb = &device->ringbuffer;
+	struct kgsl_event *event;
+	unsigned int cmds[2];
+	uint32_t ts_retired;
+
+	for (;;) {
+		ts_retired = kgsl_cmdstream_readtimestamp(device,
+						KGSL_TIMESTAMP_RETIRED);
+		while (!list_empty(&device->events)) {
+			event = list_first_entry(&device->events,
+						 struct kgsl_event, list);
+			if (!timestamp_cmp(ts_retired, event->timestamp))
+				break;
+			list_del_init(&event->list);
+			GSL_RB_STATS(rb->stats.events++);
+			event->func(device, event->priv, event->timestamp);
+		}
+
+		if (list_empty(&device->events)) {
+			memstore->ts_cmp_enable = 0;
+			return;
+		}
+
+		event = list_first_entry(&device->events, struct kgsl_event,
+					 list);
+		memstore->ref_wait_ts = event->timestamp;
+		wmb();
+		memstore->ts_cmp_enable = 1;
+		mb();
+
+		/* did it retire while we were arming? */
+		if (!kgsl_cmdstream_check_timestamp(device, event->timestamp))
+			break;
+	}
+
+	/* registers are only accessible with the clocks on; events are
+	 * added with them on, and runpending catches the rest */
+	if (!kgsl_driver.active || !(rb->flags & KGSL_FLAGS_STARTED))
+		return;
+	if (kgsl_cmdstream_readtimestamp(device, KGSL_TIMESTAMP_CONSUMED) !=
+	    rb->timestamp)
+		return;
+
+	cmds[0] = pm4_nop_packet(1);
+	cmds[1] = 0;
+	kgsl_ringbuffer_issuecmds(device, 0, cmds, 2);
+	GSL_RB_STATS(rb->stats.kicks++);
+}
+
+/* Call with the driver mutex held.  func may run before this returns. */
+void kgsl_cmdstream_add_event(struct kgsl_device *device,
+			      struct kgsl_event *event, uint32_t timestamp)
+{
+	struct kgsl_event *pos;
 
-	/* get current EOP timestamp */
-	ts_processed =
-	    kgsl_cmdstream_readtimestamp(device, KGSL_TIMESTAMP_RETIRED);
+	event->timestamp = timestamp;
 
-	list_for_each_entry_safe(entry, entry_tmp, &rb->memqueue, free_list) {
-		/*NOTE: this assumes that the free list is sorted by
-		 * timestamp, but I'm not yet sure that it is a valid
-		 * assumption
-		 */
-		if (!timestamp_cmp(ts_processed, entry->free_timestamp))
+	/* timestamps mostly arrive in order, so search from the end */
+	list_for_each_entry_reverse(pos, &device->events, list)
+		if (timestamp_cmp(timestamp, pos->timestamp))
 			break;
-		KGSL_MEM_DBG("ts_processed %d ts_free %d gpuaddr %x)\n",
-			     ts_processed, entry->free_timestamp,
-			     entry->memdesc.gpuaddr);
-		kgsl_remove_mem_entry(entry);
-	}
+	list_add(&event->list, &pos->list);
+
+	kgsl_cmdstream_arm(device);
+}
+
+/* Call with the driver mutex held, for an event that has not run */
+void kgsl_cmdstream_del_event(struct kgsl_device *device,
+			      struct kgsl_event *event)
+{
+	list_del_init(&event->list);
+	kgsl_cmdstream_arm(device);
+}
+
+/* Run the events whose timestamps have retired; call with the driver
+ * mutex held. */
+void kgsl_cmdstream_process_events(struct kgsl_device *device)
+{
+	if (device->flags & KGSL_FLAGS_INITIALIZED)
+		kgsl_cmdstream_arm(device);
+}
+
+/* bottom half of the timestamp interrupt */
+void kgsl_cmdstream_event_work(struct work_struct *work)
+{
+	mutex_lock(&kgsl_driver.mutex);
+	kgsl_cmdstream_process_events(&kgsl_driver.yamato_device);
+	mutex_unlock(&kgsl_driver.mutex);
+}
+
+static void kgsl_cmdstream_free_entry(struct kgsl_device *device, void *priv,
+				      uint32_t timestamp)
+{
+	struct kgsl_mem_entry *entry = priv;
+
+	KGSL_MEM_DBG("ts_free %d gpuaddr %x)\n", timestamp,
+		     entry->memdesc.gpuaddr);
+	kgsl_remove_mem_entry(entry);
 }
 
 int
@@ -97,13 +183,17 @@ kgsl_cmdstream_freememontimestamp(struct kgsl_device *device,
 				  uint32_t timestamp,
 				  enum kgsl_timestamp_type type)
 {
-	struct kgsl_ringbuffer *rb = &device->ringbuffer;
 	KGSL_MEM_DBG("enter (dev %p gpuaddr %x ts %d)\n",
 		     device, entry->memdesc.gpuaddr, timestamp);
 	(void)type;		/* unref. For now just use EOP timestamp */
 
-	list_add_tail(&entry->free_list, &rb->memqueue);
-	entry->free_timestamp = timestamp;
+	/* already waiting to be freed */
+	if (!list_empty(&entry->free_event.list))
+		return -EINVAL;
+
+	entry->free_event.func = kgsl_cmdstream_free_entry;
+	entry->free_event.priv = entry;
+	kgsl_cmdstream_add_event(device, &entry->free_event, timestamp);
 
 	return 0;
 }
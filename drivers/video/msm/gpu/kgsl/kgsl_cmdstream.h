@@ -1,6 +1,8 @@
 #ifndef __KGSL_CMDSTREAM_H
 #define __KGSL_CMDSTREAM_H
 
+#include <linux/list.h>
+#include <linux/workqueue.h>
 #include <linux/msm_kgsl.h>
 #include "kgsl_device.h"
 #include "kgsl_log.h"
@@ -22,11 +24,33 @@
 		kgsl_sharedmem_read(&device->memstore, (data),	\
 				KGSL_DEVICE_MEMSTORE_OFFSET(eoptimestamp), 4)
 
+struct kgsl_mem_entry;
+
+/* something to do once the GPU has retired a timestamp.  Events are kept
+ * on the device in timestamp order and run, with the driver mutex held,
+ * from the work queued by the timestamp interrupt.
+ */
+struct kgsl_event {
+	uint32_t timestamp;
+	void (*func)(struct kgsl_device *device, void *priv,
+		     uint32_t timestamp);
+	void *priv;
+	struct list_head list;
+};
+
 int kgsl_cmdstream_init(struct kgsl_device *device);
 
 int kgsl_cmdstream_close(struct kgsl_device *device);
 
-void kgsl_cmdstream_memqueue_drain(struct kgsl_device *device);
+void kgsl_cmdstream_add_event(struct kgsl_device *device,
+			      struct kgsl_event *event, uint32_t timestamp);
+
+void kgsl_cmdstream_del_event(struct kgsl_device *device,
+			      struct kgsl_event *event);
+
+void kgsl_cmdstream_process_events(struct kgsl_device *device);
+
+void kgsl_cmdstream_event_work(struct work_struct *work);
 
 uint32_t
 kgsl_cmdstream_readtimestamp(struct kgsl_device *device,
@@ -24,6 +24,7 @@
 #include <linux/types.h>
 #include <linux/irqreturn.h>
 #include <linux/wait.h>
+#include <linux/list.h>
 #include <linux/msm_kgsl.h>
 
 #include "kgsl_drawctxt.h"
@@ -46,6 +47,7 @@
 /* Private memory flags for use with memdesc->priv feild */
 #define KGSL_MEMFLAGS_MEM_REQUIRES_FLUSH    0x00000001
 #define KGSL_MEMFLAGS_VMALLOC_MEM           0x00000002
+#define KGSL_MEMFLAGS_PAGE_MEM              0x00000004
 
 #define KGSL_GRAPHICS_MEMORY_LOW_WATERMARK  0x1000000
 #define KGSL_IS_PAGE_ALIGNED(addr) (!((addr) & (~PAGE_MASK)))
@@ -61,6 +63,20 @@ struct kgsl_memregion {
 	unsigned int   sizebytes;
 };
 
+/* The memstore as the driver lays it out: what user space maps and
+ * knows the size of, then the words the CP compares before raising the
+ * timestamp interrupt (see kgsl_cmdstream_arm()).
+ */
+struct kgsl_memstore {
+	struct kgsl_devmemstore user;
+	volatile unsigned int ts_cmp_enable;
+	unsigned int sbz3;
+	volatile unsigned int ref_wait_ts;
+	unsigned int sbz4;
+};
+
+#define KGSL_MEMSTORE_OFFSET(field) offsetof(struct kgsl_memstore, field)
+
 struct kgsl_device {
 
 	unsigned int	  refcnt;
@@ -78,6 +94,9 @@ struct kgsl_device {
 	struct kgsl_drawctxt drawctxt[KGSL_CONTEXT_MAX];
 
 	wait_queue_head_t ib1_wq;
+
+	/* struct kgsl_event, oldest timestamp first */
+	struct list_head events;
 };
 
 struct kgsl_devconfig {
@@ -17,6 +17,8 @@
  * along with this program; if not, you can find it at http://www.fsf.org
  */
 #include <linux/debugfs.h>
+#include <linux/math64.h>
+#include <linux/slab.h>
 #include "kgsl_log.h"
 #include "kgsl_ringbuffer.h"
 #include "kgsl_device.h"
@@ -237,6 +239,114 @@ static struct file_operations kgsl_mmu_regs_fops = {
 };
 #endif /*DEBUG*/
 
+/* GPU memory held by each open of the device */
+static ssize_t mem_read(struct file *file, char __user *buf, size_t count,
+			loff_t *ppos)
+{
+	const int debug_bufmax = 4096;
+	struct kgsl_file_private *private;
+	struct kgsl_mem_entry *entry;
+	unsigned long pmem, pool_total = 0, page_total = 0;
+	char *buffer;
+	int n = 0;
+	ssize_t ret;
+
+	buffer = kmalloc(debug_bufmax, GFP_KERNEL);
+	if (!buffer)
+		return -ENOMEM;
+
+	n += scnprintf(buffer + n, debug_bufmax - n,
+			"%6s %10s %10s %10s %10s\n", "pid", "pmem_kb",
+			"vmalloc_kb", "pages_kb", "pool_kb");
+
+	mutex_lock(&kgsl_driver.mutex);
+	list_for_each_entry(private, &kgsl_driver.client_list, list) {
+		pmem = 0;
+		list_for_each_entry(entry, &private->mem_list, list)
+			if (!(entry->memdesc.priv & (KGSL_MEMFLAGS_VMALLOC_MEM |
+						     KGSL_MEMFLAGS_PAGE_MEM)))
+				pmem += entry->memdesc.size;
+		n += scnprintf(buffer + n, debug_bufmax - n,
+				"%6d %10lu %10lu %10lu %10lu\n",
+				private->pid, pmem >> 10,
+				private->vmalloc_size >> 10,
+				private->page_size >> 10,
+				(unsigned long)private->page_pool.count <<
+				(PAGE_SHIFT - 10));
+		page_total += private->page_size;
+		pool_total += private->page_pool.count;
+	}
+	mutex_unlock(&kgsl_driver.mutex);
+
+	n += scnprintf(buffer + n, debug_bufmax - n,
+			"total pages_kb %lu pool_kb %lu\n", page_total >> 10,
+			pool_total << (PAGE_SHIFT - 10));
+
+	ret = simple_read_from_buffer(buf, count, ppos, buffer, n);
+	kfree(buffer);
+	return ret;
+}
+
+static struct file_operations kgsl_mem_fops = {
+	.read = mem_read,
+};
+
+#ifdef GSL_STATS_RINGBUFFER
+static ssize_t rb_stats_read(struct file *file, char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	const int debug_bufmax = 1024;
+	static char buffer[1024];
+	struct kgsl_rbstats stats;
+	int n = 0;
+
+	mutex_lock(&kgsl_driver.mutex);
+	stats = kgsl_driver.yamato_device.ringbuffer.stats;
+	mutex_unlock(&kgsl_driver.mutex);
+
+	n += scnprintf(buffer + n, debug_bufmax - n,
+			"issues %lld words %lld ibs %lld starved %lld\n",
+			stats.issues, stats.words_total, stats.ibs_total,
+			stats.starved);
+	n += scnprintf(buffer + n, debug_bufmax - n,
+			"space_waits %lld avg_ns %llu max_ns %lld\n",
+			stats.waits,
+			stats.waits ? div64_u64(stats.wait_ns, stats.waits) : 0,
+			stats.wait_max_ns);
+	n += scnprintf(buffer + n, debug_bufmax - n,
+			"ts_waits %lld avg_ns %llu max_ns %lld\n",
+			stats.ts_waits,
+			stats.ts_waits ?
+				div64_u64(stats.ts_wait_ns,
+					  stats.ts_waits) : 0,
+			stats.ts_wait_max_ns);
+	n += scnprintf(buffer + n, debug_bufmax - n,
+			"irqs %lld kicks %lld events %lld\n",
+			stats.irqs, stats.kicks, stats.events);
+	n += scnprintf(buffer + n, debug_bufmax - n,
+			"standby %lld standby_ms %llu\n",
+			stats.standby_count,
+			div_u64(stats.standby_ns, NSEC_PER_MSEC));
+
+	return simple_read_from_buffer(buf, count, ppos, buffer, n);
+}
+
+static ssize_t rb_stats_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	mutex_lock(&kgsl_driver.mutex);
+	memset(&kgsl_driver.yamato_device.ringbuffer.stats, 0,
+	       sizeof(struct kgsl_rbstats));
+	mutex_unlock(&kgsl_driver.mutex);
+	return count;
+}
+
+static struct file_operations kgsl_rb_stats_fops = {
+	.read = rb_stats_read,
+	.write = rb_stats_write,
+};
+#endif /* GSL_STATS_RINGBUFFER */
+
 #ifdef CONFIG_MSM_KGSL_MMU
 static int kgsl_cache_enable_set(void *data, u64 val)
 {
@@ -282,7 +392,16 @@ int kgsl_debug_init(void)
 				&kgsl_mmu_regs_fops);
 #endif
 
+#ifdef GSL_STATS_RINGBUFFER
+	debugfs_create_file("rb_stats", 0644, dent, 0,
+				&kgsl_rb_stats_fops);
+#endif
+	debugfs_create_file("mem", 0444, dent, 0, &kgsl_mem_fops);
 #ifdef CONFIG_MSM_KGSL_MMU
+	debugfs_create_u32("page_max_order", 0644, dent,
+			   &kgsl_page_max_order);
+	debugfs_create_u32("page_pool_max", 0644, dent,
+			   &kgsl_page_pool_max);
 	debugfs_create_file("cache_enable", 0644, dent, 0,
 			    &kgsl_cache_enable_fops);
 #endif
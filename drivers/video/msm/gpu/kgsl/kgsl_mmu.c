@@ -19,6 +19,7 @@
 #include <linux/types.h>
 #include <linux/spinlock.h>
 #include <linux/genalloc.h>
+#include <linux/mm.h>
 
 #include <asm/pgalloc.h>
 #include <asm/pgtable.h>
@@ -427,8 +428,12 @@ pte_t *kgsl_get_pte_from_vaddr(unsigned int vaddr)
 	return pte_ptr;
 }
 
-int kgsl_mmu_map(struct kgsl_pagetable *pagetable,
+/* Map either range bytes starting at address (physical if flags has
+ * KGSL_MEMFLAGS_CONPHYS, else vmalloc), or the pages in pages[].
+ */
+static int kgsl_mmu_map_common(struct kgsl_pagetable *pagetable,
 				unsigned int address,
+				struct page **pages,
 				int range,
 				unsigned int protflags,
 				unsigned int *gpuaddr,
@@ -515,7 +520,9 @@ int kgsl_mmu_map(struct kgsl_pagetable *pagetable,
 		if (kgsl_pt_map_isdirty(pagetable, pte))
 			flushtlb = 1;
 		/* mark pte as in use */
-		if (phys_contiguous)
+		if (pages)
+			physaddr = page_to_phys(pages[pte - ptefirst]);
+		else if (phys_contiguous)
 			physaddr = address;
 		else {
 			physaddr = vmalloc_to_pfn((void *)address);
@@ -562,6 +569,30 @@ int kgsl_mmu_map(struct kgsl_pagetable *pagetable,
 	return 0;
 }
 
+int kgsl_mmu_map(struct kgsl_pagetable *pagetable,
+				unsigned int address,
+				int range,
+				unsigned int protflags,
+				unsigned int *gpuaddr,
+				unsigned int flags)
+{
+	return kgsl_mmu_map_common(pagetable, address, NULL, range,
+				   protflags, gpuaddr, flags);
+}
+
+int kgsl_mmu_map_pages(struct kgsl_pagetable *pagetable,
+		       struct page **pages,
+		       int numpages,
+		       unsigned int protflags,
+		       unsigned int *gpuaddr,
+		       unsigned int flags)
+{
+	return kgsl_mmu_map_common(pagetable, 0, pages,
+				   numpages << KGSL_PAGESIZE_SHIFT,
+				   protflags, gpuaddr,
+				   flags & ~KGSL_MEMFLAGS_CONPHYS);
+}
+
 int
 kgsl_mmu_unmap(struct kgsl_pagetable *pagetable, unsigned int gpuaddr,
 		int range)
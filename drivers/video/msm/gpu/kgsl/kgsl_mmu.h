@@ -31,6 +31,7 @@
 extern unsigned int kgsl_cache_enable;
 
 struct kgsl_device;
+struct page;
 
 struct kgsl_mmu_debug {
 	unsigned int  config;
@@ -107,6 +108,13 @@ int kgsl_mmu_map(struct kgsl_pagetable *pagetable,
 		 unsigned int *gpuaddr,
 		 unsigned int flags);
 
+int kgsl_mmu_map_pages(struct kgsl_pagetable *pagetable,
+		       struct page **pages,
+		       int numpages,
+		       unsigned int protflags,
+		       unsigned int *gpuaddr,
+		       unsigned int flags);
+
 int kgsl_mmu_unmap(struct kgsl_pagetable *pagetable,
 					unsigned int gpuaddr, int range);
 
@@ -123,6 +131,16 @@ static inline int kgsl_mmu_map(struct kgsl_pagetable *pagetable,
 	return 0;
 }
 
+static inline int kgsl_mmu_map_pages(struct kgsl_pagetable *pagetable,
+				     struct page **pages,
+				     int numpages,
+				     unsigned int protflags,
+				     unsigned int *gpuaddr,
+				     unsigned int flags)
+{
+	return -ENOSYS;
+}
+
 static inline int kgsl_mmu_unmap(struct kgsl_pagetable *pagetable,
 				 unsigned int gpuaddr, int range) { return 0; }
 
@@ -0,0 +1,144 @@
+/* drivers/video/msm/gpu/kgsl/kgsl_pagealloc.c
+ *
+ * GPU memory backed by pages from the page allocator.
+ *
+ * The GPU sees these through its MMU, so they need not be contiguous;
+ * nothing is taken from the pmem carveout and no vmalloc space is used.
+ * Runs of up to 1 << kgsl_page_max_order pages are tried first, without
+ * retrying or warning, since they cost less to allocate and are kinder
+ * to the TLBs; when memory is fragmented the order drops until single
+ * pages are taken.  The runs are split, so each page is freed on its own.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/highmem.h>
+#include <asm/sizes.h>
+
+#include "kgsl_pagealloc.h"
+#include "kgsl_log.h"
+
+unsigned int kgsl_page_max_order = 4;
+unsigned int kgsl_page_pool_max = SZ_4M >> PAGE_SHIFT;
+
+static struct page **kgsl_page_array_alloc(int numpages)
+{
+	size_t size = numpages * sizeof(struct page *);
+
+	if (size <= PAGE_SIZE)
+		return kmalloc(size, GFP_KERNEL);
+	return vmalloc(size);
+}
+
+static void kgsl_page_array_free(struct page **pages, int numpages)
+{
+	if (numpages * sizeof(struct page *) <= PAGE_SIZE)
+		kfree(pages);
+	else
+		vfree(pages);
+}
+
+/* Pages still mapped into user space are not pooled, so they cannot turn
+ * up in a second allocation.
+ */
+static void kgsl_page_put(struct kgsl_page_pool *pool, struct page *page)
+{
+	if (page_count(page) == 1 && pool->count < kgsl_page_pool_max) {
+		list_add(&page->lru, &pool->pages);
+		pool->count++;
+	} else
+		__free_page(page);
+}
+
+void kgsl_page_pool_init(struct kgsl_page_pool *pool)
+{
+	INIT_LIST_HEAD(&pool->pages);
+	pool->count = 0;
+}
+
+void kgsl_page_pool_drain(struct kgsl_page_pool *pool)
+{
+	struct page *page, *tmp;
+
+	list_for_each_entry_safe(page, tmp, &pool->pages, lru) {
+		list_del(&page->lru);
+		__free_page(page);
+	}
+	pool->count = 0;
+}
+
+/* Returns an array of numpages zeroed pages, taken from the pool first */
+struct page **kgsl_page_alloc(struct kgsl_page_pool *pool, int numpages)
+{
+	struct page **pages;
+	struct page *page;
+	unsigned int order = kgsl_page_max_order;
+	gfp_t gfp;
+	int i = 0, j;
+
+	pages = kgsl_page_array_alloc(numpages);
+	if (!pages)
+		return NULL;
+
+	while (i < numpages && pool->count) {
+		page = list_first_entry(&pool->pages, struct page, lru);
+		list_del(&page->lru);
+		pool->count--;
+		clear_highpage(page);
+		pages[i++] = page;
+	}
+
+	while (i < numpages) {
+		while (order && (1 << order) > numpages - i)
+			order--;
+
+		gfp = GFP_KERNEL | __GFP_ZERO;
+		if (order)
+			gfp |= __GFP_NORETRY | __GFP_NOWARN;
+
+		page = alloc_pages(gfp, order);
+		if (!page) {
+			if (order) {
+				order--;
+				continue;
+			}
+			KGSL_MEM_ERR("out of pages, %d of %d allocated\n",
+				     i, numpages);
+			while (i)
+				kgsl_page_put(pool, pages[--i]);
+			kgsl_page_array_free(pages, numpages);
+			return NULL;
+		}
+
+		if (order)
+			split_page(page, order);
+		for (j = 0; j < (1 << order); j++)
+			pages[i++] = page + j;
+	}
+
+	return pages;
+}
+
+/* Give the pages back to the pool, or to the system once the pool is
+ * full, and free the array.
+ */
+void kgsl_page_free(struct kgsl_page_pool *pool, struct page **pages,
+		    int numpages)
+{
+	int i;
+
+	for (i = 0; i < numpages; i++)
+		kgsl_page_put(pool, pages[i]);
+
+	kgsl_page_array_free(pages, numpages);
+}
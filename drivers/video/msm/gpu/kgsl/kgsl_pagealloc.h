@@ -0,0 +1,44 @@
+/* drivers/video/msm/gpu/kgsl/kgsl_pagealloc.h
+ *
+ * GPU memory backed by pages from the page allocator.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ */
+#ifndef __KGSL_PAGEALLOC_H
+#define __KGSL_PAGEALLOC_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+
+struct page;
+
+/* Pages freed through one open of the device, kept for its next
+ * allocation.  The file can be shared with other processes, so they
+ * are zeroed again when handed out.  Protected by the driver mutex.
+ */
+struct kgsl_page_pool {
+	struct list_head pages;
+	unsigned int count;
+};
+
+/* largest allocation order tried, and pages kept per pool */
+extern unsigned int kgsl_page_max_order;
+extern unsigned int kgsl_page_pool_max;
+
+void kgsl_page_pool_init(struct kgsl_page_pool *pool);
+
+void kgsl_page_pool_drain(struct kgsl_page_pool *pool);
+
+struct page **kgsl_page_alloc(struct kgsl_page_pool *pool, int numpages);
+
+void kgsl_page_free(struct kgsl_page_pool *pool, struct page **pages,
+		    int numpages);
+
+#endif /* __KGSL_PAGEALLOC_H */
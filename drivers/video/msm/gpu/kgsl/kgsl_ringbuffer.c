@@ -20,6 +20,9 @@
 #include <linux/io.h>
 #include <linux/sched.h>
 #include <linux/wait.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
 
 #include "kgsl.h"
 #include "kgsl_device.h"
@@ -78,6 +81,7 @@ void kgsl_cp_intrcallback(struct kgsl_device *device)
 		/*this is the only used soft interrupt */
 		KGSL_CMD_WARN("ringbuffer ib1 interrupt\n");
 		wake_up_interruptible_all(&device->ib1_wq);
+		schedule_work(&kgsl_driver.event_work);
 	}
 	if (status & CP_INT_CNTL__T0_PACKET_IN_IB_MASK) {
 		KGSL_CMD_FATAL("ringbuffer TO packet in IB interrupt\n");
@@ -107,8 +111,12 @@ void kgsl_cp_intrcallback(struct kgsl_device *device)
 	if (status & CP_INT_CNTL__SW_INT_MASK)
 		KGSL_CMD_DBG("ringbuffer software interrupt\n");
 
-	if (status & CP_INT_CNTL__RB_INT_MASK)
+	if (status & CP_INT_CNTL__RB_INT_MASK) {
+		/* a timestamp someone is waiting for has retired */
 		KGSL_CMD_DBG("ringbuffer rb interrupt\n");
+		GSL_RB_STATS(rb->stats.irqs++);
+		schedule_work(&kgsl_driver.event_work);
+	}
 
 	if (status & CP_INT_CNTL__IB2_INT_MASK)
 		KGSL_CMD_DBG("ringbuffer ib2 interrupt\n");
@@ -194,6 +202,8 @@ kgsl_ringbuffer_waitspace(struct kgsl_ringbuffer *rb, unsigned int numcmds,
 	int nopcount;
 	unsigned int freecmds;
 	unsigned int *cmds;
+	ktime_t start;
+	int64_t ns;
 
 	KGSL_CMD_VDBG("enter (rb=%p, numcmds=%d, wptr_ahead=%d)\n",
 		      rb, numcmds, wptr_ahead);
@@ -213,6 +223,7 @@ kgsl_ringbuffer_waitspace(struct kgsl_ringbuffer *rb, unsigned int numcmds,
 	}
 
 	/* wait for space in ringbuffer */
+	start = ktime_get();
 	do {
 		GSL_RB_GET_READPTR(rb, &rb->rptr);
 
@@ -220,6 +231,14 @@ kgsl_ringbuffer_waitspace(struct kgsl_ringbuffer *rb, unsigned int numcmds,
 
 	} while ((freecmds != 0) && (freecmds < numcmds));
 
+#ifdef GSL_STATS_RINGBUFFER
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	rb->stats.waits++;
+	rb->stats.wait_ns += ns;
+	if (ns > rb->stats.wait_max_ns)
+		rb->stats.wait_max_ns = ns;
+#endif
+
 	KGSL_CMD_VDBG("return %d\n", 0);
 
 	return 0;
@@ -413,8 +432,6 @@ static int kgsl_ringbuffer_start(struct kgsl_ringbuffer *rb)
 	rb->timestamp = 0;
 	GSL_RB_INIT_TIMESTAMP(rb);
 
-	INIT_LIST_HEAD(&rb->memqueue);
-
 	/* clear ME_HALT to start micro engine */
 	kgsl_yamato_regwrite(device, REG_CP_ME_CNTL, 0);
 
@@ -563,7 +580,7 @@ int kgsl_ringbuffer_close(struct kgsl_ringbuffer *rb)
 {
 	KGSL_CMD_VDBG("enter (rb=%p)\n", rb);
 
-	kgsl_cmdstream_memqueue_drain(rb->device);
+	kgsl_cmdstream_process_events(rb->device);
 
 	kgsl_ringbuffer_stop(rb);
 
@@ -599,7 +616,7 @@ kgsl_ringbuffer_addcmds(struct kgsl_ringbuffer *rb,
 	pmodesizedwords = pmodeoff ? 8 : 0;
 
 	ringcmds = kgsl_ringbuffer_allocspace(rb,
-					pmodesizedwords + sizedwords + 6);
+					pmodesizedwords + sizedwords + 13);
 
 	if (pmodeoff) {
 		/* disable protected mode error checking */
@@ -622,6 +639,11 @@ kgsl_ringbuffer_addcmds(struct kgsl_ringbuffer *rb,
 		*ringcmds++ = GSL_RB_PROTECTED_MODE_CONTROL;
 	}
 
+#ifdef GSL_STATS_RINGBUFFER
+	if (kgsl_cmdstream_check_timestamp(rb->device, rb->timestamp))
+		rb->stats.starved++;
+#endif
+
 	rb->timestamp++;
 	timestamp = rb->timestamp;
 
@@ -635,6 +657,19 @@ kgsl_ringbuffer_addcmds(struct kgsl_ringbuffer *rb,
 		      KGSL_DEVICE_MEMSTORE_OFFSET(eoptimestamp));
 	*ringcmds++ = rb->timestamp;
 
+	/* interrupt only if there is an event waiting for this timestamp,
+	 * see kgsl_cmdstream_arm() */
+	*ringcmds++ = pm4_type3_packet(PM4_COND_EXEC, 4);
+	*ringcmds++ = (rb->device->memstore.gpuaddr +
+		       KGSL_MEMSTORE_OFFSET(ts_cmp_enable)) >> 2;
+	*ringcmds++ = (rb->device->memstore.gpuaddr +
+		       KGSL_MEMSTORE_OFFSET(ref_wait_ts)) >> 2;
+	*ringcmds++ = rb->timestamp;
+	/* number of conditional dwords */
+	*ringcmds++ = 2;
+	*ringcmds++ = pm4_type3_packet(PM4_INTERRUPT, 1);
+	*ringcmds++ = CP_INT_CNTL__RB_INT_MASK;
+
 	kgsl_ringbuffer_submit(rb);
 
 	GSL_RB_STATS(rb->stats.words_total += sizedwords);
@@ -667,38 +702,45 @@ kgsl_ringbuffer_issuecmds(struct kgsl_device *device,
 int
 kgsl_ringbuffer_issueibcmds(struct kgsl_device *device,
 				int drawctxt_index,
-				uint32_t ibaddr,
-				int sizedwords,
+				const struct kgsl_ibdesc *ibs,
+				int numibs,
 				uint32_t *timestamp,
 				unsigned int flags)
 {
-	unsigned int link[3];
+	unsigned int *link = device->ringbuffer.ib_link;
+	unsigned int *cmds = link;
+	int i;
 
-	KGSL_CMD_VDBG("enter (device_id=%d, drawctxt_index=%d, ibaddr=0x%08x,"
-			" sizedwords=%d, timestamp=%p)\n",
-			device->id, drawctxt_index, ibaddr,
-			sizedwords, timestamp);
+	KGSL_CMD_VDBG("enter (device_id=%d, drawctxt_index=%d, ibs=%p,"
+			" numibs=%d, timestamp=%p)\n",
+			device->id, drawctxt_index, ibs, numibs, timestamp);
 
 	if (!(device->ringbuffer.flags & KGSL_FLAGS_STARTED)) {
 		KGSL_CMD_VDBG("return %d\n", -EINVAL);
 		return -EINVAL;
 	}
 
-	BUG_ON(ibaddr == 0);
-	BUG_ON(sizedwords == 0);
+	BUG_ON(numibs <= 0 || numibs > KGSL_MAX_IBS);
 
-	link[0] = PM4_HDR_INDIRECT_BUFFER_PFD;
-	link[1] = ibaddr;
-	link[2] = sizedwords;
+	for (i = 0; i < numibs; i++) {
+		BUG_ON(ibs[i].gpuaddr == 0);
+		BUG_ON(ibs[i].sizedwords == 0);
+
+		*cmds++ = PM4_HDR_INDIRECT_BUFFER_PFD;
+		*cmds++ = ibs[i].gpuaddr;
+		*cmds++ = ibs[i].sizedwords;
+	}
 
 	kgsl_drawctxt_switch(device, &device->drawctxt[drawctxt_index], flags);
 
 	*timestamp = kgsl_ringbuffer_addcmds(&device->ringbuffer,
-					0, &link[0], 3);
+					0, link, 3 * numibs);
 
+	GSL_RB_STATS(device->ringbuffer.stats.ibs_total += numibs);
 
-	KGSL_CMD_INFO("ctxt %d g %08x sd %d ts %d\n",
-			drawctxt_index, ibaddr, sizedwords, *timestamp);
+	KGSL_CMD_INFO("ctxt %d g %08x sd %d n %d ts %d\n",
+			drawctxt_index, ibs[0].gpuaddr, ibs[0].sizedwords,
+			numibs, *timestamp);
 
 	KGSL_CMD_VDBG("return %d\n", 0);
 
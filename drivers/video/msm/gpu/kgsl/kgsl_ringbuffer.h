@@ -137,6 +137,24 @@ struct kgsl_rbmemptrs {
 struct kgsl_rbstats {
 	int64_t issues;
 	int64_t words_total;
+	int64_t ibs_total;
+	/* submissions that found everything before them retired */
+	int64_t starved;
+	/* kgsl_ringbuffer_waitspace() spinning for room */
+	int64_t waits;
+	int64_t wait_ns;
+	int64_t wait_max_ns;
+	/* kgsl_yamato_waittimestamp() sleeping */
+	int64_t ts_waits;
+	int64_t ts_wait_ns;
+	int64_t ts_wait_max_ns;
+	/* timestamp interrupts, NOPs issued to get one, events run */
+	int64_t irqs;
+	int64_t kicks;
+	int64_t events;
+	/* clocks off between bursts of work */
+	int64_t standby_count;
+	int64_t standby_ns;
 };
 
 
@@ -157,11 +175,12 @@ struct kgsl_ringbuffer {
 	unsigned int rptr; /* read pointer offset in dwords from baseaddr */
 	uint32_t timestamp;
 
-	/* queue of memfrees pending timestamp elapse */
-	struct list_head memqueue;
-
 	struct kgsl_rbwatchdog watchdog;
 
+	/* staging for kgsl_ringbuffer_issueibcmds(), which runs under
+	 * kgsl_driver.mutex; too big for the stack */
+	unsigned int ib_link[3 * KGSL_MAX_IBS];
+
 #ifdef GSL_STATS_RINGBUFFER
 	struct kgsl_rbstats stats;
 #endif /* GSL_STATS_RINGBUFFER */
@@ -230,7 +249,7 @@ struct kgsl_ringbuffer {
 struct kgsl_pmem_entry;
 
 int kgsl_ringbuffer_issueibcmds(struct kgsl_device *, int drawctxt_index,
-				uint32_t ibaddr, int sizedwords,
+				const struct kgsl_ibdesc *ibs, int numibs,
 				uint32_t *timestamp,
 				unsigned int flags);
 
@@ -22,6 +22,8 @@
 #include <linux/irq.h>
 #include <linux/sched.h>
 #include <linux/wait.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
 
 #include "kgsl.h"
 #include "kgsl_log.h"
@@ -453,6 +455,7 @@ int kgsl_yamato_init(struct kgsl_device *device, struct kgsl_devconfig *config)
 	memset(device, 0, sizeof(*device));
 
 	init_waitqueue_head(&device->ib1_wq);
+	INIT_LIST_HEAD(&device->events);
 
 	memcpy(regspace, &config->regspace, sizeof(device->regspace));
 	if (regspace->mmio_phys_base == 0 || regspace->sizebytes == 0) {
@@ -526,7 +529,7 @@ int kgsl_yamato_init(struct kgsl_device *device, struct kgsl_devconfig *config)
 		goto error_close_mmu;
 	}
 
-	status = kgsl_sharedmem_alloc(memflags, sizeof(device->memstore),
+	status = kgsl_sharedmem_alloc(memflags, sizeof(struct kgsl_memstore),
 					&device->memstore);
 	if (status != 0)  {
 		status = -ENODEV;
@@ -845,18 +848,54 @@ int kgsl_yamato_regwrite(struct kgsl_device *device, unsigned int offsetwords,
 	return 0;
 }
 
+static void kgsl_yamato_wake(struct kgsl_device *device, void *priv,
+			     uint32_t timestamp)
+{
+	complete(priv);
+}
+
+/* Call with the driver mutex held; it is dropped while waiting. */
 int kgsl_yamato_waittimestamp(struct kgsl_device *device,
 				unsigned int timestamp,
 				unsigned int msecs)
 {
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct kgsl_event event;
+	ktime_t start;
 	long status;
 
 	KGSL_DRV_INFO("enter (device=%p,timestamp=%d,timeout=0x%08x)\n",
 			device, timestamp, msecs);
 
-	status = wait_event_interruptible_timeout(device->ib1_wq,
-			kgsl_cmdstream_check_timestamp(device, timestamp),
-			msecs_to_jiffies(msecs));
+	if (kgsl_cmdstream_check_timestamp(device, timestamp)) {
+		KGSL_DRV_INFO("return 0\n");
+		return 0;
+	}
+
+	start = ktime_get();
+	event.func = kgsl_yamato_wake;
+	event.priv = &done;
+	kgsl_cmdstream_add_event(device, &event, timestamp);
+
+	mutex_unlock(&kgsl_driver.mutex);
+	status = wait_for_completion_interruptible_timeout(&done,
+					msecs_to_jiffies(msecs));
+	mutex_lock(&kgsl_driver.mutex);
+
+	if (!list_empty(&event.list))
+		kgsl_cmdstream_del_event(device, &event);
+
+#ifdef GSL_STATS_RINGBUFFER
+	{
+		struct kgsl_rbstats *stats = &device->ringbuffer.stats;
+		u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		stats->ts_waits++;
+		stats->ts_wait_ns += ns;
+		if (ns > stats->ts_wait_max_ns)
+			stats->ts_wait_max_ns = ns;
+	}
+#endif
 
 	if (status > 0)
 		status = 0;
@@ -873,8 +912,7 @@ int kgsl_yamato_waittimestamp(struct kgsl_device *device,
 
 int kgsl_yamato_runpending(struct kgsl_device *device)
 {
-	if (device->flags & KGSL_FLAGS_INITIALIZED)
-		kgsl_cmdstream_memqueue_drain(device);
+	kgsl_cmdstream_process_events(device);
 	return 0;
 }
 
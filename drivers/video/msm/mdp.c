@@ -25,6 +25,11 @@
 #include <linux/android_pmem.h>
 #include <linux/major.h>
 #include <linux/msm_hw3d.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/debugfs.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
 
 #include <mach/msm_iomap.h>
 #include <mach/msm_fb.h>
@@ -500,14 +505,8 @@ int mdp_set_output_format(struct mdp_device *mdp_dev, int bpp)
 	return 0;
 }
 
-int mdp_blit(struct mdp_device *mdp_dev, struct fb_info *fb,
-	     struct mdp_blit_req *req)
+static int mdp_blit_check(struct mdp_blit_req *req)
 {
-	int ret;
-	unsigned long src_start = 0, src_len = 0, dst_start = 0, dst_len = 0;
-	struct mdp_info *mdp = container_of(mdp_dev, struct mdp_info, mdp_dev);
-	struct file *src_file = 0, *dst_file = 0;
-
 	/* WORKAROUND FOR HARDWARE BUG IN BG TILE FETCH */
 	if (unlikely(req->src_rect.h == 0 ||
 		     req->src_rect.w == 0)) {
@@ -517,22 +516,33 @@ int mdp_blit(struct mdp_device *mdp_dev, struct fb_info *fb,
 	if (unlikely(req->dst_rect.h == 0 ||
 		     req->dst_rect.w == 0))
 		return -EINVAL;
+	return 0;
+}
 
-	/* do this first so that if this fails, the caller can always
-	 * safely call put_img */
-	if (unlikely(get_img(&req->src, fb, &src_start, &src_len, &src_file))) {
-		printk(KERN_ERR "mpd_ppp: could not retrieve src image from "
-				"memory\n");
-		return -EINVAL;
-	}
+/* one pass through the PPP */
+static int mdp_ppp_run(struct mdp_info *mdp, struct mdp_blit_req *req,
+		       struct file *src_file, unsigned long src_start,
+		       unsigned long src_len, struct file *dst_file,
+		       unsigned long dst_start, unsigned long dst_len)
+{
+	int ret;
 
-	if (unlikely(get_img(&req->dst, fb, &dst_start, &dst_len, &dst_file))) {
-		printk(KERN_ERR "mpd_ppp: could not retrieve dst image from "
-				"memory\n");
-		put_img(src_file);
-		return -EINVAL;
+	enable_mdp_irq(mdp, DL0_ROI_DONE);
+	ret = mdp_ppp_blit(mdp, req, src_file, src_start, src_len, dst_file,
+			   dst_start, dst_len);
+	if (ret) {
+		disable_mdp_irq(mdp, DL0_ROI_DONE);
+		return ret;
 	}
-	mutex_lock(&mdp_mutex);
+	return mdp_ppp_wait(mdp);
+}
+
+/* called with mdp_mutex held */
+static int mdp_blit_img(struct mdp_info *mdp, struct mdp_blit_req *req,
+			struct file *src_file, unsigned long src_start,
+			unsigned long src_len, struct file *dst_file,
+			unsigned long dst_start, unsigned long dst_len)
+{
 	timeout_req = req;
 	/* transp_masking unimplemented */
 	req->transp_mask = MDP_TRANSP_NOP;
@@ -542,50 +552,327 @@ int mdp_blit(struct mdp_device *mdp_dev, struct fb_info *fb,
 		      HAS_ALPHA(req->src.format)) &&
 		     (req->flags & MDP_ROT_90 &&
 		      req->dst_rect.w <= 16 && req->dst_rect.h >= 16))) {
-		int i;
+		int i, ret;
 		unsigned int tiles = req->dst_rect.h / 16;
 		unsigned int remainder = req->dst_rect.h % 16;
 		req->src_rect.w = 16*req->src_rect.w / req->dst_rect.h;
 		req->dst_rect.h = 16;
 		for (i = 0; i < tiles; i++) {
-			enable_mdp_irq(mdp, DL0_ROI_DONE);
-			ret = mdp_ppp_blit(mdp, req, src_file, src_start,
-					   src_len, dst_file, dst_start,
-					   dst_len);
-			if (ret)
-				goto err_bad_blit;
-			ret = mdp_ppp_wait(mdp);
+			ret = mdp_ppp_run(mdp, req, src_file, src_start,
+					  src_len, dst_file, dst_start,
+					  dst_len);
 			if (ret)
-				goto err_wait_failed;
+				return ret;
 			req->dst_rect.y += 16;
 			req->src_rect.x += req->src_rect.w;
 		}
 		if (!remainder)
-			goto end;
+			return 0;
 		req->src_rect.w = remainder*req->src_rect.w / req->dst_rect.h;
 		req->dst_rect.h = remainder;
 	}
 #endif
-	enable_mdp_irq(mdp, DL0_ROI_DONE);
-	ret = mdp_ppp_blit(mdp, req, src_file, src_start, src_len, dst_file,
-			   dst_start,
-			   dst_len);
+	return mdp_ppp_run(mdp, req, src_file, src_start, src_len, dst_file,
+			   dst_start, dst_len);
+}
+
+struct mdp_blit_item {
+	struct mdp_blit_req req;
+	struct file *src_file;
+	struct file *dst_file;
+	unsigned long src_start, src_len;
+	unsigned long dst_start, dst_len;
+};
+
+struct mdp_blit_job {
+	struct list_head list;
+	uint32_t fence;
+	pid_t owner;
+	int count;
+	ktime_t queued;
+	struct mdp_blit_item items[];
+};
+
+/* for /sys/kernel/debug/mdp/blit_queue, under blit_lock */
+static struct {
+	unsigned long jobs;
+	unsigned long reqs;
+	unsigned long errors;
+	unsigned long errors_dropped;
+	unsigned long waits;
+	unsigned long throttled;
+	int max_depth;
+	u64 total_ns;
+	u64 max_ns;
+} mdp_blit_stats;
+
+#define MDP_BLIT_QUEUE_DEPTH 8
+
+static int mdp_blit_retired(struct mdp_info *mdp, uint32_t fence)
+{
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&mdp->blit_lock, flags);
+	ret = (int)(mdp->blit_retired - fence) >= 0;
+	spin_unlock_irqrestore(&mdp->blit_lock, flags);
+	return ret;
+}
+
+static int mdp_blit_has_room(struct mdp_info *mdp)
+{
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&mdp->blit_lock, flags);
+	ret = mdp->blit_depth < MDP_BLIT_QUEUE_DEPTH;
+	spin_unlock_irqrestore(&mdp->blit_lock, flags);
+	return ret;
+}
+
+/* Called with blit_lock held.  Only the oldest failure is let go if
+ * more than MDP_BLIT_ERR_MAX are left unreported, by owners that never
+ * wait for them.
+ */
+static void mdp_blit_record_err(struct mdp_info *mdp,
+				struct mdp_blit_job *job, int err)
+{
+	struct mdp_blit_err *e;
+
+	if (mdp->nr_blit_errs == MDP_BLIT_ERR_MAX) {
+		memmove(&mdp->blit_errs[0], &mdp->blit_errs[1],
+			(MDP_BLIT_ERR_MAX - 1) * sizeof(mdp->blit_errs[0]));
+		mdp->nr_blit_errs--;
+		mdp_blit_stats.errors_dropped++;
+	}
+	e = &mdp->blit_errs[mdp->nr_blit_errs++];
+	e->owner = job->owner;
+	e->fence = job->fence;
+	e->err = err;
+	mdp_blit_stats.errors++;
+}
+
+/* Called with blit_lock held: the oldest failure of the caller's lists
+ * up to fence, which is then reported.
+ */
+static int mdp_blit_take_err(struct mdp_info *mdp, uint32_t fence)
+{
+	struct mdp_blit_err *e;
+	int i, err;
+
+	for (i = 0; i < mdp->nr_blit_errs; i++) {
+		e = &mdp->blit_errs[i];
+		if (e->owner != current->tgid || (int)(e->fence - fence) > 0)
+			continue;
+		err = e->err;
+		mdp->nr_blit_errs--;
+		memmove(e, e + 1, (mdp->nr_blit_errs - i) * sizeof(*e));
+		return err;
+	}
+	return 0;
+}
+
+static void mdp_blit_work(struct work_struct *work)
+{
+	struct mdp_info *mdp = container_of(work, struct mdp_info, blit_work);
+	struct mdp_blit_job *job;
+	struct mdp_blit_item *item;
+	unsigned long flags;
+	u64 ns;
+	int i, ret;
+
+	for (;;) {
+		spin_lock_irqsave(&mdp->blit_lock, flags);
+		if (list_empty(&mdp->blit_jobs)) {
+			spin_unlock_irqrestore(&mdp->blit_lock, flags);
+			break;
+		}
+		job = list_first_entry(&mdp->blit_jobs, struct mdp_blit_job,
+				       list);
+		list_del(&job->list);
+		mdp->blit_depth--;
+		spin_unlock_irqrestore(&mdp->blit_lock, flags);
+
+		/* like MSMFB_BLIT, stop at the first request that fails */
+		ret = 0;
+		mutex_lock(&mdp_mutex);
+		for (i = 0; i < job->count && !ret; i++) {
+			item = &job->items[i];
+			ret = mdp_blit_img(mdp, &item->req, item->src_file,
+					   item->src_start, item->src_len,
+					   item->dst_file, item->dst_start,
+					   item->dst_len);
+		}
+		mutex_unlock(&mdp_mutex);
+
+		for (i = 0; i < job->count; i++) {
+			put_img(job->items[i].src_file);
+			put_img(job->items[i].dst_file);
+		}
+
+		ns = ktime_to_ns(ktime_sub(ktime_get(), job->queued));
+		spin_lock_irqsave(&mdp->blit_lock, flags);
+		mdp->blit_retired = job->fence;
+		if (ret)
+			mdp_blit_record_err(mdp, job, ret);
+		mdp_blit_stats.total_ns += ns;
+		if (ns > mdp_blit_stats.max_ns)
+			mdp_blit_stats.max_ns = ns;
+		spin_unlock_irqrestore(&mdp->blit_lock, flags);
+
+		wake_up_all(&mdp->blit_waitqueue);
+		kfree(job);
+	}
+}
+
+/* The images are looked up here, while the caller's files are still
+ * reachable, and released by the worker once the blit is done.  Blocks
+ * while MDP_BLIT_QUEUE_DEPTH lists are already waiting.
+ */
+int mdp_blit_queue(struct mdp_device *mdp_dev, struct fb_info *fb,
+		   struct mdp_blit_req *req, int count, uint32_t *fence)
+{
+	struct mdp_info *mdp = container_of(mdp_dev, struct mdp_info, mdp_dev);
+	struct mdp_blit_job *job;
+	struct mdp_blit_item *item;
+	unsigned long flags;
+	int i, ret;
+
+	if (count <= 0 || count > MDP_BLIT_QUEUE_MAX)
+		return -EINVAL;
+	for (i = 0; i < count; i++)
+		if (mdp_blit_check(&req[i]))
+			return -EINVAL;
+
+	job = kzalloc(sizeof(*job) + count * sizeof(job->items[0]),
+		      GFP_KERNEL);
+	if (!job)
+		return -ENOMEM;
+
+	for (i = 0; i < count; i++) {
+		item = &job->items[i];
+		item->req = req[i];
+		if (get_img(&item->req.src, fb, &item->src_start,
+			    &item->src_len, &item->src_file) ||
+		    get_img(&item->req.dst, fb, &item->dst_start,
+			    &item->dst_len, &item->dst_file)) {
+			printk(KERN_ERR "mpd_ppp: could not retrieve image "
+			       "from memory\n");
+			ret = -EINVAL;
+			goto err_get_img;
+		}
+	}
+	job->count = count;
+
+	if (!mdp_blit_has_room(mdp)) {
+		spin_lock_irqsave(&mdp->blit_lock, flags);
+		mdp_blit_stats.throttled++;
+		spin_unlock_irqrestore(&mdp->blit_lock, flags);
+	}
+	ret = wait_event_interruptible(mdp->blit_waitqueue,
+				       mdp_blit_has_room(mdp));
 	if (ret)
-		goto err_bad_blit;
-	ret = mdp_ppp_wait(mdp);
+		goto err_get_img;
+
+	spin_lock_irqsave(&mdp->blit_lock, flags);
+	job->fence = ++mdp->blit_fence;
+	job->owner = current->tgid;
+	job->queued = ktime_get();
+	list_add_tail(&job->list, &mdp->blit_jobs);
+	mdp->blit_depth++;
+	mdp_blit_stats.jobs++;
+	mdp_blit_stats.reqs += count;
+	if (mdp->blit_depth > mdp_blit_stats.max_depth)
+		mdp_blit_stats.max_depth = mdp->blit_depth;
+	*fence = job->fence;
+	spin_unlock_irqrestore(&mdp->blit_lock, flags);
+
+	queue_work(mdp->blit_wq, &mdp->blit_work);
+	return 0;
+
+err_get_img:
+	for (i = 0; i < count; i++) {
+		put_img(job->items[i].src_file);
+		put_img(job->items[i].dst_file);
+	}
+	kfree(job);
+	return ret;
+}
+
+/* Returns the error of the oldest list up to fence, queued by the
+ * caller's process, that failed and has not been reported yet.  Each
+ * failure is reported once, so a later wait returns the next one.
+ */
+int mdp_blit_wait(struct mdp_device *mdp_dev, uint32_t fence,
+		  unsigned long timeout)
+{
+	struct mdp_info *mdp = container_of(mdp_dev, struct mdp_info, mdp_dev);
+	unsigned long flags;
+	long ret;
+
+	spin_lock_irqsave(&mdp->blit_lock, flags);
+	ret = (int)(mdp->blit_fence - fence) < 0 ? -EINVAL : 0;
+	mdp_blit_stats.waits++;
+	spin_unlock_irqrestore(&mdp->blit_lock, flags);
 	if (ret)
-		goto err_wait_failed;
-end:
-	put_img(src_file);
-	put_img(dst_file);
+		return ret;
+
+	ret = wait_event_interruptible_timeout(mdp->blit_waitqueue,
+					       mdp_blit_retired(mdp, fence),
+					       timeout);
+	if (ret < 0)
+		return ret;
+	if (ret == 0 && !mdp_blit_retired(mdp, fence))
+		return -ETIMEDOUT;
+
+	spin_lock_irqsave(&mdp->blit_lock, flags);
+	ret = mdp_blit_take_err(mdp, fence);
+	spin_unlock_irqrestore(&mdp->blit_lock, flags);
+	return ret;
+}
+
+int mdp_blit(struct mdp_device *mdp_dev, struct fb_info *fb,
+	     struct mdp_blit_req *req)
+{
+	int ret;
+	unsigned long src_start = 0, src_len = 0, dst_start = 0, dst_len = 0;
+	struct mdp_info *mdp = container_of(mdp_dev, struct mdp_info, mdp_dev);
+	struct file *src_file = 0, *dst_file = 0;
+	unsigned long flags;
+	uint32_t fence;
+
+	ret = mdp_blit_check(req);
+	if (ret)
+		return ret;
+
+	/* do this first so that if this fails, the caller can always
+	 * safely call put_img */
+	if (unlikely(get_img(&req->src, fb, &src_start, &src_len, &src_file))) {
+		printk(KERN_ERR "mpd_ppp: could not retrieve src image from "
+				"memory\n");
+		return -EINVAL;
+	}
+
+	if (unlikely(get_img(&req->dst, fb, &dst_start, &dst_len, &dst_file))) {
+		printk(KERN_ERR "mpd_ppp: could not retrieve dst image from "
+				"memory\n");
+		put_img(src_file);
+		return -EINVAL;
+	}
+
+	/* synchronous blits go after anything already queued */
+	spin_lock_irqsave(&mdp->blit_lock, flags);
+	fence = mdp->blit_fence;
+	spin_unlock_irqrestore(&mdp->blit_lock, flags);
+	wait_event(mdp->blit_waitqueue, mdp_blit_retired(mdp, fence));
+
+	mutex_lock(&mdp_mutex);
+	ret = mdp_blit_img(mdp, req, src_file, src_start, src_len, dst_file,
+			   dst_start, dst_len);
 	mutex_unlock(&mdp_mutex);
-	return 0;
-err_bad_blit:
-	disable_mdp_irq(mdp, DL0_ROI_DONE);
-err_wait_failed:
+
 	put_img(src_file);
 	put_img(dst_file);
-	mutex_unlock(&mdp_mutex);
 	return ret;
 }
 
@@ -786,6 +1073,93 @@ void mdp_hw_init(struct mdp_info *mdp)
 
 }
 
+#if defined(CONFIG_DEBUG_FS)
+
+#define DEBUG_BUFMAX 1024
+
+static ssize_t debug_read_blit_queue(struct file *file, char __user *ubuf,
+				     size_t count, loff_t *ppos)
+{
+	struct mdp_info *mdp = file->private_data;
+	unsigned long flags;
+	uint32_t fence, retired;
+	int depth;
+	char *buf;
+	int n = 0;
+	ssize_t ret;
+
+	buf = kmalloc(DEBUG_BUFMAX, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&mdp->blit_lock, flags);
+	fence = mdp->blit_fence;
+	retired = mdp->blit_retired;
+	depth = mdp->blit_depth;
+	n += scnprintf(buf + n, DEBUG_BUFMAX - n,
+		       "fence %u retired %u depth %d max %d\n"
+		       "lists %lu blits %lu errors %lu (%lu dropped) "
+		       "waits %lu throttled %lu\n"
+		       "latency avg %llu max %llu ns\n",
+		       fence, retired, depth, mdp_blit_stats.max_depth,
+		       mdp_blit_stats.jobs, mdp_blit_stats.reqs,
+		       mdp_blit_stats.errors, mdp_blit_stats.errors_dropped,
+		       mdp_blit_stats.waits,
+		       mdp_blit_stats.throttled,
+		       mdp_blit_stats.jobs - depth ?
+		       div64_u64(mdp_blit_stats.total_ns,
+				 mdp_blit_stats.jobs - depth) : 0,
+		       mdp_blit_stats.max_ns);
+	spin_unlock_irqrestore(&mdp->blit_lock, flags);
+
+	ret = simple_read_from_buffer(ubuf, count, ppos, buf, n);
+	kfree(buf);
+	return ret;
+}
+
+static ssize_t debug_reset_blit_queue(struct file *file,
+				      const char __user *buf,
+				      size_t count, loff_t *ppos)
+{
+	struct mdp_info *mdp = file->private_data;
+	unsigned long flags;
+
+	/* wait for the queue to empty so the latencies add up */
+	wait_event(mdp->blit_waitqueue,
+		   mdp_blit_retired(mdp, mdp->blit_fence));
+	spin_lock_irqsave(&mdp->blit_lock, flags);
+	memset(&mdp_blit_stats, 0, sizeof(mdp_blit_stats));
+	spin_unlock_irqrestore(&mdp->blit_lock, flags);
+	return count;
+}
+
+static int debug_open(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return 0;
+}
+
+static const struct file_operations debug_blit_queue_fops = {
+	.open = debug_open,
+	.read = debug_read_blit_queue,
+	.write = debug_reset_blit_queue,
+};
+
+static void mdp_debugfs_init(struct mdp_info *mdp)
+{
+	struct dentry *dent;
+
+	dent = debugfs_create_dir("mdp", 0);
+	if (IS_ERR(dent))
+		return;
+
+	debugfs_create_file("blit_queue", 0644, dent, mdp,
+			    &debug_blit_queue_fops);
+}
+#else
+static inline void mdp_debugfs_init(struct mdp_info *mdp) { }
+#endif
+
 uint32_t msm_mdp_base;
 int mdp_probe(struct platform_device *pdev)
 {
@@ -805,6 +1179,10 @@ int mdp_probe(struct platform_device *pdev)
 		return -ENOMEM;
 
 	spin_lock_init(&mdp->lock);
+	spin_lock_init(&mdp->blit_lock);
+	INIT_LIST_HEAD(&mdp->blit_jobs);
+	INIT_WORK(&mdp->blit_work, mdp_blit_work);
+	init_waitqueue_head(&mdp->blit_waitqueue);
 
 	mdp->irq = platform_get_irq(pdev, 0);
 	if (mdp->irq < 0) {
@@ -824,6 +1202,8 @@ int mdp_probe(struct platform_device *pdev)
 	mdp->mdp_dev.dma = mdp_dma;
 	mdp->mdp_dev.dma_wait = mdp_dma_wait;
 	mdp->mdp_dev.blit = mdp_blit;
+	mdp->mdp_dev.blit_queue = mdp_blit_queue;
+	mdp->mdp_dev.blit_wait = mdp_blit_wait;
 	mdp->mdp_dev.set_grp_disp = mdp_set_grp_disp;
 	mdp->mdp_dev.set_output_format = mdp_set_output_format;
 	mdp->mdp_dev.check_output_format = mdp_check_output_format;
@@ -856,6 +1236,12 @@ int mdp_probe(struct platform_device *pdev)
 		goto error_get_ebi1_clk;
 	}
 
+	mdp->blit_wq = create_singlethread_workqueue("mdp_blit");
+	if (!mdp->blit_wq) {
+		ret = -ENOMEM;
+		goto error_create_workqueue;
+	}
+
 	ret = request_irq(mdp->irq, mdp_isr, IRQF_DISABLED, "msm_mdp", mdp);
 	if (ret)
 		goto error_request_irq;
@@ -876,11 +1262,14 @@ int mdp_probe(struct platform_device *pdev)
 	if (ret)
 		goto error_device_register;
 
+	mdp_debugfs_init(mdp);
 	return 0;
 
 error_device_register:
 	free_irq(mdp->irq, mdp);
 error_request_irq:
+	destroy_workqueue(mdp->blit_wq);
+error_create_workqueue:
 	clk_put(mdp->ebi1_clk);
 error_get_ebi1_clk:
 	clk_put(mdp->clk);
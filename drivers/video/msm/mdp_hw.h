@@ -17,6 +17,7 @@
 
 #include <linux/platform_device.h>
 #include <linux/wait.h>
+#include <linux/workqueue.h>
 #include <mach/msm_iomap.h>
 #include <mach/msm_fb.h>
 
@@ -41,6 +42,15 @@ struct mdp_out_interface {
 	struct msmfb_callback	*irq_cb;
 };
 
+/* a queued blit list that failed, until a wait by its owner reports it */
+struct mdp_blit_err {
+	pid_t owner;			/* thread group that queued it */
+	uint32_t fence;
+	int err;
+};
+
+#define MDP_BLIT_ERR_MAX 16
+
 struct mdp_info {
 	spinlock_t lock;
 	struct mdp_device mdp_dev;
@@ -52,6 +62,19 @@ struct mdp_info {
 	int format;
 	int pack_pattern;
 	bool dma_config_dirty;
+
+	/* blits queued by MSMFB_BLIT_QUEUE, run in order by blit_work */
+	spinlock_t blit_lock;
+	struct list_head blit_jobs;
+	struct workqueue_struct *blit_wq;
+	struct work_struct blit_work;
+	wait_queue_head_t blit_waitqueue;
+	int blit_depth;
+	uint32_t blit_fence;		/* last fence handed out */
+	uint32_t blit_retired;		/* last fence completed */
+	/* unreported failures, oldest first */
+	struct mdp_blit_err blit_errs[MDP_BLIT_ERR_MAX];
+	int nr_blit_errs;
 };
 
 extern int mdp_out_if_register(struct mdp_device *mdp_dev, int interface,
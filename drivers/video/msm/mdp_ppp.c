@@ -674,6 +674,5 @@ int mdp_ppp_blit(const struct mdp_info *mdp, struct mdp_blit_req *req,
 #if PPP_DUMP_BLITS
 	pr_info("%s: sending blit\n", __func__);
 #endif
-	send_blit(mdp, req, &regs, src_file, dst_file);
-	return 0;
+	return send_blit(mdp, req, &regs, src_file, dst_file);
 }
@@ -32,6 +32,7 @@
 #include <linux/clk.h>
 #include <linux/debugfs.h>
 #include <linux/dma-mapping.h>
+#include <linux/interrupt.h>
 
 extern void start_drawing_late_resume(struct early_suspend *h);
 static void msmfb_resume_handler(struct early_suspend *h);
@@ -70,8 +71,24 @@ static int msmfb_debug_mask;
 module_param_named(msmfb_debug_mask, msmfb_debug_mask, int,
 		   S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* What starting one more DMA costs, in pixels: two dirty regions are sent
+ * as one when the area their union adds is no more than this. */
+static int msmfb_dma_overhead = 4096;
+module_param_named(dma_overhead, msmfb_dma_overhead, int,
+		   S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* regions sent per frame, at most */
+#define MSMFB_MAX_DIRTY 4
+
 struct mdp_device *mdp;
 
+struct msmfb_rect {
+	int left;
+	int top;
+	int eright; /* exclusive */
+	int ebottom; /* exclusive */
+};
+
 struct msmfb_info {
 	struct fb_info *fb;
 	struct msm_panel_data *panel;
@@ -83,12 +100,26 @@ struct msmfb_info {
 	unsigned frame_done;
 	int sleeping;
 	unsigned update_frame;
+	/* updates requested since the last frame was started, one spare
+	 * slot for the incoming region before it is merged */
+	struct msmfb_rect dirty[MSMFB_MAX_DIRTY + 1];
+	int ndirty;
+	/* the frame being sent, one region per dma */
+	struct msmfb_rect dma_rects[MSMFB_MAX_DIRTY];
+	int ndma;
+	int dma_next;
+	int dma_continue;
+	int dma_deferred;
+	unsigned dma_yoffset;
+	unsigned dma_frame;
+	struct tasklet_struct dma_tasklet;
 	struct {
-		int left;
-		int top;
-		int eright; /* exclusive */
-		int ebottom; /* exclusive */
-	} update_info;
+		unsigned long updates;
+		unsigned long frames;
+		unsigned long dmas;
+		u64 bytes;
+		u64 bbox_bytes;	/* had each frame been sent as one box */
+	} stats;
 	char *black;
 
 	struct early_suspend earlier_suspend;
@@ -117,12 +148,96 @@ static int msmfb_release(struct fb_info *info, int user)
 	return 0;
 }
 
+static inline int msmfb_rect_area(const struct msmfb_rect *r)
+{
+	return (r->eright - r->left) * (r->ebottom - r->top);
+}
+
+static void msmfb_rect_union(struct msmfb_rect *dst,
+			     const struct msmfb_rect *a,
+			     const struct msmfb_rect *b)
+{
+	dst->left = min(a->left, b->left);
+	dst->top = min(a->top, b->top);
+	dst->eright = max(a->eright, b->eright);
+	dst->ebottom = max(a->ebottom, b->ebottom);
+}
+
+/* The pixels sending a and b as one region costs over sending each of
+ * them once. */
+static int msmfb_merge_cost(const struct msmfb_rect *a,
+			    const struct msmfb_rect *b)
+{
+	struct msmfb_rect u;
+	int w, h, overlap = 0;
+
+	w = min(a->eright, b->eright) - max(a->left, b->left);
+	h = min(a->ebottom, b->ebottom) - max(a->top, b->top);
+	if (w > 0 && h > 0)
+		overlap = w * h;
+
+	msmfb_rect_union(&u, a, b);
+	return msmfb_rect_area(&u) - msmfb_rect_area(a) - msmfb_rect_area(b) +
+		overlap;
+}
+
+static void msmfb_remove_dirty(struct msmfb_info *msmfb, int i)
+{
+	msmfb->dirty[i] = msmfb->dirty[--msmfb->ndirty];
+}
+
+/* Add an update to the frame, folding it into any region it is cheaper
+ * to send with than apart.  If that leaves too many regions the pair
+ * that costs least to merge is merged.  Panels that cannot take partial
+ * updates only ever get one region.  Called with update_lock held. */
+static void msmfb_add_dirty(struct msmfb_info *msmfb, uint32_t left,
+			    uint32_t top, uint32_t eright, uint32_t ebottom)
+{
+	struct msmfb_rect r = { left, top, eright, ebottom };
+	int max_dirty = 1;
+	int i, j, best_i, best_j, cost, best;
+
+	if (msmfb->panel->caps & MSMFB_CAP_PARTIAL_UPDATES)
+		max_dirty = MSMFB_MAX_DIRTY;
+
+restart:
+	for (i = 0; i < msmfb->ndirty; i++) {
+		if (msmfb_merge_cost(&msmfb->dirty[i], &r) <=
+		    msmfb_dma_overhead) {
+			msmfb_rect_union(&r, &r, &msmfb->dirty[i]);
+			msmfb_remove_dirty(msmfb, i);
+			goto restart;
+		}
+	}
+	msmfb->dirty[msmfb->ndirty++] = r;
+
+	while (msmfb->ndirty > max_dirty) {
+		best = INT_MAX;
+		best_i = 0;
+		best_j = 1;
+		for (i = 0; i < msmfb->ndirty; i++)
+			for (j = i + 1; j < msmfb->ndirty; j++) {
+				cost = msmfb_merge_cost(&msmfb->dirty[i],
+							&msmfb->dirty[j]);
+				if (cost < best) {
+					best = cost;
+					best_i = i;
+					best_j = j;
+				}
+			}
+		msmfb_rect_union(&msmfb->dirty[best_i], &msmfb->dirty[best_i],
+				 &msmfb->dirty[best_j]);
+		msmfb_remove_dirty(msmfb, best_j);
+	}
+}
+
 /* Called from dma interrupt handler, must not sleep */
 static void msmfb_handle_dma_interrupt(struct msmfb_callback *callback)
 {
 	unsigned long irq_flags;
 	struct msmfb_info *msmfb  = container_of(callback, struct msmfb_info,
 					       dma_callback);
+	int deferred;
 #if PRINT_FPS
 	int64_t dt;
 	ktime_t now;
@@ -131,7 +246,18 @@ static void msmfb_handle_dma_interrupt(struct msmfb_callback *callback)
 #endif
 
 	spin_lock_irqsave(&msmfb->update_lock, irq_flags);
-	msmfb->frame_done = msmfb->frame_requested;
+	/* the mdp lock is held here, so the next region of this frame is
+	 * started from the tasklet */
+	if (msmfb->dma_next < msmfb->ndma) {
+		msmfb->dma_continue = 1;
+		spin_unlock_irqrestore(&msmfb->update_lock, irq_flags);
+		tasklet_schedule(&msmfb->dma_tasklet);
+		return;
+	}
+	msmfb->ndma = 0;
+	msmfb->frame_done = msmfb->dma_frame;
+	deferred = msmfb->dma_deferred;
+	msmfb->dma_deferred = 0;
 	if (msmfb->sleeping == UPDATING &&
 	    msmfb->frame_done == msmfb->update_frame) {
 		DLOG(SUSPEND_RESUME, "full update completed\n");
@@ -151,16 +277,32 @@ static void msmfb_handle_dma_interrupt(struct msmfb_callback *callback)
 #endif
 	spin_unlock_irqrestore(&msmfb->update_lock, irq_flags);
 	wake_up(&msmfb->frame_wq);
+	/* a vsync came while this frame was being sent */
+	if (deferred)
+		tasklet_schedule(&msmfb->dma_tasklet);
 }
 
-static int msmfb_start_dma(struct msmfb_info *msmfb)
+static void msmfb_dma_next(struct msmfb_info *msmfb)
 {
-	uint32_t x, y, w, h;
+	struct msmfb_rect *r = &msmfb->dma_rects[msmfb->dma_next++];
 	unsigned addr;
+
+	addr = ((msmfb->xres * (msmfb->dma_yoffset + r->top) + r->left) *
+		BYTES_PER_PIXEL(msmfb));
+	mdp->dma(mdp, addr + msmfb->fb->fix.smem_start,
+		 msmfb->xres * BYTES_PER_PIXEL(msmfb),
+		 r->eright - r->left, r->ebottom - r->top, r->left, r->top,
+		 &msmfb->dma_callback,
+		 msmfb->panel->interface_type);
+}
+
+static int msmfb_start_dma(struct msmfb_info *msmfb)
+{
+	struct msmfb_rect *r, bbox;
 	unsigned long irq_flags;
-	uint32_t yoffset;
 	s64 time_since_request;
 	struct msm_panel_data *panel = msmfb->panel;
+	int i, n = 0;
 
 	spin_lock_irqsave(&msmfb->update_lock, irq_flags);
 	time_since_request = ktime_to_ns(ktime_sub(ktime_get(),
@@ -180,29 +322,47 @@ static int msmfb_start_dma(struct msmfb_info *msmfb)
 		spin_unlock_irqrestore(&msmfb->update_lock, irq_flags);
 		return -1;
 	}
-	x = msmfb->update_info.left;
-	y = msmfb->update_info.top;
-	w = msmfb->update_info.eright - x;
-	h = msmfb->update_info.ebottom - y;
-	yoffset = msmfb->yoffset;
-	msmfb->update_info.left = msmfb->xres + 1;
-	msmfb->update_info.top = msmfb->yres + 1;
-	msmfb->update_info.eright = 0;
-	msmfb->update_info.ebottom = 0;
-	if (unlikely(w > msmfb->xres || h > msmfb->yres ||
-		     w == 0 || h == 0)) {
-		printk(KERN_INFO "invalid update: %d %d %d "
-				"%d\n", x, y, w, h);
+	if (msmfb->ndma) {
+		/* the last frame is still going out, this one follows it */
+		msmfb->dma_deferred = 1;
+		spin_unlock_irqrestore(&msmfb->update_lock, irq_flags);
+		return -1;
+	}
+	for (i = 0; i < msmfb->ndirty; i++) {
+		r = &msmfb->dirty[i];
+		if (unlikely(r->eright - r->left > msmfb->xres ||
+			     r->ebottom - r->top > msmfb->yres ||
+			     r->eright <= r->left || r->ebottom <= r->top)) {
+			printk(KERN_INFO "invalid update: %d %d %d "
+					"%d\n", r->left, r->top,
+					r->eright - r->left,
+					r->ebottom - r->top);
+			continue;
+		}
+		if (n)
+			msmfb_rect_union(&bbox, &bbox, r);
+		else
+			bbox = *r;
+		msmfb->dma_rects[n++] = *r;
+		msmfb->stats.bytes += msmfb_rect_area(r) *
+				      BYTES_PER_PIXEL(msmfb);
+	}
+	msmfb->ndirty = 0;
+	if (!n) {
 		msmfb->frame_done = msmfb->frame_requested;
 		goto error;
 	}
+	msmfb->ndma = n;
+	msmfb->dma_next = 0;
+	msmfb->dma_yoffset = msmfb->yoffset;
+	msmfb->dma_frame = msmfb->frame_requested;
+	msmfb->stats.frames++;
+	msmfb->stats.dmas += n;
+	msmfb->stats.bbox_bytes += msmfb_rect_area(&bbox) *
+				   BYTES_PER_PIXEL(msmfb);
 	spin_unlock_irqrestore(&msmfb->update_lock, irq_flags);
 
-	addr = ((msmfb->xres * (yoffset + y) + x) * BYTES_PER_PIXEL(msmfb));
-	mdp->dma(mdp, addr + msmfb->fb->fix.smem_start,
-		 msmfb->xres * BYTES_PER_PIXEL(msmfb), w, h, x, y,
-		 &msmfb->dma_callback,
-		 panel->interface_type);
+	msmfb_dma_next(msmfb);
 	return 0;
 error:
 	spin_unlock_irqrestore(&msmfb->update_lock, irq_flags);
@@ -213,6 +373,23 @@ error:
 	return 0;
 }
 
+static void msmfb_dma_tasklet(unsigned long data)
+{
+	struct msmfb_info *msmfb = (struct msmfb_info *)data;
+	unsigned long irq_flags;
+	int cont;
+
+	spin_lock_irqsave(&msmfb->update_lock, irq_flags);
+	cont = msmfb->dma_continue;
+	msmfb->dma_continue = 0;
+	spin_unlock_irqrestore(&msmfb->update_lock, irq_flags);
+
+	if (cont)
+		msmfb_dma_next(msmfb);
+	else
+		msmfb_start_dma(msmfb);
+}
+
 /* Called from esync interrupt handler, must not sleep */
 static void msmfb_handle_vsync_interrupt(struct msmfb_callback *callback)
 {
@@ -327,19 +504,11 @@ restart:
 		}
 	}
 
-	/* set the update request */
-	if (left < msmfb->update_info.left)
-		msmfb->update_info.left = left;
-	if (top < msmfb->update_info.top)
-		msmfb->update_info.top = top;
-	if (eright > msmfb->update_info.eright)
-		msmfb->update_info.eright = eright;
-	if (ebottom > msmfb->update_info.ebottom)
-		msmfb->update_info.ebottom = ebottom;
-	DLOG(SHOW_UPDATES, "update queued %d %d %d %d %d\n",
-		msmfb->update_info.left, msmfb->update_info.top,
-		msmfb->update_info.eright, msmfb->update_info.ebottom,
-		msmfb->yoffset);
+	/* add the update to this frame's regions */
+	msmfb_add_dirty(msmfb, left, top, eright, ebottom);
+	msmfb->stats.updates++;
+	DLOG(SHOW_UPDATES, "update queued, %d regions %d\n",
+		msmfb->ndirty, msmfb->yoffset);
 	spin_unlock_irqrestore(&msmfb->update_lock, irq_flags);
 
 	/* if the panel is all the way on wait for vsync, otherwise sleep
@@ -601,6 +770,44 @@ static int msmfb_blit(struct fb_info *info,
 }
 
 
+static int msmfb_blit_queue(struct fb_info *info, void __user *p)
+{
+	struct mdp_blit_queue_list __user *list = p;
+	struct mdp_blit_req *req;
+	uint32_t count, fence;
+	int ret;
+
+	if (get_user(count, &list->count))
+		return -EFAULT;
+	if (!count || count > MDP_BLIT_QUEUE_MAX)
+		return -EINVAL;
+
+	req = kmalloc(count * sizeof(*req), GFP_KERNEL);
+	if (!req)
+		return -ENOMEM;
+	if (copy_from_user(req, list->req, count * sizeof(*req))) {
+		ret = -EFAULT;
+		goto done;
+	}
+
+	ret = mdp->blit_queue(mdp, info, req, count, &fence);
+	if (!ret && put_user(fence, &list->fence))
+		ret = -EFAULT;
+done:
+	kfree(req);
+	return ret;
+}
+
+static int msmfb_blit_wait(void __user *p)
+{
+	struct mdp_blit_wait wait;
+
+	if (copy_from_user(&wait, p, sizeof(wait)))
+		return -EFAULT;
+	return mdp->blit_wait(mdp, wait.fence,
+			      msecs_to_jiffies(wait.timeout_ms));
+}
+
 DEFINE_MUTEX(mdp_ppp_lock);
 
 static int msmfb_ioctl(struct fb_info *p, unsigned int cmd, unsigned long arg)
@@ -628,6 +835,10 @@ static int msmfb_ioctl(struct fb_info *p, unsigned int cmd, unsigned long arg)
 		       ktime_to_ns(t2) - ktime_to_ns(t1));
 #endif
 		break;
+	case MSMFB_BLIT_QUEUE:
+		return msmfb_blit_queue(p, argp);
+	case MSMFB_BLIT_WAIT:
+		return msmfb_blit_wait(argp);
 	default:
 			printk(KERN_INFO "msmfb unknown ioctl: %d\n", cmd);
 			return -EINVAL;
@@ -678,14 +889,38 @@ static ssize_t debug_read(struct file *file, char __user *buf, size_t count,
 		       msmfb->sleeping);
 	n += scnprintf(buffer + n, debug_bufmax, "update_frame %d\n",
 		       msmfb->update_frame);
+	n += scnprintf(buffer + n, debug_bufmax, "updates %lu\n",
+		       msmfb->stats.updates);
+	n += scnprintf(buffer + n, debug_bufmax, "frames %lu\n",
+		       msmfb->stats.frames);
+	n += scnprintf(buffer + n, debug_bufmax, "dmas %lu\n",
+		       msmfb->stats.dmas);
+	n += scnprintf(buffer + n, debug_bufmax, "bytes %llu\n",
+		       msmfb->stats.bytes);
+	n += scnprintf(buffer + n, debug_bufmax, "bbox_bytes %llu\n",
+		       msmfb->stats.bbox_bytes);
 	spin_unlock_irqrestore(&msmfb->update_lock, irq_flags);
 	n++;
 	buffer[n] = 0;
 	return simple_read_from_buffer(buf, count, ppos, buffer, n);
 }
 
+/* write anything to reset the update counters */
+static ssize_t debug_write(struct file *file, const char __user *buf,
+			   size_t count, loff_t *ppos)
+{
+	struct msmfb_info *msmfb = (struct msmfb_info *)file->private_data;
+	unsigned long irq_flags;
+
+	spin_lock_irqsave(&msmfb->update_lock, irq_flags);
+	memset(&msmfb->stats, 0, sizeof(msmfb->stats));
+	spin_unlock_irqrestore(&msmfb->update_lock, irq_flags);
+	return count;
+}
+
 static struct file_operations debug_fops = {
 	.read = debug_read,
+	.write = debug_write,
 	.open = debug_open,
 };
 #endif
@@ -850,7 +1085,7 @@ static int msmfb_probe(struct platform_device *pdev)
 #endif
 
 #if MSMFB_DEBUG
-	debugfs_create_file("msm_fb", S_IFREG | S_IRUGO, NULL,
+	debugfs_create_file("msm_fb", S_IFREG | S_IRUGO | S_IWUSR, NULL,
 			    (void *)fb->par, &debug_fops);
 #endif
 
@@ -863,6 +1098,8 @@ static int msmfb_probe(struct platform_device *pdev)
 		     HRTIMER_MODE_REL);
 
 	msmfb->fake_vsync.function = msmfb_fake_vsync;
+	tasklet_init(&msmfb->dma_tasklet, msmfb_dma_tasklet,
+		     (unsigned long)msmfb);
 
 	ret = register_framebuffer(fb);
 	if (ret)
@@ -873,10 +1110,6 @@ static int msmfb_probe(struct platform_device *pdev)
 #ifdef CONFIG_FB_MSM_LOGO
 	if (!load_565rle_image(INIT_IMAGE_FILE)) {
 		/* Flip buffer */
-		msmfb->update_info.left = 0;
-		msmfb->update_info.top = 0;
-		msmfb->update_info.eright = info->var.xres;
-		msmfb->update_info.ebottom = info->var.yres;
 		msmfb_pan_update(info, 0, 0, fb->var.xres,
 				 fb->var.yres, 0, 1);
 	}
@@ -57,6 +57,16 @@
 #define PMEM_CLEAN_INV_CACHES	_IOW(PMEM_IOCTL_MAGIC, 11, unsigned int)
 #define PMEM_CLEAN_CACHES	_IOW(PMEM_IOCTL_MAGIC, 12, unsigned int)
 #define PMEM_INV_CACHES		_IOW(PMEM_IOCTL_MAGIC, 13, unsigned int)
+/* Clean and/or invalidate a list of ranges of the file, given as
+ * offsets from its start.  The kernel may maintain the whole cache
+ * instead when the ranges add up to enough.  Pass a pmem_cache_op. */
+#define PMEM_CACHE_OP		_IOW(PMEM_IOCTL_MAGIC, 14, unsigned int)
+
+#define PMEM_CACHE_CLEAN	0x1
+#define PMEM_CACHE_INV		0x2
+#define PMEM_CACHE_FLUSH	(PMEM_CACHE_CLEAN | PMEM_CACHE_INV)
+
+#define PMEM_CACHE_MAX_RANGES	64
 
 struct pmem_region {
 	unsigned long offset;
@@ -69,6 +79,12 @@ struct pmem_addr {
 	unsigned long length;
 };
 
+struct pmem_cache_op {
+	unsigned int flags;		/* PMEM_CACHE_* */
+	unsigned int nr_ranges;
+	struct pmem_region *ranges;
+};
+
 #ifdef __KERNEL__
 void put_pmem_fd(int fd);
 void flush_pmem_fd(int fd, unsigned long start, unsigned long len);
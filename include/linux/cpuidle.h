@@ -40,6 +40,8 @@ struct cpuidle_state {
 
 	unsigned long long	usage;
 	unsigned long long	time; /* in US */
+	unsigned long long	above; /* a deeper state would have paid */
+	unsigned long long	below; /* left before target_residency */
 
 	int (*enter)	(struct cpuidle_device *dev,
 			 struct cpuidle_state *state);
@@ -468,6 +468,17 @@ static inline int device_is_registered(struct device *dev)
 	return dev->kobj.state_in_sysfs;
 }
 
+/*
+ * Let the PM core suspend and resume the device in parallel with others.
+ * Only its parent and children are still ordered against it, so a driver
+ * opting in must not depend on any other device being awake.
+ */
+static inline void device_enable_async_suspend(struct device *dev)
+{
+	if (dev->power.status == DPM_ON)
+		dev->power.async_suspend = 1;
+}
+
 void driver_init(void);
 
 /*
@@ -821,6 +821,11 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	int mmap_miss;			/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+
+	unsigned int issued_pages;	/* Pages read ahead in this sample */
+	unsigned int hit_pages;		/* ... of which were referenced */
+	unsigned int last_pages;	/* Size of the latest readahead */
+	int ra_shift;			/* Adaptive scaling of ra_pages */
 };
 
 /*
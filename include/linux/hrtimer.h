@@ -437,10 +437,12 @@ extern void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 				     void *timerf, char *comm,
 				     unsigned int timer_flag);
 
-static inline void timer_stats_account_hrtimer(struct hrtimer *timer)
+static inline void timer_stats_account_hrtimer(struct hrtimer *timer,
+					       unsigned int timer_flag)
 {
 	timer_stats_update_stats(timer, timer->start_pid, timer->start_site,
-				 timer->function, timer->start_comm, 0);
+				 timer->function, timer->start_comm,
+				 timer_flag);
 }
 
 extern void __timer_stats_hrtimer_set_start_info(struct hrtimer *timer,
@@ -456,7 +458,8 @@ static inline void timer_stats_hrtimer_clear_start_info(struct hrtimer *timer)
 	timer->start_site = NULL;
 }
 #else
-static inline void timer_stats_account_hrtimer(struct hrtimer *timer)
+static inline void timer_stats_account_hrtimer(struct hrtimer *timer,
+					       unsigned int timer_flag)
 {
 }
 
@@ -0,0 +1,63 @@
+/*
+ * include/linux/launch_prefetch.h
+ *
+ * Record the page cache faults of an application launch and replay them
+ * as batched readahead on the next launch.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#ifndef _LINUX_LAUNCH_PREFETCH_H
+#define _LINUX_LAUNCH_PREFETCH_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/*
+ * Usage, from the process that launches applications:
+ *
+ *  LAUNCH_PREFETCH_START	record file faults of thread group @tgid,
+ *				for at most @timeout_ms (0: until STOP)
+ *  LAUNCH_PREFETCH_STOP	stop recording; read() then returns the
+ *				trace, one "<start> <nr_pages> <path>" line
+ *				per extent, sorted by file and offset
+ *  write()			queue trace lines in the same format
+ *  LAUNCH_PREFETCH_REPLAY	sort and coalesce the queued lines and read
+ *				them ahead in the background
+ */
+struct launch_prefetch_record {
+	__u32 tgid;		/* thread group to record */
+	__u32 timeout_ms;	/* length of the launch window */
+};
+
+#define __LAUNCH_PREFETCH_IOC	0x7a
+
+#define LAUNCH_PREFETCH_START	_IOW(__LAUNCH_PREFETCH_IOC, 1, \
+				     struct launch_prefetch_record)
+#define LAUNCH_PREFETCH_STOP	_IO(__LAUNCH_PREFETCH_IOC, 2)
+#define LAUNCH_PREFETCH_REPLAY	_IO(__LAUNCH_PREFETCH_IOC, 3)
+
+#ifdef __KERNEL__
+
+struct file;
+
+#ifdef CONFIG_LAUNCH_PREFETCH
+extern pid_t launch_prefetch_tgid;
+extern void __launch_prefetch_record(struct file *file, pgoff_t index);
+
+static inline void launch_prefetch_record(struct file *file, pgoff_t index)
+{
+	if (unlikely(launch_prefetch_tgid))
+		__launch_prefetch_record(file, index);
+}
+#else
+static inline void launch_prefetch_record(struct file *file, pgoff_t index)
+{
+}
+#endif
+
+#endif /* __KERNEL__ */
+
+#endif /* _LINUX_LAUNCH_PREFETCH_H */
@@ -58,6 +58,8 @@ extern void mem_cgroup_uncharge_page(struct page *page);
 extern void mem_cgroup_uncharge_cache_page(struct page *page);
 extern int mem_cgroup_shrink_usage(struct page *page,
 			struct mm_struct *mm, gfp_t gfp_mask);
+extern unsigned long mem_cgroup_soft_reclaim(gfp_t gfp_mask,
+					     unsigned long nr_to_reclaim);
 
 extern unsigned long mem_cgroup_isolate_pages(unsigned long nr_to_scan,
 					struct list_head *dst,
@@ -163,6 +165,12 @@ static inline int mem_cgroup_shrink_usage(struct page *page,
 	return 0;
 }
 
+static inline unsigned long mem_cgroup_soft_reclaim(gfp_t gfp_mask,
+					unsigned long nr_to_reclaim)
+{
+	return 0;
+}
+
 static inline void mem_cgroup_add_lru_list(struct page *page, int lru)
 {
 }
@@ -163,6 +163,29 @@ struct kgsl_ringbuffer_issueibcmds {
 #define IOCTL_KGSL_RINGBUFFER_ISSUEIBCMDS \
 	_IOWR(KGSL_IOC_TYPE, 0x10, struct kgsl_ringbuffer_issueibcmds)
 
+/* issue a batch of indirect buffers to the GPU under one timestamp.
+ * ibs points to numibs (at most KGSL_MAX_IBS) descriptors, each a subset
+ * of a buffer as for IOCTL_KGSL_RINGBUFFER_ISSUEIBCMDS; they are run in
+ * order.  The other fields are as for IOCTL_KGSL_RINGBUFFER_ISSUEIBCMDS.
+ */
+#define KGSL_MAX_IBS	32
+
+struct kgsl_ibdesc {
+	unsigned int gpuaddr;
+	unsigned int sizedwords;
+};
+
+struct kgsl_ringbuffer_issueibs {
+	unsigned int drawctxt_id;
+	struct kgsl_ibdesc *ibs;
+	unsigned int numibs;
+	unsigned int timestamp; /*output param */
+	unsigned int flags;
+};
+
+#define IOCTL_KGSL_RINGBUFFER_ISSUEIBS \
+	_IOWR(KGSL_IOC_TYPE, 0x27, struct kgsl_ringbuffer_issueibs)
+
 /* read the most recently executed timestamp value
  * type should be a value from enum kgsl_timestamp_type
  */
@@ -277,4 +300,42 @@ struct kgsl_drawctxt_set_bin_base_offset {
 
 #define IOCTL_KGSL_DRAWCTXT_SET_BIN_BASE_OFFSET \
 	_IOW(KGSL_IOC_TYPE, 0x25, struct kgsl_drawctxt_set_bin_base_offset)
+
+/* clean and/or invalidate ranges of a vmalloc or page allocation, given
+ * as offsets from its start */
+#define KGSL_CACHE_CLEAN	0x1
+#define KGSL_CACHE_INV		0x2
+#define KGSL_CACHE_FLUSH	(KGSL_CACHE_CLEAN | KGSL_CACHE_INV)
+
+#define KGSL_CACHE_MAX_RANGES	64
+
+struct kgsl_cache_range {
+	unsigned int offset;
+	unsigned int len;
+};
+
+struct kgsl_sharedmem_cache_op {
+	unsigned int gpuaddr;
+	unsigned int flags;
+	unsigned int nr_ranges;
+	struct kgsl_cache_range *ranges;
+};
+
+#define IOCTL_KGSL_SHAREDMEM_CACHE_OP \
+	_IOW(KGSL_IOC_TYPE, 0x26, struct kgsl_sharedmem_cache_op)
+
+/* allocate size bytes (rounded up to a page) of GPU memory from system
+ * pages.  To reach it from the CPU, mmap the kgsl fd with the returned
+ * gpuaddr as the offset and the rounded size as the length.  Free it
+ * with IOCTL_KGSL_SHAREDMEM_FREE.
+ */
+struct kgsl_sharedmem_alloc {
+	unsigned int gpuaddr;	/*output param */
+	unsigned int size;
+	/* as for IOCTL_KGSL_SHAREDMEM_FROM_VMALLOC */
+	int force_no_low_watermark;
+};
+
+#define IOCTL_KGSL_SHAREDMEM_ALLOC \
+	_IOWR(KGSL_IOC_TYPE, 0x28, struct kgsl_sharedmem_alloc)
 #endif /* _MSM_KGSL_H */
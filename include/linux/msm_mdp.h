@@ -19,6 +19,9 @@
 #define MSMFB_IOCTL_MAGIC 'm'
 #define MSMFB_GRP_DISP          _IOW(MSMFB_IOCTL_MAGIC, 1, unsigned int)
 #define MSMFB_BLIT              _IOW(MSMFB_IOCTL_MAGIC, 2, unsigned int)
+#define MSMFB_BLIT_QUEUE        _IOWR(MSMFB_IOCTL_MAGIC, 3, unsigned int)
+#define MSMFB_BLIT_WAIT         _IOW(MSMFB_IOCTL_MAGIC, 4, \
+				     struct mdp_blit_wait)
 
 enum {
 	MDP_RGB_565,      // RGB 565 planer
@@ -85,4 +88,24 @@ struct mdp_blit_req_list {
 	struct mdp_blit_req req[];
 };
 
+/* MSMFB_BLIT_QUEUE: the requests are run in order, after everything
+ * queued before them, and the call returns once they are queued.  The
+ * fence is filled in; pass it to MSMFB_BLIT_WAIT to wait for the whole
+ * list to finish.  The wait fails with the error of the oldest list the
+ * calling process queued, up to and including that one, that failed
+ * and has not been reported yet.  Each failure is reported once.
+ */
+#define MDP_BLIT_QUEUE_MAX 32
+
+struct mdp_blit_queue_list {
+	uint32_t count;
+	uint32_t fence;
+	struct mdp_blit_req req[];
+};
+
+struct mdp_blit_wait {
+	uint32_t fence;
+	uint32_t timeout_ms;
+};
+
 #endif //_MSM_MDP_H_
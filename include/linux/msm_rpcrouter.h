@@ -27,6 +27,13 @@ struct rpcrouter_ioctl_server_args {
 	uint32_t vers;
 };
 
+/* buf receives messages as <uint32_t length><message>... */
+struct rpcrouter_ioctl_read_batch {
+	void *buf;
+	uint32_t size;		/* in: size of buf, out: bytes used */
+	uint32_t count;		/* out: number of messages */
+};
+
 #define RPC_ROUTER_IOCTL_MAGIC (0xC1)
 
 #define RPC_ROUTER_IOCTL_GET_VERSION \
@@ -44,4 +51,7 @@ struct rpcrouter_ioctl_server_args {
 #define RPC_ROUTER_IOCTL_GET_MINOR_VERSION \
 	_IOW(RPC_ROUTER_IOCTL_MAGIC, 4, unsigned int)
 
+#define RPC_ROUTER_IOCTL_READ_BATCH \
+	_IOWR(RPC_ROUTER_IOCTL_MAGIC, 5, struct rpcrouter_ioctl_read_batch)
+
 #endif
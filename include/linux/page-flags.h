@@ -51,6 +51,10 @@
  * PG_buddy is set to indicate that the page is free and in the buddy system
  * (see mm/page_alloc.c).
  *
+ * PG_speculative is set on pagecache pages brought in by readahead and
+ * cleared on their first reference, so that readahead can measure how much
+ * of what it read was actually used (see mm/readahead.c).
+ *
  */
 
 /*
@@ -94,6 +98,7 @@ enum pageflags {
 	PG_reclaim,		/* To be reclaimed asap */
 	PG_buddy,		/* Page is free, on buddy lists */
 	PG_swapbacked,		/* Page is backed by RAM/swap */
+	PG_speculative,		/* Read ahead, not yet referenced */
 #ifdef CONFIG_UNEVICTABLE_LRU
 	PG_unevictable,		/* Page is "unevictable"  */
 	PG_mlocked,		/* Page is vma mlocked */
@@ -213,6 +218,7 @@ PAGEFLAG(MappedToDisk, mappedtodisk)
 /* PG_readahead is only used for file reads; PG_reclaim is only for writes */
 PAGEFLAG(Reclaim, reclaim) TESTCLEARFLAG(Reclaim, reclaim)
 PAGEFLAG(Readahead, reclaim)		/* Reminder to do async read-ahead */
+PAGEFLAG(Speculative, speculative) TESTCLEARFLAG(Speculative, speculative)
 
 #ifdef CONFIG_HIGHMEM
 /*
@@ -453,4 +453,32 @@ static inline int add_to_page_cache(struct page *page,
 	return error;
 }
 
+/*
+ * A page brought in by readahead is being referenced for the first time.
+ * Credit the readahead of @ra with a hit.
+ */
+static inline void page_cache_ra_hit(struct file_ra_state *ra,
+				     struct page *page)
+{
+	if (unlikely(PageSpeculative(page)) && TestClearPageSpeculative(page)) {
+		ra->hit_pages++;
+		count_vm_event(READAHEAD_HIT);
+	}
+}
+
+/*
+ * The page the caller missed on was read in by a synchronous readahead.
+ * It was demanded rather than speculated, so take it out of the sample.
+ */
+static inline void page_cache_ra_demand(struct file_ra_state *ra,
+					struct page *page)
+{
+	if (unlikely(PageSpeculative(page)) && TestClearPageSpeculative(page)) {
+		if (ra->last_pages)
+			ra->last_pages--;
+		if (ra->issued_pages)
+			ra->issued_pages--;
+	}
+}
+
 #endif /* _LINUX_PAGEMAP_H */
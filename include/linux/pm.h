@@ -22,6 +22,8 @@
 #define _LINUX_PM_H
 
 #include <linux/list.h>
+#include <linux/completion.h>
+#include <linux/workqueue.h>
 
 /*
  * Callbacks for platform drivers to implement.
@@ -319,9 +321,12 @@ struct dev_pm_info {
 	pm_message_t		power_state;
 	unsigned		can_wakeup:1;
 	unsigned		should_wakeup:1;
+	unsigned		async_suspend:1;
 	enum dpm_state		status;		/* Owned by the PM core */
 #ifdef	CONFIG_PM_SLEEP
 	struct list_head	entry;
+	struct completion	completion;
+	struct work_struct	work;
 #endif
 };
 
@@ -393,6 +398,8 @@ extern int device_prepare_suspend(pm_message_t state);
 
 extern void __suspend_report_result(const char *function, void *fn, int ret);
 
+extern int pm_async_enabled;
+
 #define suspend_report_result(fn, ret)					\
 	do {								\
 		__suspend_report_result(__func__, fn, ret);		\
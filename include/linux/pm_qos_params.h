@@ -2,7 +2,11 @@
  *
  * Mark Gross <mgross@linux.intel.com>
  */
+#ifndef _LINUX_PM_QOS_PARAMS_H
+#define _LINUX_PM_QOS_PARAMS_H
+
 #include <linux/list.h>
+#include <linux/plist.h>
 #include <linux/notifier.h>
 #include <linux/miscdevice.h>
 
@@ -10,10 +14,32 @@
 #define PM_QOS_CPU_DMA_LATENCY 1
 #define PM_QOS_NETWORK_LATENCY 2
 #define PM_QOS_NETWORK_THROUGHPUT 3
+#define PM_QOS_CPU_FREQ_MIN 4
+#define PM_QOS_CPU_FREQ_MAX 5
 
-#define PM_QOS_NUM_CLASSES 4
+#define PM_QOS_NUM_CLASSES 6
 #define PM_QOS_DEFAULT_VALUE -1
 
+/* cpu frequencies are in kHz, as in cpufreq */
+#define PM_QOS_CPU_FREQ_MIN_DEFAULT_VALUE 0
+#define PM_QOS_CPU_FREQ_MAX_DEFAULT_VALUE INT_MAX
+
+/*
+ * A request kept by its owner for as long as it needs the QoS, so that
+ * changing or dropping it takes no allocation or search.  The name is
+ * not copied and must outlive the request.
+ */
+struct pm_qos_request {
+	struct plist_node node;
+	int pm_qos_class;
+	const char *name;
+};
+
+void pm_qos_add_request(struct pm_qos_request *req, int pm_qos_class,
+			const char *name, s32 value);
+void pm_qos_update_request(struct pm_qos_request *req, s32 new_value);
+void pm_qos_remove_request(struct pm_qos_request *req);
+
 int pm_qos_add_requirement(int qos, char *name, s32 value);
 int pm_qos_update_requirement(int qos, char *name, s32 new_value);
 void pm_qos_remove_requirement(int qos, char *name);
@@ -23,3 +49,4 @@ int pm_qos_requirement(int qos);
 int pm_qos_add_notifier(int qos, struct notifier_block *notifier);
 int pm_qos_remove_notifier(int qos, struct notifier_block *notifier);
 
+#endif
@@ -136,6 +136,7 @@ extern unsigned long nr_running(void);
 extern unsigned long nr_uninterruptible(void);
 extern unsigned long nr_active(void);
 extern unsigned long nr_iowait(void);
+extern unsigned long sched_cpu_util(int cpu);
 
 struct seq_file;
 struct cfs_rq;
@@ -2290,6 +2291,16 @@ extern void sched_move_task(struct task_struct *tsk);
 #ifdef CONFIG_FAIR_GROUP_SCHED
 extern int sched_group_set_shares(struct task_group *tg, unsigned long shares);
 extern unsigned long sched_group_shares(struct task_group *tg);
+extern int sched_group_set_wakeup_boost(struct task_group *tg, int boost);
+extern int sched_group_wakeup_boost(struct task_group *tg);
+#endif
+#ifdef CONFIG_CFS_BANDWIDTH
+extern int sched_group_set_cfs_quota(struct task_group *tg,
+				     long cfs_quota_us);
+extern long sched_group_cfs_quota(struct task_group *tg);
+extern int sched_group_set_cfs_period(struct task_group *tg,
+				      long cfs_period_us);
+extern long sched_group_cfs_period(struct task_group *tg);
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 extern int sched_group_set_rt_runtime(struct task_group *tg,
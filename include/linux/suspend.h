@@ -136,6 +136,42 @@ static inline void suspend_set_ops(struct platform_suspend_ops *ops) {}
 static inline int pm_suspend(suspend_state_t state) { return -ENOSYS; }
 #endif /* !CONFIG_SUSPEND */
 
+/* Phases of a suspend cycle, as timed by the suspend profiler */
+enum {
+	SUSPEND_PROFILE_EARLY_SUSPEND,
+	SUSPEND_PROFILE_SYNC,
+	SUSPEND_PROFILE_FREEZE,
+	SUSPEND_PROFILE_SUSPEND_DEVICES,
+	SUSPEND_PROFILE_SUSPEND_NOIRQ,
+	SUSPEND_PROFILE_SUSPEND_SYSDEV,
+	SUSPEND_PROFILE_SLEEP,
+	SUSPEND_PROFILE_RESUME_SYSDEV,
+	SUSPEND_PROFILE_RESUME_NOIRQ,
+	SUSPEND_PROFILE_RESUME_DEVICES,
+	SUSPEND_PROFILE_THAW,
+	SUSPEND_PROFILE_LATE_RESUME,
+	SUSPEND_PROFILE_NR_PHASES
+};
+
+#ifdef CONFIG_SUSPEND_PROFILE
+extern void suspend_profile_begin(void);
+extern void suspend_profile_finish(int error);
+extern void suspend_profile_start(int phase);
+extern void suspend_profile_end(int phase);
+extern void suspend_profile_abort(const char *fmt, ...)
+	__attribute__ ((format (printf, 1, 2)));
+extern void suspend_profile_callback(const char *name, s64 usecs);
+extern void suspend_profile_print_last(void);
+#else /* !CONFIG_SUSPEND_PROFILE */
+static inline void suspend_profile_begin(void) {}
+static inline void suspend_profile_finish(int error) {}
+static inline void suspend_profile_start(int phase) {}
+static inline void suspend_profile_end(int phase) {}
+static inline void suspend_profile_abort(const char *fmt, ...) {}
+static inline void suspend_profile_callback(const char *name, s64 usecs) {}
+static inline void suspend_profile_print_last(void) {}
+#endif /* !CONFIG_SUSPEND_PROFILE */
+
 /* struct pbe is used for creating lists of pages that should be restored
  * atomically during the resume from disk, because the page frames they have
  * occupied before the suspend are in use.
@@ -222,6 +222,10 @@ extern int vm_swappiness;
 extern int remove_mapping(struct address_space *mapping, struct page *page);
 extern long vm_total_pages;
 
+/* linux/mm/workingset.c */
+extern void workingset_eviction(struct address_space *mapping, pgoff_t index);
+extern int workingset_refault(struct address_space *mapping, pgoff_t index);
+
 #ifdef CONFIG_NUMA
 extern int zone_reclaim_mode;
 extern int sysctl_min_unmapped_ratio;
@@ -110,9 +110,11 @@ extern unsigned long get_next_timer_interrupt(unsigned long now);
 /*
  * Timer-statistics info:
  */
-#ifdef CONFIG_TIMER_STATS
-
 #define TIMER_STATS_FLAG_DEFERRABLE	0x1
+/* expired in the same tick or interrupt as an earlier timer */
+#define TIMER_STATS_FLAG_MERGED		0x2
+
+#ifdef CONFIG_TIMER_STATS
 
 extern void init_timer_stats(void);
 
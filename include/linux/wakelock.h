@@ -17,6 +17,8 @@
 #define _LINUX_WAKELOCK_H
 
 #include <linux/list.h>
+#include <linux/rbtree.h>
+#include <linux/spinlock.h>
 #include <linux/ktime.h>
 
 /* A wake_lock prevents the system from entering suspend or other low power
@@ -35,6 +37,8 @@ enum {
 struct wake_lock {
 #ifdef CONFIG_HAS_WAKELOCK
 	struct list_head    link;
+	struct rb_node      node;
+	spinlock_t          state_lock;
 	int                 flags;
 	const char         *name;
 	unsigned long       expires;
@@ -47,6 +51,7 @@ struct wake_lock {
 		ktime_t         prevent_suspend_time;
 		ktime_t         max_time;
 		ktime_t         last_time;
+		ktime_t         sleep_wait_mark;
 	} stat;
 #endif
 #endif
@@ -61,8 +66,8 @@ void wake_lock_timeout(struct wake_lock *lock, long timeout);
 void wake_unlock(struct wake_lock *lock);
 
 /* wake_lock_active returns a non-zero value if the wake_lock is currently
- * locked. If the wake_lock has a timeout, it does not check the timeout
- * but if the timeout had aready been checked it will return 0.
+ * locked. If the wake_lock has a timeout, it returns 0 once the timeout
+ * has passed.
  */
 int wake_lock_active(struct wake_lock *lock);
 
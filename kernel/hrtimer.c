@@ -1128,7 +1128,11 @@ int hrtimer_get_res(const clockid_t which_clock, struct timespec *tp)
 }
 EXPORT_SYMBOL_GPL(hrtimer_get_res);
 
-static void __run_hrtimer(struct hrtimer *timer)
+/*
+ * @merged: an earlier timer already caused this interrupt or tick, so
+ * this one (thanks to its slack, often) did not need a wakeup of its own.
+ */
+static void __run_hrtimer(struct hrtimer *timer, int merged)
 {
 	struct hrtimer_clock_base *base = timer->base;
 	struct hrtimer_cpu_base *cpu_base = base->cpu_base;
@@ -1139,7 +1143,8 @@ static void __run_hrtimer(struct hrtimer *timer)
 
 	debug_hrtimer_deactivate(timer);
 	__remove_hrtimer(timer, base, HRTIMER_STATE_CALLBACK, 0);
-	timer_stats_account_hrtimer(timer);
+	timer_stats_account_hrtimer(timer,
+				    merged ? TIMER_STATS_FLAG_MERGED : 0);
 	fn = timer->function;
 
 	/*
@@ -1198,6 +1203,7 @@ void hrtimer_interrupt(struct clock_event_device *dev)
 	struct hrtimer_clock_base *base;
 	ktime_t expires_next, now;
 	int nr_retries = 0;
+	int nr_run = 0;
 	int i;
 
 	BUG_ON(!cpu_base->hres_active);
@@ -1251,7 +1257,7 @@ void hrtimer_interrupt(struct clock_event_device *dev)
 				break;
 			}
 
-			__run_hrtimer(timer);
+			__run_hrtimer(timer, nr_run++);
 		}
 		spin_unlock(&cpu_base->lock);
 		base++;
@@ -1344,6 +1350,7 @@ void hrtimer_run_queues(void)
 	struct hrtimer_cpu_base *cpu_base = &__get_cpu_var(hrtimer_bases);
 	struct hrtimer_clock_base *base;
 	int index, gettime = 1;
+	int nr_run = 0;
 
 	if (hrtimer_hres_active())
 		return;
@@ -1369,7 +1376,7 @@ void hrtimer_run_queues(void)
 					hrtimer_get_expires_tv64(timer))
 				break;
 
-			__run_hrtimer(timer);
+			__run_hrtimer(timer, nr_run++);
 		}
 		spin_unlock(&cpu_base->lock);
 	}
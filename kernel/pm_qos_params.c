@@ -13,9 +13,18 @@
  * latency: usec
  * timeout: usec <-- currently not used.
  * throughput: kbs (kilo byte / sec)
+ * cpu frequency floor and ceiling: kHz
  *
  * There are lists of pm_qos_objects each one wrapping requirements, notifiers
  *
+ * The requirements of each pm_qos_object are kept in a plist sorted by
+ * value, so the target is the first or the last of them, and is found
+ * without walking the list.  Drivers that change their requirement often
+ * keep a struct pm_qos_request for it, which needs no allocation or
+ * search by name; the name based interface is built on top of it.  The
+ * requests, and which of them sets each target, are shown in
+ * /sys/kernel/debug/pm_qos.
+ *
  * User mode requirements on a QOS parameter register themselves to the
  * subsystem by opening the device node /dev/... and writing there request to
  * the node.  As long as the process holds a file handle open to the node the
@@ -39,6 +48,7 @@
 #include <linux/string.h>
 #include <linux/platform_device.h>
 #include <linux/init.h>
+#include <linux/debugfs.h>
 
 #include <linux/uaccess.h>
 
@@ -47,60 +57,90 @@
  * or pm_qos_object list and pm_qos_objects need to happen with pm_qos_lock
  * held, taken with _irqsave.  One lock to rule them all
  */
+static DEFINE_SPINLOCK(pm_qos_lock);
+
+/* a requirement made through the name based interface */
 struct requirement_list {
 	struct list_head list;
-	union {
-		s32 value;
-		s32 usec;
-		s32 kbps;
-	};
+	struct pm_qos_request req;
 	char *name;
 };
 
-static s32 max_compare(s32 v1, s32 v2);
-static s32 min_compare(s32 v1, s32 v2);
+enum pm_qos_type {
+	PM_QOS_MAX,		/* the highest requirement wins */
+	PM_QOS_MIN,		/* the lowest requirement wins */
+};
+
+#define PM_QOS_OWNER_LEN 32
 
 struct pm_qos_object {
-	struct requirement_list requirements;
+	struct plist_head requests;
+	struct list_head named;		/* the requirement_lists */
 	struct blocking_notifier_head *notifiers;
 	struct miscdevice pm_qos_power_miscdev;
 	char *name;
 	s32 default_value;
 	atomic_t target_value;
-	s32 (*comparitor)(s32, s32);
+	enum pm_qos_type type;
+	char owner[PM_QOS_OWNER_LEN];	/* who set target_value */
 };
 
 static struct pm_qos_object null_pm_qos;
 static BLOCKING_NOTIFIER_HEAD(cpu_dma_lat_notifier);
 static struct pm_qos_object cpu_dma_pm_qos = {
-	.requirements = {LIST_HEAD_INIT(cpu_dma_pm_qos.requirements.list)},
+	.requests = PLIST_HEAD_INIT(cpu_dma_pm_qos.requests, pm_qos_lock),
+	.named = LIST_HEAD_INIT(cpu_dma_pm_qos.named),
 	.notifiers = &cpu_dma_lat_notifier,
 	.name = "cpu_dma_latency",
 	.default_value = 2000 * USEC_PER_SEC,
 	.target_value = ATOMIC_INIT(2000 * USEC_PER_SEC),
-	.comparitor = min_compare
+	.type = PM_QOS_MIN,
 };
 
 static BLOCKING_NOTIFIER_HEAD(network_lat_notifier);
 static struct pm_qos_object network_lat_pm_qos = {
-	.requirements = {LIST_HEAD_INIT(network_lat_pm_qos.requirements.list)},
+	.requests = PLIST_HEAD_INIT(network_lat_pm_qos.requests, pm_qos_lock),
+	.named = LIST_HEAD_INIT(network_lat_pm_qos.named),
 	.notifiers = &network_lat_notifier,
 	.name = "network_latency",
 	.default_value = 2000 * USEC_PER_SEC,
 	.target_value = ATOMIC_INIT(2000 * USEC_PER_SEC),
-	.comparitor = min_compare
+	.type = PM_QOS_MIN,
 };
 
 
 static BLOCKING_NOTIFIER_HEAD(network_throughput_notifier);
 static struct pm_qos_object network_throughput_pm_qos = {
-	.requirements =
-		{LIST_HEAD_INIT(network_throughput_pm_qos.requirements.list)},
+	.requests = PLIST_HEAD_INIT(network_throughput_pm_qos.requests,
+				    pm_qos_lock),
+	.named = LIST_HEAD_INIT(network_throughput_pm_qos.named),
 	.notifiers = &network_throughput_notifier,
 	.name = "network_throughput",
 	.default_value = 0,
 	.target_value = ATOMIC_INIT(0),
-	.comparitor = max_compare
+	.type = PM_QOS_MAX,
+};
+
+static BLOCKING_NOTIFIER_HEAD(cpu_freq_min_notifier);
+static struct pm_qos_object cpu_freq_min_pm_qos = {
+	.requests = PLIST_HEAD_INIT(cpu_freq_min_pm_qos.requests, pm_qos_lock),
+	.named = LIST_HEAD_INIT(cpu_freq_min_pm_qos.named),
+	.notifiers = &cpu_freq_min_notifier,
+	.name = "cpu_freq_min",
+	.default_value = PM_QOS_CPU_FREQ_MIN_DEFAULT_VALUE,
+	.target_value = ATOMIC_INIT(PM_QOS_CPU_FREQ_MIN_DEFAULT_VALUE),
+	.type = PM_QOS_MAX,
+};
+
+static BLOCKING_NOTIFIER_HEAD(cpu_freq_max_notifier);
+static struct pm_qos_object cpu_freq_max_pm_qos = {
+	.requests = PLIST_HEAD_INIT(cpu_freq_max_pm_qos.requests, pm_qos_lock),
+	.named = LIST_HEAD_INIT(cpu_freq_max_pm_qos.named),
+	.notifiers = &cpu_freq_max_notifier,
+	.name = "cpu_freq_max",
+	.default_value = PM_QOS_CPU_FREQ_MAX_DEFAULT_VALUE,
+	.target_value = ATOMIC_INIT(PM_QOS_CPU_FREQ_MAX_DEFAULT_VALUE),
+	.type = PM_QOS_MIN,
 };
 
 
@@ -108,11 +148,11 @@ static struct pm_qos_object *pm_qos_array[] = {
 	&null_pm_qos,
 	&cpu_dma_pm_qos,
 	&network_lat_pm_qos,
-	&network_throughput_pm_qos
+	&network_throughput_pm_qos,
+	&cpu_freq_min_pm_qos,
+	&cpu_freq_max_pm_qos,
 };
 
-static DEFINE_SPINLOCK(pm_qos_lock);
-
 static ssize_t pm_qos_power_write(struct file *filp, const char __user *buf,
 		size_t count, loff_t *f_pos);
 static int pm_qos_power_open(struct inode *inode, struct file *filp);
@@ -125,42 +165,76 @@ static const struct file_operations pm_qos_power_fops = {
 };
 
 /* static helper functions */
-static s32 max_compare(s32 v1, s32 v2)
+
+/* the request that sets the target, called with pm_qos_lock held */
+static struct pm_qos_request *pm_qos_top_request(struct pm_qos_object *o)
 {
-	return max(v1, v2);
+	struct plist_node *node;
+
+	if (plist_head_empty(&o->requests))
+		return NULL;
+
+	if (o->type == PM_QOS_MIN)
+		node = plist_first(&o->requests);
+	else
+		node = plist_last(&o->requests);
+	return container_of(node, struct pm_qos_request, node);
 }
 
-static s32 min_compare(s32 v1, s32 v2)
+/*
+ * Take @req out of its class, and put it back with @value unless @del is
+ * set.  Called with pm_qos_lock held; returns 1 if that changed the
+ * target, which the caller passes on with pm_qos_notify() once it has
+ * dropped the lock.
+ */
+static int __update_target(struct pm_qos_request *req, int del, s32 value)
 {
-	return min(v1, v2);
+	struct pm_qos_object *o = pm_qos_array[req->pm_qos_class];
+	struct pm_qos_request *top;
+	s32 extreme_value;
+
+	if (value == PM_QOS_DEFAULT_VALUE)
+		value = o->default_value;
+
+	if (!plist_node_empty(&req->node))
+		plist_del(&req->node, &o->requests);
+	if (!del) {
+		plist_node_init(&req->node, value);
+		plist_add(&req->node, &o->requests);
+	}
+
+	top = pm_qos_top_request(o);
+	extreme_value = top ? top->node.prio : o->default_value;
+	if (atomic_read(&o->target_value) == extreme_value)
+		return 0;
+
+	atomic_set(&o->target_value, extreme_value);
+	strlcpy(o->owner, top ? top->name : "default", sizeof(o->owner));
+	pr_debug("pm_qos: new target for %s is %d, set by %s\n",
+		 o->name, extreme_value, o->owner);
+	return 1;
 }
 
+static void pm_qos_notify(int pm_qos_class)
+{
+	struct pm_qos_object *o = pm_qos_array[pm_qos_class];
+
+	blocking_notifier_call_chain(o->notifiers,
+			(unsigned long) atomic_read(&o->target_value), NULL);
+}
 
-static void update_target(int target)
+/* The watchers are told if this changes the target. */
+static void update_target(struct pm_qos_request *req, int del, s32 value)
 {
-	s32 extreme_value;
-	struct requirement_list *node;
 	unsigned long flags;
-	int call_notifier = 0;
+	int changed;
 
 	spin_lock_irqsave(&pm_qos_lock, flags);
-	extreme_value = pm_qos_array[target]->default_value;
-	list_for_each_entry(node,
-			&pm_qos_array[target]->requirements.list, list) {
-		extreme_value = pm_qos_array[target]->comparitor(
-				extreme_value, node->value);
-	}
-	if (atomic_read(&pm_qos_array[target]->target_value) != extreme_value) {
-		call_notifier = 1;
-		atomic_set(&pm_qos_array[target]->target_value, extreme_value);
-		pr_debug(KERN_ERR "new target for qos %d is %d\n", target,
-			atomic_read(&pm_qos_array[target]->target_value));
-	}
+	changed = __update_target(req, del, value);
 	spin_unlock_irqrestore(&pm_qos_lock, flags);
 
-	if (call_notifier)
-		blocking_notifier_call_chain(pm_qos_array[target]->notifiers,
-			(unsigned long) extreme_value, NULL);
+	if (changed)
+		pm_qos_notify(req->pm_qos_class);
 }
 
 static int register_pm_qos_misc(struct pm_qos_object *qos)
@@ -197,6 +271,62 @@ int pm_qos_requirement(int pm_qos_class)
 }
 EXPORT_SYMBOL_GPL(pm_qos_requirement);
 
+/**
+ * pm_qos_add_request - inserts a caller owned qos request
+ * @req: the request, owned by the caller until it is removed
+ * @pm_qos_class: identifies which list of qos request to use
+ * @name: identifies the request, not copied
+ * @value: defines the qos request
+ *
+ * Adds @req to the pm_qos_class list of requested qos performance
+ * characteristics and recomputes the aggregate QoS expectation.
+ */
+void pm_qos_add_request(struct pm_qos_request *req, int pm_qos_class,
+			const char *name, s32 value)
+{
+	req->pm_qos_class = pm_qos_class;
+	req->name = name;
+	plist_node_init(&req->node, 0);
+	update_target(req, 0, value);
+}
+EXPORT_SYMBOL_GPL(pm_qos_add_request);
+
+/**
+ * pm_qos_update_request - modifies a qos request
+ * @req: a request added with pm_qos_add_request
+ * @new_value: defines the qos request
+ */
+void pm_qos_update_request(struct pm_qos_request *req, s32 new_value)
+{
+	update_target(req, 0, new_value);
+}
+EXPORT_SYMBOL_GPL(pm_qos_update_request);
+
+/**
+ * pm_qos_remove_request - removes a qos request
+ * @req: a request added with pm_qos_add_request
+ *
+ * After this the caller may free @req.
+ */
+void pm_qos_remove_request(struct pm_qos_request *req)
+{
+	update_target(req, 1, 0);
+}
+EXPORT_SYMBOL_GPL(pm_qos_remove_request);
+
+/* called with pm_qos_lock held */
+static struct requirement_list *find_requirement(int pm_qos_class,
+						 const char *name)
+{
+	struct requirement_list *node;
+
+	list_for_each_entry(node, &pm_qos_array[pm_qos_class]->named, list) {
+		if (strcmp(node->name, name) == 0)
+			return node;
+	}
+	return NULL;
+}
+
 /**
  * pm_qos_add_requirement - inserts new qos request into the list
  * @pm_qos_class: identifies which list of qos request to us
@@ -211,23 +341,26 @@ int pm_qos_add_requirement(int pm_qos_class, char *name, s32 value)
 {
 	struct requirement_list *dep;
 	unsigned long flags;
+	int changed;
 
 	dep = kzalloc(sizeof(struct requirement_list), GFP_KERNEL);
 	if (dep) {
-		if (value == PM_QOS_DEFAULT_VALUE)
-			dep->value = pm_qos_array[pm_qos_class]->default_value;
-		else
-			dep->value = value;
 		dep->name = kstrdup(name, GFP_KERNEL);
 		if (!dep->name)
 			goto cleanup;
 
+		dep->req.pm_qos_class = pm_qos_class;
+		dep->req.name = dep->name;
+		plist_node_init(&dep->req.node, 0);
+
+		/* findable by name only once it is in the list */
 		spin_lock_irqsave(&pm_qos_lock, flags);
-		list_add(&dep->list,
-			&pm_qos_array[pm_qos_class]->requirements.list);
+		list_add(&dep->list, &pm_qos_array[pm_qos_class]->named);
+		changed = __update_target(&dep->req, 0, value);
 		spin_unlock_irqrestore(&pm_qos_lock, flags);
-		update_target(pm_qos_class);
 
+		if (changed)
+			pm_qos_notify(pm_qos_class);
 		return 0;
 	}
 
@@ -252,25 +385,17 @@ int pm_qos_update_requirement(int pm_qos_class, char *name, s32 new_value)
 {
 	unsigned long flags;
 	struct requirement_list *node;
-	int pending_update = 0;
+	int changed = 0;
 
+	/* under the lock, so pm_qos_remove_requirement() can't free it */
 	spin_lock_irqsave(&pm_qos_lock, flags);
-	list_for_each_entry(node,
-		&pm_qos_array[pm_qos_class]->requirements.list, list) {
-		if (strcmp(node->name, name) == 0) {
-			if (new_value == PM_QOS_DEFAULT_VALUE)
-				node->value =
-				pm_qos_array[pm_qos_class]->default_value;
-			else
-				node->value = new_value;
-			pending_update = 1;
-			break;
-		}
-	}
+	node = find_requirement(pm_qos_class, name);
+	if (node)
+		changed = __update_target(&node->req, 0, new_value);
 	spin_unlock_irqrestore(&pm_qos_lock, flags);
-	if (pending_update)
-		update_target(pm_qos_class);
 
+	if (changed)
+		pm_qos_notify(pm_qos_class);
 	return 0;
 }
 EXPORT_SYMBOL_GPL(pm_qos_update_requirement);
@@ -287,22 +412,22 @@ void pm_qos_remove_requirement(int pm_qos_class, char *name)
 {
 	unsigned long flags;
 	struct requirement_list *node;
-	int pending_update = 0;
+	int changed = 0;
 
 	spin_lock_irqsave(&pm_qos_lock, flags);
-	list_for_each_entry(node,
-		&pm_qos_array[pm_qos_class]->requirements.list, list) {
-		if (strcmp(node->name, name) == 0) {
-			kfree(node->name);
-			list_del(&node->list);
-			kfree(node);
-			pending_update = 1;
-			break;
-		}
+	node = find_requirement(pm_qos_class, name);
+	if (node) {
+		list_del(&node->list);
+		changed = __update_target(&node->req, 1, 0);
 	}
 	spin_unlock_irqrestore(&pm_qos_lock, flags);
-	if (pending_update)
-		update_target(pm_qos_class);
+
+	if (changed)
+		pm_qos_notify(pm_qos_class);
+	if (node) {
+		kfree(node->name);
+		kfree(node);
+	}
 }
 EXPORT_SYMBOL_GPL(pm_qos_remove_requirement);
 
@@ -345,37 +470,39 @@ int pm_qos_remove_notifier(int pm_qos_class, struct notifier_block *notifier)
 EXPORT_SYMBOL_GPL(pm_qos_remove_notifier);
 
 #define PID_NAME_LEN sizeof("process_1234567890")
-static char name[PID_NAME_LEN];
+
+/* what a process that has one of the device nodes open asks for */
+struct pm_qos_file_request {
+	struct pm_qos_request req;
+	char name[PID_NAME_LEN];
+};
 
 static int pm_qos_power_open(struct inode *inode, struct file *filp)
 {
-	int ret;
+	struct pm_qos_file_request *freq;
 	long pm_qos_class;
 
-	lock_kernel();
 	pm_qos_class = find_pm_qos_object_by_minor(iminor(inode));
-	if (pm_qos_class >= 0) {
-		filp->private_data = (void *)pm_qos_class;
-		sprintf(name, "process_%d", current->pid);
-		ret = pm_qos_add_requirement(pm_qos_class, name,
-					PM_QOS_DEFAULT_VALUE);
-		if (ret >= 0) {
-			unlock_kernel();
-			return 0;
-		}
-	}
-	unlock_kernel();
+	if (pm_qos_class < 0)
+		return -EPERM;
 
-	return -EPERM;
+	freq = kzalloc(sizeof(*freq), GFP_KERNEL);
+	if (!freq)
+		return -ENOMEM;
+
+	snprintf(freq->name, sizeof(freq->name), "process_%d", current->pid);
+	pm_qos_add_request(&freq->req, pm_qos_class, freq->name,
+			   PM_QOS_DEFAULT_VALUE);
+	filp->private_data = freq;
+	return 0;
 }
 
 static int pm_qos_power_release(struct inode *inode, struct file *filp)
 {
-	int pm_qos_class;
+	struct pm_qos_file_request *freq = filp->private_data;
 
-	pm_qos_class = (long)filp->private_data;
-	sprintf(name, "process_%d", current->pid);
-	pm_qos_remove_requirement(pm_qos_class, name);
+	pm_qos_remove_request(&freq->req);
+	kfree(freq);
 
 	return 0;
 }
@@ -383,25 +510,75 @@ static int pm_qos_power_release(struct inode *inode, struct file *filp)
 static ssize_t pm_qos_power_write(struct file *filp, const char __user *buf,
 		size_t count, loff_t *f_pos)
 {
+	struct pm_qos_file_request *freq = filp->private_data;
 	s32 value;
-	int pm_qos_class;
 
-	pm_qos_class = (long)filp->private_data;
 	if (count != sizeof(s32))
 		return -EINVAL;
 	if (copy_from_user(&value, buf, sizeof(s32)))
 		return -EFAULT;
-	sprintf(name, "process_%d", current->pid);
-	pm_qos_update_requirement(pm_qos_class, name, value);
+	pm_qos_update_request(&freq->req, value);
 
 	return  sizeof(s32);
 }
 
+#if defined(CONFIG_DEBUG_FS)
+
+#define DEBUG_BUFMAX 4096
+
+static ssize_t debug_read_requests(struct file *file, char __user *ubuf,
+				   size_t count, loff_t *ppos)
+{
+	struct pm_qos_object *o;
+	struct pm_qos_request *req;
+	unsigned long flags;
+	char *buf;
+	int pm_qos_class;
+	int n = 0;
+	ssize_t ret;
+
+	buf = kmalloc(DEBUG_BUFMAX, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&pm_qos_lock, flags);
+	for (pm_qos_class = 1; pm_qos_class < PM_QOS_NUM_CLASSES;
+	     pm_qos_class++) {
+		o = pm_qos_array[pm_qos_class];
+		n += scnprintf(buf + n, DEBUG_BUFMAX - n,
+			       "%s: %d, set by %s\n", o->name,
+			       atomic_read(&o->target_value),
+			       o->owner[0] ? o->owner : "default");
+		plist_for_each_entry(req, &o->requests, node)
+			n += scnprintf(buf + n, DEBUG_BUFMAX - n,
+				       "  %-24s %d\n", req->name,
+				       req->node.prio);
+	}
+	spin_unlock_irqrestore(&pm_qos_lock, flags);
+
+	ret = simple_read_from_buffer(ubuf, count, ppos, buf, n);
+	kfree(buf);
+	return ret;
+}
+
+static const struct file_operations debug_requests_fops = {
+	.read = debug_read_requests,
+};
+
+static void __init pm_qos_debug_init(void)
+{
+	debugfs_create_file("pm_qos", 0444, NULL, NULL, &debug_requests_fops);
+}
+#else
+static inline void pm_qos_debug_init(void) { }
+#endif
 
 static int __init pm_qos_power_init(void)
 {
 	int ret = 0;
 
+	pm_qos_debug_init();
+
 	ret = register_pm_qos_misc(&cpu_dma_pm_qos);
 	if (ret < 0) {
 		printk(KERN_ERR "pm_qos_param: cpu_dma_latency setup failed\n");
@@ -413,9 +590,19 @@ static int __init pm_qos_power_init(void)
 		return ret;
 	}
 	ret = register_pm_qos_misc(&network_throughput_pm_qos);
-	if (ret < 0)
+	if (ret < 0) {
 		printk(KERN_ERR
 			"pm_qos_param: network_throughput setup failed\n");
+		return ret;
+	}
+	ret = register_pm_qos_misc(&cpu_freq_min_pm_qos);
+	if (ret < 0) {
+		printk(KERN_ERR "pm_qos_param: cpu_freq_min setup failed\n");
+		return ret;
+	}
+	ret = register_pm_qos_misc(&cpu_freq_max_pm_qos);
+	if (ret < 0)
+		printk(KERN_ERR "pm_qos_param: cpu_freq_max setup failed\n");
 
 	return ret;
 }
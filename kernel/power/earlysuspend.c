@@ -13,10 +13,12 @@
  *
  */
 
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/seq_file.h>
 #include <linux/syscalls.h> /* sys_sync */
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
@@ -30,8 +32,29 @@ enum {
 static int debug_mask = DEBUG_USER_STATE;
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * The handlers of one level are spread over up to "parallel" threads of
+ * their own, and every one of them has returned before the next level
+ * starts.  Levels therefore stay strictly ordered; within a level only
+ * handlers given to the same thread keep their registration order.
+ * parallel <= 1 calls every handler in order from the suspend work.
+ */
+#define EARLY_SUSPEND_THREADS 4
+static int parallel = EARLY_SUSPEND_THREADS;
+module_param_named(parallel, parallel, int, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static const char *early_suspend_wq_names[EARLY_SUSPEND_THREADS] = {
+	"early_suspend/0", "early_suspend/1",
+	"early_suspend/2", "early_suspend/3",
+};
+static struct workqueue_struct *early_suspend_wq[EARLY_SUSPEND_THREADS];
+static int nr_early_suspend_wq;
+static int resuming;
+
 static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
+static ktime_t last_early_suspend_time;
+static ktime_t last_late_resume_time;
 static void early_suspend(struct work_struct *work);
 static void late_resume(struct work_struct *work);
 static DECLARE_WORK(early_suspend_work, early_suspend);
@@ -44,10 +67,80 @@ enum {
 };
 static int state;
 
+static void update_stat(ktime_t *last, ktime_t *max, ktime_t start)
+{
+	*last = ktime_sub(ktime_get(), start);
+	if (last->tv64 > max->tv64)
+		*max = *last;
+}
+
+static void call_suspend(struct early_suspend *handler)
+{
+	ktime_t start = ktime_get();
+
+	handler->suspend(handler);
+	update_stat(&handler->stat.last_suspend, &handler->stat.max_suspend,
+		    start);
+}
+
+static void call_resume(struct early_suspend *handler)
+{
+	ktime_t start = ktime_get();
+
+	handler->resume(handler);
+	update_stat(&handler->stat.last_resume, &handler->stat.max_resume,
+		    start);
+}
+
+static void early_suspend_handler_work(struct work_struct *work)
+{
+	struct early_suspend *handler =
+		container_of(work, struct early_suspend, work);
+
+	if (resuming)
+		call_resume(handler);
+	else
+		call_suspend(handler);
+}
+
+static int early_suspend_threads(void)
+{
+	return min(parallel, nr_early_suspend_wq);
+}
+
+static void sync_handlers(int threads)
+{
+	int i;
+
+	for (i = 0; i < threads; i++)
+		flush_workqueue(early_suspend_wq[i]);
+}
+
+/* Caller holds early_suspend_lock */
+static void call_handler(struct early_suspend *handler, int threads,
+			 int *level, int *n)
+{
+	if (threads <= 1) {
+		if (resuming)
+			call_resume(handler);
+		else
+			call_suspend(handler);
+		return;
+	}
+	if (handler->level != *level) {
+		sync_handlers(threads);
+		*level = handler->level;
+		*n = 0;
+	}
+	queue_work(early_suspend_wq[(*n)++ % threads], &handler->work);
+}
+
 void register_early_suspend(struct early_suspend *handler)
 {
 	struct list_head *pos;
 
+	memset(&handler->stat, 0, sizeof(handler->stat));
+	INIT_WORK(&handler->work, early_suspend_handler_work);
 	mutex_lock(&early_suspend_lock);
 	list_for_each(pos, &early_suspend_handlers) {
 		struct early_suspend *e;
@@ -57,7 +150,7 @@ void register_early_suspend(struct early_suspend *handler)
 	}
 	list_add_tail(&handler->link, pos);
 	if ((state & SUSPENDED) && handler->suspend)
-		handler->suspend(handler);
+		call_suspend(handler);
 	mutex_unlock(&early_suspend_lock);
 }
 EXPORT_SYMBOL(register_early_suspend);
@@ -75,6 +168,9 @@ static void early_suspend(struct work_struct *work)
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	int level = INT_MIN;
+	int threads, n = 0;
+	ktime_t start;
 
 	pr_info("[R] early_suspend start\n");
 	mutex_lock(&early_suspend_lock);
@@ -94,10 +190,17 @@ static void early_suspend(struct work_struct *work)
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
+	suspend_profile_start(SUSPEND_PROFILE_EARLY_SUSPEND);
+	start = ktime_get();
+	threads = early_suspend_threads();
+	resuming = 0;
 	list_for_each_entry(pos, &early_suspend_handlers, link) {
 		if (pos->suspend != NULL)
-			pos->suspend(pos);
+			call_handler(pos, threads, &level, &n);
 	}
+	sync_handlers(threads);
+	last_early_suspend_time = ktime_sub(ktime_get(), start);
+	suspend_profile_end(SUSPEND_PROFILE_EARLY_SUSPEND);
 	mutex_unlock(&early_suspend_lock);
 
 	if (debug_mask & DEBUG_SUSPEND)
@@ -117,6 +220,9 @@ static void late_resume(struct work_struct *work)
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	int level = INT_MIN;
+	int threads, n = 0;
+	ktime_t start;
 
 	pr_info("[R] late_resume start\n");
 	mutex_lock(&early_suspend_lock);
@@ -134,11 +240,19 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
+	suspend_profile_start(SUSPEND_PROFILE_LATE_RESUME);
+	start = ktime_get();
+	threads = early_suspend_threads();
+	resuming = 1;
 	list_for_each_entry_reverse(pos, &early_suspend_handlers, link)
 		if (pos->resume != NULL)
-			pos->resume(pos);
+			call_handler(pos, threads, &level, &n);
+	sync_handlers(threads);
+	last_late_resume_time = ktime_sub(ktime_get(), start);
+	suspend_profile_end(SUSPEND_PROFILE_LATE_RESUME);
 	if (debug_mask & DEBUG_SUSPEND)
-		pr_info("late_resume: done\n");
+		pr_info("late_resume: done in %lld us\n",
+			ktime_to_us(last_late_resume_time));
 abort:
 	mutex_unlock(&early_suspend_lock);
 	pr_info("[R] late_resume end\n");
@@ -180,3 +294,77 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+static int __init early_suspend_init(void)
+{
+	int i;
+
+	for (i = 0; i < EARLY_SUSPEND_THREADS; i++) {
+		const char *name = early_suspend_wq_names[i];
+
+		early_suspend_wq[i] = create_singlethread_workqueue(name);
+		if (!early_suspend_wq[i])
+			break;
+	}
+	nr_early_suspend_wq = i;
+	return 0;
+}
+core_initcall(early_suspend_init);
+
+#ifdef CONFIG_DEBUG_FS
+static int early_suspend_stats_show(struct seq_file *m, void *unused)
+{
+	struct early_suspend *pos;
+
+	mutex_lock(&early_suspend_lock);
+	seq_printf(m, "early_suspend %lld us, late_resume %lld us\n",
+		   ktime_to_us(last_early_suspend_time),
+		   ktime_to_us(last_late_resume_time));
+	seq_puts(m, "level\tsuspend\tmax_suspend\tresume\tmax_resume"
+		 "\thandler\n");
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		seq_printf(m, "%d\t%lld\t%lld\t%lld\t%lld\t%pF\n",
+			   pos->level, ktime_to_us(pos->stat.last_suspend),
+			   ktime_to_us(pos->stat.max_suspend),
+			   ktime_to_us(pos->stat.last_resume),
+			   ktime_to_us(pos->stat.max_resume),
+			   pos->suspend ? (void *)pos->suspend :
+					  (void *)pos->resume);
+	mutex_unlock(&early_suspend_lock);
+	return 0;
+}
+
+static int early_suspend_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_stats_show, NULL);
+}
+
+static ssize_t early_suspend_stats_clear(struct file *file,
+					 const char __user *buf,
+					 size_t count, loff_t *ppos)
+{
+	struct early_suspend *pos;
+
+	mutex_lock(&early_suspend_lock);
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		memset(&pos->stat, 0, sizeof(pos->stat));
+	mutex_unlock(&early_suspend_lock);
+	return count;
+}
+
+static const struct file_operations early_suspend_stats_fops = {
+	.open = early_suspend_stats_open,
+	.read = seq_read,
+	.write = early_suspend_stats_clear,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init early_suspend_debug_init(void)
+{
+	debugfs_create_file("early_suspend", 0644, NULL, NULL,
+			    &early_suspend_stats_fops);
+	return 0;
+}
+late_initcall(early_suspend_debug_init);
+#endif
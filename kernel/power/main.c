@@ -54,6 +54,32 @@ int pm_notifier_call_chain(unsigned long val)
 			== NOTIFY_BAD) ? -EINVAL : 0;
 }
 
+/* If set, devices may be suspended and resumed asynchronously. */
+int pm_async_enabled = 1;
+
+static ssize_t pm_async_show(struct kobject *kobj, struct kobj_attribute *attr,
+			     char *buf)
+{
+	return sprintf(buf, "%d\n", pm_async_enabled);
+}
+
+static ssize_t pm_async_store(struct kobject *kobj, struct kobj_attribute *attr,
+			      const char *buf, size_t n)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 10, &val))
+		return -EINVAL;
+
+	if (val > 1)
+		return -EINVAL;
+
+	pm_async_enabled = val;
+	return n;
+}
+
+power_attr(pm_async);
+
 #ifdef CONFIG_PM_DEBUG
 int pm_test_level = TEST_NONE;
 
@@ -293,19 +319,36 @@ static int suspend_enter(suspend_state_t state)
 	arch_suspend_disable_irqs();
 	BUG_ON(!irqs_disabled());
 
-	if ((error = device_power_down(PMSG_SUSPEND))) {
+	suspend_profile_start(SUSPEND_PROFILE_SUSPEND_NOIRQ);
+	error = device_power_down(PMSG_SUSPEND);
+	suspend_profile_end(SUSPEND_PROFILE_SUSPEND_NOIRQ);
+	if (error) {
 		printk(KERN_ERR "PM: Some devices failed to power down\n");
+		suspend_profile_abort("device power down: %d", error);
 		goto Done;
 	}
 
+	suspend_profile_start(SUSPEND_PROFILE_SUSPEND_SYSDEV);
 	error = sysdev_suspend(PMSG_SUSPEND);
+	suspend_profile_end(SUSPEND_PROFILE_SUSPEND_SYSDEV);
 	if (!error) {
-		if (!suspend_test(TEST_CORE))
+		if (!suspend_test(TEST_CORE)) {
+			suspend_profile_start(SUSPEND_PROFILE_SLEEP);
 			error = suspend_ops->enter(state);
+			suspend_profile_end(SUSPEND_PROFILE_SLEEP);
+			if (error)
+				suspend_profile_abort("enter: %d", error);
+		} else
+			suspend_profile_abort("pm_test core");
+		suspend_profile_start(SUSPEND_PROFILE_RESUME_SYSDEV);
 		sysdev_resume();
-	}
+		suspend_profile_end(SUSPEND_PROFILE_RESUME_SYSDEV);
+	} else
+		suspend_profile_abort("sysdev suspend: %d", error);
 
+	suspend_profile_start(SUSPEND_PROFILE_RESUME_NOIRQ);
 	device_power_up(PMSG_RESUME);
+	suspend_profile_end(SUSPEND_PROFILE_RESUME_NOIRQ);
  Done:
 	arch_suspend_enable_irqs();
 	BUG_ON(irqs_disabled());
@@ -327,31 +370,46 @@ int suspend_devices_and_enter(suspend_state_t state)
 
 	if (suspend_ops->begin) {
 		error = suspend_ops->begin(state);
-		if (error)
+		if (error) {
+			suspend_profile_abort("platform begin: %d", error);
 			goto Close;
+		}
 	}
 	suspend_console();
 	suspend_test_start();
+	suspend_profile_start(SUSPEND_PROFILE_SUSPEND_DEVICES);
 	error = device_suspend(PMSG_SUSPEND);
+	suspend_profile_end(SUSPEND_PROFILE_SUSPEND_DEVICES);
 	if (error) {
 		printk(KERN_ERR "PM: Some devices failed to suspend\n");
+		suspend_profile_abort("device suspend: %d", error);
 		goto Recover_platform;
 	}
 	suspend_test_finish("suspend devices");
-	if (suspend_test(TEST_DEVICES))
+	if (suspend_test(TEST_DEVICES)) {
+		suspend_profile_abort("pm_test devices");
 		goto Recover_platform;
+	}
 
 	if (suspend_ops->prepare) {
 		error = suspend_ops->prepare();
-		if (error)
+		if (error) {
+			suspend_profile_abort("platform prepare: %d", error);
 			goto Resume_devices;
+		}
 	}
 
-	if (suspend_test(TEST_PLATFORM))
+	if (suspend_test(TEST_PLATFORM)) {
+		suspend_profile_abort("pm_test platform");
 		goto Finish;
+	}
 
 	error = disable_nonboot_cpus();
-	if (!error && !suspend_test(TEST_CPUS))
+	if (error)
+		suspend_profile_abort("disable nonboot cpus: %d", error);
+	else if (suspend_test(TEST_CPUS))
+		suspend_profile_abort("pm_test processors");
+	else
 		suspend_enter(state);
 
 	enable_nonboot_cpus();
@@ -360,7 +418,9 @@ int suspend_devices_and_enter(suspend_state_t state)
 		suspend_ops->finish();
  Resume_devices:
 	suspend_test_start();
+	suspend_profile_start(SUSPEND_PROFILE_RESUME_DEVICES);
 	device_resume(PMSG_RESUME);
+	suspend_profile_end(SUSPEND_PROFILE_RESUME_DEVICES);
 	suspend_test_finish("resume devices");
 	resume_console();
  Close:
@@ -430,25 +490,37 @@ static int enter_state(suspend_state_t state)
 	if (!mutex_trylock(&pm_mutex))
 		return -EBUSY;
 
+	suspend_profile_begin();
 	printk(KERN_INFO "PM: Syncing filesystems ... ");
+	suspend_profile_start(SUSPEND_PROFILE_SYNC);
 	sys_sync();
+	suspend_profile_end(SUSPEND_PROFILE_SYNC);
 	printk("done.\n");
 
 	pr_debug("PM: Preparing system for %s sleep\n", pm_states[state]);
+	suspend_profile_start(SUSPEND_PROFILE_FREEZE);
 	error = suspend_prepare();
-	if (error)
+	suspend_profile_end(SUSPEND_PROFILE_FREEZE);
+	if (error) {
+		suspend_profile_abort("prepare: %d", error);
 		goto Unlock;
+	}
 
-	if (suspend_test(TEST_FREEZER))
+	if (suspend_test(TEST_FREEZER)) {
+		suspend_profile_abort("pm_test freezer");
 		goto Finish;
+	}
 
 	pr_debug("PM: Entering %s sleep\n", pm_states[state]);
 	error = suspend_devices_and_enter(state);
 
  Finish:
 	pr_debug("PM: Finishing wakeup.\n");
+	suspend_profile_start(SUSPEND_PROFILE_THAW);
 	suspend_finish();
+	suspend_profile_end(SUSPEND_PROFILE_THAW);
  Unlock:
+	suspend_profile_finish(error);
 	mutex_unlock(&pm_mutex);
 	return error;
 }
@@ -589,9 +661,12 @@ static struct attribute * g[] = {
 #ifdef CONFIG_PM_TRACE
 	&pm_trace_attr.attr,
 #endif
-#if defined(CONFIG_PM_SLEEP) && defined(CONFIG_PM_DEBUG)
+#ifdef CONFIG_PM_SLEEP
+	&pm_async_attr.attr,
+#ifdef CONFIG_PM_DEBUG
 	&pm_test_attr.attr,
 #endif
+#endif
 #ifdef CONFIG_USER_WAKELOCK
 	&wake_lock_attr.attr,
 	&wake_unlock_attr.attr,
@@ -669,6 +744,7 @@ static void __init test_wakealarm(struct rtc_device *rtc, suspend_state_t state)
 	}
 	if (status < 0)
 		printk(err_suspend, status);
+	suspend_profile_print_last();
 
 	/* Some platforms can't detect that the alarm triggered the
 	 * wakeup, or (accordingly) disable it after it afterwards.
@@ -231,6 +231,12 @@ extern struct wake_lock main_wake_lock;
 extern suspend_state_t requested_suspend_state;
 #endif
 
+#if defined(CONFIG_WAKELOCK) && defined(CONFIG_SUSPEND_PROFILE)
+void suspend_profile_wake_locks(int type);
+#else
+static inline void suspend_profile_wake_locks(int type) {}
+#endif
+
 #ifdef CONFIG_USER_WAKELOCK
 ssize_t wake_lock_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf);
@@ -14,6 +14,7 @@
 #include <linux/syscalls.h>
 #include <linux/freezer.h>
 #include <linux/wakelock.h>
+#include "power.h"
 
 /* 
  * Timeout for stopping processes
@@ -90,15 +91,19 @@ static int try_to_freeze_tasks(bool sig_only)
 				elapsed_csecs / 100, elapsed_csecs % 100, todo);
 		if(!wakeup)
 			show_state();
-		else
+		else {
 			print_active_locks(WAKE_LOCK_SUSPEND);
+			suspend_profile_wake_locks(WAKE_LOCK_SUSPEND);
+		}
 
 		read_lock(&tasklist_lock);
 		do_each_thread(g, p) {
 			task_lock(p);
-			if (freezing(p) && !freezer_should_skip(p) &&
-							elapsed_csecs > 100)
-				printk(KERN_ERR " %s\n", p->comm);
+			if (freezing(p) && !freezer_should_skip(p)) {
+				suspend_profile_abort("freezing %s", p->comm);
+				if (elapsed_csecs > 100)
+					printk(KERN_ERR " %s\n", p->comm);
+			}
 			cancel_freezing(p);
 			task_unlock(p);
 		} while_each_thread(g, p);
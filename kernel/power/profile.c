@@ -0,0 +1,362 @@
+/*
+ * kernel/power/profile.c - Where the time of a suspend cycle goes.
+ *
+ * A cycle starts when the system first tries to suspend: when the last
+ * suspend wake lock goes away or, without wake locks, in enter_state().
+ * It then records how long each phase takes (sync, freezer, device
+ * suspend, sysdevs, the platform's sleep and the way back) and the
+ * slowest device callbacks, and is finished once processes are thawed
+ * or the attempt is given up.  Early suspend, which runs before the first
+ * attempt, opens the cycle; late resume, which runs after the wakeup that
+ * turned the screen on, is added to the last one.  A cycle that did not
+ * sleep keeps the first reason it was aborted for.
+ *
+ * The last SUSPEND_PROFILE_CYCLES cycles are in
+ * /sys/kernel/debug/suspend_profile; writing to it clears them.
+ *
+ * Times are monotonic, so the sleep phase is what it took to enter and
+ * leave the sleep state, not the time spent in it.  That is given for
+ * the whole cycle as "asleep", from the wall clock.
+ *
+ * This file is released under the GPLv2.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/suspend.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/time.h>
+#include <linux/debugfs.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#define SUSPEND_PROFILE_CYCLES		16
+#define SUSPEND_PROFILE_CALLBACKS	8
+
+struct suspend_profile_call {
+	char name[20];
+	int phase;
+	s64 usecs;
+};
+
+struct suspend_profile_cycle {
+	unsigned int id;
+	int finished;
+	int error;
+	char reason[48];
+	ktime_t begin;
+	ktime_t end;
+	struct timespec wall_begin;
+	struct timespec wall_end;
+	unsigned long phases;
+	ktime_t phase_begin[SUSPEND_PROFILE_NR_PHASES];
+	s64 phase_us[SUSPEND_PROFILE_NR_PHASES];
+	unsigned int nr_calls;
+	int nr_slowest;
+	struct suspend_profile_call slowest[SUSPEND_PROFILE_CALLBACKS];
+};
+
+static const char * const phase_names[SUSPEND_PROFILE_NR_PHASES] = {
+	[SUSPEND_PROFILE_EARLY_SUSPEND]		= "early_suspend",
+	[SUSPEND_PROFILE_SYNC]			= "sync",
+	[SUSPEND_PROFILE_FREEZE]		= "freeze",
+	[SUSPEND_PROFILE_SUSPEND_DEVICES]	= "suspend_devices",
+	[SUSPEND_PROFILE_SUSPEND_NOIRQ]		= "suspend_noirq",
+	[SUSPEND_PROFILE_SUSPEND_SYSDEV]	= "suspend_sysdev",
+	[SUSPEND_PROFILE_SLEEP]			= "sleep",
+	[SUSPEND_PROFILE_RESUME_SYSDEV]		= "resume_sysdev",
+	[SUSPEND_PROFILE_RESUME_NOIRQ]		= "resume_noirq",
+	[SUSPEND_PROFILE_RESUME_DEVICES]	= "resume_devices",
+	[SUSPEND_PROFILE_THAW]			= "thaw",
+	[SUSPEND_PROFILE_LATE_RESUME]		= "late_resume",
+};
+
+static struct suspend_profile_cycle cycles[SUSPEND_PROFILE_CYCLES];
+static unsigned int cycle_head;
+static unsigned int cycle_count;
+static unsigned int cycle_id;
+static struct suspend_profile_cycle *current_cycle;
+static int current_phase = -1;
+static DEFINE_SPINLOCK(profile_lock);
+
+/* Caller holds profile_lock */
+static struct suspend_profile_cycle *last_cycle(void)
+{
+	if (!cycle_count)
+		return NULL;
+	return &cycles[(cycle_head + SUSPEND_PROFILE_CYCLES - 1) %
+		       SUSPEND_PROFILE_CYCLES];
+}
+
+/* Caller holds profile_lock */
+static void begin_cycle(void)
+{
+	struct suspend_profile_cycle *cycle = &cycles[cycle_head];
+
+	memset(cycle, 0, sizeof(*cycle));
+	cycle->id = ++cycle_id;
+	cycle->begin = ktime_get();
+	getnstimeofday(&cycle->wall_begin);
+	cycle_head = (cycle_head + 1) % SUSPEND_PROFILE_CYCLES;
+	if (cycle_count < SUSPEND_PROFILE_CYCLES)
+		cycle_count++;
+	current_cycle = cycle;
+	current_phase = -1;
+}
+
+void suspend_profile_begin(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&profile_lock, flags);
+	if (!current_cycle)
+		begin_cycle();
+	spin_unlock_irqrestore(&profile_lock, flags);
+}
+
+void suspend_profile_finish(int error)
+{
+	struct suspend_profile_cycle *cycle;
+	unsigned long flags;
+
+	spin_lock_irqsave(&profile_lock, flags);
+	cycle = current_cycle;
+	if (cycle) {
+		cycle->end = ktime_get();
+		getnstimeofday(&cycle->wall_end);
+		cycle->error = error;
+		cycle->finished = 1;
+		current_cycle = NULL;
+		current_phase = -1;
+	}
+	spin_unlock_irqrestore(&profile_lock, flags);
+}
+
+/*
+ * Early suspend opens a cycle, late resume goes to the last one; every
+ * other phase belongs to the cycle in progress.
+ */
+void suspend_profile_start(int phase)
+{
+	struct suspend_profile_cycle *cycle;
+	unsigned long flags;
+
+	spin_lock_irqsave(&profile_lock, flags);
+	if (!current_cycle && phase == SUSPEND_PROFILE_EARLY_SUSPEND)
+		begin_cycle();
+	cycle = current_cycle ? current_cycle : last_cycle();
+	if (cycle) {
+		cycle->phase_begin[phase] = ktime_get();
+		if (cycle == current_cycle)
+			current_phase = phase;
+	}
+	spin_unlock_irqrestore(&profile_lock, flags);
+}
+
+void suspend_profile_end(int phase)
+{
+	struct suspend_profile_cycle *cycle;
+	unsigned long flags;
+
+	spin_lock_irqsave(&profile_lock, flags);
+	cycle = current_cycle ? current_cycle : last_cycle();
+	if (cycle && cycle->phase_begin[phase].tv64) {
+		cycle->phase_us[phase] += ktime_to_us(ktime_sub(ktime_get(),
+						cycle->phase_begin[phase]));
+		cycle->phase_begin[phase].tv64 = 0;
+		cycle->phases |= 1UL << phase;
+	}
+	if (cycle == current_cycle)
+		current_phase = -1;
+	spin_unlock_irqrestore(&profile_lock, flags);
+}
+
+/* Only the first reason is kept: it is the one that stopped the cycle. */
+void suspend_profile_abort(const char *fmt, ...)
+{
+	unsigned long flags;
+	va_list args;
+
+	spin_lock_irqsave(&profile_lock, flags);
+	if (current_cycle && !current_cycle->reason[0]) {
+		va_start(args, fmt);
+		vscnprintf(current_cycle->reason,
+			   sizeof(current_cycle->reason), fmt, args);
+		va_end(args);
+	}
+	spin_unlock_irqrestore(&profile_lock, flags);
+}
+
+void suspend_profile_callback(const char *name, s64 usecs)
+{
+	struct suspend_profile_cycle *cycle;
+	struct suspend_profile_call *call;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&profile_lock, flags);
+	cycle = current_cycle;
+	if (!cycle)
+		goto out;
+
+	cycle->nr_calls++;
+	if (cycle->nr_slowest < SUSPEND_PROFILE_CALLBACKS) {
+		call = &cycle->slowest[cycle->nr_slowest++];
+	} else {
+		call = &cycle->slowest[0];
+		for (i = 1; i < SUSPEND_PROFILE_CALLBACKS; i++)
+			if (cycle->slowest[i].usecs < call->usecs)
+				call = &cycle->slowest[i];
+		if (call->usecs >= usecs)
+			goto out;
+	}
+	strlcpy(call->name, name, sizeof(call->name));
+	call->phase = current_phase;
+	call->usecs = usecs;
+ out:
+	spin_unlock_irqrestore(&profile_lock, flags);
+}
+
+#define CYCLE_BUFMAX	1536
+#define DEBUG_BUFMAX	(SUSPEND_PROFILE_CYCLES * CYCLE_BUFMAX)
+
+static int print_cycle(char *buf, int size,
+		       const struct suspend_profile_cycle *cycle)
+{
+	struct timespec wall;
+	s64 asleep_us;
+	int n = 0;
+	int i;
+
+	n += scnprintf(buf + n, size - n, "cycle %u at %lld us: ",
+		       cycle->id, ktime_to_us(cycle->begin));
+	if (!cycle->finished)
+		n += scnprintf(buf + n, size - n, "in progress");
+	else if (cycle->error || cycle->reason[0])
+		n += scnprintf(buf + n, size - n, "aborted %d", cycle->error);
+	else
+		n += scnprintf(buf + n, size - n, "slept");
+	if (cycle->reason[0])
+		n += scnprintf(buf + n, size - n, " (%s)", cycle->reason);
+	if (cycle->finished) {
+		wall = timespec_sub(cycle->wall_end, cycle->wall_begin);
+		asleep_us = div_s64(timespec_to_ns(&wall), NSEC_PER_USEC) -
+			ktime_to_us(ktime_sub(cycle->end, cycle->begin));
+		n += scnprintf(buf + n, size - n, ", %lld us asleep",
+			       max_t(s64, asleep_us, 0));
+	}
+	n += scnprintf(buf + n, size - n, "\n");
+
+	for (i = 0; i < SUSPEND_PROFILE_NR_PHASES; i++)
+		if (cycle->phases & (1UL << i))
+			n += scnprintf(buf + n, size - n, "  %-16s %lld us\n",
+				       phase_names[i], cycle->phase_us[i]);
+
+	for (i = 0; i < cycle->nr_slowest; i++) {
+		const struct suspend_profile_call *call = &cycle->slowest[i];
+
+		n += scnprintf(buf + n, size - n, "  %-16s %lld us in %s\n",
+			       call->name, call->usecs, call->phase >= 0 ?
+			       phase_names[call->phase] : "-");
+	}
+	if (cycle->nr_calls > cycle->nr_slowest)
+		n += scnprintf(buf + n, size - n,
+			       "  (slowest %d of %u callbacks)\n",
+			       cycle->nr_slowest, cycle->nr_calls);
+	return n;
+}
+
+/* Log the last cycle, for the suspend test at boot. */
+void suspend_profile_print_last(void)
+{
+	struct suspend_profile_cycle cycle;
+	unsigned long flags;
+	char *buf;
+
+	spin_lock_irqsave(&profile_lock, flags);
+	if (!cycle_count) {
+		spin_unlock_irqrestore(&profile_lock, flags);
+		return;
+	}
+	cycle = *last_cycle();
+	spin_unlock_irqrestore(&profile_lock, flags);
+
+	buf = kmalloc(CYCLE_BUFMAX, GFP_KERNEL);
+	if (!buf)
+		return;
+	print_cycle(buf, CYCLE_BUFMAX, &cycle);
+	printk(KERN_INFO "PM: profile: %s", buf);
+	kfree(buf);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static ssize_t debug_read_profile(struct file *file, char __user *ubuf,
+				  size_t count, loff_t *ppos)
+{
+	struct suspend_profile_cycle cycle;
+	unsigned long flags;
+	unsigned int i, first, nr, id;
+	char *buf;
+	int n = 0;
+	ssize_t ret;
+
+	buf = kmalloc(DEBUG_BUFMAX, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&profile_lock, flags);
+	nr = cycle_count;
+	first = (cycle_head + SUSPEND_PROFILE_CYCLES - nr) %
+		SUSPEND_PROFILE_CYCLES;
+	id = cycles[first].id;
+	spin_unlock_irqrestore(&profile_lock, flags);
+
+	for (i = 0; i < nr; i++) {
+		spin_lock_irqsave(&profile_lock, flags);
+		cycle = cycles[(first + i) % SUSPEND_PROFILE_CYCLES];
+		spin_unlock_irqrestore(&profile_lock, flags);
+		/* skip cycles that were overwritten or cleared meanwhile */
+		if (cycle.id != id + i)
+			continue;
+		n += print_cycle(buf + n, DEBUG_BUFMAX - n, &cycle);
+	}
+
+	ret = simple_read_from_buffer(ubuf, count, ppos, buf, n);
+	kfree(buf);
+	return ret;
+}
+
+static ssize_t debug_clear_profile(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&profile_lock, flags);
+	if (current_cycle) {
+		/* keep the cycle in progress, as the only one */
+		cycles[0] = *current_cycle;
+		current_cycle = &cycles[0];
+		cycle_head = 1;
+		cycle_count = 1;
+	} else {
+		cycle_head = 0;
+		cycle_count = 0;
+	}
+	spin_unlock_irqrestore(&profile_lock, flags);
+	return count;
+}
+
+static const struct file_operations debug_profile_fops = {
+	.read = debug_read_profile,
+	.write = debug_clear_profile,
+};
+
+static int __init suspend_profile_init(void)
+{
+	debugfs_create_file("suspend_profile", 0644, NULL, NULL,
+			    &debug_profile_fops);
+	return 0;
+}
+late_initcall(suspend_profile_init);
+#endif
@@ -39,11 +39,25 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 #define WAKE_LOCK_INITIALIZED            (1U << 8)
 #define WAKE_LOCK_ACTIVE                 (1U << 9)
 #define WAKE_LOCK_AUTO_EXPIRE            (1U << 10)
-#define WAKE_LOCK_PREVENTING_SUSPEND     (1U << 11)
 
+/*
+ * list_lock protects the list of all wake locks, and is only taken to add
+ * or remove one or to print them.  Each lock's state_lock protects its
+ * flags, expiry and statistics.  active_lock nests inside state_lock and
+ * protects only what has_wake_lock() looks at: a count of the active locks
+ * without a timeout, and a tree of the ones with a timeout sorted by when
+ * they expire.  So locking, unlocking and checking cost the same however
+ * many wake locks there are.
+ *
+ * A lock that times out is dropped from its tree by whoever notices, but
+ * keeps WAKE_LOCK_ACTIVE until its owner next locks or unlocks it, or until
+ * it is printed, so that its statistics never need active_lock.
+ */
 static DEFINE_SPINLOCK(list_lock);
-static LIST_HEAD(inactive_locks);
-static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+static LIST_HEAD(wake_locks);
+static DEFINE_SPINLOCK(active_lock);
+static int nr_active_locks[WAKE_LOCK_TYPE_COUNT];
+static struct rb_root expire_tree[WAKE_LOCK_TYPE_COUNT];
 static int current_event_num;
 struct workqueue_struct *suspend_work_queue;
 struct wake_lock main_wake_lock;
@@ -52,9 +66,48 @@ static struct wake_lock unknown_wakeup;
 
 #ifdef CONFIG_WAKELOCK_STAT
 static struct wake_lock deleted_wake_locks;
-static ktime_t last_sleep_time_update;
 static int wait_for_wakeup;
 
+/*
+ * A clock that only runs while main_wake_lock is not held, i.e. while
+ * something other than the user keeps the system out of suspend.  A
+ * suspend lock's sleep_time is how far it moved while the lock was active,
+ * so nothing has to walk the active locks when main_wake_lock changes.
+ */
+static DEFINE_SEQLOCK(sleep_wait_seqlock);
+static ktime_t sleep_wait_total;
+static ktime_t sleep_wait_start;
+static int sleep_waiting;
+
+static ktime_t sleep_wait_time(ktime_t when)
+{
+	unsigned long seq;
+	ktime_t total;
+
+	do {
+		seq = read_seqbegin(&sleep_wait_seqlock);
+		total = sleep_wait_total;
+		if (sleep_waiting && when.tv64 > sleep_wait_start.tv64)
+			total = ktime_add(total,
+					  ktime_sub(when, sleep_wait_start));
+	} while (read_seqretry(&sleep_wait_seqlock, seq));
+	return total;
+}
+
+/* Caller holds main_wake_lock.state_lock */
+static void update_sleep_wait_stats_locked(int done)
+{
+	ktime_t now = ktime_get();
+
+	write_seqlock(&sleep_wait_seqlock);
+	if (sleep_waiting)
+		sleep_wait_total = ktime_add(sleep_wait_total,
+					     ktime_sub(now, sleep_wait_start));
+	sleep_waiting = !done;
+	sleep_wait_start = now;
+	write_sequnlock(&sleep_wait_seqlock);
+}
+
 int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 {
 	struct timespec ts;
@@ -82,6 +135,7 @@ int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 }
 
 
+/* Caller holds lock->state_lock */
 static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 {
 	int lock_count = lock->stat.count;
@@ -103,9 +157,10 @@ static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 		else
 			expire_count++;
 		total_time = ktime_add(total_time, add_time);
-		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND)
+		if ((lock->flags & WAKE_LOCK_TYPE_MASK) == WAKE_LOCK_SUSPEND)
 			prevent_suspend_time = ktime_add(prevent_suspend_time,
-					ktime_sub(now, last_sleep_time_update));
+					ktime_sub(sleep_wait_time(now),
+						  lock->stat.sleep_wait_mark));
 		if (add_time.tv64 > max_time.tv64)
 			max_time = add_time;
 	}
@@ -124,22 +179,28 @@ static int wakelock_stats_show(struct seq_file *m, void *unused)
 	unsigned long irqflags;
 	struct wake_lock *lock;
 	int ret;
-	int type;
 
 	spin_lock_irqsave(&list_lock, irqflags);
 
 	ret = seq_puts(m, "name\tcount\texpire_count\twake_count\tactive_since"
 			"\ttotal_time\tsleep_time\tmax_time\tlast_change\n");
-	list_for_each_entry(lock, &inactive_locks, link)
+	list_for_each_entry(lock, &wake_locks, link) {
+		spin_lock(&lock->state_lock);
 		ret = print_lock_stat(m, lock);
-	for (type = 0; type < WAKE_LOCK_TYPE_COUNT; type++) {
-		list_for_each_entry(lock, &active_wake_locks[type], link)
-			ret = print_lock_stat(m, lock);
+		spin_unlock(&lock->state_lock);
 	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
 	return 0;
 }
 
+/* Caller holds lock->state_lock */
+static void wake_lock_stat_start_locked(struct wake_lock *lock)
+{
+	lock->stat.last_time = ktime_get();
+	lock->stat.sleep_wait_mark = sleep_wait_time(lock->stat.last_time);
+}
+
+/* Caller holds lock->state_lock */
 static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 {
 	ktime_t duration;
@@ -158,108 +219,145 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 	if (ktime_to_ns(duration) > ktime_to_ns(lock->stat.max_time))
 		lock->stat.max_time = duration;
 	lock->stat.last_time = ktime_get();
-	if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-		duration = ktime_sub(now, last_sleep_time_update);
+	if ((lock->flags & WAKE_LOCK_TYPE_MASK) == WAKE_LOCK_SUSPEND) {
+		duration = ktime_sub(sleep_wait_time(now),
+				     lock->stat.sleep_wait_mark);
 		lock->stat.prevent_suspend_time = ktime_add(
 			lock->stat.prevent_suspend_time, duration);
-		lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
 	}
 }
+#endif
 
-static void update_sleep_wait_stats_locked(int done)
+/* Caller holds active_lock */
+static void expire_wake_lock(struct wake_lock *lock, int type)
 {
-	struct wake_lock *lock;
-	ktime_t now, etime, elapsed, add;
-	int expired;
-
-	now = ktime_get();
-	elapsed = ktime_sub(now, last_sleep_time_update);
-	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
-		expired = get_expired_time(lock, &etime);
-		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-			if (expired)
-				add = ktime_sub(etime, last_sleep_time_update);
-			else
-				add = elapsed;
-			lock->stat.prevent_suspend_time = ktime_add(
-				lock->stat.prevent_suspend_time, add);
-		}
-		if (done || expired)
-			lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
-		else
-			lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
+	rb_erase(&lock->node, &expire_tree[type]);
+	RB_CLEAR_NODE(&lock->node);
+	if (debug_mask & (DEBUG_WAKE_LOCK | DEBUG_EXPIRE))
+		pr_info("expired wake lock %s\n", lock->name);
+}
+
+/* Caller holds lock->state_lock and active_lock */
+static void wake_lock_dequeue_locked(struct wake_lock *lock, int type)
+{
+	if ((lock->flags & (WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE)) ==
+	    WAKE_LOCK_ACTIVE)
+		nr_active_locks[type]--;
+	if (!RB_EMPTY_NODE(&lock->node)) {
+		rb_erase(&lock->node, &expire_tree[type]);
+		RB_CLEAR_NODE(&lock->node);
 	}
-	last_sleep_time_update = now;
 }
-#endif
 
+/* Caller holds lock->state_lock and active_lock */
+static void wake_lock_enqueue_locked(struct wake_lock *lock, int type)
+{
+	struct rb_node **p = &expire_tree[type].rb_node;
+	struct rb_node *parent = NULL;
+	struct wake_lock *entry;
+
+	if (!(lock->flags & WAKE_LOCK_AUTO_EXPIRE)) {
+		nr_active_locks[type]++;
+		return;
+	}
+	while (*p) {
+		parent = *p;
+		entry = rb_entry(parent, struct wake_lock, node);
+		if (time_before(lock->expires, entry->expires))
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&lock->node, parent, p);
+	rb_insert_color(&lock->node, &expire_tree[type]);
+}
 
-static void expire_wake_lock(struct wake_lock *lock)
+/* Caller holds lock->state_lock */
+static void print_active_lock(struct wake_lock *lock)
 {
-#ifdef CONFIG_WAKELOCK_STAT
-	wake_unlock_stat_locked(lock, 1);
-#endif
-	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
-	if (debug_mask & (DEBUG_WAKE_LOCK | DEBUG_EXPIRE))
-		pr_info("expired wake lock %s\n", lock->name);
+	if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
+		long timeout = lock->expires - jiffies;
+		if (timeout <= 0)
+			pr_info("wake lock %s, expired\n", lock->name);
+		else
+			pr_info("active wake lock %s, time left %ld.%03lu\n",
+				lock->name, timeout / HZ,
+				(timeout % HZ) * MSEC_PER_SEC / HZ);
+	} else
+		pr_info("active wake lock %s\n", lock->name);
 }
 
-/* Caller must acquire the list_lock spinlock */
-static void print_active_locks_locked(int type)
+void print_active_locks(int type)
 {
+	unsigned long irqflags;
 	struct wake_lock *lock;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry(lock, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				pr_info("wake lock %s, expired\n", lock->name);
-			else
-				pr_info("active wake lock %s, time left %ld.%03lu\n",
-					lock->name, timeout / HZ,
-					(timeout % HZ) * MSEC_PER_SEC / HZ);
-		} else
-			pr_info("active wake lock %s\n", lock->name);
+	spin_lock_irqsave(&list_lock, irqflags);
+	list_for_each_entry(lock, &wake_locks, link) {
+		spin_lock(&lock->state_lock);
+		if ((lock->flags & (WAKE_LOCK_TYPE_MASK | WAKE_LOCK_ACTIVE)) ==
+		    (type | WAKE_LOCK_ACTIVE))
+			print_active_lock(lock);
+		spin_unlock(&lock->state_lock);
 	}
+	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 
-void print_active_locks(int type)
+#ifdef CONFIG_SUSPEND_PROFILE
+/* Give an active lock of the type as the reason suspend was aborted */
+void suspend_profile_wake_locks(int type)
 {
 	unsigned long irqflags;
+	struct wake_lock *lock;
+	int found = 0;
+
 	spin_lock_irqsave(&list_lock, irqflags);
-	print_active_locks_locked(type);
+	list_for_each_entry(lock, &wake_locks, link) {
+		spin_lock(&lock->state_lock);
+		if ((lock->flags & (WAKE_LOCK_TYPE_MASK | WAKE_LOCK_ACTIVE)) ==
+		    (type | WAKE_LOCK_ACTIVE) && wake_lock_active(lock)) {
+			suspend_profile_abort("wake lock %s", lock->name);
+			found = 1;
+		}
+		spin_unlock(&lock->state_lock);
+		if (found)
+			break;
+	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
+#endif
 
+/* Caller holds active_lock */
 static long has_wake_lock_locked(int type)
 {
-	struct wake_lock *lock, *n;
-	long max_timeout = 0;
+	unsigned long now = jiffies;
+	struct rb_node *node;
+	struct wake_lock *lock;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
+	if (nr_active_locks[type])
+		return -1;
+	while ((node = rb_first(&expire_tree[type]))) {
+		lock = rb_entry(node, struct wake_lock, node);
+		if ((long)(lock->expires - now) > 0)
+			break;
+		expire_wake_lock(lock, type);
 	}
-	return max_timeout;
+	node = rb_last(&expire_tree[type]);
+	if (!node)
+		return 0;
+	lock = rb_entry(node, struct wake_lock, node);
+	return lock->expires - now;
 }
 
 long has_wake_lock(int type)
 {
 	long ret;
 	unsigned long irqflags;
-	spin_lock_irqsave(&list_lock, irqflags);
+	spin_lock_irqsave(&active_lock, irqflags);
 	ret = has_wake_lock_locked(type);
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	spin_unlock_irqrestore(&active_lock, irqflags);
 	return ret;
 }
 
@@ -270,19 +368,25 @@ static void suspend(struct work_struct *work)
 	unsigned long irqflags;
 
 	pr_info("[R] suspend start\n");
+	suspend_profile_begin();
 	if (has_wake_lock(WAKE_LOCK_SUSPEND)) {
 		if (debug_mask & DEBUG_SUSPEND || debug_mask & DEBUG_FORBID_SUSPEND)
 			pr_info("suspend: abort suspend\n");
 		if (debug_mask & DEBUG_FORBID_SUSPEND)
 			print_active_locks(WAKE_LOCK_SUSPEND);
+		suspend_profile_wake_locks(WAKE_LOCK_SUSPEND);
+		suspend_profile_finish(-EAGAIN);
 		return;
 	}
 
 	entry_event_num = current_event_num;
+	suspend_profile_start(SUSPEND_PROFILE_SYNC);
 	sys_sync();
+	suspend_profile_end(SUSPEND_PROFILE_SYNC);
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("suspend: enter suspend\n");
 	ret = pm_suspend(requested_suspend_state);
+	suspend_profile_finish(ret);
 	if (debug_mask & DEBUG_EXIT_SUSPEND) {
 		struct timespec ts;
 		struct rtc_time tm;
@@ -308,18 +412,37 @@ static void expire_wake_locks(unsigned long data)
 	unsigned long irqflags;
 	if (debug_mask & DEBUG_EXPIRE)
 		pr_info("expire_wake_locks: start\n");
-	spin_lock_irqsave(&list_lock, irqflags);
 	if (debug_mask & DEBUG_SUSPEND)
-		print_active_locks_locked(WAKE_LOCK_SUSPEND);
+		print_active_locks(WAKE_LOCK_SUSPEND);
+	spin_lock_irqsave(&active_lock, irqflags);
 	has_lock = has_wake_lock_locked(WAKE_LOCK_SUSPEND);
-	if (debug_mask & DEBUG_EXPIRE)
-		pr_info("expire_wake_locks: done, has_lock %ld\n", has_lock);
 	if (has_lock == 0)
 		queue_work(suspend_work_queue, &suspend_work);
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	spin_unlock_irqrestore(&active_lock, irqflags);
+	if (debug_mask & DEBUG_EXPIRE)
+		pr_info("expire_wake_locks: done, has_lock %ld\n", has_lock);
 }
 static DEFINE_TIMER(expire_timer, expire_wake_locks, 0, 0);
 
+/* Caller holds active_lock */
+static void update_expire_timer_locked(struct wake_lock *lock,
+				       const char *func, long expire_in)
+{
+	if (expire_in > 0) {
+		if (debug_mask & DEBUG_EXPIRE)
+			pr_info("%s: %s, start expire timer, %ld\n",
+				func, lock->name, expire_in);
+		mod_timer(&expire_timer, jiffies + expire_in);
+	} else {
+		if (del_timer(&expire_timer))
+			if (debug_mask & DEBUG_EXPIRE)
+				pr_info("%s: %s, stop expire timer\n",
+					func, lock->name);
+		if (expire_in == 0)
+			queue_work(suspend_work_queue, &suspend_work);
+	}
+}
+
 static int power_suspend_late(struct platform_device *pdev, pm_message_t state)
 {
 	unsigned long irqflags;
@@ -331,6 +454,8 @@ static int power_suspend_late(struct platform_device *pdev, pm_message_t state)
 		pr_info("power_suspend_late return %d\n", ret);
 	if (ret && (debug_mask & DEBUG_FORBID_SUSPEND))
 		print_active_locks(WAKE_LOCK_SUSPEND);
+	if (ret)
+		suspend_profile_wake_locks(WAKE_LOCK_SUSPEND);
 	return ret;
 }
 
@@ -360,12 +485,15 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 	lock->stat.prevent_suspend_time = ktime_set(0, 0);
 	lock->stat.max_time = ktime_set(0, 0);
 	lock->stat.last_time = ktime_set(0, 0);
+	lock->stat.sleep_wait_mark = ktime_set(0, 0);
 #endif
 	lock->flags = (type & WAKE_LOCK_TYPE_MASK) | WAKE_LOCK_INITIALIZED;
+	spin_lock_init(&lock->state_lock);
+	RB_CLEAR_NODE(&lock->node);
 
 	INIT_LIST_HEAD(&lock->link);
 	spin_lock_irqsave(&list_lock, irqflags);
-	list_add(&lock->link, &inactive_locks);
+	list_add(&lock->link, &wake_locks);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 EXPORT_SYMBOL(wake_lock_init);
@@ -373,27 +501,45 @@ EXPORT_SYMBOL(wake_lock_init);
 void wake_lock_destroy(struct wake_lock *lock)
 {
 	unsigned long irqflags;
+	int type;
+#ifdef CONFIG_WAKELOCK_STAT
+	typeof(lock->stat) stat;
+#endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_lock_destroy name=%s\n", lock->name);
 	spin_lock_irqsave(&list_lock, irqflags);
-	lock->flags &= ~WAKE_LOCK_INITIALIZED;
+	list_del(&lock->link);
+	spin_lock(&lock->state_lock);
+	type = lock->flags & WAKE_LOCK_TYPE_MASK;
+	spin_lock(&active_lock);
+	wake_lock_dequeue_locked(lock, type);
+	spin_unlock(&active_lock);
+	lock->flags &= ~(WAKE_LOCK_INITIALIZED | WAKE_LOCK_ACTIVE |
+			 WAKE_LOCK_AUTO_EXPIRE);
+#ifdef CONFIG_WAKELOCK_STAT
+	stat = lock->stat;
+#endif
+	spin_unlock(&lock->state_lock);
+	spin_unlock_irqrestore(&list_lock, irqflags);
+
 #ifdef CONFIG_WAKELOCK_STAT
-	if (lock->stat.count) {
-		deleted_wake_locks.stat.count += lock->stat.count;
-		deleted_wake_locks.stat.expire_count += lock->stat.expire_count;
+	if (stat.count) {
+		spin_lock_irqsave(&deleted_wake_locks.state_lock, irqflags);
+		deleted_wake_locks.stat.count += stat.count;
+		deleted_wake_locks.stat.expire_count += stat.expire_count;
 		deleted_wake_locks.stat.total_time =
 			ktime_add(deleted_wake_locks.stat.total_time,
-				  lock->stat.total_time);
+				  stat.total_time);
 		deleted_wake_locks.stat.prevent_suspend_time =
 			ktime_add(deleted_wake_locks.stat.prevent_suspend_time,
-				  lock->stat.prevent_suspend_time);
+				  stat.prevent_suspend_time);
 		deleted_wake_locks.stat.max_time =
 			ktime_add(deleted_wake_locks.stat.max_time,
-				  lock->stat.max_time);
+				  stat.max_time);
+		spin_unlock_irqrestore(&deleted_wake_locks.state_lock,
+				       irqflags);
 	}
 #endif
-	list_del(&lock->link);
-	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 EXPORT_SYMBOL(wake_lock_destroy);
 
@@ -402,74 +548,55 @@ static void wake_lock_internal(
 {
 	int type;
 	unsigned long irqflags;
-	long expire_in;
 
-	spin_lock_irqsave(&list_lock, irqflags);
+	spin_lock_irqsave(&lock->state_lock, irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
 	BUG_ON(!(lock->flags & WAKE_LOCK_INITIALIZED));
 #ifdef CONFIG_WAKELOCK_STAT
-	if (type == WAKE_LOCK_SUSPEND && wait_for_wakeup) {
+	if (type == WAKE_LOCK_SUSPEND && wait_for_wakeup &&
+	    xchg(&wait_for_wakeup, 0)) {
 		if (debug_mask & DEBUG_WAKEUP)
 			pr_info("wakeup wake lock: %s\n", lock->name);
-		wait_for_wakeup = 0;
 		lock->stat.wakeup_count++;
 	}
+	if (lock == &main_wake_lock)
+		update_sleep_wait_stats_locked(1);
 	if ((lock->flags & WAKE_LOCK_AUTO_EXPIRE) &&
 	    (long)(lock->expires - jiffies) <= 0) {
 		wake_unlock_stat_locked(lock, 0);
-		lock->stat.last_time = ktime_get();
+		wake_lock_stat_start_locked(lock);
 	}
+	if (!(lock->flags & WAKE_LOCK_ACTIVE))
+		wake_lock_stat_start_locked(lock);
 #endif
-	if (!(lock->flags & WAKE_LOCK_ACTIVE)) {
-		lock->flags |= WAKE_LOCK_ACTIVE;
-#ifdef CONFIG_WAKELOCK_STAT
-		lock->stat.last_time = ktime_get();
-#endif
-	}
-	list_del(&lock->link);
-	if (has_timeout) {
-		if (debug_mask & DEBUG_WAKE_LOCK)
+	if (debug_mask & DEBUG_WAKE_LOCK) {
+		if (has_timeout)
 			pr_info("wake_lock: %s, type %d, timeout %ld.%03lu\n",
 				lock->name, type, timeout / HZ,
 				(timeout % HZ) * MSEC_PER_SEC / HZ);
+		else
+			pr_info("wake_lock: %s, type %d\n", lock->name, type);
+	}
+
+	spin_lock(&active_lock);
+	wake_lock_dequeue_locked(lock, type);
+	lock->flags |= WAKE_LOCK_ACTIVE;
+	if (has_timeout) {
 		lock->expires = jiffies + timeout;
 		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
-		list_add_tail(&lock->link, &active_wake_locks[type]);
 	} else {
-		if (debug_mask & DEBUG_WAKE_LOCK)
-			pr_info("wake_lock: %s, type %d\n", lock->name, type);
 		lock->expires = LONG_MAX;
 		lock->flags &= ~WAKE_LOCK_AUTO_EXPIRE;
-		list_add(&lock->link, &active_wake_locks[type]);
 	}
+	wake_lock_enqueue_locked(lock, type);
 	if (type == WAKE_LOCK_SUSPEND) {
 		current_event_num++;
-#ifdef CONFIG_WAKELOCK_STAT
-		if (lock == &main_wake_lock)
-			update_sleep_wait_stats_locked(1);
-		else if (!wake_lock_active(&main_wake_lock))
-			update_sleep_wait_stats_locked(0);
-#endif
-		if (has_timeout)
-			expire_in = has_wake_lock_locked(type);
-		else
-			expire_in = -1;
-		if (expire_in > 0) {
-			if (debug_mask & DEBUG_EXPIRE)
-				pr_info("wake_lock: %s, start expire timer, "
-					"%ld\n", lock->name, expire_in);
-			mod_timer(&expire_timer, jiffies + expire_in);
-		} else {
-			if (del_timer(&expire_timer))
-				if (debug_mask & DEBUG_EXPIRE)
-					pr_info("wake_lock: %s, stop expire timer\n",
-						lock->name);
-			if (expire_in == 0)
-				queue_work(suspend_work_queue, &suspend_work);
-		}
+		update_expire_timer_locked(lock, "wake_lock", has_timeout ?
+					   has_wake_lock_locked(type) : -1);
 	}
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	spin_unlock(&active_lock);
+	spin_unlock_irqrestore(&lock->state_lock, irqflags);
 }
 
 void wake_lock(struct wake_lock *lock)
@@ -488,49 +615,40 @@ void wake_unlock(struct wake_lock *lock)
 {
 	int type;
 	unsigned long irqflags;
-	spin_lock_irqsave(&list_lock, irqflags);
+	spin_lock_irqsave(&lock->state_lock, irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 0);
+	if (lock == &main_wake_lock)
+		update_sleep_wait_stats_locked(0);
 #endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
+	spin_lock(&active_lock);
+	wake_lock_dequeue_locked(lock, type);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
-	if (type == WAKE_LOCK_SUSPEND) {
-		long has_lock = has_wake_lock_locked(type);
-		if (has_lock > 0) {
-			if (debug_mask & DEBUG_EXPIRE)
-				pr_info("wake_unlock: %s, start expire timer, "
-					"%ld\n", lock->name, has_lock);
-			mod_timer(&expire_timer, jiffies + has_lock);
-		} else {
-			if (del_timer(&expire_timer))
-				if (debug_mask & DEBUG_EXPIRE)
-					pr_info("wake_unlock: %s, stop expire "
-						"timer\n", lock->name);
-			if (has_lock == 0)
-				queue_work(suspend_work_queue, &suspend_work);
-		}
-		if (lock == &main_wake_lock) {
-			if (debug_mask & DEBUG_SUSPEND)
-				print_active_locks_locked(WAKE_LOCK_SUSPEND);
-#ifdef CONFIG_WAKELOCK_STAT
-			update_sleep_wait_stats_locked(0);
-#endif
-		}
-	}
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	if (type == WAKE_LOCK_SUSPEND)
+		update_expire_timer_locked(lock, "wake_unlock",
+					   has_wake_lock_locked(type));
+	spin_unlock(&active_lock);
+	spin_unlock_irqrestore(&lock->state_lock, irqflags);
+	if (lock == &main_wake_lock && (debug_mask & DEBUG_SUSPEND))
+		print_active_locks(WAKE_LOCK_SUSPEND);
 }
 EXPORT_SYMBOL(wake_unlock);
 
 int wake_lock_active(struct wake_lock *lock)
 {
-	return !!(lock->flags & WAKE_LOCK_ACTIVE);
+	int flags = lock->flags;
+
+	if ((flags & WAKE_LOCK_AUTO_EXPIRE) &&
+	    (long)(lock->expires - jiffies) <= 0)
+		return 0;
+	return !!(flags & WAKE_LOCK_ACTIVE);
 }
 EXPORT_SYMBOL(wake_lock_active);
 
+
 static int wakelock_stats_open(struct inode *inode, struct file *file)
 {
 	return single_open(file, wakelock_stats_show, NULL);
@@ -547,10 +665,6 @@ static const struct file_operations wakelock_stats_fops = {
 static int __init wakelocks_init(void)
 {
 	int ret;
-	int i;
-
-	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
-		INIT_LIST_HEAD(&active_wake_locks[i]);
 
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
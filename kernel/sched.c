@@ -72,6 +72,7 @@
 #include <linux/debugfs.h>
 #include <linux/ctype.h>
 #include <linux/ftrace.h>
+#include <linux/cpufreq.h>
 #include <trace/sched.h>
 
 #include <asm/tlb.h>
@@ -249,6 +250,97 @@ static void destroy_rt_bandwidth(struct rt_bandwidth *rt_b)
 }
 #endif
 
+#ifdef CONFIG_CFS_BANDWIDTH
+/*
+ * CFS bandwidth control: a group may run for cfs_quota of every
+ * cfs_period on each cpu, after which its cfs_rq on that cpu is taken
+ * off the runqueue until the next period refills it.
+ */
+struct cfs_bandwidth {
+	/* nests inside the rq lock: */
+	spinlock_t		lock;
+	ktime_t			cfs_period;
+	u64			cfs_quota;
+	struct hrtimer		cfs_period_timer;
+
+	/* statistics, for cpu.stat */
+	u64			nr_periods;
+	u64			nr_throttled;
+	u64			throttled_time;
+};
+
+/* default period, in nsecs */
+#define DEF_CFS_PERIOD		(100 * NSEC_PER_MSEC)
+
+static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun);
+
+static enum hrtimer_restart sched_cfs_period_timer(struct hrtimer *timer)
+{
+	struct cfs_bandwidth *cfs_b =
+		container_of(timer, struct cfs_bandwidth, cfs_period_timer);
+	ktime_t now;
+	int overrun;
+	int idle = 0;
+
+	for (;;) {
+		now = hrtimer_cb_get_time(timer);
+		overrun = hrtimer_forward(timer, now, cfs_b->cfs_period);
+
+		if (!overrun)
+			break;
+
+		idle = do_sched_cfs_period_timer(cfs_b, overrun);
+	}
+
+	return idle ? HRTIMER_NORESTART : HRTIMER_RESTART;
+}
+
+static
+void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b, u64 period, u64 quota)
+{
+	cfs_b->cfs_period = ns_to_ktime(period);
+	cfs_b->cfs_quota = quota;
+	cfs_b->nr_periods = 0;
+	cfs_b->nr_throttled = 0;
+	cfs_b->throttled_time = 0;
+
+	spin_lock_init(&cfs_b->lock);
+
+	hrtimer_init(&cfs_b->cfs_period_timer,
+			CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	cfs_b->cfs_period_timer.function = sched_cfs_period_timer;
+}
+
+static void start_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	ktime_t now;
+
+	if (cfs_b->cfs_quota == RUNTIME_INF)
+		return;
+
+	if (hrtimer_active(&cfs_b->cfs_period_timer))
+		return;
+
+	spin_lock(&cfs_b->lock);
+	for (;;) {
+		if (hrtimer_active(&cfs_b->cfs_period_timer))
+			break;
+
+		now = hrtimer_cb_get_time(&cfs_b->cfs_period_timer);
+		hrtimer_forward(&cfs_b->cfs_period_timer, now,
+				cfs_b->cfs_period);
+		hrtimer_start_expires(&cfs_b->cfs_period_timer,
+				HRTIMER_MODE_ABS);
+	}
+	spin_unlock(&cfs_b->lock);
+}
+
+static void destroy_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	hrtimer_cancel(&cfs_b->cfs_period_timer);
+}
+#endif
+
 /*
  * sched_domains_mutex serializes calls to arch_init_sched_domains,
  * detach_destroy_domains and partition_sched_domains.
@@ -279,6 +371,11 @@ struct task_group {
 	/* runqueue "owned" by this group on each cpu */
 	struct cfs_rq **cfs_rq;
 	unsigned long shares;
+	/* prefer this group's wakeups over those of other groups */
+	int wakeup_boost;
+#ifdef CONFIG_CFS_BANDWIDTH
+	struct cfs_bandwidth cfs_bandwidth;
+#endif
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -459,6 +556,17 @@ struct cfs_rq {
 	 */
 	unsigned long rq_weight;
 #endif
+#ifdef CONFIG_CFS_BANDWIDTH
+	/*
+	 * Run time used in the current period, and the quota it is held
+	 * to (a copy of tg->cfs_bandwidth.cfs_quota kept under the rq
+	 * lock).  A throttled cfs_rq is off its parent until refilled.
+	 */
+	u64 cfs_time;
+	u64 cfs_quota;
+	int cfs_throttled;
+	u64 cfs_throttled_clock;
+#endif
 #endif
 };
 
@@ -584,6 +692,17 @@ struct rq {
 
 	u64 clock;
 
+	/*
+	 * Frequency invariant utilisation: the time this cpu was busy,
+	 * scaled by its speed as a fraction of SCHED_LOAD_SCALE of its
+	 * fastest, averaged over SCHED_UTIL_WINDOW windows:
+	 */
+	unsigned long freq_scale;
+	unsigned long util_avg;
+	u64 util_stamp;
+	u32 util_window_time;
+	u32 util_window_busy;
+
 	atomic_t nr_iowait;
 
 #ifdef CONFIG_SMP
@@ -2795,6 +2914,142 @@ static void update_cpu_load(struct rq *this_rq)
 	}
 }
 
+/*
+ * Each window, the utilisation keeps 3/4 of its last value and takes 1/4
+ * of the share of the window the cpu was busy, weighted by the speed it
+ * ran at: a task busy half the time at half speed counts as 1/4.  The
+ * time is folded in at every context switch, tick and speed change.
+ */
+#define SCHED_UTIL_WINDOW	(10 * NSEC_PER_MSEC)
+
+static void update_rq_util(struct rq *rq, int busy)
+{
+	u64 delta = rq->clock - rq->util_stamp;
+
+	rq->util_stamp = rq->clock;
+	if ((s64)delta <= 0)
+		return;
+
+	while (delta) {
+		u32 step = SCHED_UTIL_WINDOW - rq->util_window_time;
+		u64 util;
+
+		if (delta < step)
+			step = delta;
+		if (busy)
+			rq->util_window_busy += ((u64)step * rq->freq_scale) >>
+						SCHED_LOAD_SHIFT;
+		rq->util_window_time += step;
+		delta -= step;
+		if (rq->util_window_time < SCHED_UTIL_WINDOW)
+			break;
+
+		util = (u64)rq->util_window_busy << SCHED_LOAD_SHIFT;
+		do_div(util, SCHED_UTIL_WINDOW);
+		/* round up on the way up, as update_cpu_load() does */
+		if (util > rq->util_avg)
+			util += 3;
+		rq->util_avg = (rq->util_avg * 3 + (unsigned long)util) / 4;
+		rq->util_window_busy = 0;
+		rq->util_window_time = 0;
+
+		/* idle for long enough to have forgotten everything */
+		if (!busy && !rq->util_avg) {
+			rq->util_window_time = do_div(delta, SCHED_UTIL_WINDOW);
+			break;
+		}
+	}
+}
+
+/**
+ * sched_cpu_util - how busy a cpu has recently been
+ * @cpu: the cpu
+ *
+ * Returns the share of the last few SCHED_UTIL_WINDOW windows the cpu was
+ * busy, in SCHED_LOAD_SCALE units of what it would do at its top speed,
+ * so that it means the same whatever speed the cpu ran at.  For cpufreq
+ * governors.
+ */
+unsigned long sched_cpu_util(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long flags, util;
+
+	spin_lock_irqsave(&rq->lock, flags);
+	update_rq_clock(rq);
+	update_rq_util(rq, rq->curr != rq->idle);
+	util = rq->util_avg;
+	spin_unlock_irqrestore(&rq->lock, flags);
+
+	return util;
+}
+EXPORT_SYMBOL_GPL(sched_cpu_util);
+
+#ifdef CONFIG_CPU_FREQ
+static DEFINE_PER_CPU(unsigned int, sched_max_freq);
+
+static void sched_set_freq(int cpu, unsigned int cur)
+{
+	unsigned int max = per_cpu(sched_max_freq, cpu);
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long flags;
+
+	if (!max || !cur)
+		return;
+
+	spin_lock_irqsave(&rq->lock, flags);
+	update_rq_clock(rq);
+	update_rq_util(rq, rq->curr != rq->idle);
+	rq->freq_scale = min_t(u64, div_u64((u64)cur << SCHED_LOAD_SHIFT, max),
+			       SCHED_LOAD_SCALE);
+	spin_unlock_irqrestore(&rq->lock, flags);
+}
+
+static int sched_freq_transition(struct notifier_block *nb,
+				 unsigned long val, void *data)
+{
+	struct cpufreq_freqs *freqs = data;
+
+	if (val == CPUFREQ_POSTCHANGE)
+		sched_set_freq(freqs->cpu, freqs->new);
+	return 0;
+}
+
+static int sched_freq_policy(struct notifier_block *nb,
+			     unsigned long val, void *data)
+{
+	struct cpufreq_policy *policy = data;
+	int cpu;
+
+	if (val != CPUFREQ_NOTIFY)
+		return 0;
+
+	for_each_cpu(cpu, policy->cpus) {
+		per_cpu(sched_max_freq, cpu) = policy->cpuinfo.max_freq;
+		sched_set_freq(cpu, policy->cur);
+	}
+	return 0;
+}
+
+static struct notifier_block sched_freq_transition_nb = {
+	.notifier_call = sched_freq_transition,
+};
+
+static struct notifier_block sched_freq_policy_nb = {
+	.notifier_call = sched_freq_policy,
+};
+
+static int __init sched_freq_init(void)
+{
+	cpufreq_register_notifier(&sched_freq_transition_nb,
+				  CPUFREQ_TRANSITION_NOTIFIER);
+	cpufreq_register_notifier(&sched_freq_policy_nb,
+				  CPUFREQ_POLICY_NOTIFIER);
+	return 0;
+}
+core_initcall(sched_freq_init);
+#endif
+
 #ifdef CONFIG_SMP
 
 /*
@@ -4461,6 +4716,7 @@ void scheduler_tick(void)
 	spin_lock(&rq->lock);
 	update_rq_clock(rq);
 	update_cpu_load(rq);
+	update_rq_util(rq, curr != rq->idle);
 	curr->sched_class->task_tick(rq, curr, 0);
 	spin_unlock(&rq->lock);
 
@@ -4634,6 +4890,7 @@ need_resched_nonpreemptible:
 
 	spin_lock_irq(&rq->lock);
 	update_rq_clock(rq);
+	update_rq_util(rq, prev != rq->idle);
 	clear_tsk_need_resched(prev);
 
 	if (prev->state && !(preempt_count() & PREEMPT_ACTIVE)) {
@@ -6501,6 +6758,8 @@ static void migrate_dead_tasks(unsigned int dead_cpu)
 		if (!rq->nr_running)
 			break;
 		update_rq_clock(rq);
+		/* moving a task off may charge, and throttle, its group */
+		unthrottle_offline_cfs_rqs(rq);
 		next = pick_next_task(rq, rq->curr);
 		if (!next)
 			break;
@@ -8323,6 +8582,9 @@ static void init_tg_cfs_entry(struct task_group *tg, struct cfs_rq *cfs_rq,
 	tg->cfs_rq[cpu] = cfs_rq;
 	init_cfs_rq(cfs_rq, rq);
 	cfs_rq->tg = tg;
+#ifdef CONFIG_CFS_BANDWIDTH
+	cfs_rq->cfs_quota = tg->cfs_bandwidth.cfs_quota;
+#endif
 	if (add)
 		list_add(&cfs_rq->leaf_cfs_rq_list, &rq->leaf_cfs_rq_list);
 
@@ -8442,6 +8704,15 @@ void __init sched_init(void)
 #endif /* CONFIG_USER_SCHED */
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	init_cfs_bandwidth(&init_task_group.cfs_bandwidth,
+			DEF_CFS_PERIOD, RUNTIME_INF);
+#ifdef CONFIG_USER_SCHED
+	init_cfs_bandwidth(&root_task_group.cfs_bandwidth,
+			DEF_CFS_PERIOD, RUNTIME_INF);
+#endif /* CONFIG_USER_SCHED */
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 #ifdef CONFIG_GROUP_SCHED
 	list_add(&init_task_group.list, &task_groups);
 	INIT_LIST_HEAD(&init_task_group.children);
@@ -8459,6 +8730,7 @@ void __init sched_init(void)
 		rq = cpu_rq(i);
 		spin_lock_init(&rq->lock);
 		rq->nr_running = 0;
+		rq->freq_scale = SCHED_LOAD_SCALE;
 		init_cfs_rq(&rq->cfs, rq);
 		init_rt_rq(&rq->rt, rq);
 #ifdef CONFIG_FAIR_GROUP_SCHED
@@ -8733,6 +9005,10 @@ static void free_fair_sched_group(struct task_group *tg)
 {
 	int i;
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	destroy_cfs_bandwidth(&tg->cfs_bandwidth);
+#endif
+
 	for_each_possible_cpu(i) {
 		if (tg->cfs_rq)
 			kfree(tg->cfs_rq[i]);
@@ -8752,6 +9028,10 @@ int alloc_fair_sched_group(struct task_group *tg, struct task_group *parent)
 	struct rq *rq;
 	int i;
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	init_cfs_bandwidth(&tg->cfs_bandwidth, DEF_CFS_PERIOD, RUNTIME_INF);
+#endif
+
 	tg->cfs_rq = kzalloc(sizeof(cfs_rq) * nr_cpu_ids, GFP_KERNEL);
 	if (!tg->cfs_rq)
 		goto err;
@@ -9102,8 +9382,117 @@ unsigned long sched_group_shares(struct task_group *tg)
 {
 	return tg->shares;
 }
+
+int sched_group_set_wakeup_boost(struct task_group *tg, int boost)
+{
+	tg->wakeup_boost = !!boost;
+	return 0;
+}
+
+int sched_group_wakeup_boost(struct task_group *tg)
+{
+	return tg->wakeup_boost;
+}
 #endif
 
+#ifdef CONFIG_CFS_BANDWIDTH
+static DEFINE_MUTEX(cfs_constraints_mutex);
+
+/* keep the period timer, and the quota it refills, sane */
+#define MIN_CFS_PERIOD		NSEC_PER_MSEC
+#define MAX_CFS_PERIOD		NSEC_PER_SEC
+#define MIN_CFS_QUOTA		NSEC_PER_MSEC
+
+static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
+{
+	struct cfs_bandwidth *cfs_b = &tg->cfs_bandwidth;
+	int i;
+
+	/*
+	 * We can't throttle the root cgroup.
+	 */
+	if (!tg->se[0])
+		return -EINVAL;
+
+	if (period < MIN_CFS_PERIOD || period > MAX_CFS_PERIOD)
+		return -EINVAL;
+
+	if (quota != RUNTIME_INF && (quota < MIN_CFS_QUOTA || quota > period))
+		return -EINVAL;
+
+	mutex_lock(&cfs_constraints_mutex);
+	spin_lock_irq(&cfs_b->lock);
+	cfs_b->cfs_period = ns_to_ktime(period);
+	cfs_b->cfs_quota = quota;
+	spin_unlock_irq(&cfs_b->lock);
+
+	/* start each cpu on a fresh period, under the new quota */
+	for_each_possible_cpu(i) {
+		struct cfs_rq *cfs_rq = tg->cfs_rq[i];
+		struct rq *rq = rq_of(cfs_rq);
+
+		spin_lock_irq(&rq->lock);
+		cfs_rq->cfs_quota = quota;
+		cfs_rq->cfs_time = 0;
+		if (cfs_rq_throttled(cfs_rq))
+			unthrottle_cfs_rq(cfs_rq);
+		spin_unlock_irq(&rq->lock);
+	}
+	mutex_unlock(&cfs_constraints_mutex);
+
+	return 0;
+}
+
+int sched_group_set_cfs_quota(struct task_group *tg, long cfs_quota_us)
+{
+	u64 quota, period;
+
+	if (cfs_quota_us > MAX_CFS_PERIOD / NSEC_PER_USEC)
+		return -EINVAL;
+
+	period = ktime_to_ns(tg->cfs_bandwidth.cfs_period);
+	quota = (u64)cfs_quota_us * NSEC_PER_USEC;
+	if (cfs_quota_us < 0)
+		quota = RUNTIME_INF;
+
+	return tg_set_cfs_bandwidth(tg, period, quota);
+}
+
+long sched_group_cfs_quota(struct task_group *tg)
+{
+	u64 quota_us;
+
+	if (tg->cfs_bandwidth.cfs_quota == RUNTIME_INF)
+		return -1;
+
+	quota_us = tg->cfs_bandwidth.cfs_quota;
+	do_div(quota_us, NSEC_PER_USEC);
+	return quota_us;
+}
+
+int sched_group_set_cfs_period(struct task_group *tg, long cfs_period_us)
+{
+	u64 quota, period;
+
+	if (cfs_period_us < 0 || cfs_period_us > MAX_CFS_PERIOD / NSEC_PER_USEC)
+		return -EINVAL;
+
+	period = (u64)cfs_period_us * NSEC_PER_USEC;
+	quota = tg->cfs_bandwidth.cfs_quota;
+
+	return tg_set_cfs_bandwidth(tg, period, quota);
+}
+
+long sched_group_cfs_period(struct task_group *tg)
+{
+	u64 period_us;
+
+	period_us = ktime_to_ns(tg->cfs_bandwidth.cfs_period);
+	do_div(period_us, NSEC_PER_USEC);
+	return period_us;
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 #ifdef CONFIG_RT_GROUP_SCHED
 /*
  * Ensure that the real time constraints are schedulable.
@@ -9455,8 +9844,62 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 
 	return (u64) tg->shares;
 }
+
+static int cpu_wakeup_boost_write_u64(struct cgroup *cgrp, struct cftype *cft,
+		u64 boost)
+{
+	return sched_group_set_wakeup_boost(cgroup_tg(cgrp), boost);
+}
+
+static u64 cpu_wakeup_boost_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return sched_group_wakeup_boost(cgroup_tg(cgrp));
+}
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
+#ifdef CONFIG_CFS_BANDWIDTH
+static int cpu_cfs_quota_write_s64(struct cgroup *cgrp, struct cftype *cft,
+		s64 cfs_quota_us)
+{
+	return sched_group_set_cfs_quota(cgroup_tg(cgrp), cfs_quota_us);
+}
+
+static s64 cpu_cfs_quota_read_s64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return sched_group_cfs_quota(cgroup_tg(cgrp));
+}
+
+static int cpu_cfs_period_write_u64(struct cgroup *cgrp, struct cftype *cft,
+		u64 cfs_period_us)
+{
+	return sched_group_set_cfs_period(cgroup_tg(cgrp), cfs_period_us);
+}
+
+static u64 cpu_cfs_period_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return sched_group_cfs_period(cgroup_tg(cgrp));
+}
+
+static int cpu_stats_show(struct cgroup *cgrp, struct cftype *cft,
+		struct cgroup_map_cb *cb)
+{
+	struct cfs_bandwidth *cfs_b = &cgroup_tg(cgrp)->cfs_bandwidth;
+	u64 nr_periods, nr_throttled, throttled_time;
+
+	spin_lock_irq(&cfs_b->lock);
+	nr_periods = cfs_b->nr_periods;
+	nr_throttled = cfs_b->nr_throttled;
+	throttled_time = cfs_b->throttled_time;
+	spin_unlock_irq(&cfs_b->lock);
+
+	cb->fill(cb, "nr_periods", nr_periods);
+	cb->fill(cb, "nr_throttled", nr_throttled);
+	cb->fill(cb, "throttled_time", throttled_time);
+
+	return 0;
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 #ifdef CONFIG_RT_GROUP_SCHED
 static int cpu_rt_runtime_write(struct cgroup *cgrp, struct cftype *cft,
 				s64 val)
@@ -9488,6 +9931,27 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_shares_read_u64,
 		.write_u64 = cpu_shares_write_u64,
 	},
+	{
+		.name = "wakeup_boost",
+		.read_u64 = cpu_wakeup_boost_read_u64,
+		.write_u64 = cpu_wakeup_boost_write_u64,
+	},
+#endif
+#ifdef CONFIG_CFS_BANDWIDTH
+	{
+		.name = "cfs_quota_us",
+		.read_s64 = cpu_cfs_quota_read_s64,
+		.write_s64 = cpu_cfs_quota_write_s64,
+	},
+	{
+		.name = "cfs_period_us",
+		.read_u64 = cpu_cfs_period_read_u64,
+		.write_u64 = cpu_cfs_period_write_u64,
+	},
+	{
+		.name = "stat",
+		.read_map = cpu_stats_show,
+	},
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
@@ -186,6 +186,17 @@ find_matching_se(struct sched_entity **se, struct sched_entity **pse)
 	}
 }
 
+/* the wakeup preference of the group an entity stands for, or is in */
+static inline int entity_wakeup_boost(struct sched_entity *se)
+{
+	struct cfs_rq *cfs_rq = group_cfs_rq(se);
+
+	if (!cfs_rq)
+		cfs_rq = cfs_rq_of(se);
+
+	return cfs_rq->tg->wakeup_boost;
+}
+
 #else	/* CONFIG_FAIR_GROUP_SCHED */
 
 static inline struct rq *rq_of(struct cfs_rq *cfs_rq)
@@ -241,6 +252,11 @@ find_matching_se(struct sched_entity **se, struct sched_entity **pse)
 {
 }
 
+static inline int entity_wakeup_boost(struct sched_entity *se)
+{
+	return 0;
+}
+
 #endif	/* CONFIG_FAIR_GROUP_SCHED */
 
 
@@ -474,6 +490,52 @@ __update_curr(struct cfs_rq *cfs_rq, struct sched_entity *curr,
 	update_min_vruntime(cfs_rq);
 }
 
+#ifdef CONFIG_CFS_BANDWIDTH
+static inline int cfs_rq_throttled(struct cfs_rq *cfs_rq)
+{
+	return cfs_rq->cfs_throttled;
+}
+
+/*
+ * Charge the run time to the group's quota.  Going over it only asks
+ * for a reschedule: the cfs_rq is taken off its parent from
+ * put_prev_task_fair(), where nothing in it is running any more.
+ */
+static void account_cfs_rq_quota(struct cfs_rq *cfs_rq,
+		unsigned long delta_exec)
+{
+	if (cfs_rq->cfs_quota == RUNTIME_INF)
+		return;
+
+	cfs_rq->cfs_time += delta_exec;
+	start_cfs_bandwidth(&cfs_rq->tg->cfs_bandwidth);
+
+	if (cfs_rq->cfs_time > cfs_rq->cfs_quota)
+		resched_task(rq_of(cfs_rq)->curr);
+}
+#else
+static inline int cfs_rq_throttled(struct cfs_rq *cfs_rq)
+{
+	return 0;
+}
+
+static inline void account_cfs_rq_quota(struct cfs_rq *cfs_rq,
+		unsigned long delta_exec)
+{
+}
+#endif
+
+/* is the entity, or any of its parents, in a throttled cfs_rq */
+static int entity_throttled(struct sched_entity *se)
+{
+	for_each_sched_entity(se) {
+		if (cfs_rq_throttled(cfs_rq_of(se)))
+			return 1;
+	}
+
+	return 0;
+}
+
 static void update_curr(struct cfs_rq *cfs_rq)
 {
 	struct sched_entity *curr = cfs_rq->curr;
@@ -494,6 +556,7 @@ static void update_curr(struct cfs_rq *cfs_rq)
 
 	__update_curr(cfs_rq, curr, delta_exec);
 	curr->exec_start = now;
+	account_cfs_rq_quota(cfs_rq, delta_exec);
 
 	if (entity_is_task(curr)) {
 		struct task_struct *curtask = task_of(curr);
@@ -764,6 +827,137 @@ dequeue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int sleep)
 	update_min_vruntime(cfs_rq);
 }
 
+#ifdef CONFIG_CFS_BANDWIDTH
+/*
+ * Take a cfs_rq that ran out of quota off the runqueue: dequeue the
+ * group's entity, and its parents that are left empty, just as
+ * dequeue_task_fair() would.  Its tasks stay queued on it.
+ */
+static void throttle_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	struct cfs_bandwidth *cfs_b = &cfs_rq->tg->cfs_bandwidth;
+	struct sched_entity *se = cfs_rq->tg->se[cpu_of(rq)];
+
+	for_each_sched_entity(se) {
+		struct cfs_rq *qcfs_rq = cfs_rq_of(se);
+
+		if (!se->on_rq)
+			break;
+		dequeue_entity(qcfs_rq, se, 0);
+		if (qcfs_rq->load.weight || cfs_rq_throttled(qcfs_rq))
+			break;
+	}
+
+	cfs_rq->cfs_throttled = 1;
+	cfs_rq->cfs_throttled_clock = rq->clock;
+
+	spin_lock(&cfs_b->lock);
+	cfs_b->nr_throttled++;
+	spin_unlock(&cfs_b->lock);
+}
+
+static void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	struct cfs_bandwidth *cfs_b = &cfs_rq->tg->cfs_bandwidth;
+	struct sched_entity *se = cfs_rq->tg->se[cpu_of(rq)];
+
+	update_rq_clock(rq);
+	cfs_rq->cfs_throttled = 0;
+
+	spin_lock(&cfs_b->lock);
+	cfs_b->throttled_time += rq->clock - cfs_rq->cfs_throttled_clock;
+	spin_unlock(&cfs_b->lock);
+
+	if (!cfs_rq->load.weight)
+		return;
+
+	for_each_sched_entity(se) {
+		if (se->on_rq)
+			break;
+		cfs_rq = cfs_rq_of(se);
+		enqueue_entity(cfs_rq, se, 1);
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	/* we may have been holding up a cpu that has nothing else to do */
+	if (rq->curr == rq->idle && rq->cfs.nr_running &&
+	    cpu_online(cpu_of(rq)))
+		resched_task(rq->curr);
+}
+
+static void check_cfs_rq_quota(struct cfs_rq *cfs_rq)
+{
+	if (!cfs_rq_throttled(cfs_rq) && cfs_rq->cfs_time > cfs_rq->cfs_quota)
+		throttle_cfs_rq(cfs_rq);
+}
+
+/*
+ * Refill each cpu's quota for the periods gone by, and put back what
+ * that lets run again.  Returns 1 once no cpu has used any quota, so
+ * the timer can stop until the group runs again.
+ */
+static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
+{
+	struct task_group *tg =
+		container_of(cfs_b, struct task_group, cfs_bandwidth);
+	int i, idle = 1;
+
+	if (cfs_b->cfs_quota == RUNTIME_INF)
+		return 1;
+
+	for_each_online_cpu(i) {
+		struct cfs_rq *cfs_rq = tg->cfs_rq[i];
+		struct rq *rq = rq_of(cfs_rq);
+
+		spin_lock(&rq->lock);
+		if (cfs_rq->cfs_time) {
+			u64 refill = overrun * cfs_rq->cfs_quota;
+
+			cfs_rq->cfs_time -= min(cfs_rq->cfs_time, refill);
+			if (cfs_rq_throttled(cfs_rq) &&
+					cfs_rq->cfs_time < cfs_rq->cfs_quota)
+				unthrottle_cfs_rq(cfs_rq);
+			if (cfs_rq->cfs_time)
+				idle = 0;
+		}
+		spin_unlock(&rq->lock);
+	}
+
+	spin_lock(&cfs_b->lock);
+	cfs_b->nr_periods += overrun;
+	spin_unlock(&cfs_b->lock);
+
+	return idle;
+}
+
+#ifdef CONFIG_HOTPLUG_CPU
+/*
+ * The tasks of a throttled cfs_rq are still counted in rq->nr_running but
+ * cannot be picked, and the period timer no longer refills a cpu once it
+ * is offline: put every group back so migrate_dead_tasks() can move them.
+ */
+static void unthrottle_offline_cfs_rqs(struct rq *rq)
+{
+	struct cfs_rq *cfs_rq;
+
+	for_each_leaf_cfs_rq(rq, cfs_rq)
+		if (cfs_rq_throttled(cfs_rq))
+			unthrottle_cfs_rq(cfs_rq);
+}
+#endif
+#else
+static inline void check_cfs_rq_quota(struct cfs_rq *cfs_rq)
+{
+}
+
+static inline void unthrottle_offline_cfs_rqs(struct rq *rq)
+{
+}
+#endif
+
 /*
  * Preempt the current task with a newly woken task if needed:
  */
@@ -952,6 +1146,9 @@ static void enqueue_task_fair(struct rq *rq, struct task_struct *p, int wakeup)
 			break;
 		cfs_rq = cfs_rq_of(se);
 		enqueue_entity(cfs_rq, se, wakeup);
+		/* a throttled group goes back on when its quota is refilled */
+		if (cfs_rq_throttled(cfs_rq))
+			break;
 		wakeup = 1;
 	}
 
@@ -971,8 +1168,11 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int sleep)
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		dequeue_entity(cfs_rq, se, sleep);
-		/* Don't dequeue parent if it has other entities besides us */
-		if (cfs_rq->load.weight)
+		/*
+		 * Don't dequeue parent if it has other entities besides us,
+		 * or is off the runqueue already, being throttled.
+		 */
+		if (cfs_rq->load.weight || cfs_rq_throttled(cfs_rq))
 			break;
 		sleep = 1;
 	}
@@ -1347,6 +1547,13 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se)
 {
 	s64 gran, vdiff = curr->vruntime - se->vruntime;
 
+	/*
+	 * A group that prefers its wakeups (the foreground) gets up to a
+	 * latency period of vruntime head start over one that doesn't.
+	 */
+	vdiff += (s64)(entity_wakeup_boost(se) - entity_wakeup_boost(curr)) *
+		sysctl_sched_latency;
+
 	if (vdiff <= 0)
 		return -1;
 
@@ -1395,6 +1602,10 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int sync)
 	if (unlikely(se == pse))
 		return;
 
+	/* it won't run before its group's quota is refilled */
+	if (entity_throttled(pse))
+		return;
+
 	/*
 	 * Only set the backward buddy when the current task is still on the
 	 * rq. This can happen when a wakeup gets interleaved with schedule on
@@ -1491,6 +1702,11 @@ static void put_prev_task_fair(struct rq *rq, struct task_struct *prev)
 		cfs_rq = cfs_rq_of(se);
 		put_prev_entity(cfs_rq, se);
 	}
+
+	/* with nothing running, throttle the groups out of quota */
+	se = &prev->se;
+	for_each_sched_entity(se)
+		check_cfs_rq_quota(cfs_rq_of(se));
 }
 
 #ifdef CONFIG_SMP
@@ -0,0 +1,187 @@
+/*
+ * kernel/sched_util_test.c
+ *
+ * Check that the scheduler's frequency invariant utilisation follows a
+ * known load across cpu speeds.
+ *
+ * A thread bound to one cpu runs a duty cycle (busy for part of each
+ * period, asleep for the rest) at each speed of the cpu's frequency
+ * table, the speed being pinned with PM_QOS_CPU_FREQ_MIN/MAX requests.
+ * After settling, sched_cpu_util() should be the measured duty cycle
+ * times the speed over the top speed, give or take what else runs on
+ * the cpu.  Each case is logged; a summary follows.  With a driver that
+ * only pretends to change speed, such as cpufreq_sim, this checks the
+ * bookkeeping rather than the hardware.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/cpufreq.h>
+#include <linux/pm_qos_params.h>
+#include <linux/hrtimer.h>
+#include <linux/delay.h>
+
+#define PERIOD_NS	(20 * NSEC_PER_MSEC)
+#define SETTLE_PERIODS	25
+#define SAMPLE_PERIODS	25
+
+static int cpu;
+module_param(cpu, int, S_IRUGO);
+
+/* allowed error, in SCHED_LOAD_SCALE units */
+static int tolerance = SCHED_LOAD_SCALE / 10;
+module_param(tolerance, int, S_IRUGO);
+
+static const int duties[] = { 25, 50, 75 };
+
+static struct task_struct *test_task;
+static struct pm_qos_request freq_min;
+static struct pm_qos_request freq_max;
+
+static int pin_freq(unsigned int freq)
+{
+	int i;
+
+	pm_qos_update_request(&freq_max, freq);
+	pm_qos_update_request(&freq_min, freq);
+	for (i = 0; i < 100; i++) {
+		if (cpufreq_quick_get(cpu) == freq)
+			return 0;
+		msleep(10);
+	}
+	return -ETIMEDOUT;
+}
+
+/* Busy for @busy_ns, then asleep until the end of the period */
+static s64 run_period(s64 busy_ns)
+{
+	ktime_t start = ktime_get();
+	ktime_t end = ktime_add_ns(start, PERIOD_NS);
+	s64 busy;
+
+	while (ktime_to_ns(ktime_sub(ktime_get(), start)) < busy_ns)
+		cpu_relax();
+	busy = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	set_current_state(TASK_UNINTERRUPTIBLE);
+	schedule_hrtimeout(&end, HRTIMER_MODE_ABS);
+	return busy;
+}
+
+static int run_case(unsigned int freq, unsigned int max_freq, int duty)
+{
+	s64 busy_ns = div_s64((s64)PERIOD_NS * duty, 100);
+	s64 busy = 0;
+	u64 expected, total = 0;
+	unsigned long util;
+	int i;
+
+	for (i = 0; i < SETTLE_PERIODS; i++)
+		run_period(busy_ns);
+	for (i = 0; i < SAMPLE_PERIODS; i++) {
+		busy += run_period(busy_ns);
+		total += sched_cpu_util(cpu);
+	}
+	util = div_u64(total, SAMPLE_PERIODS);
+
+	/* what we were busy for, at this speed */
+	expected = div_u64((u64)busy << SCHED_LOAD_SHIFT,
+			   PERIOD_NS * SAMPLE_PERIODS);
+	expected = div_u64(expected * freq, max_freq);
+
+	pr_info("sched_util_test: %u kHz, %d%% busy: util %lu, expected %llu"
+		"%s\n", freq, duty, util, (unsigned long long)expected,
+		abs((long)util - (long)expected) > tolerance ? " FAIL" : "");
+	return abs((long)util - (long)expected) <= tolerance;
+}
+
+static int sched_util_test_thread(void *arg)
+{
+	struct cpufreq_frequency_table *table;
+	struct cpufreq_policy *policy;
+	unsigned int max_freq;
+	int i, j, passed = 0, run = 0;
+
+	policy = cpufreq_cpu_get(cpu);
+	table = cpufreq_frequency_get_table(cpu);
+	if (!policy || !table) {
+		pr_info("sched_util_test: no cpufreq table for cpu %d\n", cpu);
+		goto out;
+	}
+	max_freq = policy->cpuinfo.max_freq;
+
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		unsigned int freq = table[i].frequency;
+
+		if (freq == CPUFREQ_ENTRY_INVALID)
+			continue;
+		if (pin_freq(freq)) {
+			pr_info("sched_util_test: could not pin %u kHz\n",
+				freq);
+			continue;
+		}
+		for (j = 0; j < ARRAY_SIZE(duties); j++) {
+			if (kthread_should_stop())
+				goto out;
+			passed += run_case(freq, max_freq, duties[j]);
+			run++;
+		}
+	}
+	pr_info("sched_util_test: %d of %d cases passed\n", passed, run);
+
+out:
+	if (policy)
+		cpufreq_cpu_put(policy);
+	pm_qos_update_request(&freq_min, PM_QOS_DEFAULT_VALUE);
+	pm_qos_update_request(&freq_max, PM_QOS_DEFAULT_VALUE);
+	while (!kthread_should_stop())
+		schedule_timeout_interruptible(HZ);
+	return 0;
+}
+
+static int __init sched_util_test_init(void)
+{
+	if (!cpu_online(cpu))
+		return -ENODEV;
+
+	pm_qos_add_request(&freq_min, PM_QOS_CPU_FREQ_MIN,
+			   "sched_util_test", PM_QOS_DEFAULT_VALUE);
+	pm_qos_add_request(&freq_max, PM_QOS_CPU_FREQ_MAX,
+			   "sched_util_test", PM_QOS_DEFAULT_VALUE);
+
+	test_task = kthread_create(sched_util_test_thread, NULL,
+				   "sched_util_test");
+	if (IS_ERR(test_task)) {
+		pm_qos_remove_request(&freq_min);
+		pm_qos_remove_request(&freq_max);
+		return PTR_ERR(test_task);
+	}
+	kthread_bind(test_task, cpu);
+	wake_up_process(test_task);
+	return 0;
+}
+
+static void __exit sched_util_test_exit(void)
+{
+	kthread_stop(test_task);
+	pm_qos_remove_request(&freq_min);
+	pm_qos_remove_request(&freq_max);
+}
+
+late_initcall(sched_util_test_init);
+module_exit(sched_util_test_exit);
+
+MODULE_DESCRIPTION("Frequency invariant scheduler utilisation test");
+MODULE_LICENSE("GPL");
@@ -31,6 +31,11 @@
  * Display the information collected so far:
  * # cat /proc/timer_stats
  *
+ * An event is "merged" when the timer expired in the same tick or timer
+ * interrupt as an earlier one, so that it did not cost a wakeup of its
+ * own; timer slack and deferrable timer coalescing are what make this
+ * happen on purpose.
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License version 2 as
  * published by the Free Software Foundation.
@@ -65,9 +70,10 @@ struct entry {
 	pid_t			pid;
 
 	/*
-	 * Number of timeout events:
+	 * Number of timeout events, and how many of them were merged:
 	 */
 	unsigned long		count;
+	unsigned long		merged;
 	unsigned int		timer_flag;
 
 	/*
@@ -204,6 +210,7 @@ static struct entry *tstat_lookup(struct entry *entry, char *comm)
 	if (curr) {
 		*curr = *entry;
 		curr->count = 0;
+		curr->merged = 0;
 		curr->next = NULL;
 		memcpy(curr->comm, comm, TASK_COMM_LEN);
 
@@ -227,6 +234,7 @@ static struct entry *tstat_lookup(struct entry *entry, char *comm)
  * @startf:	pointer to the function which did the timer setup
  * @timerf:	pointer to the timer callback function of the timer
  * @comm:	name of the process which set up the timer
+ * @timer_flag:	TIMER_STATS_FLAG_* for this event
  *
  * When the timer is already registered, then the event counter is
  * incremented. Otherwise the timer is registered in a free slot.
@@ -251,16 +259,18 @@ void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 	input.start_func = startf;
 	input.expire_func = timerf;
 	input.pid = pid;
-	input.timer_flag = timer_flag;
+	input.timer_flag = timer_flag & ~TIMER_STATS_FLAG_MERGED;
 
 	spin_lock_irqsave(lock, flags);
 	if (!active)
 		goto out_unlock;
 
 	entry = tstat_lookup(&input, comm);
-	if (likely(entry))
+	if (likely(entry)) {
 		entry->count++;
-	else
+		if (timer_flag & TIMER_STATS_FLAG_MERGED)
+			entry->merged++;
+	} else
 		atomic_inc(&overflow_count);
 
  out_unlock:
@@ -283,6 +293,7 @@ static int tstats_show(struct seq_file *m, void *v)
 	struct entry *entry;
 	unsigned long ms;
 	long events = 0;
+	long merged = 0;
 	ktime_t time;
 	int i;
 
@@ -298,7 +309,7 @@ static int tstats_show(struct seq_file *m, void *v)
 	period = ktime_to_timespec(time);
 	ms = period.tv_nsec / 1000000;
 
-	seq_puts(m, "Timer Stats Version: v0.2\n");
+	seq_puts(m, "Timer Stats Version: v0.3\n");
 	seq_printf(m, "Sample period: %ld.%03ld s\n", period.tv_sec, ms);
 	if (atomic_read(&overflow_count))
 		seq_printf(m, "Overflow: %d entries\n",
@@ -317,9 +328,13 @@ static int tstats_show(struct seq_file *m, void *v)
 		print_name_offset(m, (unsigned long)entry->start_func);
 		seq_puts(m, " (");
 		print_name_offset(m, (unsigned long)entry->expire_func);
-		seq_puts(m, ")\n");
+		if (entry->merged)
+			seq_printf(m, ") %lu merged\n", entry->merged);
+		else
+			seq_puts(m, ")\n");
 
 		events += entry->count;
+		merged += entry->merged;
 	}
 
 	ms += period.tv_sec * 1000;
@@ -332,6 +347,7 @@ static int tstats_show(struct seq_file *m, void *v)
 			   (events * 1000000 / ms) % 1000);
 	else
 		seq_printf(m, "%ld total events\n", events);
+	seq_printf(m, "%ld merged events\n", merged);
 
 	mutex_unlock(&show_mutex);
 
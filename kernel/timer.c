@@ -374,19 +374,23 @@ void __timer_stats_timer_set_start_info(struct timer_list *timer, void *addr)
 	timer->start_pid = current->pid;
 }
 
-static void timer_stats_account_timer(struct timer_list *timer)
+static void timer_stats_account_timer(struct timer_list *timer, int merged)
 {
 	unsigned int flag = 0;
 
 	if (unlikely(tbase_get_deferrable(timer->base)))
 		flag |= TIMER_STATS_FLAG_DEFERRABLE;
+	if (merged)
+		flag |= TIMER_STATS_FLAG_MERGED;
 
 	timer_stats_update_stats(timer, timer->start_pid, timer->start_site,
 				 timer->function, timer->start_comm, flag);
 }
 
 #else
-static void timer_stats_account_timer(struct timer_list *timer) {}
+static void timer_stats_account_timer(struct timer_list *timer, int merged)
+{
+}
 #endif
 
 #ifdef CONFIG_DEBUG_OBJECTS_TIMERS
@@ -589,6 +593,32 @@ static struct tvec_base *lock_timer_base(struct timer_list *timer,
 	}
 }
 
+/*
+ * A deferrable timer only runs once its CPU is awake for something else,
+ * so it may as well expire a little late.  Move it to the coarsest
+ * boundary within 1/DEFERRABLE_SLACK of its timeout past what was asked:
+ * deferrable timers set around the same time then share an expiry, and
+ * the CPU runs them in one go instead of waking up for each of them.
+ */
+#define DEFERRABLE_SLACK	16
+
+static unsigned long coalesce_deferrable(unsigned long expires)
+{
+	unsigned long now = jiffies;
+	unsigned long limit, mask;
+
+	if (!time_after(expires, now))
+		return expires;
+
+	limit = expires + (expires - now) / DEFERRABLE_SLACK;
+	mask = expires ^ limit;
+	if (!mask)
+		return expires;
+
+	mask = (1UL << __fls(mask)) - 1;
+	return limit & ~mask;
+}
+
 int __mod_timer(struct timer_list *timer, unsigned long expires)
 {
 	struct tvec_base *base, *new_base;
@@ -598,6 +628,9 @@ int __mod_timer(struct timer_list *timer, unsigned long expires)
 	timer_stats_timer_set_start_info(timer);
 	BUG_ON(!timer->function);
 
+	if (tbase_get_deferrable(timer->base))
+		expires = coalesce_deferrable(expires);
+
 	base = lock_timer_base(timer, &flags);
 
 	if (timer_pending(timer)) {
@@ -650,6 +683,8 @@ void add_timer_on(struct timer_list *timer, int cpu)
 
 	timer_stats_timer_set_start_info(timer);
 	BUG_ON(timer_pending(timer) || !timer->function);
+	if (tbase_get_deferrable(timer->base))
+		timer->expires = coalesce_deferrable(timer->expires);
 	spin_lock_irqsave(&base->lock, flags);
 	timer_set_base(timer, base);
 	debug_timer_activate(timer);
@@ -832,6 +867,7 @@ static int cascade(struct tvec_base *base, struct tvec *tv, int index)
 static inline void __run_timers(struct tvec_base *base)
 {
 	struct timer_list *timer;
+	int nr_run = 0;
 
 	spin_lock_irq(&base->lock);
 	while (time_after_eq(jiffies, base->timer_jiffies)) {
@@ -857,7 +893,7 @@ static inline void __run_timers(struct tvec_base *base)
 			fn = timer->function;
 			data = timer->data;
 
-			timer_stats_account_timer(timer);
+			timer_stats_account_timer(timer, nr_run++);
 
 			set_running_timer(base, timer);
 			detach_timer(timer, 1);
@@ -34,6 +34,7 @@
 #include <linux/hardirq.h> /* for BUG_ON(!in_atomic()) only */
 #include <linux/memcontrol.h>
 #include <linux/mm_inline.h> /* for page_is_file_cache() */
+#include <linux/launch_prefetch.h>
 #include "internal.h"
 
 /*
@@ -123,6 +124,10 @@ void __remove_from_page_cache(struct page *page)
 	BUG_ON(page_mapped(page));
 	mem_cgroup_uncharge_cache_page(page);
 
+	/* Read ahead but never referenced */
+	if (TestClearPageSpeculative(page))
+		__count_vm_event(READAHEAD_UNUSED);
+
 	/*
 	 * Some filesystems seem to re-dirty the page even after
 	 * the VM has canceled the dirty bit (eg ext3 journaling).
@@ -506,9 +511,12 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 
 	ret = add_to_page_cache(page, mapping, offset, gfp_mask);
 	if (ret == 0) {
-		if (page_is_file_cache(page))
-			lru_cache_add_file(page);
-		else
+		if (page_is_file_cache(page)) {
+			if (workingset_refault(mapping, offset))
+				lru_cache_add_active_file(page);
+			else
+				lru_cache_add_file(page);
+		} else
 			lru_cache_add_active_anon(page);
 	}
 	return ret;
@@ -1037,7 +1045,9 @@ find_page:
 			page = find_get_page(mapping, index);
 			if (unlikely(page == NULL))
 				goto no_cached_page;
-		}
+			page_cache_ra_demand(ra, page);
+		} else
+			page_cache_ra_hit(ra, page);
 		if (PageReadahead(page)) {
 			page_cache_async_readahead(mapping,
 					ra, filp, page,
@@ -1464,6 +1474,8 @@ int filemap_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	if (vmf->pgoff >= size)
 		return VM_FAULT_SIGBUS;
 
+	launch_prefetch_record(file, vmf->pgoff);
+
 	/* If we don't want any read-ahead, don't bother */
 	if (VM_RandomReadHint(vma))
 		goto no_cached_page;
@@ -1483,12 +1495,15 @@ retry_find:
 			page = find_lock_page(mapping, vmf->pgoff);
 			if (!page)
 				goto no_cached_page;
-		}
+			page_cache_ra_demand(ra, page);
+		} else
+			page_cache_ra_hit(ra, page);
 		if (PageReadahead(page)) {
 			page_cache_async_readahead(mapping, ra, file, page,
 							   vmf->pgoff, 1);
 		}
-	}
+	} else if (page)
+		page_cache_ra_hit(ra, page);
 
 	if (!page) {
 		unsigned long ra_pages;
@@ -1511,7 +1526,9 @@ retry_find:
 			count_vm_event(PGMAJFAULT);
 		}
 		did_readaround = 1;
-		ra_pages = max_sane_readahead(file->f_ra.ra_pages);
+		ra_pages = ra_adaptive_pages(ra, vmf->pgoff);
+		if (ra_pages)
+			ra_pages = max_sane_readahead(ra_pages);
 		if (ra_pages) {
 			pgoff_t start = 0;
 
@@ -1522,6 +1539,7 @@ retry_find:
 		page = find_lock_page(mapping, vmf->pgoff);
 		if (!page)
 			goto no_cached_page;
+		page_cache_ra_demand(ra, page);
 	}
 
 	if (!did_readaround)
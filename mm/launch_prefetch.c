@@ -0,0 +1,710 @@
+/* mm/launch_prefetch.c
+**
+** Application launch prefetcher.
+**
+** While a launch is being recorded, every page cache fault taken by the
+** launching thread group is logged as (file, page offset).  When recording
+** stops the log is sorted, coalesced into extents and handed to userspace
+** as text.  On the next launch userspace writes the trace back and the
+** extents are read ahead in file and offset order from a kernel thread,
+** so the working set arrives in a few large I/Os instead of one fault at
+** a time.
+**
+** This software is licensed under the terms of the GNU General Public
+** License version 2, as published by the Free Software Foundation, and
+** may be copied, distributed, and modified under those terms.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+*/
+
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/kref.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/miscdevice.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/vmalloc.h>
+#include <linux/sort.h>
+#include <linux/workqueue.h>
+#include <linux/uaccess.h>
+#include <linux/launch_prefetch.h>
+
+#define LPF_MAX_ENTRIES		16384	/* faults recorded per launch */
+#define LPF_MAX_FILES		256	/* distinct files per launch */
+#define LPF_MAX_EXTENTS		8192	/* extents queued per replay */
+
+/*
+ * lpf_file - a file faulted on during the recorded launch
+ * The inode identifies it while recording.  The file is pinned when it is
+ * first seen, so its path can be looked up once recording has stopped.
+ */
+struct lpf_file {
+	struct inode *inode;
+	struct file *file;
+	char *path;			/* NULL if it could not be found */
+};
+
+struct lpf_entry {
+	unsigned int file;		/* index into lpf_files */
+	pgoff_t index;
+};
+
+/* thread group being recorded, 0 if none */
+pid_t launch_prefetch_tgid;
+
+/*
+ * lpf_trace - the text of the last finished recording
+ * Readers hold a reference while they copy it out, without lpf_mutex.
+ */
+struct lpf_trace {
+	struct kref ref;
+	size_t len;
+	char text[0];
+};
+
+/*
+ * lpf_mutex - serializes starting and stopping a recording, and protects
+ * lpf_trace
+ */
+static DEFINE_MUTEX(lpf_mutex);
+
+/*
+ * lpf_lock - protects launch_prefetch_tgid and the recording slots
+ *
+ * This is all the fault path takes.  It only fills in slots allocated
+ * when recording started; the paths are found after recording stops.
+ */
+static DEFINE_SPINLOCK(lpf_lock);
+
+static struct lpf_file *lpf_files;
+static unsigned int lpf_nr_files;
+static struct lpf_entry *lpf_entries;
+static unsigned int lpf_nr_entries;
+
+static struct lpf_trace *lpf_trace;
+
+/*
+ * lpf_extent - one line of a trace queued for replay
+ * Paths are owned by the batch and shared by consecutive lines.
+ */
+struct lpf_extent {
+	const char *path;
+	pgoff_t start;
+	unsigned long nr;
+};
+
+struct lpf_path {
+	struct list_head list;
+	char path[0];
+};
+
+struct lpf_batch {
+	struct list_head list;		/* entry in lpf_replay_list */
+	struct list_head paths;
+	struct lpf_extent *extents;
+	unsigned int nr;
+};
+
+/* lpf_replay_mutex - protects lpf_pending */
+static DEFINE_MUTEX(lpf_replay_mutex);
+static struct lpf_batch *lpf_pending;
+
+/* batches waiting for lpf_replay_work, protected by lpf_replay_lock */
+static LIST_HEAD(lpf_replay_list);
+static DEFINE_SPINLOCK(lpf_replay_lock);
+
+static struct workqueue_struct *lpf_wq;
+
+static void lpf_free_recording(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < lpf_nr_files; i++) {
+		fput(lpf_files[i].file);
+		kfree(lpf_files[i].path);
+	}
+	kfree(lpf_files);
+	vfree(lpf_entries);
+	lpf_files = NULL;
+	lpf_entries = NULL;
+	lpf_nr_files = 0;
+	lpf_nr_entries = 0;
+}
+
+static void lpf_trace_release(struct kref *ref)
+{
+	vfree(container_of(ref, struct lpf_trace, ref));
+}
+
+static void lpf_put_trace(struct lpf_trace *trace)
+{
+	if (trace)
+		kref_put(&trace->ref, lpf_trace_release);
+}
+
+/* Stop the fault path recording; the slots are ours afterwards */
+static void lpf_stop_recording(void)
+{
+	spin_lock(&lpf_lock);
+	launch_prefetch_tgid = 0;
+	spin_unlock(&lpf_lock);
+}
+
+static char *lpf_file_path(struct file *file)
+{
+	char *buf, *path;
+
+	buf = (char *) __get_free_page(GFP_KERNEL);
+	if (!buf)
+		return NULL;
+
+	path = d_path(&file->f_path, buf, PAGE_SIZE);
+	if (IS_ERR(path) || strchr(path, '\n'))
+		path = NULL;
+	else
+		path = kstrdup(path, GFP_KERNEL);
+	free_page((unsigned long) buf);
+	return path;
+}
+
+void __launch_prefetch_record(struct file *file, pgoff_t index)
+{
+	struct inode *inode = file->f_mapping->host;
+	int i;
+
+	if (current->tgid != launch_prefetch_tgid)
+		return;
+	spin_lock(&lpf_lock);
+	if (current->tgid != launch_prefetch_tgid)
+		goto out;
+
+	if (lpf_nr_entries == LPF_MAX_ENTRIES) {
+		launch_prefetch_tgid = 0;
+		goto out;
+	}
+
+	for (i = lpf_nr_files - 1; i >= 0; i--)
+		if (lpf_files[i].inode == inode)
+			break;
+	if (i < 0) {
+		if (lpf_nr_files == LPF_MAX_FILES)
+			goto out;
+		i = lpf_nr_files++;
+		get_file(file);
+		lpf_files[i].inode = inode;
+		lpf_files[i].file = file;
+	}
+
+	lpf_entries[lpf_nr_entries].file = i;
+	lpf_entries[lpf_nr_entries].index = index;
+	lpf_nr_entries++;
+out:
+	spin_unlock(&lpf_lock);
+}
+
+static int lpf_entry_cmp(const void *a, const void *b)
+{
+	const struct lpf_entry *ea = a, *eb = b;
+
+	if (ea->file != eb->file)
+		return ea->file < eb->file ? -1 : 1;
+	if (ea->index != eb->index)
+		return ea->index < eb->index ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Walk the sorted entries as extents; emit them into @buf if non-NULL.
+ * Returns the length of the trace text.
+ */
+static size_t lpf_format_trace(char *buf, size_t size)
+{
+	struct lpf_entry *e = lpf_entries;
+	size_t len = 0;
+	unsigned int i, j;
+
+	for (i = 0; i < lpf_nr_entries; i = j) {
+		pgoff_t end = e[i].index + 1;
+
+		for (j = i + 1; j < lpf_nr_entries; j++) {
+			if (e[j].file != e[i].file || e[j].index > end)
+				break;
+			end = e[j].index + 1;
+		}
+		if (!lpf_files[e[i].file].path)
+			continue;
+		len += snprintf(buf ? buf + len : NULL, buf ? size - len : 0,
+				"%lu %lu %s\n", e[i].index, end - e[i].index,
+				lpf_files[e[i].file].path);
+	}
+	return len;
+}
+
+/*
+ * Stop recording and turn the log into the trace text.
+ * Called with lpf_mutex held.
+ */
+static void lpf_finish(void)
+{
+	unsigned int i;
+	size_t len;
+
+	lpf_stop_recording();
+	if (!lpf_entries)
+		return;
+
+	for (i = 0; i < lpf_nr_files; i++)
+		lpf_files[i].path = lpf_file_path(lpf_files[i].file);
+
+	sort(lpf_entries, lpf_nr_entries, sizeof(struct lpf_entry),
+	     lpf_entry_cmp, NULL);
+
+	len = lpf_format_trace(NULL, 0);
+	lpf_trace = vmalloc(sizeof(*lpf_trace) + len + 1);
+	if (lpf_trace) {
+		kref_init(&lpf_trace->ref);
+		lpf_format_trace(lpf_trace->text, len + 1);
+		lpf_trace->len = len;
+	}
+	lpf_free_recording();
+}
+
+static void lpf_timeout(struct work_struct *work)
+{
+	mutex_lock(&lpf_mutex);
+	lpf_finish();
+	mutex_unlock(&lpf_mutex);
+}
+
+static DECLARE_DELAYED_WORK(lpf_timeout_work, lpf_timeout);
+
+static int lpf_start(void __user *arg)
+{
+	struct launch_prefetch_record rec;
+	int ret = 0;
+
+	if (copy_from_user(&rec, arg, sizeof(rec)))
+		return -EFAULT;
+	if (!rec.tgid)
+		return -EINVAL;
+
+	cancel_delayed_work_sync(&lpf_timeout_work);
+
+	mutex_lock(&lpf_mutex);
+	lpf_stop_recording();
+	lpf_free_recording();
+	lpf_put_trace(lpf_trace);
+	lpf_trace = NULL;
+
+	lpf_files = kcalloc(LPF_MAX_FILES, sizeof(struct lpf_file),
+			    GFP_KERNEL);
+	lpf_entries = vmalloc(LPF_MAX_ENTRIES * sizeof(struct lpf_entry));
+	if (!lpf_files || !lpf_entries) {
+		lpf_free_recording();
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	spin_lock(&lpf_lock);
+	launch_prefetch_tgid = rec.tgid;
+	spin_unlock(&lpf_lock);
+	if (rec.timeout_ms)
+		schedule_delayed_work(&lpf_timeout_work,
+				      msecs_to_jiffies(rec.timeout_ms));
+out:
+	mutex_unlock(&lpf_mutex);
+	return ret;
+}
+
+static int lpf_stop(void)
+{
+	int ret;
+
+	cancel_delayed_work_sync(&lpf_timeout_work);
+
+	mutex_lock(&lpf_mutex);
+	lpf_finish();
+	ret = lpf_trace ? lpf_trace->len : 0;
+	mutex_unlock(&lpf_mutex);
+
+	return ret;
+}
+
+static void lpf_free_batch(struct lpf_batch *batch)
+{
+	struct lpf_path *p, *tmp;
+
+	list_for_each_entry_safe(p, tmp, &batch->paths, list)
+		kfree(p);
+	vfree(batch->extents);
+	kfree(batch);
+}
+
+static int lpf_extent_cmp(const void *a, const void *b)
+{
+	const struct lpf_extent *ea = a, *eb = b;
+	int ret;
+
+	ret = strcmp(ea->path, eb->path);
+	if (ret)
+		return ret;
+	if (ea->start != eb->start)
+		return ea->start < eb->start ? -1 : 1;
+	return 0;
+}
+
+static void lpf_replay_batch(struct lpf_batch *batch)
+{
+	struct lpf_extent *e = batch->extents;
+	struct file *file = NULL;
+	const char *cur = NULL;
+	unsigned int i, j;
+
+	sort(e, batch->nr, sizeof(struct lpf_extent), lpf_extent_cmp, NULL);
+
+	for (i = 0; i < batch->nr; i = j) {
+		pgoff_t start = e[i].start;
+		pgoff_t end = start + e[i].nr;
+		pgoff_t size;
+
+		/* Coalesce overlapping and adjacent extents of a file */
+		for (j = i + 1; j < batch->nr; j++) {
+			if (strcmp(e[j].path, e[i].path) || e[j].start > end)
+				break;
+			end = max(end, (pgoff_t)(e[j].start + e[j].nr));
+		}
+
+		if (!cur || strcmp(cur, e[i].path)) {
+			if (file)
+				fput(file);
+			cur = e[i].path;
+			file = filp_open(cur, O_RDONLY | O_LARGEFILE, 0);
+			if (IS_ERR(file))
+				file = NULL;
+		}
+		if (!file)
+			continue;
+
+		size = (i_size_read(file->f_mapping->host) + PAGE_CACHE_SIZE - 1)
+			>> PAGE_CACHE_SHIFT;
+		if (start >= size)
+			continue;
+		if (end > size)
+			end = size;
+		force_page_cache_readahead(file->f_mapping, file,
+					   start, end - start);
+	}
+	if (file)
+		fput(file);
+}
+
+static void lpf_replay(struct work_struct *work)
+{
+	struct lpf_batch *batch;
+
+	for (;;) {
+		spin_lock(&lpf_replay_lock);
+		batch = NULL;
+		if (!list_empty(&lpf_replay_list)) {
+			batch = list_first_entry(&lpf_replay_list,
+						 struct lpf_batch, list);
+			list_del(&batch->list);
+		}
+		spin_unlock(&lpf_replay_lock);
+
+		if (!batch)
+			break;
+		lpf_replay_batch(batch);
+		lpf_free_batch(batch);
+	}
+}
+
+static DECLARE_WORK(lpf_replay_work, lpf_replay);
+
+static const char *lpf_batch_path(struct lpf_batch *batch, const char *path)
+{
+	struct lpf_path *p;
+
+	if (!list_empty(&batch->paths)) {
+		p = list_entry(batch->paths.prev, struct lpf_path, list);
+		if (!strcmp(p->path, path))
+			return p->path;
+	}
+
+	p = kmalloc(sizeof(*p) + strlen(path) + 1, GFP_KERNEL);
+	if (!p)
+		return NULL;
+	strcpy(p->path, path);
+	list_add_tail(&p->list, &batch->paths);
+	return p->path;
+}
+
+/* Parse one "<start> <nr_pages> <path>" line into the pending batch */
+static int lpf_queue_line(char *line)
+{
+	struct lpf_batch *batch = lpf_pending;
+	struct lpf_extent *e;
+	unsigned long start, nr;
+	char *p;
+
+	start = simple_strtoul(line, &p, 10);
+	if (p == line || *p != ' ')
+		return -EINVAL;
+	line = p + 1;
+	nr = simple_strtoul(line, &p, 10);
+	if (p == line || *p != ' ' || !nr)
+		return -EINVAL;
+	line = p + 1;
+	if (*line != '/')
+		return -EINVAL;
+
+	if (!batch) {
+		batch = kzalloc(sizeof(*batch), GFP_KERNEL);
+		if (!batch)
+			return -ENOMEM;
+		INIT_LIST_HEAD(&batch->paths);
+		batch->extents = vmalloc(LPF_MAX_EXTENTS *
+					 sizeof(struct lpf_extent));
+		if (!batch->extents) {
+			kfree(batch);
+			return -ENOMEM;
+		}
+		lpf_pending = batch;
+	}
+	if (batch->nr == LPF_MAX_EXTENTS)
+		return -ENOSPC;
+
+	e = &batch->extents[batch->nr];
+	e->path = lpf_batch_path(batch, line);
+	if (!e->path)
+		return -ENOMEM;
+	e->start = start;
+	e->nr = nr;
+	batch->nr++;
+	return 0;
+}
+
+/*
+ * Queue the whole lines of @buf.  Returns the bytes consumed, or an
+ * error if not even the first line could be queued: lines queued before
+ * a failure stay queued, so they must not be reported as unconsumed.
+ * Called with lpf_replay_mutex held.
+ */
+static ssize_t lpf_queue_lines(char *buf, size_t count)
+{
+	char *line, *eol;
+	ssize_t done = 0;
+	int ret = -EINVAL;
+
+	for (line = buf; line < buf + count; line = eol + 1) {
+		eol = memchr(line, '\n', buf + count - line);
+		if (!eol)
+			break;
+		*eol = '\0';
+		ret = lpf_queue_line(line);
+		if (ret)
+			break;
+		done = eol + 1 - buf;
+	}
+
+	return done ? done : ret;
+}
+
+static ssize_t lpf_write(struct file *file, const char __user *buf,
+			 size_t count, loff_t *ppos)
+{
+	char *page;
+	ssize_t ret;
+
+	if (count > PAGE_SIZE)
+		count = PAGE_SIZE;
+
+	page = (char *) __get_free_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+	if (copy_from_user(page, buf, count)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	/* Only whole lines are consumed; the caller resubmits the rest */
+	mutex_lock(&lpf_replay_mutex);
+	ret = lpf_queue_lines(page, count);
+	mutex_unlock(&lpf_replay_mutex);
+out:
+	free_page((unsigned long) page);
+	return ret;
+}
+
+#ifdef CONFIG_LAUNCH_PREFETCH_SELFTEST
+struct lpf_test {
+	const char *input;
+	ssize_t ret;			/* bytes consumed, or error */
+	unsigned int nr;		/* extents queued */
+};
+
+static const struct lpf_test lpf_tests[] __initdata = {
+	{ "0 4 /system/lib/libc.so\n10 2 /system/lib/libc.so\n", 49, 2 },
+	{ "5 1 /a\n7 1 /b", 7, 1 },		/* partial last line */
+	{ "7 1 /b", -EINVAL, 0 },		/* no whole line */
+	{ "x 1 /a\n", -EINVAL, 0 },
+	{ "1 0 /a\n", -EINVAL, 0 },		/* empty extent */
+	{ "1 1 a\n", -EINVAL, 0 },		/* relative path */
+	{ "1 1 /a\nbad\n2 1 /a\n", 7, 1 },	/* stops at the bad line */
+};
+
+/* Feed the replay parser known input, and check what it queued */
+static void __init lpf_selftest(void)
+{
+	char buf[64];
+	int i, failed = 0;
+
+	mutex_lock(&lpf_replay_mutex);
+	for (i = 0; i < ARRAY_SIZE(lpf_tests); i++) {
+		const struct lpf_test *t = &lpf_tests[i];
+		ssize_t ret;
+		unsigned int nr;
+
+		strlcpy(buf, t->input, sizeof(buf));
+		ret = lpf_queue_lines(buf, strlen(buf));
+		nr = lpf_pending ? lpf_pending->nr : 0;
+		if (ret != t->ret || nr != t->nr ||
+		    (nr == 2 && lpf_pending->extents[0].path !=
+				lpf_pending->extents[1].path)) {
+			printk(KERN_ERR "launch_prefetch: selftest %d failed: "
+			       "returned %zd, queued %u\n", i, ret, nr);
+			failed++;
+		}
+		if (lpf_pending) {
+			lpf_free_batch(lpf_pending);
+			lpf_pending = NULL;
+		}
+	}
+	mutex_unlock(&lpf_replay_mutex);
+
+	printk(KERN_INFO "launch_prefetch: selftest %d of %d passed\n",
+	       (int)ARRAY_SIZE(lpf_tests) - failed, (int)ARRAY_SIZE(lpf_tests));
+}
+#else
+static inline void lpf_selftest(void)
+{
+}
+#endif
+
+static int lpf_start_replay(void)
+{
+	struct lpf_batch *batch;
+	int nr;
+
+	mutex_lock(&lpf_replay_mutex);
+	batch = lpf_pending;
+	lpf_pending = NULL;
+	mutex_unlock(&lpf_replay_mutex);
+
+	if (!batch)
+		return 0;
+	nr = batch->nr;
+
+	spin_lock(&lpf_replay_lock);
+	list_add_tail(&batch->list, &lpf_replay_list);
+	spin_unlock(&lpf_replay_lock);
+	queue_work(lpf_wq, &lpf_replay_work);
+
+	return nr;
+}
+
+static ssize_t lpf_read(struct file *file, char __user *buf,
+			size_t count, loff_t *ppos)
+{
+	struct lpf_trace *trace;
+	ssize_t ret;
+
+	mutex_lock(&lpf_mutex);
+	if (launch_prefetch_tgid) {
+		mutex_unlock(&lpf_mutex);
+		return -EBUSY;
+	}
+	trace = lpf_trace;
+	if (trace)
+		kref_get(&trace->ref);
+	mutex_unlock(&lpf_mutex);
+
+	if (!trace)
+		return 0;
+	ret = simple_read_from_buffer(buf, count, ppos, trace->text,
+				      trace->len);
+	lpf_put_trace(trace);
+	return ret;
+}
+
+static long lpf_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	long ret = -ENOTTY;
+
+	switch (cmd) {
+	case LAUNCH_PREFETCH_START:
+		ret = lpf_start((void __user *) arg);
+		break;
+	case LAUNCH_PREFETCH_STOP:
+		ret = lpf_stop();
+		break;
+	case LAUNCH_PREFETCH_REPLAY:
+		ret = lpf_start_replay();
+		break;
+	}
+
+	return ret;
+}
+
+static int lpf_open(struct inode *inode, struct file *file)
+{
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+	return nonseekable_open(inode, file);
+}
+
+static struct file_operations lpf_fops = {
+	.owner = THIS_MODULE,
+	.open = lpf_open,
+	.read = lpf_read,
+	.write = lpf_write,
+	.unlocked_ioctl = lpf_ioctl,
+	.compat_ioctl = lpf_ioctl,
+};
+
+static struct miscdevice lpf_misc = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name = "launch_prefetch",
+	.fops = &lpf_fops,
+};
+
+static int __init launch_prefetch_init(void)
+{
+	int ret;
+
+	lpf_wq = create_singlethread_workqueue("launch_prefetch");
+	if (!lpf_wq)
+		return -ENOMEM;
+
+	lpf_selftest();
+
+	ret = misc_register(&lpf_misc);
+	if (unlikely(ret)) {
+		printk(KERN_ERR "launch_prefetch: failed to register misc "
+		       "device!\n");
+		destroy_workqueue(lpf_wq);
+		return ret;
+	}
+
+	return 0;
+}
+
+module_init(launch_prefetch_init);
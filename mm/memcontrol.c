@@ -166,6 +166,18 @@ struct mem_cgroup {
 
 	unsigned int	swappiness;
 
+	/*
+	 * Global reclaim takes pages from groups with a higher
+	 * reclaim_priority, or above their soft_limit, before scanning the
+	 * global LRU lists.  Protected by reclaim_param_lock, as are the
+	 * soft reclaim statistics.
+	 */
+	struct list_head list;		/* entry in mem_cgroup_list */
+	unsigned int	reclaim_priority;
+	unsigned long long soft_limit;
+	unsigned long	soft_reclaimed;	/* pages */
+	unsigned long	soft_reclaim_runs;
+
 	/*
 	 * statistics. This must be placed at the end of memcg.
 	 */
@@ -204,6 +216,10 @@ static void mem_cgroup_get(struct mem_cgroup *mem);
 static void mem_cgroup_put(struct mem_cgroup *mem);
 static struct mem_cgroup *parent_mem_cgroup(struct mem_cgroup *mem);
 
+/* All memory cgroups, for soft reclaim; protected by mem_cgroup_list_lock */
+static LIST_HEAD(mem_cgroup_list);
+static DEFINE_SPINLOCK(mem_cgroup_list_lock);
+
 static void mem_cgroup_charge_statistics(struct mem_cgroup *mem,
 					 struct page_cgroup *pc,
 					 bool charge)
@@ -541,8 +557,8 @@ int mem_cgroup_inactive_file_is_low(struct mem_cgroup *memcg)
 	unsigned long active;
 	unsigned long inactive;
 
-	inactive = mem_cgroup_get_local_zonestat(memcg, LRU_INACTIVE_FILE);
-	active = mem_cgroup_get_local_zonestat(memcg, LRU_ACTIVE_FILE);
+	inactive = mem_cgroup_get_all_zonestat(memcg, LRU_INACTIVE_FILE);
+	active = mem_cgroup_get_all_zonestat(memcg, LRU_ACTIVE_FILE);
 
 	return (active > inactive);
 }
@@ -808,6 +824,102 @@ static int mem_cgroup_hierarchical_reclaim(struct mem_cgroup *root_mem,
 	return ret;
 }
 
+/*
+ * Soft reclaim victims are taken in this order: highest reclaim_priority
+ * first, then largest excess over the soft limit.
+ */
+#define MEM_CGROUP_SOFT_RECLAIM_VICTIMS	16
+
+struct mem_cgroup_victim {
+	struct mem_cgroup *mem;
+	unsigned int priority;
+	unsigned long long excess;
+};
+
+static bool mem_cgroup_victim_before(struct mem_cgroup_victim *a,
+				     struct mem_cgroup_victim *b)
+{
+	if (a->priority != b->priority)
+		return a->priority > b->priority;
+	return a->excess > b->excess;
+}
+
+/**
+ * mem_cgroup_soft_reclaim - reclaim from expendable groups first
+ * @gfp_mask: reclaim context
+ * @nr_to_reclaim: number of pages wanted
+ *
+ * Called by global reclaim before it scans the global LRU lists.  Each
+ * group with a non-zero reclaim_priority or usage above its soft limit
+ * gets one pass of per-group reclaim, most expendable first, until
+ * @nr_to_reclaim pages were freed.  Groups with priority 0 within their
+ * soft limit, e.g. the foreground application, are never touched here.
+ *
+ * Returns the number of pages reclaimed.
+ */
+unsigned long mem_cgroup_soft_reclaim(gfp_t gfp_mask,
+				      unsigned long nr_to_reclaim)
+{
+	struct mem_cgroup_victim victims[MEM_CGROUP_SOFT_RECLAIM_VICTIMS];
+	struct mem_cgroup_victim v;
+	struct mem_cgroup *mem;
+	unsigned long reclaimed = 0;
+	unsigned long ret;
+	int nr = 0;
+	int i;
+
+	if (mem_cgroup_disabled())
+		return 0;
+
+	spin_lock(&mem_cgroup_list_lock);
+	list_for_each_entry(mem, &mem_cgroup_list, list) {
+		unsigned long long usage;
+
+		usage = res_counter_read_u64(&mem->res, RES_USAGE);
+		if (!usage)
+			continue;
+
+		v.mem = mem;
+		v.priority = mem->reclaim_priority;
+		v.excess = usage > mem->soft_limit ? usage - mem->soft_limit : 0;
+		if (!v.priority && !v.excess)
+			continue;
+
+		/* insertion sort, keeping the most expendable groups */
+		for (i = nr; i > 0; i--) {
+			if (!mem_cgroup_victim_before(&v, &victims[i - 1]))
+				break;
+			if (i < MEM_CGROUP_SOFT_RECLAIM_VICTIMS)
+				victims[i] = victims[i - 1];
+		}
+		if (i < MEM_CGROUP_SOFT_RECLAIM_VICTIMS) {
+			victims[i] = v;
+			if (nr < MEM_CGROUP_SOFT_RECLAIM_VICTIMS)
+				nr++;
+		}
+	}
+	for (i = 0; i < nr; i++)
+		mem_cgroup_get(victims[i].mem);
+	spin_unlock(&mem_cgroup_list_lock);
+
+	for (i = 0; i < nr; i++) {
+		mem = victims[i].mem;
+		if (reclaimed < nr_to_reclaim && !mem_cgroup_is_obsolete(mem)) {
+			ret = try_to_free_mem_cgroup_pages(mem, gfp_mask, false,
+						get_swappiness(mem));
+			reclaimed += ret;
+
+			spin_lock(&mem->reclaim_param_lock);
+			mem->soft_reclaimed += ret;
+			mem->soft_reclaim_runs++;
+			spin_unlock(&mem->reclaim_param_lock);
+		}
+		mem_cgroup_put(mem);
+	}
+
+	return reclaimed;
+}
+
 bool mem_cgroup_oom_called(struct task_struct *task)
 {
 	bool ret = false;
@@ -1952,6 +2064,17 @@ static int mem_control_stat_show(struct cgroup *cont, struct cftype *cft,
 		cb->fill(cb, "unevictable", unevictable * PAGE_SIZE);
 
 	}
+	{
+		unsigned long soft_reclaimed, soft_reclaim_runs;
+
+		spin_lock(&mem_cont->reclaim_param_lock);
+		soft_reclaimed = mem_cont->soft_reclaimed;
+		soft_reclaim_runs = mem_cont->soft_reclaim_runs;
+		spin_unlock(&mem_cont->reclaim_param_lock);
+
+		cb->fill(cb, "soft_reclaimed", soft_reclaimed * PAGE_SIZE);
+		cb->fill(cb, "soft_reclaim_runs", soft_reclaim_runs);
+	}
 	{
 		unsigned long long limit, memsw_limit;
 		memcg_get_hierarchical_limit(mem_cont, &limit, &memsw_limit);
@@ -2031,6 +2154,58 @@ static int mem_cgroup_swappiness_write(struct cgroup *cgrp, struct cftype *cft,
 	return 0;
 }
 
+static u64 mem_cgroup_soft_limit_read(struct cgroup *cgrp, struct cftype *cft)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+	u64 val;
+
+	spin_lock(&memcg->reclaim_param_lock);
+	val = memcg->soft_limit;
+	spin_unlock(&memcg->reclaim_param_lock);
+
+	return val;
+}
+
+static int mem_cgroup_soft_limit_write(struct cgroup *cgrp, struct cftype *cft,
+				       const char *buffer)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+	unsigned long long val;
+	int ret;
+
+	ret = res_counter_memparse_write_strategy(buffer, &val);
+	if (ret)
+		return ret;
+
+	spin_lock(&memcg->reclaim_param_lock);
+	memcg->soft_limit = val;
+	spin_unlock(&memcg->reclaim_param_lock);
+
+	return 0;
+}
+
+static u64 mem_cgroup_reclaim_priority_read(struct cgroup *cgrp,
+					    struct cftype *cft)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+
+	return memcg->reclaim_priority;
+}
+
+static int mem_cgroup_reclaim_priority_write(struct cgroup *cgrp,
+					     struct cftype *cft, u64 val)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+
+	if (val > UINT_MAX)
+		return -EINVAL;
+
+	spin_lock(&memcg->reclaim_param_lock);
+	memcg->reclaim_priority = val;
+	spin_unlock(&memcg->reclaim_param_lock);
+
+	return 0;
+}
 
 static struct cftype mem_cgroup_files[] = {
 	{
@@ -2074,6 +2249,16 @@ static struct cftype mem_cgroup_files[] = {
 		.read_u64 = mem_cgroup_swappiness_read,
 		.write_u64 = mem_cgroup_swappiness_write,
 	},
+	{
+		.name = "soft_limit_in_bytes",
+		.read_u64 = mem_cgroup_soft_limit_read,
+		.write_string = mem_cgroup_soft_limit_write,
+	},
+	{
+		.name = "reclaim_priority",
+		.read_u64 = mem_cgroup_reclaim_priority_read,
+		.write_u64 = mem_cgroup_reclaim_priority_write,
+	},
 };
 
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR_SWAP
@@ -2276,7 +2461,12 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 
 	if (parent)
 		mem->swappiness = get_swappiness(parent);
+	mem->soft_limit = (unsigned long long)LLONG_MAX;
 	atomic_set(&mem->refcnt, 1);
+
+	spin_lock(&mem_cgroup_list_lock);
+	list_add_tail(&mem->list, &mem_cgroup_list);
+	spin_unlock(&mem_cgroup_list_lock);
 	return &mem->css;
 free_out:
 	__mem_cgroup_free(mem);
@@ -2296,6 +2486,10 @@ static void mem_cgroup_destroy(struct cgroup_subsys *ss,
 	struct mem_cgroup *mem = mem_cgroup_from_cont(cont);
 	struct mem_cgroup *last_scanned_child = mem->last_scanned_child;
 
+	spin_lock(&mem_cgroup_list_lock);
+	list_del(&mem->list);
+	spin_unlock(&mem_cgroup_list_lock);
+
 	if (last_scanned_child) {
 		VM_BUG_ON(!mem_cgroup_is_obsolete(last_scanned_child));
 		mem_cgroup_put(last_scanned_child);
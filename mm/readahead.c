@@ -38,6 +38,85 @@ static void do_expire_ra_lock(struct work_struct *work)
 }
 static DECLARE_DELAYED_WORK(work_expire_ra_lock, do_expire_ra_lock);
 
+/*
+ * Per-file readahead adaptation.
+ *
+ * Every page read ahead speculatively is marked PG_speculative and counted
+ * in ra->issued_pages; its first reference clears the flag and counts in
+ * ra->hit_pages.  Once RA_SAMPLE_PAGES pages have had a chance to be used,
+ * the hit rate decides whether the file's window is halved (random access,
+ * e.g. dex files or databases: readahead is eventually switched off) or
+ * doubled (sequential streams), within RA_SHIFT_MAX of the bdi default.
+ */
+#define RA_SAMPLE_PAGES		64
+#define RA_HIT_LOW		25	/* percent */
+#define RA_HIT_HIGH		75	/* percent */
+#define RA_SHIFT_MAX		2
+#define RA_SHIFT_REENABLE	(-2)
+
+static unsigned long ra_scaled_pages(struct file_ra_state *ra)
+{
+	if (ra->ra_shift >= 0)
+		return ra->ra_pages << ra->ra_shift;
+	return ra->ra_pages >> -ra->ra_shift;
+}
+
+/**
+ * ra_adaptive_pages - current readahead window limit of a file
+ * @ra: file_ra_state which holds the readahead state
+ * @offset: page offset being accessed
+ *
+ * Returns @ra->ra_pages scaled by the hit rate observed on the file.  If
+ * readahead had been switched off for poor hits but @offset continues the
+ * previous access, a small window is restored so that a stream starting
+ * on a randomly accessed file can earn its readahead back.
+ */
+unsigned long ra_adaptive_pages(struct file_ra_state *ra, pgoff_t offset)
+{
+	unsigned long pages = ra_scaled_pages(ra);
+
+	if (!pages && ra->ra_pages && ra->prev_pos != -1 &&
+	    offset - (pgoff_t)(ra->prev_pos >> PAGE_CACHE_SHIFT) == 1) {
+		ra->ra_shift = max(ra->ra_shift, RA_SHIFT_REENABLE);
+		ra->issued_pages = ra->hit_pages = ra->last_pages = 0;
+		pages = ra_scaled_pages(ra);
+	}
+	return pages;
+}
+
+/*
+ * Account @nr freshly issued speculative pages and, when enough earlier
+ * ones have settled, rescale the window according to their hit rate.
+ * Pages of the latest readahead are excluded from the sample as they had
+ * no chance to be referenced yet.
+ */
+static void ra_account(struct file_ra_state *ra, int nr)
+{
+	unsigned int settled;
+	unsigned int hits;
+
+	if (nr <= 0)
+		return;
+	count_vm_events(READAHEAD_PAGES, nr);
+
+	settled = ra->issued_pages - ra->last_pages;
+	if (settled >= RA_SAMPLE_PAGES) {
+		hits = min(ra->hit_pages, settled);
+		if (hits * 100 < settled * RA_HIT_LOW && ra_scaled_pages(ra)) {
+			ra->ra_shift--;
+			count_vm_event(READAHEAD_SHRINK);
+		} else if (hits * 100 >= settled * RA_HIT_HIGH &&
+			   ra->ra_shift < RA_SHIFT_MAX) {
+			ra->ra_shift++;
+			count_vm_event(READAHEAD_GROW);
+		}
+		ra->issued_pages = ra->last_pages;
+		ra->hit_pages -= hits;
+	}
+	ra->issued_pages += nr;
+	ra->last_pages = nr;
+}
+
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
  * memset *ra to zero.
@@ -131,7 +210,7 @@ out:
 static int
 __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 			pgoff_t offset, unsigned long nr_to_read,
-			unsigned long lookahead_size)
+			unsigned long lookahead_size, struct file_ra_state *ra)
 {
 	struct inode *inode = mapping->host;
 	struct page *page;
@@ -168,6 +247,8 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		list_add(&page->lru, &page_pool);
 		if (page_idx == nr_to_read - lookahead_size)
 			SetPageReadahead(page);
+		if (ra)
+			SetPageSpeculative(page);
 		ret++;
 	}
 
@@ -179,6 +260,8 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	if (ret)
 		read_pages(mapping, filp, &page_pool, ret);
 	BUG_ON(!list_empty(&page_pool));
+	if (ra)
+		ra_account(ra, ret);
 out:
 	return ret;
 }
@@ -203,7 +286,7 @@ int force_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		if (this_chunk > nr_to_read)
 			this_chunk = nr_to_read;
 		err = __do_page_cache_readahead(mapping, filp,
-						offset, this_chunk, 0);
+						offset, this_chunk, 0, NULL);
 		if (err < 0) {
 			ret = err;
 			break;
@@ -228,7 +311,8 @@ int do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	if (bdi_read_congested(mapping->backing_dev_info))
 		return -1;
 
-	return __do_page_cache_readahead(mapping, filp, offset, nr_to_read, 0);
+	return __do_page_cache_readahead(mapping, filp, offset, nr_to_read, 0,
+					 &filp->f_ra);
 }
 
 /*
@@ -268,7 +352,7 @@ static unsigned long ra_submit(struct file_ra_state *ra,
 	int actual;
 
 	actual = __do_page_cache_readahead(mapping, filp,
-					ra->start, ra->size, ra->async_size);
+					ra->start, ra->size, ra->async_size, ra);
 
 	return actual;
 }
@@ -359,13 +443,20 @@ ondemand_readahead(struct address_space *mapping,
 		   bool hit_readahead_marker, pgoff_t offset,
 		   unsigned long req_size)
 {
-	int	max = ra->ra_pages;	/* max readahead pages */
+	int	max = ra_adaptive_pages(ra, offset);	/* max readahead pages */
 	pgoff_t prev_offset;
 	int	sequential;
 	if (ra_lock) {
 		max = (ra_lock * 1024) / PAGE_CACHE_SIZE;
 	}
 
+	/*
+	 * Readahead has been switched off for poor hits on this file.
+	 */
+	if (!max)
+		return __do_page_cache_readahead(mapping, filp,
+						offset, req_size, 0, NULL);
+
 	/*
 	 * It's the expected callback offset, assume sequential access.
 	 * Ramp up sizes, and push forward the readahead window.
@@ -387,7 +478,7 @@ ondemand_readahead(struct address_space *mapping,
 	 */
 	if (!hit_readahead_marker && !sequential) {
 		return __do_page_cache_readahead(mapping, filp,
-						offset, req_size, 0);
+						offset, req_size, 0, NULL);
 	}
 
 	/*
@@ -0,0 +1,192 @@
+/*
+ * mm/slab_bench.c
+ *
+ * Module-based microbenchmark for the slab allocators.  For every kmalloc
+ * size class it measures the throughput of back-to-back kmalloc()/kfree()
+ * pairs (the per-cpu fast path), the throughput of batched allocation
+ * followed by batched freeing (which exercises refill and flush of the
+ * per-cpu caches), and the worst case latency seen for a single call.
+ *
+ * The benchmark runs once at load time and the module then refuses to
+ * stay loaded, so it can simply be insmod'ed again for another run:
+ *
+ *	insmod slab_bench.ko iterations=100000 batch=256
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <asm/div64.h>
+
+static int iterations = 100000;
+module_param(iterations, int, 0444);
+MODULE_PARM_DESC(iterations, "Number of operations per size class");
+
+static int batch = 256;
+module_param(batch, int, 0444);
+MODULE_PARM_DESC(batch, "Objects held at once in the batched test");
+
+static int max_size = PAGE_SIZE;
+module_param(max_size, int, 0444);
+MODULE_PARM_DESC(max_size, "Largest size class to measure");
+
+struct slab_bench_result {
+	unsigned long long total_ns;
+	unsigned long long max_ns;
+	unsigned long ops;
+};
+
+static void slab_bench_account(struct slab_bench_result *res,
+			       unsigned long long start,
+			       unsigned long long end)
+{
+	unsigned long long delta = end - start;
+
+	res->total_ns += delta;
+	if (delta > res->max_ns)
+		res->max_ns = delta;
+	res->ops++;
+}
+
+static unsigned long slab_bench_avg(struct slab_bench_result *res)
+{
+	unsigned long long avg = res->total_ns;
+
+	if (!res->ops)
+		return 0;
+	do_div(avg, res->ops);
+	return (unsigned long)avg;
+}
+
+static int slab_bench_pairs(size_t size, struct slab_bench_result *alloc,
+			    struct slab_bench_result *free)
+{
+	unsigned long long t0, t1, t2;
+	void *obj;
+	int i;
+
+	for (i = 0; i < iterations; i++) {
+		t0 = sched_clock();
+		obj = kmalloc(size, GFP_KERNEL);
+		t1 = sched_clock();
+		if (!obj)
+			return -ENOMEM;
+		kfree(obj);
+		t2 = sched_clock();
+
+		slab_bench_account(alloc, t0, t1);
+		slab_bench_account(free, t1, t2);
+
+		if ((i & 1023) == 1023)
+			cond_resched();
+	}
+	return 0;
+}
+
+static int slab_bench_batched(size_t size, void **objs,
+			      struct slab_bench_result *alloc,
+			      struct slab_bench_result *free)
+{
+	unsigned long long t0, t1;
+	int done = 0;
+	int i, n;
+
+	while (done < iterations) {
+		n = min(batch, iterations - done);
+
+		for (i = 0; i < n; i++) {
+			t0 = sched_clock();
+			objs[i] = kmalloc(size, GFP_KERNEL);
+			t1 = sched_clock();
+			if (!objs[i])
+				goto fail;
+			slab_bench_account(alloc, t0, t1);
+		}
+		for (i = 0; i < n; i++) {
+			t0 = sched_clock();
+			kfree(objs[i]);
+			t1 = sched_clock();
+			slab_bench_account(free, t0, t1);
+		}
+		done += n;
+		cond_resched();
+	}
+	return 0;
+
+fail:
+	while (--i >= 0)
+		kfree(objs[i]);
+	return -ENOMEM;
+}
+
+static void slab_bench_report(const char *test, size_t size,
+			      struct slab_bench_result *alloc,
+			      struct slab_bench_result *free)
+{
+	printk(KERN_INFO "slab_bench: %-7s %5zu bytes: "
+	       "alloc avg %lu ns max %llu ns, free avg %lu ns max %llu ns\n",
+	       test, size, slab_bench_avg(alloc), alloc->max_ns,
+	       slab_bench_avg(free), free->max_ns);
+}
+
+static int __init slab_bench_init(void)
+{
+	struct slab_bench_result alloc, free;
+	void **objs;
+	size_t size;
+	int ret = 0;
+
+	if (iterations <= 0 || batch <= 0)
+		return -EINVAL;
+
+	objs = vmalloc(batch * sizeof(void *));
+	if (!objs)
+		return -ENOMEM;
+
+	printk(KERN_INFO "slab_bench: %d iterations, batch %d\n",
+	       iterations, batch);
+
+	for (size = 8; size <= max_size; size <<= 1) {
+		memset(&alloc, 0, sizeof(alloc));
+		memset(&free, 0, sizeof(free));
+		ret = slab_bench_pairs(size, &alloc, &free);
+		if (ret)
+			break;
+		slab_bench_report("pairs", size, &alloc, &free);
+
+		memset(&alloc, 0, sizeof(alloc));
+		memset(&free, 0, sizeof(free));
+		ret = slab_bench_batched(size, objs, &alloc, &free);
+		if (ret)
+			break;
+		slab_bench_report("batched", size, &alloc, &free);
+	}
+
+	vfree(objs);
+	if (ret) {
+		printk(KERN_ERR "slab_bench: allocation of %zu bytes failed\n",
+		       size);
+		return ret;
+	}
+
+	/* Nothing to keep around; fail the load so it can be rerun. */
+	return -EAGAIN;
+}
+
+static void __exit slab_bench_exit(void)
+{
+}
+
+module_init(slab_bench_init);
+module_exit(slab_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("kmalloc/kfree throughput and latency benchmark");
@@ -756,6 +756,9 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		if (!mapping || !__remove_mapping(mapping, page))
 			goto keep_locked;
 
+		if (page_is_file_cache(page))
+			workingset_eviction(mapping, page->index);
+
 		/*
 		 * At this point, we have no other references and there is
 		 * no way to pick any more up (removed from LRU, removed
@@ -1717,6 +1720,18 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 
 			lru_pages += zone_lru_pages(zone);
 		}
+
+		/*
+		 * Take from expendable memory cgroups before touching
+		 * everybody else's pages on the global LRU lists.
+		 */
+		sc->nr_reclaimed += mem_cgroup_soft_reclaim(sc->gfp_mask,
+							    SWAP_CLUSTER_MAX);
+		if (sc->nr_reclaimed >= sc->swap_cluster_max) {
+			ret = sc->nr_reclaimed;
+			priority = DEF_PRIORITY;
+			goto out;
+		}
 	}
 
 	for (priority = DEF_PRIORITY; priority >= 0; priority--) {
@@ -1860,6 +1875,7 @@ static unsigned long balance_pgdat(pg_data_t *pgdat, int order)
 	int all_zones_ok;
 	int priority;
 	int i;
+	int soft_reclaimed = 0;
 	unsigned long total_scanned;
 	struct reclaim_state *reclaim_state = current->reclaim_state;
 	struct scan_control sc = {
@@ -1928,6 +1944,26 @@ loop_again:
 		if (i < 0)
 			goto out;
 
+		/*
+		 * Reclaim from expendable memory cgroups first; if that is
+		 * enough, recheck the watermarks before scanning the zones.
+		 * Only once per call: the recheck goes round loop_again, and
+		 * groups that fault their pages straight back in must not
+		 * keep kswapd from ever scanning the zones.
+		 */
+		if (priority == DEF_PRIORITY && !soft_reclaimed) {
+			unsigned long nr_soft;
+
+			soft_reclaimed = 1;
+			nr_soft = mem_cgroup_soft_reclaim(GFP_KERNEL,
+							  SWAP_CLUSTER_MAX);
+			if (nr_soft >= SWAP_CLUSTER_MAX) {
+				sc.nr_reclaimed += nr_soft;
+				all_zones_ok = 0;
+				break;
+			}
+		}
+
 		for (i = 0; i <= end_zone; i++) {
 			struct zone *zone = pgdat->node_zones + i;
 
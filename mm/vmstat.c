@@ -683,6 +683,15 @@ static const char * const vmstat_text[] = {
 	"allocstall",
 
 	"pgrotated",
+
+	"readahead_pages",
+	"readahead_hit",
+	"readahead_unused",
+	"readahead_grow",
+	"readahead_shrink",
+
+	"workingset_refault",
+	"workingset_activate",
 #ifdef CONFIG_HUGETLB_PAGE
 	"htlb_buddy_alloc_success",
 	"htlb_buddy_alloc_fail",
@@ -0,0 +1,180 @@
+/*
+ * mm/workingset.c - working set detection for file pages
+ *
+ * A file page that is reclaimed and faulted back in shortly afterwards
+ * was part of the working set; it was only evicted because streaming
+ * I/O (or any other use-once access) pushed it off the inactive list
+ * before it had a chance to be referenced twice.  Such a refault should
+ * go straight to the active list instead of competing with the stream
+ * on the inactive list again.
+ *
+ * Every reclaim of a file page bumps a global eviction counter.  The
+ * counter value at eviction time is remembered for the (mapping, index)
+ * in a fixed-size hash of non-resident pages.  On refault, the number of
+ * evictions that happened in between is the refault distance: the page
+ * would have stayed resident had the inactive list been that much bigger.
+ * The inactive list can only grow at the expense of the active list, so
+ * a refault distance no larger than the active file list means the page
+ * deserves activation.
+ *
+ * The non-resident table only holds a 32-bit cookie per page, so lookups
+ * may rarely produce false positives; that merely activates a page.
+ */
+
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/init.h>
+#include <linux/jhash.h>
+#include <linux/vmalloc.h>
+#include <linux/vmstat.h>
+#include <linux/spinlock.h>
+#include <linux/swap.h>
+
+#define WORKINGSET_BUCKET_SLOTS	8	/* 64 bytes: one cache line */
+#define WORKINGSET_LOCKS	64
+
+struct workingset_slot {
+	u32 cookie;			/* 0 if empty */
+	u32 evicted;			/* workingset_evictions at eviction */
+};
+
+struct workingset_bucket {
+	struct workingset_slot slot[WORKINGSET_BUCKET_SLOTS];
+};
+
+static struct workingset_bucket *workingset_table __read_mostly;
+static unsigned long workingset_mask __read_mostly;
+static spinlock_t workingset_locks[WORKINGSET_LOCKS];
+
+static atomic_t workingset_evictions = ATOMIC_INIT(0);
+
+static u32 workingset_hash(struct address_space *mapping, pgoff_t index,
+			   u32 seed)
+{
+	return jhash_2words((u32)(unsigned long)mapping, (u32)index, seed);
+}
+
+static struct workingset_bucket *workingset_bucket(struct address_space *mapping,
+						   pgoff_t index, u32 *cookie,
+						   spinlock_t **lock)
+{
+	unsigned long b = workingset_hash(mapping, index, 0) & workingset_mask;
+
+	*cookie = workingset_hash(mapping, index, 0x9e3779b9) | 1;
+	*lock = &workingset_locks[b % WORKINGSET_LOCKS];
+	return &workingset_table[b];
+}
+
+/**
+ * workingset_eviction - note the reclaim of a file page
+ * @mapping: address space the page was removed from
+ * @index: page offset within @mapping
+ */
+void workingset_eviction(struct address_space *mapping, pgoff_t index)
+{
+	struct workingset_bucket *bucket;
+	struct workingset_slot *slot, *victim;
+	spinlock_t *lock;
+	u32 cookie, now;
+	int i;
+
+	if (!workingset_table)
+		return;
+
+	now = atomic_inc_return(&workingset_evictions);
+	bucket = workingset_bucket(mapping, index, &cookie, &lock);
+
+	spin_lock(lock);
+	victim = &bucket->slot[0];
+	for (i = 0; i < WORKINGSET_BUCKET_SLOTS; i++) {
+		slot = &bucket->slot[i];
+		if (!slot->cookie || slot->cookie == cookie) {
+			victim = slot;
+			break;
+		}
+		/* Replace the entry evicted longest ago */
+		if (now - slot->evicted > now - victim->evicted)
+			victim = slot;
+	}
+	victim->cookie = cookie;
+	victim->evicted = now;
+	spin_unlock(lock);
+}
+
+/**
+ * workingset_refault - check a file page being brought back in
+ * @mapping: address space the page is added to
+ * @index: page offset within @mapping
+ *
+ * Returns 1 if the page was evicted recently enough to be considered part
+ * of the working set, in which case it should be activated right away.
+ */
+int workingset_refault(struct address_space *mapping, pgoff_t index)
+{
+	struct workingset_bucket *bucket;
+	struct workingset_slot *slot;
+	unsigned long distance = 0;
+	spinlock_t *lock;
+	u32 cookie;
+	int found = 0;
+	int i;
+
+	if (!workingset_table)
+		return 0;
+
+	bucket = workingset_bucket(mapping, index, &cookie, &lock);
+
+	spin_lock(lock);
+	for (i = 0; i < WORKINGSET_BUCKET_SLOTS; i++) {
+		slot = &bucket->slot[i];
+		if (slot->cookie == cookie) {
+			distance = (u32)atomic_read(&workingset_evictions) -
+				   slot->evicted;
+			slot->cookie = 0;
+			found = 1;
+			break;
+		}
+	}
+	spin_unlock(lock);
+
+	if (!found)
+		return 0;
+
+	count_vm_event(WORKINGSET_REFAULT);
+	if (distance > global_page_state(NR_ACTIVE_FILE))
+		return 0;
+
+	count_vm_event(WORKINGSET_ACTIVATE);
+	return 1;
+}
+
+/*
+ * Remember roughly one eviction per four pages of memory, enough to cover
+ * refault distances up to a quarter of RAM.
+ */
+static int __init workingset_init(void)
+{
+	unsigned long slots = roundup_pow_of_two(totalram_pages) >> 2;
+	unsigned long buckets = max(slots / WORKINGSET_BUCKET_SLOTS, 1UL);
+	struct workingset_bucket *table;
+	int i;
+
+	for (i = 0; i < WORKINGSET_LOCKS; i++)
+		spin_lock_init(&workingset_locks[i]);
+
+	table = vmalloc(buckets * sizeof(struct workingset_bucket));
+	if (!table) {
+		printk(KERN_WARNING "workingset: unable to allocate table, "
+		       "refault detection disabled\n");
+		return -ENOMEM;
+	}
+	memset(table, 0, buckets * sizeof(struct workingset_bucket));
+	workingset_mask = buckets - 1;
+	smp_wmb();
+	workingset_table = table;
+
+	printk(KERN_INFO "workingset: tracking %lu non-resident pages\n",
+	       buckets * WORKINGSET_BUCKET_SLOTS);
+	return 0;
+}
+module_init(workingset_init);